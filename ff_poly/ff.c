@@ -339,6 +339,34 @@ int ff_invsqrt (ff_t o[1], ff_t a[1], int ext)
 	return sts;
 }
 
+/*
+	Computes square roots of a[0],...,a[n-1], setting s[i]=1 and o[i]=sqrt(a[i]) if a[i] is a square and s[i]=0 otherwise.
+	Returns the number of squares.  The exponentiations a^{(m-1)/2} are performed in parallel along a common addition chain,
+	which hides the latency of the field multiplications, and the 2-Sylow part is then handled by ff_2Sylow_invsqrt as in ff_invsqrt.
+	o and a may overlap.
+*/
+int ff_parallel_sqrt (ff_t o[], ff_t a[], char s[], int n)
+{
+	ff_t b, x[FF_PARALLEL_CHAIN_MAX], y;
+	register int i, j, k, m;
+
+	ff_setup_2g();
+	for ( i = k = 0 ; i < n ; i += m ) {
+		m = ( n-i < FF_PARALLEL_CHAIN_MAX ? n-i : FF_PARALLEL_CHAIN_MAX );
+		ff_parallel_exp_chain (x, a+i, m, _ff_sqrt_chain, _ff_sqrt_chain_len);	// x[j] = a^{(m-1)/2}
+		for ( j = 0 ; j < m ; j++ ) {
+			if ( _ff_zero(a[i+j]) ) { _ff_set_zero (o[i+j]);  s[i+j] = 1;  k++;  continue; }
+			ff_mult (b, a[i+j], x[j]);
+			ff_mult (b, b, x[j]);										// b = a^m is in the 2-Sylow subgroup
+			if ( ! ff_2Sylow_invsqrt (&y, &b, 0) ) { s[i+j] = 0;  continue; }
+			ff_mult (y, y, x[j]);										// y = a^{-1/2}
+			ff_mult (o[i+j], y, a[i+j]);
+			s[i+j] = 1;  k++;
+		}
+	}
+	return k;
+}
+
 /*
    Computes a^{-1/2} for a in the 2-Sylow subgroup, computing in F_p^2 if necessary.
    Returns 0 if the root is in F_p^2, in which case o=a^{-1/2}/z as above, otherwise returns 1
@@ -680,6 +708,32 @@ void ff_exp_chain (ff_t o[1], ff_t a[1], int chain[], int len)
 	_ff_set (o[0], c);
 }
 
+// Computes o[i] = a[i]^e for i < n using the same addition chain for every a[i] (so the multiplications are independent), o and a may overlap
+void ff_parallel_exp_chain (ff_t o[], ff_t a[], int n, int chain[], int len)
+{
+	register int i, j, k, m, t;
+	ff_t b[4][FF_PARALLEL_CHAIN_MAX], c[FF_PARALLEL_CHAIN_MAX];
+
+	for ( k = 0 ; k < n ; k += m, o += m, a += m ) {
+		m = ( n-k < FF_PARALLEL_CHAIN_MAX ? n-k : FF_PARALLEL_CHAIN_MAX );
+		if ( ! len ) { for ( i = 0 ; i < m ; i++ ) _ff_set_one(o[i]);  continue; }
+		for ( i = 0 ; i < m ; i++ ) {
+			_ff_set (b[0][i], a[i]);
+			_ff_square (b[3][i],b[0][i]);
+			_ff_mult(b[1][i],b[0][i],b[3][i]);
+			_ff_mult(b[2][i],b[1][i],b[3][i]);
+			ff_mult(b[3][i],b[3][i],b[2][i]);
+		}
+		for ( i = 0 ; i < m ; i++ ) _ff_set(c[i], b[chain[0]][i]);
+		for ( t = 0 ; t < chain[1] ; t++ ) for ( i = 0 ; i < m ; i++ ) ff_square(c[i],c[i]);
+		for ( j = 2 ; j < len ; j+=2 ) {
+			for ( i = 0 ; i < m ; i++ ) ff_mult(c[i],c[i],b[chain[j]][i]);
+			for ( t = 0 ; t < chain[j+1] ; t++ ) for ( i = 0 ; i < m ; i++ ) ff_square(c[i],c[i]);
+		}
+		for ( i = 0 ; i < m ; i++ ) _ff_set (o[i], c[i]);
+	}
+}
+
 // This function is copied from mpzutil.c to make ff.c/ff.h/asm.h self-contained
 unsigned long ff_ui_inverse (unsigned long a, unsigned long m)
 {
@@ -59,6 +59,7 @@ extern "C" {
 #define FF_ITAB_SIZE				(3*FF_MONTGOMERY_RBITS+1)
 
 #define FF_MAX_CHAIN_LEN			42
+#define FF_PARALLEL_CHAIN_MAX		16				// number of elements ff_parallel_exp_chain processes in lockstep
 #define FF_BINOMIAL_MAX			16
 
 
@@ -511,7 +512,9 @@ unsigned long ff_ui_inverse (unsigned long a, unsigned long m);
 void ff_exp_ui (ff_t o[1], ff_t a[1], unsigned long e);
 int ff_precompute_exp_chain (int chain[FF_MAX_CHAIN_LEN], unsigned long e);
 void ff_exp_chain (ff_t o[1], ff_t a[1], int chain[], int len);
+void ff_parallel_exp_chain (ff_t o[], ff_t a[], int n, int chain[], int len);	// o[i] = a[i]^e for i < n, o and a may overlap
 int ff_invsqrt (ff_t o[1], ff_t a[1], int ext);							// computes 1/sqrt(a), returns 1 if sqrt is rational, 0 if sqrt is in F_p^2. 
+int ff_parallel_sqrt (ff_t o[], ff_t a[], char s[], int n);					// sets s[i]=1 and o[i]=sqrt(a[i]) if a[i] is a square, s[i]=0 otherwise, returns # squares
 void ff_setup_2g (void);	
 int ff_cbrt_invcbrt (ff_t o[1], ff_t *oi, ff_t a[1]);							// computes cbrt(a) and optionally invcbrt(a).  returns 1 for success, 0 if no cbrt in F_p
 int ff_3Sylow_invcbrt (ff_t o[1], ff_t a[1]);								// computes a^{-1/3} for a in the 3-Sylow subgroup, returns 0 if a is not a residue in the 3-Sylow
@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <gmp.h>
+#include "ff_poly.h"
+#include "hecurve.h"
+#include "prime.h"
+#include "smalljac.h"
+#include "cstd.h"
+
+/*
+    Copyright (c) 2026 The smalljac contributors
+    See LICENSE file for license details.
+*/
+
+/*
+	Checks the claim used by jac_order to filter candidate group orders in genus 2: if the 3-torsion modular polynomial of
+	y^2 = x^5+f3x^3+f2x^2+f1x+f0 is squarefree and has no roots in F_p (hecurve_g2_3tor returns 1), then 3 does not divide #J(C/F_p).
+	Also checks that a return value of 3 implies 3 | #J(C/F_p).
+
+	The group orders are computed by smalljac_Lpolys at p below smalljac_count_p(2), where a1 is obtained by point counting and
+	jac_order does not use 3-torsion information, so they do not depend on the claim being checked.
+*/
+
+#define CHECK_3TOR_MAXP		40000
+
+static long f[][4] = { {3,0,-2,1}, {-7,2,0,11}, {0,0,-1,1}, {1,1,1,1}, {5,-3,7,-2}, {-11,13,0,6}, {2,0,0,-9}, {0,4,-4,1}, {-1,0,17,3}, {9,-6,1,-5} };
+
+static unsigned long P1[CHECK_3TOR_MAXP+1];
+
+static int check_3tor_callback (smalljac_curve_t curve, unsigned long p, int good, long a[], int n, void *arg)
+{
+	if ( good && n == 2 ) P1[p] = (unsigned long)((long)(p*p+1) + (long)(p+1)*a[0] + a[1]);		// P(1) = 1+a1+a2+p*a1+p^2
+	return 1;
+}
+
+int main (int argc, char *argv[])
+{
+	smalljac_curve_t curve;
+	prime_enum_ctx_t *ctx;
+	ff_t g[6];
+	char buf[256];
+	unsigned long p;
+	long none, three, hits, errors;
+	int i, k, err, tor3;
+
+	errors = 0;
+	for ( i = 0 ; i < sizeof(f)/sizeof(f[0]) ; i++ ) {
+		sprintf (buf, "x^5+%ld*x^3+%ld*x^2+%ld*x+%ld", f[i][0], f[i][1], f[i][2], f[i][3]);
+		curve = smalljac_curve_init (buf, &err);
+		if ( ! curve ) { printf ("check_3tor: unable to create curve %s (error %d)\n", buf, err);  return 1; }
+		for ( p = 0 ; p <= CHECK_3TOR_MAXP ; p++ ) P1[p] = 0;
+		smalljac_Lpolys (curve, 11, CHECK_3TOR_MAXP, 0, check_3tor_callback, 0);
+		smalljac_curve_clear (curve);
+		none = three = hits = 0;
+		ctx = prime_enum_start (11, CHECK_3TOR_MAXP, 0);
+		while ( (p = prime_enum (ctx)) ) {
+			if ( ! P1[p] ) continue;
+			ff_setup_ui (p);
+			_ff_set_one (g[5]);  _ff_set_zero (g[4]);
+			for ( k = 0 ; k < 4 ; k++ ) _ff_set_i (g[3-k], f[i][k]);
+			tor3 = hecurve_g2_3tor (g);
+			if ( ! (P1[p]%3) ) hits++;
+			if ( tor3 == 1 ) { none++;  if ( ! (P1[p]%3) ) { printf ("check_3tor: %s at p=%lu has no 3-torsion roots but #J = %lu\n", buf, p, P1[p]);  errors++; } }
+			if ( tor3 == 3 ) { three++;  if ( P1[p]%3 ) { printf ("check_3tor: %s at p=%lu has 3-torsion roots but #J = %lu\n", buf, p, P1[p]);  errors++; } }
+		}
+		prime_enum_end (ctx);
+		printf ("%-40s %ld primes with no 3-torsion roots, %ld with 3-torsion, %ld with 3 | #J\n", buf, none, three, hits);
+	}
+	if ( errors ) { printf ("check_3tor: %ld errors\n", errors);  return 1; }
+	puts ("check_3tor: ok");
+	return 0;
+}
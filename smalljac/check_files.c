@@ -0,0 +1,193 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <gmp.h>
+#include "smalljac.h"
+#include "check_ref.h"
+#include "cstd.h"
+
+/*
+    Copyright (c) 2026 The smalljac contributors
+    See LICENSE file for license details.
+*/
+
+/*
+	Checks that L-poly data written to each of the supported file formats reads back exactly as computed by smalljac_Lpolys.
+	For each curve the records for p <= maxp (including bad primes) are written to a text file (in the format written by lpdata)
+	and to a binary file (smalljac_lpfile_create), as well as to a text file and a gzip compressed text file written by smalljac_writer
+	(with no background compression processes and with several, which must produce identical files), and each file is then read back with smalljac_lpfile_next, after seeks into
+	the middle of the file with smalljac_lpfile_seek, and with smalljac_Lpolys_from_file on a subinterval.  The records are also
+	written to columnar files (with and without SMALLJAC_COLFILE_COMPRESS), which are read back one chunk at a time, starting
+	with the chunk in the middle of the file and the chunk whose q statistics contain a norm in the middle of the range.
+	The files are written to the current directory and removed afterwards.
+*/
+
+// the genus 1 ranges span several column chunks, gzip members, and binary blocks, the genus 2 ranges several blocks
+static struct { char *curve;  unsigned long maxp; } curves[] = { {"[1,2,3,4,5]", 1UL<<21}, {"[0,0,1,-1,0]", 1UL<<21}, {"[x^5+3*x^3-2*x+1]", 1UL<<17}, {"[x^6-3*x^4+x^3+2*x+5]", 1UL<<17} };
+
+static long V[SMALLJAC_MAX_GENUS+3][SMALLJAC_COLFILE_MAX_CHUNK];
+
+// reads the records of F starting at check_R[i] until the end of the file, returns 1 if they all match
+static int check_files_read (char *filename, smalljac_lpfile_t F, long i)
+{
+	unsigned long q;
+	long a[SMALLJAC_MAX_GENUS];
+	int sts;
+
+	for ( ; (sts = smalljac_lpfile_next (F, &q, a)) != -1 ; i++ ) if ( ! check_ref_match (filename, i, q, sts > 0, a, sts) ) return 0;
+	if ( i < check_nr ) { printf ("check_files: %s ended before q=%lu\n", filename, check_R[i].q);  check_errors++;  return 0; }
+	return 1;
+}
+
+// reads filename with smalljac_lpfile_next from the start and after seeks, and with smalljac_Lpolys_from_file on a subinterval
+static void check_files_reader (char *filename)
+{
+	struct check_ref_scan ctx;
+	smalljac_lpfile_t F;
+	unsigned long start, end;
+	char *s;
+	long i, j, result;
+
+	if ( ! (F = smalljac_lpfile_open (filename)) ) { printf ("check_files: unable to open %s\n", filename);  check_errors++;  return; }
+	smalljac_lpfile_info (F, &s, &start, &end, 0, 0, 0);
+	if ( strcmp (s, check_curve) || start != 1 || end != check_maxp ) { printf ("check_files: %s has header %s %lu %lu\n", filename, s, start, end);  check_errors++; }
+	check_files_read (filename, F, 0);
+
+	// seek to a norm that is present, to one that is not, and to either end
+	for ( j = 1 ; j < 4 ; j++ ) {
+		i = (j*check_nr)/4;
+		smalljac_lpfile_seek (F, check_R[i].q);
+		if ( ! check_files_read (filename, F, i) ) { printf ("check_files: seek to %lu failed in %s\n", check_R[i].q, filename);  break; }
+		smalljac_lpfile_seek (F, check_R[i].q+1);
+		if ( ! check_files_read (filename, F, i+1) ) { printf ("check_files: seek to %lu failed in %s\n", check_R[i].q+1, filename);  break; }
+	}
+	smalljac_lpfile_seek (F, 0);
+	check_files_read (filename, F, 0);
+	smalljac_lpfile_seek (F, check_maxp+1);
+	check_files_read (filename, F, check_nr);
+	smalljac_lpfile_close (F);
+
+	// smalljac_Lpolys_from_file on the middle third of the records
+	ctx.name = filename;  ctx.i = check_nr/3;
+	result = smalljac_Lpolys_from_file (filename, check_R[check_nr/3].q, check_R[(2*check_nr)/3].q, 0, check_ref_callback, &ctx);
+	if ( result != check_R[(2*check_nr)/3].q || ctx.i != (2*check_nr)/3+1 ) { printf ("check_files: smalljac_Lpolys_from_file on %s returned %ld after %ld records\n", filename, result, ctx.i-check_nr/3);  check_errors++; }
+}
+
+// writes the records with smalljac_writer, as lpdata does
+static int check_files_write_writer (char *filename, int flags, int threads)
+{
+	smalljac_writer_t W;
+	char header[256];
+	long i;
+
+	if ( ! (W = smalljac_writer_create (filename, flags, threads)) ) return 0;
+	sprintf (header, "%s %lu %lu\n", check_curve, 1UL, check_maxp);
+	if ( ! smalljac_writer_write (W, header, strlen(header)) ) { smalljac_writer_close (W);  return 0; }
+	for ( i = 0 ; i < check_nr ; i++ ) if ( ! smalljac_writer_lpoly (W, check_R[i].q, check_R[i].n > 0, check_R[i].a, check_R[i].n) ) { smalljac_writer_close (W);  return 0; }
+	return smalljac_writer_close (W);
+}
+
+// returns 1 if the two files have the same contents
+static int check_files_same (char *file1, char *file2)
+{
+	FILE *fp1, *fp2;
+	int c1, c2;
+
+	if ( ! (fp1 = fopen (file1, "r")) ) return 0;
+	if ( ! (fp2 = fopen (file2, "r")) ) { fclose (fp1);  return 0; }
+	do { c1 = getc (fp1);  c2 = getc (fp2); } while ( c1 == c2 && c1 != EOF );
+	fclose (fp1);  fclose (fp2);
+	return ( c1 == c2 );
+}
+
+// reads chunk k of the columnar file F, whose first row should be check_R[i], returns the number of rows or -1 if they do not match
+static long check_files_col_chunk (char *filename, smalljac_colfile_t F, unsigned long k, long i, int n)
+{
+	long a[SMALLJAC_MAX_GENUS], rows, min, max, j;
+	int col, sts;
+
+	rows = smalljac_colfile_chunk_stats (F, k, SMALLJAC_COLFILE_Q_COL, &min, &max);
+	if ( rows <= 0 || i+rows > check_nr ) { printf ("check_files: chunk %lu of %s has %ld rows\n", k, filename, rows);  check_errors++;  return -1; }
+	if ( min != check_R[i].q || max != check_R[i+rows-1].q ) { printf ("check_files: chunk %lu of %s has q in [%ld,%ld], expected [%lu,%lu]\n", k, filename, min, max, check_R[i].q, check_R[i+rows-1].q);  check_errors++;  return -1; }
+	for ( col = 0 ; col < n+SMALLJAC_COLFILE_VALUE_COL ; col++ )
+		if ( smalljac_colfile_read (F, k, col, V[col]) != rows ) { printf ("check_files: error reading column %d of chunk %lu of %s\n", col, k, filename);  check_errors++;  return -1; }
+	for ( j = 0 ; j < rows ; j++ ) {
+		if ( V[SMALLJAC_COLFILE_CURVE_COL][j] || V[SMALLJAC_COLFILE_GOOD_COL][j] < 0 || V[SMALLJAC_COLFILE_GOOD_COL][j] > 1 ) {
+			printf ("check_files: %s has curve %ld good %ld at q=%ld\n", filename, V[SMALLJAC_COLFILE_CURVE_COL][j], V[SMALLJAC_COLFILE_GOOD_COL][j], V[SMALLJAC_COLFILE_Q_COL][j]);  check_errors++;  return -1;
+		}
+		sts = ( V[SMALLJAC_COLFILE_GOOD_COL][j] ? n : 0 );
+		for ( col = 0 ; col < n ; col++ ) a[col] = V[SMALLJAC_COLFILE_VALUE_COL+col][j];
+		if ( ! sts ) for ( col = 0 ; col < n ; col++ ) if ( a[col] ) { printf ("check_files: %s has nonzero values for bad q=%ld\n", filename, V[SMALLJAC_COLFILE_Q_COL][j]);  check_errors++;  return -1; }
+		if ( ! check_ref_match (filename, i+j, V[SMALLJAC_COLFILE_Q_COL][j], sts > 0, a, sts) ) return -1;
+	}
+	return rows;
+}
+
+// writes the records to a columnar file and reads them back, starting with the chunks in the middle of the file
+static void check_files_colfile (char *filename, int flags, int genus)
+{
+	smalljac_colfile_t F;
+	unsigned long rows, chunks, curves, k, m;
+	long i, j, first[64], min, max;
+	int n, fl;
+
+	if ( ! (F = smalljac_colfile_create (filename, genus, flags)) || smalljac_colfile_curve (F, check_curve) != 0 ) { printf ("check_files: error creating %s\n", filename);  check_errors++;  return; }
+	for ( i = 0 ; i < check_nr ; i++ ) if ( ! smalljac_colfile_append (F, check_R[i].q, check_R[i].n > 0, check_R[i].a, check_R[i].n) ) break;
+	if ( ! smalljac_colfile_close (F) || i < check_nr ) { printf ("check_files: error writing %s\n", filename);  check_errors++;  return; }
+
+	if ( ! (F = smalljac_colfile_open (filename)) ) { printf ("check_files: unable to open %s\n", filename);  check_errors++;  return; }
+	smalljac_colfile_info (F, &n, &fl, &rows, &chunks, &curves);
+	if ( n != genus || fl != flags || rows != check_nr || curves != 1 || chunks > 64 || strcmp (smalljac_colfile_curve_string (F, 0), check_curve) ) {
+		printf ("check_files: %s has n=%d flags=%d rows=%lu chunks=%lu curves=%lu\n", filename, n, fl, rows, chunks, curves);  check_errors++;  smalljac_colfile_close (F);  return;
+	}
+	for ( k = 0, i = 0 ; k < chunks ; k++ ) { first[k] = i;  i += smalljac_colfile_chunk_stats (F, k, SMALLJAC_COLFILE_Q_COL, 0, 0); }
+	if ( i != check_nr ) { printf ("check_files: chunks of %s hold %ld rows\n", filename, i);  check_errors++;  smalljac_colfile_close (F);  return; }
+
+	// the chunk in the middle, then the chunk holding the record in the middle of the range, then everything
+	check_files_col_chunk (filename, F, chunks/2, first[chunks/2], n);
+	for ( j = check_nr/2, k = 0 ; k < chunks ; k++ ) {
+		smalljac_colfile_chunk_stats (F, k, SMALLJAC_COLFILE_Q_COL, &min, &max);
+		if ( min <= check_R[j].q && check_R[j].q <= max ) break;
+	}
+	if ( k == chunks || j < first[k] || (k+1 < chunks && j >= first[k+1]) ) { printf ("check_files: q=%lu is not in the right chunk of %s\n", check_R[j].q, filename);  check_errors++; }
+	else check_files_col_chunk (filename, F, k, first[k], n);
+	for ( k = 0, m = 0 ; k < chunks ; k++ ) if ( check_files_col_chunk (filename, F, k, first[k], n) > 0 ) m++;
+	if ( m < chunks ) printf ("check_files: %lu of %lu chunks of %s did not match\n", chunks-m, chunks, filename);
+	smalljac_colfile_close (F);
+}
+
+int main (int argc, char *argv[])
+{
+	smalljac_curve_t c;
+	long result, bad;
+	int i, j, genus, err;
+
+	check_name = "check_files";
+	for ( i = 0 ; i < sizeof(curves)/sizeof(curves[0]) ; i++ ) {
+		c = smalljac_curve_init (curves[i].curve, &err);
+		if ( ! c ) { printf ("check_files: unable to create curve %s (error %d)\n", curves[i].curve, err);  return 1; }
+		genus = smalljac_curve_genus (c);
+		result = check_ref_run (c, curves[i].curve, curves[i].maxp, 0);
+		smalljac_curve_clear (c);
+		if ( result < 0 ) return 1;
+		for ( bad = 0, j = 0 ; j < check_nr ; j++ ) if ( ! check_R[j].good ) bad++;
+
+		if ( ! check_ref_write_text ("check_files.txt") ) { printf ("check_files: error writing check_files.txt\n");  check_errors++; } else check_files_reader ("check_files.txt");
+		if ( ! check_ref_write_binary ("check_files.lpd", genus) ) { printf ("check_files: error writing check_files.lpd\n");  check_errors++; } else check_files_reader ("check_files.lpd");
+		if ( ! check_files_write_writer ("check_files_w.txt", 0, 0) ) { printf ("check_files: error writing check_files_w.txt\n");  check_errors++; }
+		else if ( ! check_files_same ("check_files.txt", "check_files_w.txt") ) { printf ("check_files: smalljac_writer output differs from fprintf output\n");  check_errors++; }
+		else check_files_reader ("check_files_w.txt");
+		if ( ! check_files_write_writer ("check_files.txt.gz", SMALLJAC_WRITER_COMPRESS, 0) ) { printf ("check_files: error writing check_files.txt.gz\n");  check_errors++; } else check_files_reader ("check_files.txt.gz");
+		if ( ! check_files_write_writer ("check_files_w.txt.gz", SMALLJAC_WRITER_COMPRESS, 3) ) { printf ("check_files: error writing check_files_w.txt.gz\n");  check_errors++; }
+		else if ( ! check_files_same ("check_files.txt.gz", "check_files_w.txt.gz") ) { printf ("check_files: compressed output depends on the number of compression processes\n");  check_errors++; }
+		check_files_colfile ("check_files.lpc", 0, genus);
+		check_files_colfile ("check_files.lpc", SMALLJAC_COLFILE_COMPRESS, genus);
+		printf ("%-30s %ld records (%ld bad) (%ld errors)\n", check_curve, check_nr, bad, check_errors);
+	}
+	unlink ("check_files.txt");  unlink ("check_files.lpd");  unlink ("check_files.lpc");
+	unlink ("check_files_w.txt");  unlink ("check_files.txt.gz");  unlink ("check_files_w.txt.gz");
+	if ( check_errors ) { printf ("check_files: %ld errors\n", check_errors);  return 1; }
+	puts ("check_files: ok");
+	return 0;
+}
@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <gmp.h>
+#include "smalljac.h"
+#include "cstd.h"
+
+/*
+    Copyright (c) 2026 The smalljac contributors
+    See LICENSE file for license details.
+*/
+
+/*
+	Checks smalljac_nagao_sums against a direct computation of the six sums (using the definitions in smalljac.h, summed in long double
+	from the traces returned by smalljac_Lpolys), for curves of rank 0 to 3, over [1,N] and [start,N], and with a subset of the sums selected.
+	The sums computed with the curves split among 4 child processes must be identical.  Also checks early termination: curves that are
+	dropped at the first checkpoint, curves that are dropped exactly at p = end (which must not be counted as completed), and curves
+	that are never dropped.
+*/
+
+#define CHECK_NAGAO_END		1000003UL				// prime
+#define CHECK_NAGAO_TOL		1e-9
+
+static char *curves[] = { "[0,-1,1,-10,-20]", "[0,0,1,-1,0]", "[0,1,1,-2,0]", "[0,0,1,-7,6]", "[1,2,3,4,5]" };		// 11a, 37a, 389a, 5077a, and one more
+#define CHECK_NAGAO_CURVES	(sizeof(curves)/sizeof(curves[0]))
+
+struct check_nagao_ctx {
+	long double r[SMALLJAC_NAGAO_SUMS];
+	unsigned long count;
+};
+
+static long errors;
+
+static int check_nagao_callback (smalljac_curve_t c, unsigned long p, int good, long a[], int n, void *arg)
+{
+	struct check_nagao_ctx *ctx = (struct check_nagao_ctx *) arg;
+	long double x, ap, lp;
+
+	if ( ! good ) return 1;
+	x = p;  ap = -a[0];  lp = logl (x);
+	ctx->r[0] += (1.0L - (x-1.0L)/(x+1.0L-ap)) * lp;
+	ctx->r[1] += ap * lp;
+	ctx->r[2] += ap * lp / x;
+	ctx->r[3] += logl ((x+1.0L-ap)/x);
+	ctx->r[4] += ap / x;
+	ctx->r[5] += ap / sqrtl (x);
+	ctx->count++;
+	return 1;
+}
+
+// computes all six sums for curve over the good primes in [start,end] directly
+static void check_nagao_direct (double S[SMALLJAC_NAGAO_SUMS], char *curve, unsigned long start, unsigned long end)
+{
+	struct check_nagao_ctx ctx;
+	smalljac_curve_t c;
+	long double N;
+	int err;
+
+	memset (&ctx, 0, sizeof(ctx));
+	c = smalljac_curve_init (curve, &err);
+	if ( ! c ) { printf ("check_nagao: unable to create curve %s (error %d)\n", curve, err);  exit (1); }
+	smalljac_Lpolys (c, start, end, 0, check_nagao_callback, &ctx);
+	smalljac_curve_clear (c);
+	N = end;
+	S[0] = ctx.r[0];
+	S[1] = -ctx.r[1] / N;
+	S[2] = -ctx.r[2] / logl (N);
+	S[3] = ctx.r[3];
+	S[4] = -ctx.r[4];
+	S[5] = -ctx.r[5] / ctx.count;
+}
+
+// compares the sums selected by sums in S with the direct computation T (unselected sums must be 0)
+static void check_nagao_compare (char *curve, unsigned long start, unsigned long end, int sums, double S[], double T[])
+{
+	int j;
+
+	for ( j = 0 ; j < SMALLJAC_NAGAO_SUMS ; j++ ) {
+		if ( ! (sums&(1<<j)) ) { if ( S[j] != 0.0 ) { printf ("check_nagao: unselected S_%d = %f for %s\n", j+1, S[j], curve);  errors++; }  continue; }
+		if ( fabs (S[j]-T[j]) > CHECK_NAGAO_TOL * (1.0+fabs(T[j])) ) { printf ("check_nagao: S_%d for %s on [%lu,%lu] is %.12f, expected %.12f\n", j+1, curve, start, end, S[j], T[j]);  errors++; }
+	}
+}
+
+int main (int argc, char *argv[])
+{
+	static double S[SMALLJAC_NAGAO_SUMS*CHECK_NAGAO_CURVES], T[SMALLJAC_NAGAO_SUMS*CHECK_NAGAO_CURVES], U[SMALLJAC_NAGAO_SUMS*CHECK_NAGAO_CURVES];
+	double D[SMALLJAC_NAGAO_SUMS];
+	unsigned long last[CHECK_NAGAO_CURVES], V[CHECK_NAGAO_CURVES];
+	long result;
+	int i;
+
+	// all six sums over [1,N]
+	for ( i = 0 ; i < CHECK_NAGAO_CURVES ; i++ ) check_nagao_direct (T+SMALLJAC_NAGAO_SUMS*i, curves[i], 1, CHECK_NAGAO_END);
+	result = smalljac_nagao_sums (curves, CHECK_NAGAO_CURVES, 1, CHECK_NAGAO_END, SMALLJAC_NAGAO_ALL, S, last, 0, 0, 0.0);
+	if ( result != CHECK_NAGAO_CURVES ) { printf ("check_nagao: smalljac_nagao_sums returned %ld\n", result);  errors++; }
+	for ( i = 0 ; i < CHECK_NAGAO_CURVES ; i++ ) {
+		if ( last[i] != CHECK_NAGAO_END ) { printf ("check_nagao: last = %lu for %s\n", last[i], curves[i]);  errors++; }
+		check_nagao_compare (curves[i], 1, CHECK_NAGAO_END, SMALLJAC_NAGAO_ALL, S+SMALLJAC_NAGAO_SUMS*i, T+SMALLJAC_NAGAO_SUMS*i);
+		printf ("%-20s S = %9.4f %7.4f %7.4f %8.4f %7.4f %7.4f\n", curves[i], S[6*i], S[6*i+1], S[6*i+2], S[6*i+3], S[6*i+4], S[6*i+5]);
+	}
+
+	// the curves split among 4 child processes give exactly the same results
+	memcpy (U, S, sizeof(S));  memcpy (V, last, sizeof(last));
+	setenv ("SMALLJAC_THREADS", "4", 1);
+	result = smalljac_nagao_sums (curves, CHECK_NAGAO_CURVES, 1, CHECK_NAGAO_END, SMALLJAC_NAGAO_ALL, S, last, 0, 0, 0.0);
+	unsetenv ("SMALLJAC_THREADS");
+	if ( result != CHECK_NAGAO_CURVES || memcmp (U, S, sizeof(S)) || memcmp (V, last, sizeof(last)) ) { printf ("check_nagao: smalljac_nagao_sums with 4 processes returned %ld and different sums\n", result);  errors++; }
+
+	// with a threshold that no curve falls below the results are the same
+	result = smalljac_nagao_sums (curves, CHECK_NAGAO_CURVES, 1, CHECK_NAGAO_END, SMALLJAC_NAGAO_ALL, S, last, 1000, 2, -1e300);
+	if ( result != CHECK_NAGAO_CURVES ) { printf ("check_nagao: smalljac_nagao_sums with threshold -1e300 returned %ld\n", result);  errors++; }
+	for ( i = 0 ; i < CHECK_NAGAO_CURVES ; i++ ) check_nagao_compare (curves[i], 1, CHECK_NAGAO_END, SMALLJAC_NAGAO_ALL, S+SMALLJAC_NAGAO_SUMS*i, T+SMALLJAC_NAGAO_SUMS*i);
+
+	// S_2 and S_5 only, over [start,N]
+	for ( i = 0 ; i < CHECK_NAGAO_CURVES ; i++ ) check_nagao_direct (T+SMALLJAC_NAGAO_SUMS*i, curves[i], 10007, CHECK_NAGAO_END);
+	result = smalljac_nagao_sums (curves, CHECK_NAGAO_CURVES, 10007, CHECK_NAGAO_END, SMALLJAC_NAGAO_S2|SMALLJAC_NAGAO_S5, S, last, 0, 0, 0.0);
+	if ( result != CHECK_NAGAO_CURVES ) { printf ("check_nagao: smalljac_nagao_sums on [10007,%lu] returned %ld\n", CHECK_NAGAO_END, result);  errors++; }
+	for ( i = 0 ; i < CHECK_NAGAO_CURVES ; i++ ) check_nagao_compare (curves[i], 10007, CHECK_NAGAO_END, SMALLJAC_NAGAO_S2|SMALLJAC_NAGAO_S5, S+SMALLJAC_NAGAO_SUMS*i, T+SMALLJAC_NAGAO_SUMS*i);
+
+	// every curve is dropped at the first checkpoint, the first prime >= 1+1000, and the sums are those for [1,1009]
+	result = smalljac_nagao_sums (curves, CHECK_NAGAO_CURVES, 1, CHECK_NAGAO_END, SMALLJAC_NAGAO_ALL, S, last, 1000, 1, 1e300);
+	if ( result != 0 ) { printf ("check_nagao: smalljac_nagao_sums with threshold 1e300 returned %ld\n", result);  errors++; }
+	for ( i = 0 ; i < CHECK_NAGAO_CURVES ; i++ ) {
+		if ( last[i] != 1009 ) { printf ("check_nagao: %s was dropped at %lu, expected 1009\n", curves[i], last[i]);  errors++; }
+		check_nagao_direct (D, curves[i], 1, 1009);
+		check_nagao_compare (curves[i], 1, 1009, SMALLJAC_NAGAO_ALL, S+SMALLJAC_NAGAO_SUMS*i, D);
+	}
+
+	// every curve is dropped at the checkpoint p = end, none of them completed
+	result = smalljac_nagao_sums (curves, CHECK_NAGAO_CURVES, 1, CHECK_NAGAO_END, SMALLJAC_NAGAO_ALL, S, last, CHECK_NAGAO_END-1, 3, 1e300);
+	if ( result != 0 ) { printf ("check_nagao: %ld curves dropped at p = end were counted as completed\n", result);  errors++; }
+	for ( i = 0 ; i < CHECK_NAGAO_CURVES ; i++ ) if ( last[i] != CHECK_NAGAO_END ) { printf ("check_nagao: %s was dropped at %lu, expected %lu\n", curves[i], last[i], CHECK_NAGAO_END);  errors++; }
+
+	if ( errors ) { printf ("check_nagao: %ld errors\n", errors);  return 1; }
+	puts ("check_nagao: ok");
+	return 0;
+}
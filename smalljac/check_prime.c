@@ -0,0 +1,193 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gmp.h>
+#include "prime.h"
+
+/*
+    Copyright (c) 2026 The smalljac contributors
+    See LICENSE file for license details.
+*/
+
+/*
+	Checks prime_enum, prime_enum_mod, prime_enum_powers, and prime_bpsw against a simple sieve of Eratosthenes on [0,10^7] and
+	on windows near 2^50.  Just below 2^64, where a reference sieve would need all the primes up to 2^32, the windows are checked
+	by sieving with the primes up to 2^22 and testing the survivors with GMP's mpz_probab_prime_p.
+*/
+
+#define CHECK_PRIME_MAX			10000000UL
+#define CHECK_PRIME_WINDOW		(1UL<<20)
+#define CHECK_PRIME_WINDOW64		(1UL<<16)
+
+static long errors;
+
+// sets s[i] = 1 iff start+i is prime for 0 <= i <= end-start by sieving with the np primes in pr, which must include every prime up to
+// sqrt(end) if full is set, otherwise the survivors are tested with mpz_probab_prime_p
+static void sieve_window (unsigned char *s, unsigned long start, unsigned long end, unsigned long *pr, long np, int full)
+{
+	register unsigned long p, n, i;
+	register long j;
+	mpz_t x;
+
+	memset (s, 1, end-start+1);
+	for ( n = start ; n < 2 && n <= end ; n++ ) s[n-start] = 0;
+	for ( j = 0 ; j < np ; j++ ) {
+		p = pr[j];
+		if ( full && p > end/p ) break;
+		n = ( start <= p ? 2*p : ((start+p-1)/p)*p );
+		for ( ; n <= end && n >= start ; n += p ) s[n-start] = 0;
+	}
+	if ( full ) return;
+	mpz_init (x);
+	for ( i = 0 ; i <= end-start ; i++ ) if ( s[i] ) { mpz_set_ui (x, start+i);  s[i] = ( mpz_probab_prime_p (x, 40) ? 1 : 0 ); }
+	mpz_clear (x);
+}
+
+// returns k such that q = p^k, or 0 if q is not a power of p
+static int ui_pp_exp (unsigned long q, unsigned long p)
+{
+	int k;
+
+	for ( k = 0 ; ! (q % p) ; q /= p, k++ );
+	return ( q == 1 ? k : 0 );
+}
+
+// compares prime_enum on [start,end] with the reference s
+static void check_enum (unsigned char *s, unsigned long start, unsigned long end)
+{
+	prime_enum_ctx_t *ctx;
+	unsigned long p, n;
+
+	ctx = prime_enum_start (start, end, 0);
+	n = start;
+	while ( (p = prime_enum (ctx)) ) {
+		if ( p < n || p > end ) { printf ("check_prime: prime_enum on [%lu,%lu] returned %lu out of order\n", start, end, p);  errors++;  break; }
+		for ( ; n < p ; n++ ) if ( s[n-start] ) { printf ("check_prime: prime_enum on [%lu,%lu] missed %lu\n", start, end, n);  errors++;  break; }
+		if ( ! s[p-start] ) { printf ("check_prime: prime_enum on [%lu,%lu] returned composite %lu\n", start, end, p);  errors++; }
+		if ( p == end ) { n = end;  break; }
+		n = p+1;
+	}
+	prime_enum_end (ctx);
+	for ( ; n < end ; n++ ) if ( s[n-start] ) break;					// n < end avoids wrapping at end = 2^64-1
+	if ( s[n-start] && n != p ) { printf ("check_prime: prime_enum on [%lu,%lu] stopped before %lu\n", start, end, n);  errors++; }
+}
+
+static int ui_cmp (const void *a, const void *b)
+	{ return ( *(unsigned long *)a < *(unsigned long *)b ? -1 : ( *(unsigned long *)a > *(unsigned long *)b ? 1 : 0 ) ); }
+
+// returns 1 if n mod m is one of the k sorted classes in c
+static int in_classes (unsigned long n, unsigned long m, unsigned long c[], int k)
+	{ n %= m;  return ( bsearch (&n, c, k, sizeof(c[0]), ui_cmp) ? 1 : 0 ); }
+
+// compares prime_enum_mod on [start,end] with the primes in the reference s that lie in one of the classes r[0],...,r[k-1] mod m
+static void check_enum_mod (unsigned char *s, unsigned long start, unsigned long end, unsigned long m, unsigned long r[], int k)
+{
+	prime_enum_mod_ctx_t *ctx;
+	unsigned long *c;
+	unsigned long p, n;
+	int i;
+
+	c = malloc (k*sizeof(*c));
+	for ( i = 0 ; i < k ; i++ ) c[i] = r[i]%m;
+	qsort (c, k, sizeof(*c), ui_cmp);
+	ctx = prime_enum_mod_start (start, end, m, r, k);
+	n = start;
+	while ( (p = prime_enum_mod (ctx)) ) {
+		if ( p < n || p > end ) { printf ("check_prime: prime_enum_mod (m=%lu) on [%lu,%lu] returned %lu out of order\n", m, start, end, p);  errors++;  break; }
+		for ( ; n < p ; n++ ) if ( s[n-start] && in_classes (n, m, c, k) ) { printf ("check_prime: prime_enum_mod (m=%lu) on [%lu,%lu] missed %lu\n", m, start, end, n);  errors++;  break; }
+		if ( ! s[p-start] || ! in_classes (p, m, c, k) ) { printf ("check_prime: prime_enum_mod (m=%lu) on [%lu,%lu] returned %lu\n", m, start, end, p);  errors++; }
+		if ( p == end ) { n = end;  break; }
+		n = p+1;
+	}
+	prime_enum_mod_end (ctx);
+	for ( ; n < end ; n++ ) if ( s[n-start] && in_classes (n, m, c, k) ) break;
+	if ( s[n-start] && in_classes (n, m, c, k) && n != p ) { printf ("check_prime: prime_enum_mod (m=%lu) on [%lu,%lu] stopped before %lu\n", m, start, end, n);  errors++; }
+	free (c);
+}
+
+// runs check_enum_mod for a fixed list of moduli and residue sets, including m = 1 and classes that are not coprime to m,
+// and for a CRT modulus (47#) that is too large for a bitmap of classes, with 64 classes taken from primes in [start,end]
+static void check_enum_mods (unsigned char *s, unsigned long start, unsigned long end)
+{
+	static unsigned long r1[] = {0}, r2[] = {1}, r3[] = {1,3}, r4[] = {2,3,5,7}, r5[] = {0,2,5}, r6[] = {1,7,11,13,17,19,23,29}, r7[] = {3,4,9,10,12};
+	static unsigned long r8[] = {5,14,99,1000,30029}, r9[] = {6,35}, r10[] = {13,1,25,5};
+	unsigned long r11[64], m, n, w, j;
+	int i;
+
+	check_enum_mod (s, start, end, 1, r1, 1);
+	check_enum_mod (s, start, end, 2, r2, 1);
+	check_enum_mod (s, start, end, 4, r3, 1);
+	check_enum_mod (s, start, end, 4, r3+1, 1);
+	check_enum_mod (s, start, end, 12, r4, 4);
+	check_enum_mod (s, start, end, 10, r5, 3);
+	check_enum_mod (s, start, end, 30, r6, 8);
+	check_enum_mod (s, start, end, 13, r7, 5);
+	check_enum_mod (s, start, end, 30030, r8, 5);
+	check_enum_mod (s, start, end, 210, r9, 2);
+	check_enum_mod (s, start, end, 12, r10, 4);
+	m = 614889782588491410UL;
+	for ( w = 0, j = 0 ; j <= end-start ; j++ ) w += s[j];
+	for ( i = 0, n = 0, j = 0 ; j <= end-start && i < 64 ; j++ ) if ( s[j] && ! (n++ % (w/64+1)) ) r11[i++] = (start+j) % m;			// spread over [start,end]
+	check_enum_mod (s, start, end, m, r11, i);
+}
+
+int main (int argc, char *argv[])
+{
+	prime_enum_ctx_t *ctx;
+	unsigned char *s, *t;
+	unsigned long *pr, start, end, p, q, n;
+	long np, i;
+
+	// reference sieve on [0,CHECK_PRIME_MAX], and the primes up to 2^25 for the windows near 2^50
+	s = malloc ((1UL<<25)+1);
+	memset (s, 1, (1UL<<25)+1);  s[0] = s[1] = 0;
+	for ( n = 2 ; n*n <= (1UL<<25) ; n++ ) if ( s[n] ) for ( p = n*n ; p <= (1UL<<25) ; p += n ) s[p] = 0;
+	pr = malloc (2200000*sizeof(*pr));
+	for ( np = 0, n = 2 ; n <= (1UL<<25) ; n++ ) if ( s[n] ) pr[np++] = n;
+
+	check_enum (s, 0, CHECK_PRIME_MAX);
+	check_enum (s+1000003, 1000003, 1000003);
+	check_enum (s+9999000, 9999000, 9999990);
+	for ( n = 0 ; n <= CHECK_PRIME_MAX ; n++ ) if ( prime_bpsw (n) != s[n] ) { printf ("check_prime: prime_bpsw(%lu) = %d\n", n, prime_bpsw(n));  errors++;  break; }
+	check_enum_mods (s, 0, CHECK_PRIME_MAX);
+	check_enum_mods (s+123457, 123457, 2345678);
+	printf ("checked [0,%lu] (%ld errors)\n", CHECK_PRIME_MAX, errors);
+
+	// prime powers up to 10^6, in increasing order
+	for ( i = 0, p = 2 ; p <= 1000000 ; p++ ) if ( s[p] ) for ( q = p ; q <= 1000000 ; q *= p ) i++;
+	ctx = prime_enum_start (0, 1000000, 20);
+	for ( q = 0 ; (p = prime_enum_powers (ctx)) ; q = p, i-- ) {
+		n = ( prime_enum_base (ctx) ? prime_enum_base (ctx) : p );
+		if ( p <= q || ! s[n] || prime_enum_exp (ctx) != ui_pp_exp (p, n) ) { printf ("check_prime: prime_enum_powers returned %lu with exponent %d\n", p, prime_enum_exp (ctx));  errors++;  break; }
+	}
+	prime_enum_end (ctx);
+	if ( i ) { printf ("check_prime: prime_enum_powers missed %ld prime powers\n", i);  errors++; }
+
+	// windows near 2^50
+	t = malloc (CHECK_PRIME_WINDOW+1);
+	for ( i = 0 ; i < 3 ; i++ ) {
+		start = (1UL<<50) + ( i == 0 ? 0 : ( i == 1 ? 123456789 : -CHECK_PRIME_WINDOW-1 ) );  end = start + CHECK_PRIME_WINDOW;
+		sieve_window (t, start, end, pr, np, 1);
+		check_enum (t, start, end);
+		check_enum_mods (t, start, end);
+		for ( n = start ; n <= end ; n++ ) if ( prime_bpsw (n) != t[n-start] ) { printf ("check_prime: prime_bpsw(%lu) = %d\n", n, prime_bpsw(n));  errors++;  break; }
+	}
+	printf ("checked windows near 2^50 (%ld errors)\n", errors);
+
+	// windows just below 2^64
+	for ( np = 0 ; pr[np] < (1UL<<22) ; np++ );
+	for ( i = 0 ; i < 2 ; i++ ) {
+		end = ( i ? ~0UL - 987654321 : ~0UL );  start = end - CHECK_PRIME_WINDOW64;
+		sieve_window (t, start, end, pr, np, 0);
+		check_enum (t, start, end);
+		check_enum_mods (t, start, end);
+		for ( n = start ; n < end ; n++ ) if ( prime_bpsw (n) != t[n-start] ) { printf ("check_prime: prime_bpsw(%lu) = %d\n", n, prime_bpsw(n));  errors++;  break; }
+		if ( prime_bpsw (end) != t[end-start] ) { printf ("check_prime: prime_bpsw(%lu) = %d\n", end, prime_bpsw(end));  errors++; }
+	}
+	printf ("checked windows below 2^64 (%ld errors)\n", errors);
+
+	free (s);  free (t);  free (pr);
+	if ( errors ) { printf ("check_prime: %ld errors\n", errors);  return 1; }
+	puts ("check_prime: ok");
+	return 0;
+}
@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <gmp.h>
+#include "prime.h"
+
+/*
+    Copyright (c) 2026 The smalljac contributors
+    See LICENSE file for license details.
+*/
+
+/*
+	Checks prime files (see prime_save_file in prime.c).  We sieve the small prime tables, build a prime table in memory, and record what
+	nth_small_prime, small_prime_pi, prime_enum, and prime_enum_mod return, then save the tables to a file, drop the small prime tables,
+	and set SMALLJAC_PRIME_FILE, so that prime_setup maps them from the file.  With the mapped tables the results must be the same,
+	as must the prime table loaded by prime_load_file (and one built from the mapped tables).  Finally the file is truncated, after
+	which it must be rejected and prime_setup must fall back to sieving (expect two complaints about it on stderr).
+*/
+
+#define CHECK_PRIMETAB_PI			1000000					// number of primes in the prime table (p_2,...,p_PI)
+#define CHECK_PRIMETAB_MAX			10000000UL				// prime_enum is compared on [0,CHECK_PRIMETAB_MAX]
+#define CHECK_PRIMETAB_WINDOW		(1UL<<20)				// and on [2^40,2^40+CHECK_PRIMETAB_WINDOW]
+#define CHECK_PRIMETAB_MAX_PRIMES	700000					// pi(10^7) = 664579
+
+static int P[PRIME_SMALL_PRIMES+1], Pi[PRIME_MAX_SMALL_INTEGER+1];
+static unsigned long E[CHECK_PRIMETAB_MAX_PRIMES], W[CHECK_PRIMETAB_MAX_PRIMES], M[CHECK_PRIMETAB_MAX_PRIMES];
+static long ne, nw, nm;
+static unsigned long classes[] = {1,4,7,11,13,14};						// prime_enum_mod is compared for these classes mod 15
+static long errors;
+
+// records the primes in [start,end] (or just those in the classes r[0],...,r[k-1] mod m if m is nonzero) in p, returns the number of primes
+static long check_primetab_enum (unsigned long p[], unsigned long start, unsigned long end, unsigned long m, unsigned long r[], int k)
+{
+	prime_enum_ctx_t *ctx;
+	prime_enum_mod_ctx_t *mctx;
+	long n, q;
+
+	n = 0;
+	if ( m ) {
+		mctx = prime_enum_mod_start (start, end, m, r, k);
+		while ( (q = prime_enum_mod (mctx)) && n < CHECK_PRIMETAB_MAX_PRIMES ) p[n++] = q;
+		prime_enum_mod_end (mctx);
+	} else {
+		ctx = prime_enum_start (start, end, 0);
+		while ( (q = prime_enum (ctx)) && n < CHECK_PRIMETAB_MAX_PRIMES ) p[n++] = q;
+		prime_enum_end (ctx);
+	}
+	return n;
+}
+
+// compares prime_enum or prime_enum_mod on [start,end] with the n primes in p
+static void check_primetab_enum_compare (char *what, unsigned long p[], long n, unsigned long start, unsigned long end, unsigned long m, unsigned long r[], int k)
+{
+	static unsigned long q[CHECK_PRIMETAB_MAX_PRIMES];
+	long i, j;
+
+	j = check_primetab_enum (q, start, end, m, r, k);
+	for ( i = 0 ; i < n && i < j && p[i] == q[i] ; i++ );
+	if ( i < n || j != n ) { printf ("check_primetab: %s tables, prime_enum%s on [%lu,%lu] differs at prime %ld\n", what, ( m ? "_mod" : "" ), start, end, i);  errors++; }
+}
+
+// compares the small prime tables and prime enumeration with the reference
+static void check_primetab_compare (char *what)
+{
+	long i;
+
+	for ( i = 1 ; i <= PRIME_SMALL_PRIMES && nth_small_prime (i) == P[i] ; i++ );
+	if ( i <= PRIME_SMALL_PRIMES ) { printf ("check_primetab: %s tables, nth_small_prime(%ld) = %d, expected %d\n", what, i, nth_small_prime (i), P[i]);  errors++; }
+	for ( i = 0 ; i <= PRIME_MAX_SMALL_INTEGER && small_prime_pi (i) == Pi[i] ; i++ );
+	if ( i <= PRIME_MAX_SMALL_INTEGER ) { printf ("check_primetab: %s tables, small_prime_pi(%ld) = %d, expected %d\n", what, i, small_prime_pi (i), Pi[i]);  errors++; }
+	check_primetab_enum_compare (what, E, ne, 0, CHECK_PRIMETAB_MAX, 0, 0, 0);
+	check_primetab_enum_compare (what, W, nw, 1UL<<40, (1UL<<40)+CHECK_PRIMETAB_WINDOW, 0, 0, 0);
+	check_primetab_enum_compare (what, M, nm, 0, CHECK_PRIMETAB_MAX, 15, classes, sizeof(classes)/sizeof(classes[0]));
+}
+
+// compares the prime table tab with the reference table ref
+static void check_primetab_table (char *what, prime_table_t tab, prime_table_t ref)
+{
+	unsigned char *g1, *g2;
+	long i, x;
+
+	if ( tab->si != ref->si || tab->ti != ref->ti || tab->sp != ref->sp || tab->tp != ref->tp ) {
+		printf ("check_primetab: %s prime table covers p_%ld = %ld to p_%ld = %ld, expected p_%ld = %ld to p_%ld = %ld\n", what, tab->si, tab->sp, tab->ti, tab->tp, ref->si, ref->sp, ref->ti, ref->tp);
+		errors++;  return;
+	}
+	for ( i = ref->si ; i <= ref->ti && prime_table_nth_prime (tab, i) == prime_table_nth_prime (ref, i) ; i++ );
+	if ( i <= ref->ti ) { printf ("check_primetab: %s prime table has p_%ld = %ld, expected %ld\n", what, i, prime_table_nth_prime (tab, i), prime_table_nth_prime (ref, i));  errors++; }
+	for ( x = 0 ; x <= ref->tp+1 ; x += 997 ) {
+		if ( prime_table_pi (tab, x) != prime_table_pi (ref, x) ) { printf ("check_primetab: %s prime table has pi(%ld) = %ld, expected %ld\n", what, x, prime_table_pi (tab, x), prime_table_pi (ref, x));  errors++;  break; }
+		if ( prime_table_next_gap (tab, &g1, x) != prime_table_next_gap (ref, &g2, x) || (g1 ? g1-tab->gaps : -1) != (g2 ? g2-ref->gaps : -1) ) { printf ("check_primetab: %s prime table, next prime after %ld differs\n", what, x);  errors++;  break; }
+	}
+}
+
+int main (int argc, char *argv[])
+{
+	prime_table_t ref, tab;
+	char name[64];
+	struct stat st;
+	int *p0;
+	long i;
+
+	// reference results with the sieved tables
+	unsetenv ("SMALLJAC_PRIME_FILE");
+	p0 = prime_small_primes ();
+	for ( i = 1 ; i <= PRIME_SMALL_PRIMES ; i++ ) P[i] = nth_small_prime (i);
+	for ( i = 0 ; i <= PRIME_MAX_SMALL_INTEGER ; i++ ) Pi[i] = small_prime_pi (i);
+	ne = check_primetab_enum (E, 0, CHECK_PRIMETAB_MAX, 0, 0, 0);
+	nw = check_primetab_enum (W, 1UL<<40, (1UL<<40)+CHECK_PRIMETAB_WINDOW, 0, 0, 0);
+	nm = check_primetab_enum (M, 0, CHECK_PRIMETAB_MAX, 15, classes, sizeof(classes)/sizeof(classes[0]));
+	prime_table_init (ref, 2, CHECK_PRIMETAB_PI);
+	printf ("reference: %ld primes up to %lu, %ld in the window at 2^40, %ld in the classes mod 15, p_%ld = %ld\n", ne, CHECK_PRIMETAB_MAX, nw, nm, ref->ti, ref->tp);
+
+	sprintf (name, "check_primetab_%d.dat", (int) getpid());
+	if ( ! prime_save_file (name, ref) ) { printf ("check_primetab: unable to save prime file %s\n", name);  return 1; }
+
+	// small prime tables mapped from the file via SMALLJAC_PRIME_FILE
+	prime_cleanup ();
+	setenv ("SMALLJAC_PRIME_FILE", name, 1);
+	if ( prime_small_primes () == p0 ) { printf ("check_primetab: SMALLJAC_PRIME_FILE=%s was not used\n", name);  errors++; }
+	check_primetab_compare ("mapped");
+	if ( ! prime_load_file (name, tab) ) { printf ("check_primetab: prime_load_file failed on %s\n", name);  errors++; }
+	else { check_primetab_table ("mapped", tab, ref);  prime_table_clear (tab); }
+	prime_table_init (tab, 2, CHECK_PRIMETAB_PI);
+	check_primetab_table ("rebuilt", tab, ref);
+	prime_table_clear (tab);
+	printf ("checked mapped tables (%ld errors)\n", errors);
+
+	// a truncated file must be rejected
+	prime_cleanup ();
+	if ( stat (name, &st) < 0 || truncate (name, st.st_size/2) < 0 ) { printf ("check_primetab: unable to truncate %s\n", name);  errors++; }
+	if ( prime_small_primes () != p0 ) { printf ("check_primetab: truncated prime file %s was used\n", name);  errors++; }
+	check_primetab_compare ("sieved");
+	if ( prime_load_file (name, tab) ) { printf ("check_primetab: prime_load_file accepted the truncated file %s\n", name);  errors++;  prime_table_clear (tab); }
+	printf ("checked truncated file (%ld errors)\n", errors);
+
+	unsetenv ("SMALLJAC_PRIME_FILE");
+	unlink (name);
+	prime_table_clear (ref);
+	if ( errors ) { printf ("check_primetab: %ld errors\n", errors);  return 1; }
+	puts ("check_primetab: ok");
+	return 0;
+}
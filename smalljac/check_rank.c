@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <gmp.h>
+#include "smalljac.h"
+#include "cstd.h"
+
+/*
+    Copyright (c) 2026 The smalljac contributors
+    See LICENSE file for license details.
+*/
+
+/*
+	Regression checks for smalljac_analytic_rank_bound with X = 10^6 on the first curves of rank 0, 1, 2, and 3 (11a, 37a, 389a, 5077a).
+	The conductor must be computed exactly, the bound must lie in [r,r+1) (it is an upper bound on the analytic rank r under GRH, and at
+	this X it is sharp enough to determine r), and it must match the value recorded below.  Also checks 32a, which has additive reduction
+	at 2, so the conductor computed from the model is only an upper bound (the function must return 0), both for the minimal model and for
+	a non-minimal one, and that specifying N = 32 makes the conductor exact and bounds the rank by 0.  Finally the bound for 37a with
+	X = 2^22 computed by 4 child processes (each summing an interval) must agree with the one computed by a single process.
+*/
+
+#define CHECK_RANK_X		1000000
+#define CHECK_RANK_TOL		1e-6
+#define CHECK_RANK_PARALLEL_X	(1UL<<22)
+
+static struct { char *curve;  unsigned long N;  int r;  double bound; } curves[] = {
+	{ "[0,-1,1,-10,-20]", 11, 0, 0.001671821003 },					// 11a
+	{ "[0,0,1,-1,0]", 37, 1, 1.003204899985 },						// 37a
+	{ "[0,1,1,-2,0]", 389, 2, 2.010013474018 },						// 389a
+	{ "[0,0,1,-7,6]", 5077, 3, 3.019257482107 },					// 5077a
+};
+
+static char *curves32[] = { "[0,0,0,4,0]", "[0,0,0,64,0]" };					// 32a, minimal and non-minimal (scaled by u = 2) models
+
+int main (int argc, char *argv[])
+{
+	smalljac_curve_t c;
+	double bound, bound4, logN;
+	long errors;
+	int i, err, exact;
+
+	errors = 0;
+	for ( i = 0 ; i < sizeof(curves)/sizeof(curves[0]) ; i++ ) {
+		c = smalljac_curve_init (curves[i].curve, &err);
+		if ( ! c ) { printf ("check_rank: unable to create curve %s (error %d)\n", curves[i].curve, err);  return 1; }
+		exact = smalljac_analytic_rank_bound (c, 0, CHECK_RANK_X, &bound, &logN);
+		smalljac_curve_clear (c);
+		printf ("%-20s N = %8.2f, bound = %.12f (%s)\n", curves[i].curve, exp(logN), bound, ( exact == 1 ? "exact" : "conductor bound" ));
+		if ( exact != 1 || fabs (logN - log ((double) curves[i].N)) > 1e-12 ) { printf ("check_rank: returned %d with N = %f for %s, expected exact N = %lu\n", exact, exp(logN), curves[i].curve, curves[i].N);  errors++; }
+		if ( bound < curves[i].r || bound >= curves[i].r+1 ) { printf ("check_rank: bound %f for %s is not in [%d,%d)\n", bound, curves[i].curve, curves[i].r, curves[i].r+1);  errors++; }
+		if ( fabs (bound - curves[i].bound) > CHECK_RANK_TOL ) { printf ("check_rank: bound %.12f for %s differs from the recorded value %.12f\n", bound, curves[i].curve, curves[i].bound);  errors++; }
+	}
+	for ( i = 0 ; i < sizeof(curves32)/sizeof(curves32[0]) ; i++ ) {
+		c = smalljac_curve_init (curves32[i], &err);
+		if ( ! c ) { printf ("check_rank: unable to create curve %s (error %d)\n", curves32[i], err);  return 1; }
+		exact = smalljac_analytic_rank_bound (c, 0, CHECK_RANK_X, &bound, &logN);
+		printf ("%-20s N <= %7.2f, bound = %.12f (%s)\n", curves32[i], exp(logN), bound, ( exact == 1 ? "exact" : "conductor bound" ));
+		if ( exact != 0 || logN < log (32.0) - 1e-12 ) { printf ("check_rank: returned %d with N = %f for %s, expected an upper bound on N = 32\n", exact, exp(logN), curves32[i]);  errors++; }
+		exact = smalljac_analytic_rank_bound (c, 32, CHECK_RANK_X, &bound, &logN);
+		smalljac_curve_clear (c);
+		if ( exact != 1 || bound < 0.0 || bound >= 1.0 ) { printf ("check_rank: returned %d with bound %f for %s with N = 32\n", exact, bound, curves32[i]);  errors++; }
+	}
+	c = smalljac_curve_init (curves[1].curve, &err);
+	setenv ("SMALLJAC_THREADS", "1", 1);
+	smalljac_analytic_rank_bound (c, 0, CHECK_RANK_PARALLEL_X, &bound, &logN);
+	setenv ("SMALLJAC_THREADS", "4", 1);
+	smalljac_analytic_rank_bound (c, 0, CHECK_RANK_PARALLEL_X, &bound4, &logN);
+	unsetenv ("SMALLJAC_THREADS");
+	smalljac_curve_clear (c);
+	printf ("%-20s X = 2^22, bound = %.12f (1 process), %.12f (4 processes)\n", curves[1].curve, bound, bound4);
+	if ( fabs (bound - bound4) > 1e-12 ) { printf ("check_rank: bound %.15f for %s with 4 processes differs from %.15f\n", bound4, curves[1].curve, bound);  errors++; }
+	if ( errors ) { printf ("check_rank: %ld errors\n", errors);  return 1; }
+	puts ("check_rank: ok");
+	return 0;
+}
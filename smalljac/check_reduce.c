@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <gmp.h>
+#include "smalljac.h"
+#include "check_ref.h"
+#include "cstd.h"
+
+/*
+    Copyright (c) 2026 The smalljac contributors
+    See LICENSE file for license details.
+*/
+
+/*
+	Checks smalljac_Lpolys_reduce_file and smalljac_Lpolys_reduce_files against sequential scans with smalljac_Lpolys_from_file(s).
+	For each curve the records of a single run of smalljac_Lpolys for [1,maxp] are written to a text file, a binary file, and a set of
+	4 binary job files (holding every 4th record), and reduced over [1,maxp] and a subinterval with SMALLJAC_THREADS set to 1 and to 4
+	(in which case the callbacks must be made in child processes).  The reduced state holds integer sums (which do not depend on how
+	the records are split among the children) and must be identical to the state of the sequential scan.  We also compare
+	smalljac_moments_file and smalljac_nagao_sums_file (for the elliptic curve) with smalljac_moments and smalljac_nagao_sums,
+	which must agree up to rounding.  The files are written to the current directory and removed afterwards.
+*/
+
+#define CHECK_REDUCE_JOBS			4
+#define CHECK_REDUCE_MOMENTS		5
+#define CHECK_REDUCE_EPSILON		1e-9
+
+static struct { char *curve;  unsigned long maxp; } curves[] = { {"[0,0,1,-1,0]", 1UL<<20}, {"[x^5+3*x^3-2*x+1]", 1UL<<16} };
+static char *threads[] = { "1", "4" };
+
+struct check_reduce_state {
+	long records, good, forked;							// forked is nonzero if any callback was made in a child process
+	unsigned long qsum, qhash;
+	long asum[SMALLJAC_MAX_GENUS], asq[SMALLJAC_MAX_GENUS];
+};
+
+static pid_t parent;
+
+static int check_reduce_callback (smalljac_curve_t c, unsigned long q, int good, long a[], int n, void *arg)
+{
+	struct check_reduce_state *s = (struct check_reduce_state *) arg;
+	int k;
+
+	s->records++;
+	s->qsum += q;  s->qhash ^= q*0x9E3779B97F4A7C15UL;
+	if ( getpid() != parent ) s->forked = 1;
+	if ( ! good ) return 1;
+	s->good++;
+	for ( k = 0 ; k < n ; k++ ) { s->asum[k] += a[k];  s->asq[k] += a[k]*a[k]; }
+	return 1;
+}
+
+static void check_reduce_merge (void *state, void *child_state)
+{
+	struct check_reduce_state *s = (struct check_reduce_state *) state, *t = (struct check_reduce_state *) child_state;
+	int k;
+
+	s->records += t->records;  s->good += t->good;  s->forked |= t->forked;
+	s->qsum += t->qsum;  s->qhash ^= t->qhash;
+	for ( k = 0 ; k < SMALLJAC_MAX_GENUS ; k++ ) { s->asum[k] += t->asum[k];  s->asq[k] += t->asq[k]; }
+}
+
+// compares the reduced state with the sequential one
+static void check_reduce_compare (char *what, char *name, unsigned long start, unsigned long end, long r1, struct check_reduce_state *s1, long r2, struct check_reduce_state *s2, int procs)
+{
+	long n;
+
+	n = check_ref_index (end+1) - check_ref_index (start);
+	if ( r2 != end || s2->records != n ) { printf ("check_reduce: sequential scan of %s on [%lu,%lu] returned %ld after %ld of %ld records\n", name, start, end, r2, s2->records, n);  check_errors++;  return; }
+	if ( r1 != n ) { printf ("check_reduce: %s on %s on [%lu,%lu] with %d processes returned %ld, expected %ld records\n", what, name, start, end, procs, r1, n);  check_errors++;  return; }
+	if ( (procs > 1) != (s1->forked != 0) ) { printf ("check_reduce: %s on %s with %d processes made its callbacks in the %s process\n", what, name, procs, ( s1->forked ? "child" : "parent" ));  check_errors++; }
+	s1->forked = s2->forked;
+	if ( memcmp (s1, s2, sizeof(*s1)) ) { printf ("check_reduce: %s on %s on [%lu,%lu] with %d processes differs from the sequential scan\n", what, name, start, end, procs);  check_errors++; }
+}
+
+// reduces over the single file name and compares with smalljac_Lpolys_from_file
+static void check_reduce_file (char *name, unsigned long start, unsigned long end, unsigned long flags, int procs)
+{
+	struct check_reduce_state s1, s2;
+	long r1, r2;
+
+	memset (&s1, 0, sizeof(s1));  memset (&s2, 0, sizeof(s2));
+	r1 = smalljac_Lpolys_reduce_file (name, start, end, flags, check_reduce_callback, &s1, sizeof(s1), check_reduce_merge);
+	r2 = smalljac_Lpolys_from_file (name, start, end, flags, check_reduce_callback, &s2);
+	check_reduce_compare ("smalljac_Lpolys_reduce_file", name, start, end, r1, &s1, r2, &s2, procs);
+}
+
+// reduces over the job files prefix_jobs_j and compares with smalljac_Lpolys_from_files
+static void check_reduce_files (char *prefix, int jobs, unsigned long start, unsigned long end, unsigned long flags, int procs)
+{
+	struct check_reduce_state s1, s2;
+	long r1, r2;
+
+	memset (&s1, 0, sizeof(s1));  memset (&s2, 0, sizeof(s2));
+	r1 = smalljac_Lpolys_reduce_files (prefix, jobs, start, end, flags, check_reduce_callback, &s1, sizeof(s1), check_reduce_merge);
+	r2 = smalljac_Lpolys_from_files (prefix, jobs, start, end, flags, check_reduce_callback, &s2);
+	check_reduce_compare ("smalljac_Lpolys_reduce_files", prefix, start, end, r1, &s1, r2, &s2, procs);
+}
+
+// writes the reference records to jobs binary job files prefix_jobs_j.lpd, record i goes in job i mod jobs
+static int check_reduce_write_jobs (char *prefix, int jobs, int genus)
+{
+	smalljac_lpfile_t F;
+	char name[256];
+	long i;
+	int j;
+
+	for ( j = 0 ; j < jobs ; j++ ) {
+		sprintf (name, "%s_%d_%d.lpd", prefix, jobs, j);
+		if ( ! (F = smalljac_lpfile_create (name, check_curve, 1, check_maxp, genus, genus)) ) return 0;
+		for ( i = j ; i < check_nr ; i += jobs ) if ( ! smalljac_lpfile_append (F, check_R[i].q, check_R[i].good, check_R[i].a, check_R[i].n) ) { smalljac_lpfile_close (F);  return 0; }
+		if ( ! smalljac_lpfile_close (F) ) return 0;
+	}
+	return 1;
+}
+
+static int check_reduce_close (double x, double y)
+	{ return fabs (x-y) <= CHECK_REDUCE_EPSILON * (1.0 + fabs (y)); }
+
+// compares smalljac_moments_file on name with smalljac_moments on the curve
+static void check_reduce_moments (smalljac_curve_t c, char *name, unsigned long start, unsigned long end, int n, int procs)
+{
+	double m1[SMALLJAC_MAX_GENUS*CHECK_REDUCE_MOMENTS], m2[SMALLJAC_MAX_GENUS*CHECK_REDUCE_MOMENTS];
+	char st1[16], st2[16];
+	long result;
+	int i;
+
+	st1[0] = st2[0] = '\0';
+	result = smalljac_moments_file (name, start, end, m1, n, CHECK_REDUCE_MOMENTS, st1);
+	smalljac_moments (c, start, end, m2, n, CHECK_REDUCE_MOMENTS, st2, 0, 0);
+	if ( result != check_ref_index (end+1) - check_ref_index (start) ) { printf ("check_reduce: smalljac_moments_file on %s with %d processes returned %ld\n", name, procs, result);  check_errors++;  return; }
+	for ( i = 0 ; i < n*CHECK_REDUCE_MOMENTS && check_reduce_close (m1[i], m2[i]) ; i++ );
+	if ( i < n*CHECK_REDUCE_MOMENTS ) { printf ("check_reduce: smalljac_moments_file on %s with %d processes has moment %d = %f, expected %f\n", name, procs, i, m1[i], m2[i]);  check_errors++; }
+	if ( strcmp (st1, st2) ) { printf ("check_reduce: smalljac_moments_file on %s with %d processes identified %s, expected %s\n", name, procs, st1, st2);  check_errors++; }
+}
+
+// compares smalljac_nagao_sums_file on name with smalljac_nagao_sums on the curve
+static void check_reduce_nagao (char *name, unsigned long start, unsigned long end, int procs)
+{
+	double S1[SMALLJAC_NAGAO_SUMS], S2[SMALLJAC_NAGAO_SUMS];
+	unsigned long last;
+	long result;
+	int i;
+
+	result = smalljac_nagao_sums_file (name, start, end, SMALLJAC_NAGAO_ALL, S1);
+	smalljac_nagao_sums (&check_curve, 1, start, end, SMALLJAC_NAGAO_ALL, S2, &last, 0, 0, 0.0);
+	if ( result != end || last != end ) { printf ("check_reduce: smalljac_nagao_sums_file on %s with %d processes returned %ld (bound %lu)\n", name, procs, result, last);  check_errors++;  return; }
+	for ( i = 0 ; i < SMALLJAC_NAGAO_SUMS && check_reduce_close (S1[i], S2[i]) ; i++ );
+	if ( i < SMALLJAC_NAGAO_SUMS ) { printf ("check_reduce: smalljac_nagao_sums_file on %s with %d processes has S_%d = %f, expected %f\n", name, procs, i+1, S1[i], S2[i]);  check_errors++; }
+}
+
+int main (int argc, char *argv[])
+{
+	static char *files[] = { "check_reduce.txt", "check_reduce.lpd" };
+	smalljac_curve_t c;
+	char name[256];
+	unsigned long maxp, start, end;
+	int i, j, k, procs, genus, err;
+
+	check_name = "check_reduce";
+	parent = getpid();
+	for ( i = 0 ; i < sizeof(curves)/sizeof(curves[0]) ; i++ ) {
+		maxp = curves[i].maxp;
+		c = smalljac_curve_init (curves[i].curve, &err);
+		if ( ! c ) { printf ("check_reduce: unable to create curve %s (error %d)\n", curves[i].curve, err);  return 1; }
+		genus = smalljac_curve_genus (c);
+		if ( check_ref_run (c, curves[i].curve, maxp, 0) < 0 ) return 1;
+		if ( ! check_ref_write_text (files[0]) || ! check_ref_write_binary (files[1], genus) || ! check_reduce_write_jobs ("check_reduce_jobs", CHECK_REDUCE_JOBS, genus) ) {
+			printf ("check_reduce: error writing data files for %s\n", curves[i].curve);  return 1;
+		}
+		for ( k = 0 ; k < sizeof(threads)/sizeof(threads[0]) ; k++ ) {
+			setenv ("SMALLJAC_THREADS", threads[k], 1);
+			procs = atoi (threads[k]);
+			for ( j = 0 ; j < 2 ; j++ ) {
+				start = ( j ? maxp/3 : 1 );  end = ( j ? maxp/2 : maxp );
+				check_reduce_file (files[0], start, end, 0, procs);
+				check_reduce_file (files[1], start, end, 0, procs);
+				check_reduce_file (files[1], start, end, SMALLJAC_A1_ONLY, procs);
+				check_reduce_files ("check_reduce_jobs", CHECK_REDUCE_JOBS, start, end, 0, procs);
+				check_reduce_moments (c, files[j], start, end, genus, procs);
+				if ( genus == 1 ) check_reduce_nagao (files[j], start, end, procs);
+			}
+		}
+		unsetenv ("SMALLJAC_THREADS");
+		smalljac_curve_clear (c);
+		printf ("%-30s %ld records (%ld errors)\n", curves[i].curve, check_nr, check_errors);
+	}
+	unlink (files[0]);  unlink (files[1]);
+	for ( j = 0 ; j < CHECK_REDUCE_JOBS ; j++ ) { sprintf (name, "check_reduce_jobs_%d_%d.lpd", CHECK_REDUCE_JOBS, j);  unlink (name); }
+	if ( check_errors ) { printf ("check_reduce: %ld errors\n", check_errors);  return 1; }
+	puts ("check_reduce: ok");
+	return 0;
+}
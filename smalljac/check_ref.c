@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gmp.h>
+#include "smalljac.h"
+#include "check_ref.h"
+#include "cstd.h"
+
+/*
+    Copyright (c) 2026 The smalljac contributors
+    See LICENSE file for license details.
+*/
+
+struct check_ref_record check_R[CHECK_REF_MAX_RECORDS];
+long check_nr, check_errors;
+char *check_name = "check";
+char *check_curve;
+unsigned long check_maxp;
+
+static int check_ref_record_callback (smalljac_curve_t c, unsigned long q, int good, long a[], int n, void *arg)
+{
+	struct check_ref_record *r;
+
+	if ( check_nr == CHECK_REF_MAX_RECORDS ) { printf ("%s: too many records\n", check_name);  return 0; }
+	r = check_R + check_nr++;
+	r->q = q;  r->good = good;  r->n = ( good || *(int *)arg ? n : 0 );
+	memcpy (r->a, a, r->n*sizeof(a[0]));
+	return 1;
+}
+
+long check_ref_run (smalljac_curve_t c, char *curve, unsigned long maxp, int bad)
+{
+	long result;
+
+	check_curve = curve;  check_maxp = maxp;  check_nr = 0;
+	result = smalljac_Lpolys (c, 1, maxp, 0, check_ref_record_callback, &bad);
+	if ( result < 0 ) printf ("%s: smalljac_Lpolys returned %ld for %s\n", check_name, result, curve);
+	return result;
+}
+
+long check_ref_index (unsigned long q)
+{
+	long i, j, k;
+
+	for ( i = 0, j = check_nr ; i < j ; ) { k = (i+j)/2;  if ( check_R[k].q < q ) i = k+1; else j = k; }
+	return i;
+}
+
+int check_ref_match (char *name, long i, unsigned long q, int good, long a[], int n)
+{
+	int k;
+
+	if ( i >= check_nr ) { printf ("%s: %s has an extra record at q=%lu (n=%d)\n", check_name, name, q, n);  check_errors++;  return 0; }
+	if ( n < 0 ) { printf ("%s: %s returned %d where q=%lu was expected\n", check_name, name, n, check_R[i].q);  check_errors++;  return 0; }
+	if ( q != check_R[i].q || good != check_R[i].good || n != check_R[i].n ) {
+		printf ("%s: %s has q=%lu (good=%d, n=%d) where q=%lu (good=%d, n=%d) was expected\n", check_name, name, q, good, n, check_R[i].q, check_R[i].good, check_R[i].n);
+		check_errors++;  return 0;
+	}
+	for ( k = 0 ; k < n ; k++ ) if ( a[k] != check_R[i].a[k] ) { printf ("%s: %s has a[%d] = %ld at q=%lu, expected %ld\n", check_name, name, k, a[k], q, check_R[i].a[k]);  check_errors++;  return 0; }
+	return 1;
+}
+
+int check_ref_callback (smalljac_curve_t c, unsigned long q, int good, long a[], int n, void *arg)
+{
+	struct check_ref_scan *scan = (struct check_ref_scan *) arg;
+
+	return check_ref_match (scan->name, scan->i++, q, good, a, ( good ? n : 0 ));
+}
+
+int check_ref_write_text (char *filename)
+{
+	FILE *fp;
+	long i;
+	int k;
+
+	if ( ! (fp = fopen (filename, "w")) ) return 0;
+	fprintf (fp, "%s %lu %lu\n", check_curve, 1UL, check_maxp);
+	for ( i = 0 ; i < check_nr ; i++ ) {
+		fprintf (fp, "%lu", check_R[i].q);
+		if ( ! check_R[i].good ) fputs (",?", fp);
+		for ( k = 0 ; k < check_R[i].n ; k++ ) fprintf (fp, ",%ld", check_R[i].a[k]);
+		fputc ('\n', fp);
+	}
+	return ( fclose (fp) == 0 );
+}
+
+int check_ref_write_binary (char *filename, int genus)
+{
+	smalljac_lpfile_t F;
+	long i;
+
+	if ( ! (F = smalljac_lpfile_create (filename, check_curve, 1, check_maxp, genus, genus)) ) return 0;
+	for ( i = 0 ; i < check_nr ; i++ ) if ( ! smalljac_lpfile_append (F, check_R[i].q, check_R[i].good, check_R[i].a, check_R[i].n) ) { smalljac_lpfile_close (F);  return 0; }
+	return smalljac_lpfile_close (F);
+}
@@ -0,0 +1,43 @@
+#ifndef _CHECK_REF_INCLUDE_
+#define _CHECK_REF_INCLUDE_
+
+#include "smalljac.h"
+
+/*
+    Copyright (c) 2026 The smalljac contributors
+    See LICENSE file for license details.
+*/
+
+/*
+	Reference runs shared by the checks of the L-poly data files and the store (check_files, check_store, check_reshard, check_reduce).
+	check_ref_run records what smalljac_Lpolys returns for [1,maxp] in check_R[0],...,check_R[check_nr-1], and the records read back
+	by the check are compared with these by check_ref_match, which reports mismatches prefixed by check_name and counts them in check_errors.
+*/
+
+#define CHECK_REF_MAX_RECORDS		156000				// pi(2^21) = 155611
+
+struct check_ref_record {
+	unsigned long q;
+	int good, n;										// n is 0 at bad primes unless the run kept the coefficients reported there (e.g. the trace of an elliptic curve)
+	long a[SMALLJAC_MAX_GENUS];
+};
+
+extern struct check_ref_record check_R[CHECK_REF_MAX_RECORDS];
+extern long check_nr, check_errors;
+extern char *check_name;								// set by the check, prefixes its messages
+extern char *check_curve;								// curve and maxp of the last reference run
+extern unsigned long check_maxp;
+
+long check_ref_run (smalljac_curve_t c, char *curve, unsigned long maxp, int bad);		// bad nonzero keeps coefficients at bad primes, returns the result of smalljac_Lpolys
+long check_ref_index (unsigned long q);													// index of the first record with norm >= q (check_nr if none)
+int check_ref_match (char *name, long i, unsigned long q, int good, long a[], int n);		// 1 if (q,good,a[0..n-1]) matches check_R[i], n < 0 is a read error
+int check_ref_callback (smalljac_curve_t c, unsigned long q, int good, long a[], int n, void *arg);	// matches records read from data files, arg points to a struct check_ref_scan
+int check_ref_write_text (char *filename);												// writes the records (of a run that did not keep bad coefficients) as lpdata does, returns 1 if successful
+int check_ref_write_binary (char *filename, int genus);									// same with smalljac_lpfile_create and smalljac_lpfile_append
+
+struct check_ref_scan {
+	char *name;											// file(s) being scanned
+	long i;												// index of the record expected next
+};
+
+#endif
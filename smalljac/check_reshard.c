@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <gmp.h>
+#include "smalljac.h"
+#include "check_ref.h"
+#include "cstd.h"
+
+/*
+    Copyright (c) 2026 The smalljac contributors
+    See LICENSE file for license details.
+*/
+
+/*
+	Checks smalljac_reshard against a single run of smalljac_Lpolys.  For each curve we write the data for [1,maxp] as 4 job files,
+	the way lpdata does (in a mix of text, compressed text, and binary formats), reshard them 4 -> 2 (binary) -> 8 (compressed text)
+	-> 1 (text), and also 4 -> 1 (columnar) directly.  Every intermediate data set is read with smalljac_Lpolys_from_files and the final
+	files are read record by record, and all of them must match the single run.  We also reshard a subinterval to a single binary file.
+	The files are written to the current directory and removed afterwards.
+*/
+
+static struct { char *curve;  unsigned long maxp; } curves[] = { {"[0,0,1,-1,0]", 1UL<<20}, {"[x^5+3*x^3-2*x+1]", 1UL<<16} };
+
+struct check_reshard_ctx {
+	void *out;												// writer or lpfile for job files
+};
+
+static int check_reshard_text_callback (smalljac_curve_t c, unsigned long q, int good, long a[], int n, void *arg)
+	{ return smalljac_writer_lpoly (((struct check_reshard_ctx *)arg)->out, q, good, a, ( good ? n : 0 )); }
+
+static int check_reshard_binary_callback (smalljac_curve_t c, unsigned long q, int good, long a[], int n, void *arg)
+	{ return smalljac_lpfile_append (((struct check_reshard_ctx *)arg)->out, q, good, a, ( good ? n : 0 )); }
+
+// writes job file jobid of jobs for [1,maxp] as lpdata would, in the format given by suffix
+static int check_reshard_write_job (smalljac_curve_t c, int genus, int jobs, int jobid, char *suffix)
+{
+	struct check_reshard_ctx ctx;
+	char name[256], header[256];
+	unsigned long flags;
+	long result;
+	int i, sts;
+
+	for ( i = 1 ; (1<<i) < jobs ; i++ );
+	flags = ((1UL<<i)-1) << (SMALLJAC_SPLIT_SHIFT+1);
+	flags |= (unsigned long)jobid << (SMALLJAC_HIGH_SHIFT+1);
+	sprintf (name, "check_reshard_lpdata_%d_%d.%s", jobs, jobid, suffix);
+	if ( ! strcmp (suffix, "lpd") ) {
+		if ( ! (ctx.out = smalljac_lpfile_create (name, check_curve, 1, check_maxp, genus, genus)) ) return 0;
+		result = smalljac_Lpolys (c, 1, check_maxp, flags, check_reshard_binary_callback, &ctx);
+		sts = smalljac_lpfile_close (ctx.out);
+	} else {
+		if ( ! (ctx.out = smalljac_writer_create (name, ( strcmp (suffix, "txt") ? SMALLJAC_WRITER_COMPRESS : 0 ), 0)) ) return 0;
+		sprintf (header, "%s %lu %lu %d %d\n", check_curve, 1UL, check_maxp, jobs, jobid);
+		smalljac_writer_write (ctx.out, header, strlen(header));
+		result = smalljac_Lpolys (c, 1, check_maxp, flags, check_reshard_text_callback, &ctx);
+		sts = smalljac_writer_close (ctx.out);
+	}
+	return ( sts && result == check_maxp );
+}
+
+// checks the data set prefix_jobs_j.ext against the reference using smalljac_Lpolys_from_files
+static void check_reshard_files (char *prefix, int jobs)
+{
+	struct check_ref_scan ctx;
+	long result;
+
+	ctx.name = prefix;  ctx.i = 0;
+	result = smalljac_Lpolys_from_files (prefix, jobs, 1, check_maxp, 0, check_ref_callback, &ctx);
+	if ( result != check_maxp || ctx.i != check_nr ) { printf ("check_reshard: smalljac_Lpolys_from_files on %s (%d jobs) returned %ld after %ld records\n", prefix, jobs, result, ctx.i);  check_errors++; }
+}
+
+// checks the single file name against check_R[i],...,check_R[j-1] by reading it record by record
+static void check_reshard_file (char *name, long i, long j)
+{
+	smalljac_lpfile_t F;
+	unsigned long q;
+	long a[SMALLJAC_MAX_GENUS];
+	int sts;
+
+	if ( ! (F = smalljac_lpfile_open (name)) ) { printf ("check_reshard: unable to open %s\n", name);  check_errors++;  return; }
+	for ( ; (sts = smalljac_lpfile_next (F, &q, a)) != -1 && i < j ; i++ ) if ( ! check_ref_match (name, i, q, sts > 0, a, sts) ) break;
+	if ( i < j || sts != -1 ) { printf ("check_reshard: %s does not end at record %ld\n", name, j);  check_errors++; }
+	smalljac_lpfile_close (F);
+}
+
+// checks the columnar file name against the reference
+static void check_reshard_colfile (char *name, int n)
+{
+	static long v[SMALLJAC_MAX_GENUS+3][SMALLJAC_COLFILE_MAX_CHUNK];
+	smalljac_colfile_t F;
+	unsigned long rows, chunks, k;
+	long a[SMALLJAC_MAX_GENUS], m, i, j;
+	int col;
+
+	if ( ! (F = smalljac_colfile_open (name)) ) { printf ("check_reshard: unable to open %s\n", name);  check_errors++;  return; }
+	smalljac_colfile_info (F, 0, 0, &rows, &chunks, 0);
+	if ( rows != check_nr ) { printf ("check_reshard: %s has %lu rows, expected %ld\n", name, rows, check_nr);  check_errors++; }
+	for ( k = 0, i = 0 ; k < chunks ; k++ ) {
+		m = smalljac_colfile_chunk_stats (F, k, SMALLJAC_COLFILE_Q_COL, 0, 0);
+		for ( col = 0 ; col < n+SMALLJAC_COLFILE_VALUE_COL ; col++ )
+			if ( smalljac_colfile_read (F, k, col, v[col]) != m ) { printf ("check_reshard: error reading column %d of chunk %lu of %s\n", col, k, name);  check_errors++;  m = 0;  break; }
+		for ( j = 0 ; j < m ; j++, i++ ) {
+			for ( col = 0 ; col < n ; col++ ) a[col] = v[SMALLJAC_COLFILE_VALUE_COL+col][j];
+			if ( ! check_ref_match (name, i, v[SMALLJAC_COLFILE_Q_COL][j], v[SMALLJAC_COLFILE_GOOD_COL][j], a, ( v[SMALLJAC_COLFILE_GOOD_COL][j] ? n : 0 )) ) { k = chunks;  break; }
+		}
+	}
+	smalljac_colfile_close (F);
+}
+
+// runs smalljac_reshard and checks the number of records written
+static void check_reshard (char *prefix, int injobs, char *outprefix, int outjobs, int format, unsigned long start, unsigned long end, long records)
+{
+	long result;
+
+	result = smalljac_reshard (prefix, injobs, outprefix, outjobs, format, start, end, 0);
+	if ( result != records ) { printf ("check_reshard: resharding %s (%d jobs) to %s (%d jobs) returned %ld, expected %ld records\n", prefix, injobs, outprefix, outjobs, result, records);  check_errors++; }
+}
+
+static void check_reshard_cleanup (void)
+{
+	static char *suffix[] = { "txt", "txt.gz", "lpd", "lpc" };
+	static char *prefix[] = { "check_reshard_lpdata", "check_reshard_a", "check_reshard_b" };
+	char name[256];
+	int i, j, k, jobs;
+
+	for ( i = 0 ; i < 4 ; i++ ) {
+		for ( j = 0 ; j < 3 ; j++ ) for ( jobs = 2 ; jobs <= 8 ; jobs *= 2 ) for ( k = 0 ; k < jobs ; k++ ) { sprintf (name, "%s_%d_%d.%s", prefix[j], jobs, k, suffix[i]);  unlink (name); }
+		sprintf (name, "check_reshard_c.%s", suffix[i]);  unlink (name);
+		sprintf (name, "check_reshard_d.%s", suffix[i]);  unlink (name);
+		sprintf (name, "check_reshard_e.%s", suffix[i]);  unlink (name);
+	}
+}
+
+int main (int argc, char *argv[])
+{
+	static char *suffix[] = { "txt", "txt.gz", "lpd", "txt" };
+	smalljac_curve_t c;
+	char *curve;
+	unsigned long maxp;
+	long i, j;
+	int k, genus, err;
+
+	check_name = "check_reshard";
+	for ( k = 0 ; k < sizeof(curves)/sizeof(curves[0]) ; k++ ) {
+		curve = curves[k].curve;  maxp = curves[k].maxp;
+		c = smalljac_curve_init (curve, &err);
+		if ( ! c ) { printf ("check_reshard: unable to create curve %s (error %d)\n", curve, err);  return 1; }
+		genus = smalljac_curve_genus (c);
+		if ( check_ref_run (c, curve, maxp, 0) < 0 ) return 1;
+		for ( i = 0 ; i < 4 ; i++ ) if ( ! check_reshard_write_job (c, genus, 4, i, suffix[i]) ) { printf ("check_reshard: error writing job %ld of 4\n", i);  check_errors++; }
+		smalljac_curve_clear (c);
+		check_reshard_files ("check_reshard_lpdata", 4);
+
+		// 4 -> 2 -> 8 -> 1
+		check_reshard ("check_reshard_lpdata", 4, "check_reshard_a", 2, SMALLJAC_FORMAT_BINARY, 0, 0, check_nr);
+		check_reshard_files ("check_reshard_a", 2);
+		check_reshard ("check_reshard_a", 2, "check_reshard_b", 8, SMALLJAC_FORMAT_GZIP, 0, 0, check_nr);
+		check_reshard_files ("check_reshard_b", 8);
+		check_reshard ("check_reshard_b", 8, "check_reshard_c", 0, SMALLJAC_FORMAT_TEXT, 0, 0, check_nr);
+		check_reshard_file ("check_reshard_c.txt", 0, check_nr);
+
+		// 4 -> 1 directly, and a subinterval
+		check_reshard ("check_reshard_lpdata", 4, "check_reshard_d", 0, SMALLJAC_FORMAT_COLUMNAR, 0, 0, check_nr);
+		check_reshard_colfile ("check_reshard_d.lpc", genus);
+		i = check_ref_index (maxp/3);  j = check_ref_index (maxp/2+1);
+		check_reshard ("check_reshard_b", 8, "check_reshard_e", 0, SMALLJAC_FORMAT_BINARY, maxp/3, maxp/2, j-i);
+		check_reshard_file ("check_reshard_e.lpd", i, j);
+		check_reshard_cleanup ();
+		printf ("%-30s %ld records (%ld errors)\n", curve, check_nr, check_errors);
+	}
+	if ( check_errors ) { printf ("check_reshard: %ld errors\n", check_errors);  return 1; }
+	puts ("check_reshard: ok");
+	return 0;
+}
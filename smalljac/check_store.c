@@ -0,0 +1,156 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <gmp.h>
+#include "smalljac.h"
+#include "check_ref.h"
+#include "cstd.h"
+
+/*
+    Copyright (c) 2026 The smalljac contributors
+    See LICENSE file for license details.
+*/
+
+/*
+	Checks the L-series store (see smalljac_store.c) against records computed with the store disabled.  For each curve we
+
+		1) fill the store with [1,maxp/2],
+		2) fork a child that requests [maxp/2+1,maxp] and is killed (SIGKILL) in the middle, leaving a partial temporary file,
+		3) request [1000,maxp], which must replay the first half and compute (and store) the second,
+		4) truncate the segment file for [1,maxp/2] and request [1,maxp], which must replay the second half and recompute
+		   (and store again) the first,
+		5) request [1,maxp] once more, which must replay everything.
+
+	After each step the records returned (including any coefficients reported at bad primes) must match the reference, and the store statistics must show how many were replayed
+	and how many were computed.  The store is created in a temporary directory under the current directory and removed afterwards.
+*/
+
+static struct { char *curve;  unsigned long maxp; } curves[] = { {"[1,2,3,4,5]", 1UL<<20}, {"[x^5+3*x^3-2*x+1]", 1UL<<17} };
+
+static unsigned long kill_q;
+
+// compares each callback with the next reference record, *(long *)arg is the index of the record expected next
+static int check_store_callback (smalljac_curve_t c, unsigned long q, int good, long a[], int n, void *arg)
+{
+	long *pi = (long *) arg;
+
+	if ( kill_q && q >= kill_q ) kill (getpid(), SIGKILL);
+	return check_ref_match ("smalljac_Lpolys", (*pi)++, q, good, a, n);
+}
+
+// requests [start,end] from smalljac_Lpolys with the store enabled and checks the records returned and the number of records replayed and computed
+static void check_store_request (smalljac_curve_t c, unsigned long start, unsigned long end, long stored, long computed)
+{
+	unsigned long s0, c0, s1, c1;
+	long i, j, result;
+
+	smalljac_store_stats (&s0, &c0);
+	i = check_ref_index (start);  j = check_ref_index (end+1);
+	result = smalljac_Lpolys (c, start, end, 0, check_store_callback, &i);
+	smalljac_store_stats (&s1, &c1);
+	if ( result != end || i != j ) { printf ("check_store: request for [%lu,%lu] returned %ld after %ld of %ld records\n", start, end, result, i-check_ref_index(start), j-check_ref_index(start));  check_errors++; }
+	if ( s1-s0 != stored || c1-c0 != computed ) { printf ("check_store: request for [%lu,%lu] replayed %lu and computed %lu records, expected %ld and %ld\n", start, end, s1-s0, c1-c0, stored, computed);  check_errors++; }
+}
+
+// removes the store directory (which contains one directory per curve)
+static void check_store_remove (char *dir)
+{
+	char path[512], name[1024];
+	struct dirent *e, *f;
+	DIR *d, *d2;
+
+	if ( ! (d = opendir (dir)) ) return;
+	while ( (e = readdir (d)) ) {
+		if ( ! strcmp (e->d_name, ".") || ! strcmp (e->d_name, "..") ) continue;
+		snprintf (path, sizeof(path), "%s/%s", dir, e->d_name);
+		if ( (d2 = opendir (path)) ) {
+			while ( (f = readdir (d2)) ) if ( strcmp (f->d_name, ".") && strcmp (f->d_name, "..") ) { snprintf (name, sizeof(name), "%s/%s", path, f->d_name);  unlink (name); }
+			closedir (d2);
+			rmdir (path);
+		} else {
+			unlink (path);
+		}
+	}
+	closedir (d);
+	rmdir (dir);
+}
+
+// finds a file in a curve directory of the store whose name starts with prefix, sets path and returns 1 if there is one
+static int check_store_find (char *dir, char *prefix, char path[1024])
+{
+	char sub[512];
+	struct dirent *e, *f;
+	DIR *d, *d2;
+	int found;
+
+	found = 0;
+	if ( ! (d = opendir (dir)) ) return 0;
+	while ( ! found && (e = readdir (d)) ) {
+		if ( e->d_name[0] == '.' ) continue;
+		snprintf (sub, sizeof(sub), "%s/%s", dir, e->d_name);
+		if ( ! (d2 = opendir (sub)) ) continue;
+		while ( (f = readdir (d2)) ) if ( ! strncmp (f->d_name, prefix, strlen(prefix)) ) { snprintf (path, 1024, "%s/%s", sub, f->d_name);  found = 1;  break; }
+		closedir (d2);
+	}
+	closedir (d);
+	return found;
+}
+
+int main (int argc, char *argv[])
+{
+	smalljac_curve_t c;
+	char dir[64], path[1024], name[64];
+	unsigned long maxp, half;
+	struct stat st;
+	long n1, n2;
+	pid_t pid;
+	int i, err, status;
+
+	check_name = "check_store";
+	strcpy (dir, "check_store_XXXXXX");
+	if ( ! mkdtemp (dir) ) { printf ("check_store: unable to create a temporary directory\n");  return 1; }
+	for ( i = 0 ; i < sizeof(curves)/sizeof(curves[0]) ; i++ ) {
+		maxp = curves[i].maxp;  half = maxp/2;
+		c = smalljac_curve_init (curves[i].curve, &err);
+		if ( ! c ) { printf ("check_store: unable to create curve %s (error %d)\n", curves[i].curve, err);  return 1; }
+		smalljac_store_disable ();
+		if ( check_ref_run (c, curves[i].curve, maxp, 1) < 0 ) return 1;
+		n1 = check_ref_index (half+1);										// records in [1,half]
+		n2 = check_ref_index (1000);											// records in [1,999]
+		if ( ! smalljac_store_enable (dir) ) { printf ("check_store: unable to enable store in %s\n", dir);  return 1; }
+
+		// 1) fill the store with the first half
+		check_store_request (c, 1, half, 0, n1);
+
+		// 2) kill a child in the middle of computing the second half
+		fflush (0);
+		if ( ! (pid = fork()) ) { kill_q = half + half/2;  smalljac_Lpolys (c, half+1, maxp, 0, check_store_callback, &n1);  exit (0); }
+		if ( pid < 0 ) { printf ("check_store: fork failed\n");  return 1; }
+		waitpid (pid, &status, 0);
+		if ( ! WIFSIGNALED(status) || WTERMSIG(status) != SIGKILL ) { printf ("check_store: child was not killed (status %d)\n", status);  check_errors++; }
+		if ( ! check_store_find (dir, ".tmp_", path) ) { printf ("check_store: the killed child did not leave a temporary file\n");  check_errors++; }
+
+		// 3) replay the first half (from 1000) and compute the second
+		check_store_request (c, 1000, maxp, n1-n2, check_nr-n1);
+
+		// 4) truncate the segment for the first half, it must be ignored (and replaced)
+		sprintf (name, "%lu_%lu_", 1UL, half);
+		if ( ! check_store_find (dir, name, path) || stat (path, &st) < 0 || truncate (path, st.st_size/2) < 0 ) { printf ("check_store: unable to truncate segment %s\n", name);  check_errors++; }
+		check_store_request (c, 1, maxp, check_nr-n1, n1);
+
+		// 5) everything is replayed
+		check_store_request (c, 1, maxp, check_nr, 0);
+		smalljac_curve_clear (c);
+		printf ("%-30s %ld records (%ld errors)\n", curves[i].curve, check_nr, check_errors);
+	}
+	smalljac_store_disable ();
+	check_store_remove (dir);
+	if ( check_errors ) { printf ("check_store: %ld errors\n", check_errors);  return 1; }
+	puts ("check_store: ok");
+	return 0;
+}
@@ -140,7 +140,7 @@ void hc_poly_standardize (hc_poly *c)
 			}
 			ff_poly_monic(c->f,0,c->f,c->d);		// note that deg 2g+1 coefficient cannot also be zero (ow curve is singular)
 		}
-		if ( ! _ff_zero (c->f[c->d-1]) && (_ff_p%c->d)) {
+		if ( ! _ff_zero (c->f[c->d-1]) && (c->d%_ff_p)) {
 			// translate so 2g coefficient is 0
 			ff_invert_small_int(&t,c->d);
 			_ff_mult(s,t,c->f[c->d-1]); _ff_neg(t,s);
@@ -167,7 +167,7 @@ void hc_poly_standardize (hc_poly *c)
 	_ff_mult(s,s,t);
 	_ff_set(c->f[c->d],t);
 	for ( i = 0 ; i < c->d ; i++ ) _ff_mult(c->f[i],c->f[i],s);
-	if ( ! _ff_zero (c->f[c->d-1]) && (_ff_p%c->d) ) {
+	if ( ! _ff_zero (c->f[c->d-1]) && (c->d%_ff_p) ) {
 		// translate by -f[d-1]/(d*f[d]) so that f[d-1] is zero
 		ff_nonresidue_inverse(&s);
 		ff_invert_small_int(&t,c->d);
@@ -46,6 +46,24 @@ static char buf[4096];
 // needed to double pts in random 
 void hecurve_g2_square_1 (ff_t u[3], ff_t v[2], ff_t u0, ff_t v0, ff_t f[6]);
 
+// same as hecurve_make_2 but with w = 1/(x1-x2) supplied by the caller
+static inline void _hecurve_make_2 (ff_t u[3], ff_t v[2], ff_t x1, ff_t y1, ff_t x2, ff_t y2, ff_t w)
+{
+	register ff_t t1, t2, t3;
+
+	// Construct u(x) = (x-x_1)(x-x_2) has roots x1 and x2 then construct v(x) so that v(x_i) = y_i ensuring u|v^2-f (note h =0)
+	_ff_set_one(u[2]);						// u[2] = 1
+	_ff_add(t1,x1,x2);
+	_ff_neg(u[1],t1);						// u[1] = -(x1+x2)
+	_ff_mult(u[0],x1,x2);						
+	_ff_sub(t2,y1,y2);
+	_ff_mult(v[1],t2,w);						// v1 = (y1-y1)/(x1-x2)
+	_ff_mult(t3,x1,y2);
+	_ff_mult(t2,x2,y1);
+	_ff_subfrom(t3,t2);
+	_ff_mult(v[0],t3,w);						// v0 = (x1y2-x2y1)/(x1-x2)
+}
+
 // note that caller must clear higher coefficients of u and v
 static inline void hecurve_make_1 (ff_t u[2], ff_t v[1], ff_t x1, ff_t y1)
 {
@@ -196,6 +214,54 @@ int hecurve_random_point (ff_t px[1], ff_t py[1], ff_t f[HECURVE_DEGREE+1])
 	return 1;
 }
 
+/*
+	Generates n random affine points on y^2=f(x) with a random choice of sign, as in hecurve_random_point.
+	The x-coordinates are drawn in batches and all the square roots in a batch are computed by ff_parallel_sqrt.
+	Returns 0 if we fail to find n points (this can only happen for very small p), 1 otherwise.
+*/
+int hecurve_random_points (ff_t px[], ff_t py[], int n, ff_t f[HECURVE_DEGREE+1])
+{
+	ff_t x[HECURVE_RANDOM_BATCH], y[HECURVE_RANDOM_BATCH];
+	char s[HECURVE_RANDOM_BATCH];
+	int i, k, m, d_f, tries;
+
+	d_f = ff_poly_degree (f, HECURVE_DEGREE);
+	for ( k = tries = 0 ; k < n ; tries += m ) {
+		if ( tries > HECURVE_RANDOM_POINT_RETRIES*n ) return 0;
+		m = 2*(n-k);											// about half the x's will give a point
+		if ( m > HECURVE_RANDOM_BATCH ) m = HECURVE_RANDOM_BATCH;
+		for ( i = 0 ; i < m ; i++ ) { _ff_random(x[i]);  ff_poly_eval (y+i, f, d_f, x+i); }
+		ff_parallel_sqrt (y, y, s, m);
+		for ( i = 0 ; i < m && k < n ; i++ ) {
+			if ( ! s[i] ) continue;
+			if ( ui_randomb(1) ) ff_negate (y[i]);
+			_ff_set(px[k],x[i]);
+			_ff_set(py[k],y[i]);
+			k++;
+		}
+	}
+	return 1;
+}
+
+#if HECURVE_GENUS == 2
+/*
+	Constructs the divisor hecurve_random would construct (with HECURVE_RANDOM == 0) from the random points (x1,y1) and (x2,y2),
+	where w = 1/(x1-x2) is supplied by the caller (so that the inversions can be batched), and is ignored if x1 = x2.
+	Returns 0 if the points cannot be used (in the sextic case they must have distinct x-coordinates).
+*/
+int hecurve_random_from_points (ff_t u[HECURVE_GENUS+1], ff_t v[HECURVE_GENUS], ff_t x1, ff_t y1, ff_t x2, ff_t y2, ff_t w, ff_t f[HECURVE_DEGREE+1])
+{
+	_hecurve_set_zero (u, v);
+	if ( _ff_equal(x1,x2) ) {
+		if ( ff_poly_degree (f, HECURVE_DEGREE) == 6 ) return 0;
+		hecurve_make_1 (u, v, x1, y1);
+	} else {
+		_hecurve_make_2 (u, v, x1, y1, x2, y2, w);
+	}
+	return 1;
+}
+#endif
+
 void hecurve_random (ff_t u[HECURVE_GENUS+1], ff_t v[HECURVE_GENUS], ff_t f[HECURVE_DEGREE+1])
 {
 	ff_t x1, y1, x2, y2;
@@ -633,23 +699,13 @@ void hecurve_make_3 (ff_t u[4], ff_t v[3], ff_t x1, ff_t y1, ff_t x2, ff_t y2, f
 // note this function is not genus specific, however caller is responsible for zeroing higher degree coefficients
 void hecurve_make_2 (ff_t u[3], ff_t v[2], ff_t x1, ff_t y1, ff_t x2, ff_t y2)
 {
-	register ff_t t1, t2, t3;
+	ff_t t1;
 #if ! HECURVE_FAST
 	if ( _ff_equal(x1,x2) ) { err_printf ("Call to hecurve_make_2 with x1 = x2!\n");  exit (0); }
 #endif
-	// Construct u(x) = (x-x_1)(x-x_2) has roots x1 and x2 then construct v(x) so that v(x_i) = y_i ensuring u|v^2-f (note h =0)
-	_ff_set_one(u[2]);						// u[2] = 1
-	_ff_add(t1,x1,x2);
-	_ff_neg(u[1],t1);						// u[1] = -(x1+x2)
-	_ff_mult(u[0],x1,x2);						
 	_ff_sub(t1,x1,x2);
 	_ff_invert(t1,t1);						// t1 = 1/(x1-x2) 
-	_ff_sub(t2,y1,y2);
-	_ff_mult(v[1],t2,t1);						// v1 = (y1-y1)/(x1-x2)
-	_ff_mult(t3,x1,y2);
-	_ff_mult(t2,x2,y1);
-	_ff_subfrom(t3,t2);
-	_ff_mult(v[0],t3,t1);						// v0 = (x1y2-x2y1)/(x1-x2)
+	_hecurve_make_2 (u, v, x1, y1, x2, y2, t1);
 	// total cost is I+5M+5A (counting subtractions and negations as additions)
 }
 
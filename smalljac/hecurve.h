@@ -37,6 +37,7 @@ extern "C" {
 #define HECURVE_SPARSE		0		// assumes f2 through f_2g are zero (makes only about 1-2 % difference)
 
 #define HECURVE_RANDOM_POINT_RETRIES	100			// this fails with probability 1/2, and we really need it to succeed
+#define HECURVE_RANDOM_BATCH			32			// maximum number of x-coordinates tested at once by hecurve_random_points
 
 // In genus 1 the ecurve interface should be used instead, it is faster and provides more functionality
 // genus 1 support in hecurve is only provided for backward compatibility and testing
@@ -167,7 +168,7 @@ int hecurve_g1_square (ff_t u[HECURVE_GENUS+1], ff_t v[HECURVE_GENUS],
 
 int hecurve_g2_compose (ff_t u[HECURVE_GENUS+1], ff_t v[HECURVE_GENUS], ff_t u1[HECURVE_GENUS+1],
 				         ff_t v1[HECURVE_GENUS], ff_t u2[HECURVE_GENUS+1],
-				         ff_t v2[HECURVE_GENUS+1], ff_t f[HECURVE_DEGREE+1], hecurve_ctx_t *ctx);
+				         ff_t v2[HECURVE_GENUS], ff_t f[HECURVE_DEGREE+1], hecurve_ctx_t *ctx);
 int hecurve_g2_square (ff_t u[HECURVE_GENUS+1], ff_t v[HECURVE_GENUS],
 				      ff_t u1[HECURVE_GENUS+1], ff_t v1[HECURVE_GENUS], ff_t f[HECURVE_DEGREE+1], hecurve_ctx_t *ctx);
 
@@ -177,6 +178,22 @@ int hecurve_g3_compose (ff_t u[HECURVE_GENUS+1], ff_t v[HECURVE_GENUS], ff_t u1[
 int hecurve_g3_square(ff_t u[HECURVE_GENUS+1], ff_t v[HECURVE_GENUS],
 				     ff_t u1[HECURVE_GENUS+1], ff_t v1[HECURVE_GENUS], ff_t f[HECURVE_DEGREE+1], hecurve_ctx_t *ctx);
 
+#if HECURVE_GENUS == 2
+// structure-of-arrays form for up to HECURVE_G2_LANES divisors with u = x^2 + u1*x + u0 and v = v1*x + v0
+#define HECURVE_G2_LANES		32
+typedef struct {
+	ff_t u0[HECURVE_G2_LANES];
+	ff_t u1[HECURVE_G2_LANES];
+	ff_t v0[HECURVE_G2_LANES];
+	ff_t v1[HECURVE_G2_LANES];
+} hecurve_g2_lanes_t;
+
+// lane-parallel compose/square for the generic case (f[4]=f[6]=0 and deg u = 2 in every lane), lanes with fail[i] set must be handled by the caller
+// o must not overlap a or b
+void hecurve_g2_compose_lanes (hecurve_g2_lanes_t * restrict o, hecurve_g2_lanes_t * restrict a, hecurve_g2_lanes_t * restrict b, int n, char fail[]);
+void hecurve_g2_square_lanes (hecurve_g2_lanes_t * restrict o, hecurve_g2_lanes_t * restrict a, ff_t f[7], int n, char fail[]);
+#endif
+
 long hecurve_g1_order_F3 (long *pd, ff_t f[4]);
 long hecurve_g1_order (long *pd, ff_t f[4]);
 long hecurve_g1_prime_order (ff_t f[4], int low);									// low=1 searches only for order < p
@@ -189,6 +206,10 @@ int hecurve_g1_test_exponent (long e, ff_t f[4]);
 int hecurve_verify (ff_t u[HECURVE_GENUS+1], ff_t v[HECURVE_GENUS], ff_t f[HECURVE_DEGREE+1]);
 void hecurve_random (ff_t u[HECURVE_GENUS+1], ff_t v[HECURVE_GENUS], ff_t f[HECURVE_DEGREE+1]);
 int  hecurve_random_point (ff_t *px, ff_t *py, ff_t f[HECURVE_DEGREE+1]);
+int hecurve_random_points (ff_t px[], ff_t py[], int n, ff_t f[HECURVE_DEGREE+1]);	// n random points, square roots computed in batches
+#if HECURVE_GENUS == 2
+int hecurve_random_from_points (ff_t u[HECURVE_GENUS+1], ff_t v[HECURVE_GENUS], ff_t x1, ff_t y1, ff_t x2, ff_t y2, ff_t w, ff_t f[HECURVE_DEGREE+1]);
+#endif
 void hecurve_invert (ff_t u[HECURVE_GENUS+1], ff_t v[HECURVE_GENUS]);
 unsigned hecurve_bits (ff_t u[HECURVE_GENUS+1], ff_t v[HECURVE_GENUS], ff_t f[HECURVE_DEGREE+1]);
 int hecurve_unbits (ff_t v[HECURVE_GENUS], ff_t u[HECURVE_GENUS+1], unsigned bits, ff_t f[HECURVE_DEGREE+1]);
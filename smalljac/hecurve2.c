@@ -26,7 +26,7 @@
 void hecurve_g2_square_1 (ff_t u[3], ff_t v[2], ff_t u0, ff_t v0, ff_t f[6]);
 void hecurve_g2_square_2_r0 (ff_t u[3], ff_t v[2], ff_t u1[3], ff_t v1[2], ff_t f[6]);
 void hecurve_g2_compose_1_2 (ff_t u[3], ff_t v[2], ff_t u1[3], ff_t v1[2], ff_t u2[3], ff_t v2[2], ff_t f[6]);
-int hecurve_g2_compose_special (ff_t u[3], ff_t v[2], ff_t u1[3], ff_t v1[2], ff_t u2[3], ff_t v2[3], ff_t f[6]);
+int hecurve_g2_compose_special (ff_t u[3], ff_t v[2], ff_t u1[3], ff_t v1[2], ff_t u2[3], ff_t v2[2], ff_t f[6]);
 int hecurve_g2_compose_d6 (ff_t u[3], ff_t v[2], ff_t u1[3], ff_t v1[2], ff_t u2[3], ff_t v2[2], ff_t f[7], hecurve_ctx_t *ctx);
 int hecurve_g2_square_d6 (ff_t u[3], ff_t v[2], ff_t u1[3], ff_t v1[2], ff_t f[7], hecurve_ctx_t *ctx);
 
@@ -409,7 +409,7 @@ hecurve_g2_square_s1_zero:
 //
 // This algorithm handles all the unusual cases - it assumes that either u1 or u2 has degree < 2
 // or that Resultant(u1,u2) = 0, otherwise hecurve_compose would have handled it
-int hecurve_g2_compose_special (ff_t u[3], ff_t v[2], ff_t u1[3], ff_t v1[2], ff_t u2[3], ff_t v2[3], ff_t f[6])
+int hecurve_g2_compose_special (ff_t u[3], ff_t v[2], ff_t u1[3], ff_t v1[2], ff_t u2[3], ff_t v2[2], ff_t f[6])
 {
 	register ff_t t1, t2, t3;
 	ff_t *swap;
@@ -1113,4 +1113,174 @@ hecurve_g2_square_d6_inverted:					// caller returns here after inverting
 	return 1;
 }
 
+
+/*
+	Lane-parallel versions of the generic cases of hecurve_g2_compose and hecurve_g2_square.
+
+	Divisors are held in structure-of-arrays form (see hecurve_g2_lanes_t), each formula is applied to every lane in turn, and
+	the field inversions are batched with ff_parallel_invert, so there is no per-divisor ctx save/restore or re-entry.  Products
+	that are summed share a single Montgomery reduction (_ff_sum_2_mults/_ff_sum_3_mults), which saves 3 reductions per composition
+	and 4 per squaring relative to the scalar formulas (this assumes p < 2^62, which always holds in smalljac).
+
+	The caller must ensure that f[4] = f[6] = 0 and that every input u is monic of degree 2.  Lanes that hit a special case (r*s1 = 0)
+	are flagged in fail[] and their outputs are not set; the caller should handle them with the scalar functions.
+	Outputs must not overlap inputs.  The results are identical to those of the scalar functions.
+*/
+void hecurve_g2_compose_lanes (hecurve_g2_lanes_t * restrict o, hecurve_g2_lanes_t * restrict a, hecurve_g2_lanes_t * restrict b, int n, char fail[])
+{
+	ff_t R[HECURVE_G2_LANES], S0[HECURVE_G2_LANES], S1[HECURVE_G2_LANES], I1[HECURVE_G2_LANES], X[HECURVE_G2_LANES];
+	int lane[HECURVE_G2_LANES];
+	register ff_t r, inv0, inv1, w0, w1, w2, w3, w4, w5, s0, s1, t1, L0, L1, L2, u0, u1;
+	register int i, j, k;
+
+	// steps 1-4 of hecurve_g2_compose: r = Res(u1,u2), inv = r/u2 mod u1, s' = (v1-v2)inv mod u1, and r*s'1 (to be inverted)
+	for ( i = k = 0 ; i < n ; i++ ) {
+		_ff_sub(inv1,a->u1[i],b->u1[i]);
+		_ff_sub(w0,b->u0[i],a->u0[i]);
+		_ff_multadd(inv0,a->u1[i],inv1,w0);
+		_ff_square(w1,inv1);
+		_ff_sum_2_mults(r,w0,w1,a->u0[i],inv0);				// r = w0*inv0 + inv1^2*u10
+		_ff_sub(w0,a->v0[i],b->v0[i]);
+		_ff_mult(w2,inv0,w0);
+		_ff_sub(w1,a->v1[i],b->v1[i]);
+		_ff_mult(w3,inv1,w1);
+		_ff_incmult(t1,a->u1[i],w3);
+		_ff_add(w4,inv0,inv1);
+		_ff_add(w5,w0,w1);
+		_ff_qnegsum(w0,w2,t1);
+		_ff_multadd(s1,w4,w5,w0);
+		_ff_mult(t1,a->u0[i],w3);
+		_ff_sub(s0,w2,t1);
+		_ff_mult(w2,r,s1);
+		fail[i] = _ff_zero(w2);
+		if ( fail[i] ) continue;
+		_ff_set(R[i],r);  _ff_set(S0[i],s0);  _ff_set(S1[i],s1);  _ff_set(I1[i],inv1);
+		_ff_set(X[k],w2);  lane[k++] = i;
+	}
+	ff_parallel_invert (X, X, k);
+
+	// steps 4-7: s'' = x + s0/s1, L = s''u2, u = (s(L+2v2)-t)/u1, v = -(L+v2) mod u
+	for ( j = 0 ; j < k ; j++ ) {
+		i = lane[j];
+		_ff_set(w1,X[j]);  _ff_set(r,R[i]);  _ff_set(s0,S0[i]);  _ff_set(s1,S1[i]);  _ff_set(inv1,I1[i]);
+		_ff_mult(w2,w1,r);
+		_ff_square(w3,s1);
+		ff_mult(w3,w3,w1);
+		_ff_mult(w4,r,w2);
+		_ff_square(w5,w4);
+		_ff_mult(s0,s0,w2);
+		_ff_add(L2,b->u1[i],s0);
+		_ff_multadd(L1,b->u1[i],s0,b->u0[i]);
+		_ff_mult(L0,b->u0[i],s0);
+		_ff_sub(w0,s0,a->u1[i]);
+		_ff_sub(w1,s0,inv1);
+		_ff_add(t1,b->u1[i],b->u1[i]);
+		_ff_addto(t1,inv1);
+		_ff_sum_2_mults(w2,w0,t1,w5,w1);					// w2 = (s0-u11)(s0-inv1) + (2u21+inv1)w5
+		_ff_subfrom(w2,a->u0[i]);
+		_ff_addto(w2,L1);
+		_ff_add(w0,b->v1[i],b->v1[i]);
+		_ff_multadd(u0,w0,w4,w2);
+		_ff_add(w0,s0,s0);
+		_ff_subfrom(w0,inv1);
+		_ff_sub(u1,w0,w5);
+		// with w1 = L2-u1 we have v1 = w3(w1u1+u0-L1)-v21 and v0 = w3(w1u0-L0)-v20
+		_ff_sub(w1,L2,u1);
+		_ff_mult(w2,w1,w3);
+		_ff_sub(w0,u0,L1);
+		_ff_sum_2_mults(o->v1[i],w2,w0,w3,u1);
+		_ff_subfrom(o->v1[i],b->v1[i]);
+		_ff_neg(w0,L0);
+		_ff_sum_2_mults(o->v0[i],w2,w0,w3,u0);
+		_ff_subfrom(o->v0[i],b->v0[i]);
+		_ff_set(o->u0[i],u0);  _ff_set(o->u1[i],u1);
+	}
+}
+
+
+void hecurve_g2_square_lanes (hecurve_g2_lanes_t * restrict o, hecurve_g2_lanes_t * restrict a, ff_t f[7], int n, char fail[])
+{
+	ff_t R[HECURVE_G2_LANES], S0[HECURVE_G2_LANES], S1[HECURVE_G2_LANES], X[HECURVE_G2_LANES];
+	int lane[HECURVE_G2_LANES];
+	register ff_t w0, w1, w2, w3, w4, w5, inv0, inv1, L0, L1, L2, r, s0, s1, t0, t1, u0, u1;
+	register int i, j, k;
+
+	// steps 1-6 of hecurve_g2_square: r = Res(2v,u), inv = r/2v mod u, t = (f-v^2)/u mod u, s' = t*inv mod u, and r*s'1 (to be inverted)
+	for ( i = k = 0 ; i < n ; i++ ) {
+		_ff_add(w5,a->v1[i],a->v1[i]);
+		_ff_add(inv0,a->v0[i],a->v0[i]);
+		_ff_square(w0,a->v1[i]);
+		_ff_square(w1,a->u1[i]);
+		_ff_add(w2,w0,w0);
+		_ff_add(w2,w2,w2);
+		_ff_mult(w3,a->u1[i],w5);
+		_ff_sub(w4,inv0,w3);
+		_ff_sum_2_mults(r,a->u0[i],w4,inv0,w2);				// r = u0*w2 + (inv0-w3)*inv0
+		_ff_neg(inv1,w5);
+		_ff_subfrom(inv0,w3);
+#if HECURVE_SPARSE
+		_ff_set (w3,w1);
+#else
+		_ff_add(w3,f[3],w1);
+#endif
+		_ff_add(w4,a->u0[i],a->u0[i]);
+		_ff_add(t1,w1,w1);
+		_ff_addto(t1,w3);
+		_ff_subfrom(t1,w4);
+		_ff_add(t0,w4,w4);
+		_ff_subfrom(t0,w3);
+		_ff_neg(w5,w0);
+		_ff_multadd(t0,t0,a->u1[i],w5);
+#if ! HECURVE_SPARSE
+		_ff_addto(t0,f[2]);
+#endif
+		_ff_mult(w0,t0,inv0);
+		_ff_mult(w1,t1,inv1);
+		_ff_add(s1,inv0,inv1);
+		_ff_add(w2,t0,t1);
+		_ff_neg(w5,w0);
+		_ff_multadd(s1,s1,w2,w5);
+		_ff_incmult(w2,a->u1[i],w1);
+		_ff_subfrom(s1,w2);
+		_ff_mult(w5,w1,a->u0[i]);
+		_ff_sub(s0,w0,w5);
+		_ff_mult(w0,r,s1);
+		fail[i] = _ff_zero(w0);
+		if ( fail[i] ) continue;
+		_ff_set(R[i],r);  _ff_set(S0[i],s0);  _ff_set(S1[i],s1);
+		_ff_set(X[k],w0);  lane[k++] = i;
+	}
+	ff_parallel_invert (X, X, k);
+
+	// steps 6-9: s'' = x + s0/s1, L = s''u, u = s^2 + 2vs/u + (v^2-f)/u^2, v = -(L+v) mod u
+	for ( j = 0 ; j < k ; j++ ) {
+		i = lane[j];
+		_ff_set(w1,X[j]);  _ff_set(r,R[i]);  _ff_set(s0,S0[i]);  _ff_set(s1,S1[i]);
+		_ff_mult(w2,w1,r);
+		_ff_square(w3,s1);
+		ff_mult(w3,w3,w1);
+		_ff_mult(w4,w2,r);
+		_ff_square(w5,w4);
+		ff_mult(s0,s0,w2);
+		_ff_add(L2,s0,a->u1[i]);
+		_ff_multadd(L1,s0,a->u1[i],a->u0[i]);
+		_ff_mult(L0,s0,a->u0[i]);
+		_ff_add(w1,a->v1[i],a->v1[i]);
+		_ff_add(w0,a->u1[i],a->u1[i]);
+		_ff_sum_3_mults(u0,s0,w1,w0,w5,w4,s0);				// u0 = s0^2 + 2v1*w4 + 2u1*w5
+		_ff_add(w0,s0,s0);
+		_ff_sub(u1,w0,w5);
+		// with w1 = L2-u1 we have v1 = w3(w1u1+u0-L1)-v1 and v0 = w3(w1u0-L0)-v0
+		_ff_sub(w1,L2,u1);
+		_ff_mult(w2,w1,w3);
+		_ff_sub(w0,u0,L1);
+		_ff_sum_2_mults(o->v1[i],w2,w0,w3,u1);
+		_ff_subfrom(o->v1[i],a->v1[i]);
+		_ff_neg(w0,L0);
+		_ff_sum_2_mults(o->v0[i],w2,w0,w3,u0);
+		_ff_subfrom(o->v0[i],a->v0[i]);
+		_ff_set(o->u0[i],u0);  _ff_set(o->u1[i],u1);
+	}
+}
+
 #endif
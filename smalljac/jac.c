@@ -26,6 +26,60 @@
 #define JAC_MAX_FASTORDER_UI_W		20
 
 
+#if HECURVE_GENUS == 2
+#define _jac_g2_lanes_ok(c)			((c).d == 5 && _ff_zero((c).f[4]))
+#define _jac_g2_generic(a)			_ff_one((a).u[2])
+#define _jac_g2_gather(L,i,a)		{ _ff_set((L).u0[i],(a).u[0]); _ff_set((L).u1[i],(a).u[1]); _ff_set((L).v0[i],(a).v[0]); _ff_set((L).v1[i],(a).v[1]); }
+#define _jac_g2_scatter(a,L,i)		{ _ff_set((a).u[0],(L).u0[i]); _ff_set((a).u[1],(L).u1[i]); _ff_set_one((a).u[2]); _ff_set((a).v[0],(L).v0[i]); _ff_set((a).v[1],(L).v1[i]); }
+
+/*
+	Computes o[i] = a[i]*b[i*bstep] (bstep is 0 when b is shared) using the lane-parallel kernel hecurve_g2_compose_lanes.
+	Lanes whose inputs are not in the generic case, or that hit a special case in the kernel, are handled by the scalar code.
+	As with the other parallel functions, o may overlap a or b lane-for-lane.
+*/
+static void jac_g2_parallel_mult (jac_t o[], jac_t a[], jac_t b[], int bstep, hc_poly c[1], int n)
+{
+	hecurve_g2_lanes_t A, B, O;
+	int lane[HECURVE_G2_LANES];
+	char fail[HECURVE_G2_LANES];
+	register int i, j, k, m, t;
+
+	for ( i = 0 ; i < n ; i += m ) {
+		m = ( n-i < HECURVE_G2_LANES ? n-i : HECURVE_G2_LANES );
+		for ( j = k = 0 ; j < m ; j++ ) {
+			t = i+j;
+			if ( _jac_g2_generic(a[t]) && _jac_g2_generic(b[t*bstep]) ) { _jac_g2_gather(A,k,a[t]);  _jac_g2_gather(B,k,b[t*bstep]);  lane[k++] = t; }
+			else __jac_mult (o[t], a[t], b[t*bstep], c[0], 0);
+		}
+		hecurve_g2_compose_lanes (&O, &A, &B, k, fail);
+		for ( j = 0 ; j < k ; j++ ) if ( fail[j] ) { t = lane[j];  __jac_mult (o[t], a[t], b[t*bstep], c[0], 0); }
+		for ( j = 0 ; j < k ; j++ ) if ( ! fail[j] ) _jac_g2_scatter (o[lane[j]], O, j);
+	}
+}
+
+// Computes o[i] = a[i]^2 using hecurve_g2_square_lanes, exactly as above
+static void jac_g2_parallel_square (jac_t o[], jac_t a[], hc_poly c[1], int n)
+{
+	hecurve_g2_lanes_t A, O;
+	int lane[HECURVE_G2_LANES];
+	char fail[HECURVE_G2_LANES];
+	register int i, j, k, m, t;
+
+	for ( i = 0 ; i < n ; i += m ) {
+		m = ( n-i < HECURVE_G2_LANES ? n-i : HECURVE_G2_LANES );
+		for ( j = k = 0 ; j < m ; j++ ) {
+			t = i+j;
+			if ( _jac_g2_generic(a[t]) ) { _jac_g2_gather(A,k,a[t]);  lane[k++] = t; }
+			else __jac_square (o[t], a[t], c[0], 0);
+		}
+		hecurve_g2_square_lanes (&O, &A, c[0].f, k, fail);
+		for ( j = 0 ; j < k ; j++ ) if ( fail[j] ) { t = lane[j];  __jac_square (o[t], a[t], c[0], 0); }
+		for ( j = 0 ; j < k ; j++ ) if ( ! fail[j] ) _jac_g2_scatter (o[lane[j]], O, j);
+	}
+}
+#endif
+
+
 // o1 should not overlap a2 or b2
 void jac_mult2 (jac_t o1[1], jac_t a1[1], jac_t b1[1], jac_t o2[1], jac_t a2[1], jac_t b2[1], hc_poly c[1])
 {
@@ -58,6 +112,19 @@ void jac_square2 (jac_t o1[1], jac_t a1[1], jac_t o2[1], jac_t a2[1], hc_poly c[
 {
 	hecurve_ctx_t ctx[2];
 	ff_t inverts[2];
+#if HECURVE_GENUS == 2
+	hecurve_g2_lanes_t A, O;
+	char fail[2];
+
+	if ( _jac_g2_lanes_ok(c[0]) && _jac_g2_generic(a1[0]) && _jac_g2_generic(a2[0]) ) {
+		_jac_g2_gather (A, 0, a1[0]);  _jac_g2_gather (A, 1, a2[0]);
+		hecurve_g2_square_lanes (&O, &A, c[0].f, 2, fail);
+		if ( fail[0] ) __jac_square (o1[0], a1[0], c[0], 0); else _jac_g2_scatter (o1[0], O, 0);
+		if ( fail[1] ) __jac_square (o2[0], a2[0], c[0], 0); else _jac_g2_scatter (o2[0], O, 1);
+		jac_gops += 2;
+		return;
+	}
+#endif
 	
 	ctx[0].state = ctx[1].state = 0;
 	if ( ! __jac_square (o1[0], a1[0], c[0], ctx) ) {
@@ -140,6 +207,9 @@ void jac_parallel_mult_c (jac_t o[], jac_t a[], jac_t b[], hc_poly c[1], int n)
 	hecurve_ctx_t ctx[JAC_MAX_CURVES];
 	register int i, j;
 	
+#if HECURVE_GENUS == 2
+	if ( _jac_g2_lanes_ok(c[0]) ) { jac_g2_parallel_mult (o, a, b, 1, c, n);  jac_gops += n;  return; }
+#endif
 	j = 0;
 	for ( i = 0 ; i < n ; i++ ) {
 		ctx[i].state = 0;
@@ -164,6 +234,9 @@ void jac_parallel_mult_1 (jac_t o[], jac_t a[], jac_t b[1], hc_poly c[1], int n)
 	hecurve_ctx_t ctx[JAC_MAX_CURVES];
 	register int i, j;
 	
+#if HECURVE_GENUS == 2
+	if ( _jac_g2_lanes_ok(c[0]) ) { jac_g2_parallel_mult (o, a, b, 0, c, n);  jac_gops += n;  return; }
+#endif
 	j = 0;
 	for ( i = 0 ; i < n ; i++ ) {
 		ctx[i].state = 0;
@@ -204,6 +277,32 @@ void jac_parallel_square (jac_t o[], jac_t a[], hc_poly c[], int n)
 	jac_gops += n;
 }
 
+void jac_parallel_square_c (jac_t o[], jac_t a[], hc_poly c[1], int n)
+{
+	int inv[JAC_MAX_CURVES];
+	ff_t inverts[JAC_MAX_CURVES];
+	hecurve_ctx_t ctx[JAC_MAX_CURVES];
+	register int i, j;
+
+#if HECURVE_GENUS == 2
+	if ( _jac_g2_lanes_ok(c[0]) ) { jac_g2_parallel_square (o, a, c, n);  jac_gops += n;  return; }
+#endif
+	j = 0;
+	for ( i = 0 ; i < n ; i++ ) {
+		ctx[i].state = 0;
+		if ( ! __jac_square (o[i], a[i], c[0], ctx+i) ) {
+			_ff_set (inverts[j], ctx[i].invert);
+			inv[j++] =i;
+		}
+	}
+	ff_parallel_invert (inverts, inverts, j);	// we could modify this to avoid overlap if needed
+	for ( i = 0 ; i < j ; i++ ) {
+		_ff_set ( ctx[inv[i]].invert, inverts[i]);
+		__jac_square (o[inv[i]], a[inv[i]], c[0], ctx+inv[i]);
+	}
+	jac_gops += n;
+}
+
 // o cannot overlap a[]
 void jac_exp_ui_powers (jac_t o[1], jac_t a[], unsigned long e, hc_poly c[1])
 {
@@ -257,6 +356,55 @@ void jac_exp_ui (jac_t o[1], jac_t a[1], unsigned long e, hc_poly c[1])
 	_jac_mult (o[0], b[0], b[1], c[0]);
 }
 
+/*
+	Computes o[i] = a[i]^e for 0 <= i < n.  The exponent is recoded once (width JAC_EXP_WINDOW wNAF) and the recoding is shared
+	by all the elements, so that each step of the addition chain is a single parallel squaring or multiplication of the whole
+	batch (with one field inversion per step, or none when the genus 2 lane kernels apply).  This is much faster than n separate
+	calls to jac_exp_ui when we need to raise a batch of random elements to the same exponent, as in jac_sylow.  Assumes 2^w <= e < 2^62
+	and d > 3 (genus 1 uses the NAF exponentiation in ecurve_exp_ui, which is already very fast).
+*/
+static void jac_exp_ui_wnaf (jac_t o[], jac_t a[], unsigned long e, hc_poly c[1], int n)
+{
+	jac_t T[1<<(JAC_EXP_WINDOW-2)][JAC_EXP_BATCH], TI[1<<(JAC_EXP_WINDOW-2)][JAC_EXP_BATCH], x[JAC_EXP_BATCH];
+	signed char d[8*sizeof(unsigned long)+1];
+	register int i, j, k, m;
+	register unsigned long t;
+
+	// the digits d[k] are odd with |d[k]| < 2^(w-1), or zero, and any w consecutive digits include at most one nonzero digit
+	for ( k = 0, t = e ; t ; k++, t >>= 1 ) {
+		if ( (t&1) ) {
+			d[k] = t & ((1<<JAC_EXP_WINDOW)-1);
+			if ( d[k] >= (1<<(JAC_EXP_WINDOW-1)) ) { d[k] -= (1<<JAC_EXP_WINDOW);  t += (unsigned long)(-d[k]); } else { t -= d[k]; }
+		} else {
+			d[k] = 0;
+		}
+	}
+	for ( ; n > 0 ; n -= m, o += m, a += m ) {
+		m = ( n < JAC_EXP_BATCH ? n : JAC_EXP_BATCH );
+		// T[j] holds a^(2j+1), TI[j] its inverse
+		for ( i = 0 ; i < m ; i++ ) _jac_set (T[0][i], a[i]);
+		jac_parallel_square_c (x, T[0], c, m);
+		for ( j = 1 ; j < (1<<(JAC_EXP_WINDOW-2)) ; j++ ) jac_parallel_mult_c (T[j], T[j-1], x, c, m);
+		for ( j = 0 ; j < (1<<(JAC_EXP_WINDOW-2)) ; j++ ) for ( i = 0 ; i < m ; i++ ) { _jac_set (TI[j][i], T[j][i]);  _jac_invert (TI[j][i]); }
+		j = k-1;											// the leading digit is always positive
+		for ( i = 0 ; i < m ; i++ ) _jac_set (x[i], T[d[j]>>1][i]);
+		for ( j-- ; j >= 0 ; j-- ) {
+			jac_parallel_square_c (x, x, c, m);
+			if ( d[j] > 0 ) jac_parallel_mult_c (x, x, T[d[j]>>1], c, m);
+			if ( d[j] < 0 ) jac_parallel_mult_c (x, x, TI[(-d[j])>>1], c, m);
+		}
+		for ( i = 0 ; i < m ; i++ ) _jac_set (o[i], x[i]);
+	}
+}
+
+void jac_exp_ui_batch (jac_t o[], jac_t a[], unsigned long e, hc_poly c[1], int n)
+{
+	register int i;
+
+	if ( c[0].d > 3 && e >= (1UL<<JAC_EXP_WINDOW) && ! (e>>62) ) { jac_exp_ui_wnaf (o, a, e, c, n);  return; }
+	for ( i = 0 ; i < n ; i++ ) jac_exp_ui (o+i, a+i, e, c);
+}
+
 // simple simultaneous exponentiation of a common base to two exponents using a 1-bit window size
 void jac_exp2_ui (jac_t o[2], jac_t a[1], unsigned long e1, unsigned long e2, hc_poly c[1])
 {
@@ -388,14 +536,41 @@ void jac_exp_mpz (jac_t o[1], jac_t a[1], mpz_t e, hc_poly c[1])
 }
 
 
+/*
+	Generates n random elements, equivalent to n calls to _jac_random, but in genus 2 the rational points used to construct
+	the divisors are obtained by hecurve_random_points, which computes the required square roots in batches.
+*/
+void jac_random_batch (jac_t o[], hc_poly c[1], int n)
+{
+#if HECURVE_GENUS == 2 && HECURVE_RANDOM == 0
+	ff_t x[2*JAC_RANDOM_BATCH], y[2*JAC_RANDOM_BATCH], w[JAC_RANDOM_BATCH];
+	register int m;
+#endif
+	register int i;
+
+#if HECURVE_GENUS == 2 && HECURVE_RANDOM == 0
+	if ( c[0].d > 3 ) {
+		for ( ; n > 0 ; n -= m, o += m ) {
+			m = ( n < JAC_RANDOM_BATCH ? n : JAC_RANDOM_BATCH );
+			if ( ! hecurve_random_points (x, y, 2*m, c[0].f) ) break;				// let _jac_random handle curves with (almost) no points
+			for ( i = 0 ; i < m ; i++ ) { _ff_sub (w[i], x[2*i], x[2*i+1]);  if ( _ff_zero(w[i]) ) _ff_set_one (w[i]); }
+			ff_parallel_invert (w, w, m);
+			for ( i = 0 ; i < m ; i++ )
+				if ( ! hecurve_random_from_points (o[i].u, o[i].v, x[2*i], y[2*i], x[2*i+1], y[2*i+1], w[i], c[0].f) ) _jac_random (o[i], c[0]);
+		}
+	}
+#endif
+	for ( i = 0 ; i < n ; i++ ) _jac_random (o[i], c[0]);
+}
+
 int jac_verify_group_exponent (mpz_t e, hc_poly c[1])
 {
-	jac_t a, b;
+	jac_t a[JAC_CONFIDENCE_LEVEL], b;
 	int i;
 
+	jac_random_batch (a, c, JAC_CONFIDENCE_LEVEL);
 	for ( i = 0 ; i < JAC_CONFIDENCE_LEVEL ; i++ ) {
-		_jac_random (a, c[0]);
-		jac_exp_mpz (&b, &a, e, c);
+		jac_exp_mpz (&b, a+i, e, c);
 		if ( ! _jac_is_identity (b) ) return 0;
 	}
 	return 1;
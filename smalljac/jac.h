@@ -30,6 +30,9 @@ extern "C" {
 #define JAC_CONFIDENCE_LEVEL		20			// larger value used internally in jac_sylow - note that smalljac results are (except where noted) provably correct regardless of this setting
 #define JAC_MAX_GENERATORS		9			// this should be at least 2g+1 (not 2g, we need room for one extra)
 #define JAC_CYCLIC_TESTS			4			// number of times to attempt to prove p-Sylow subgroup is cyclic before computing it
+#define JAC_EXP_WINDOW			4			// wNAF window width used by jac_exp_ui_batch
+#define JAC_EXP_BATCH			32			// maximum number of elements jac_exp_ui_batch will process in one addition chain
+#define JAC_RANDOM_BATCH		16			// number of random elements jac_random_batch constructs at once
 
 unsigned long jac_gops;
 
@@ -66,11 +69,15 @@ void jac_parallel_mult (jac_t o[], jac_t a[], jac_t b[], hc_poly c[], int n);
 void jac_parallel_mult_c (jac_t o[], jac_t a[], jac_t b[], hc_poly c[1], int n);		// multiple a's and b's but same c
 void jac_parallel_mult_1 (jac_t o[], jac_t a[], jac_t b[1], hc_poly c[1], int n);
 void jac_parallel_square (jac_t o[], jac_t a[], hc_poly c[], int n);
+void jac_parallel_square_c (jac_t o[], jac_t a[], hc_poly c[1], int n);		// multiple a's but same c
 
 void jac_square_mult (jac_t a[1], jac_t b[1], hc_poly c[1]);
 void jac_mult2 (jac_t o1[1], jac_t a1[1], jac_t b1[1], jac_t o2[1], jac_t a2[1], jac_t b2[1], hc_poly c[1]);	// o1 can't overlap a2 or b2
 
+void jac_random_batch (jac_t o[], hc_poly c[1], int n);		// equivalent to n calls to _jac_random but faster
+
 void jac_exp_ui (jac_t o[1], jac_t a[1], unsigned long e, hc_poly c[1]);
+void jac_exp_ui_batch (jac_t o[], jac_t a[], unsigned long e, hc_poly c[1], int n);		// o[i] = a[i]^e for i < n, o may overlap a
 static inline void jac_exp_si (jac_t o[1], jac_t a[1], long e, hc_poly c[1])
 	{ if ( e >= 0 ) jac_exp_ui (o, a, e, c); else { jac_exp_ui (o, a, -e, c); _jac_invert(o[0]); } }
 void jac_exp2_ui (jac_t o[2], jac_t a[1], unsigned long e1, unsigned long e2, hc_poly c[1]);
@@ -30,16 +30,47 @@
 	so none of the code here gets used in genus 1 anymore, but for the moment we won't change things.
 */
 
-// SMALLJAC_M determines the number of group operations to perform simultaneously
-// when doing a parallel search
-#if HECURVE_GENUS == 1
-unsigned long SMALLJAC_M = 4;				// increase to 8 for large p
-#else
-unsigned long SMALLJAC_M = 32;
-#endif
+static jac_search_ctx_t *jac_search_default;
+
+jac_search_ctx_t *jac_search_ctx_alloc (int tabbits)
+{
+	jac_search_ctx_t *ctx;
+	
+	ctx = mem_alloc (sizeof(*ctx));
+	smalljac_table_alloc (&ctx->tab, tabbits);
+	ctx->baby_stash = mem_alloc (JAC_SEARCH_STASHSIZE*sizeof(*ctx->baby_stash));
+	ctx->m = JAC_SEARCH_WIDTH;
+	return ctx;
+}
+
+void jac_search_ctx_free (jac_search_ctx_t *ctx)
+{
+	if ( ! ctx ) return;
+	smalljac_table_free (&ctx->tab);
+	mem_free (ctx->baby_stash);
+	mem_free (ctx);
+}
 
-#define SMALLJAC_BABY_STASHSIZE		4096
-jac_t baby_stash[SMALLJAC_BABY_STASHSIZE];
+// the default context is used by jac_order, jac_search, and jac_structure
+jac_search_ctx_t *jac_search_default_ctx (void)
+{
+	if ( ! jac_search_default ) jac_search_default = jac_search_ctx_alloc (SMALLJAC_TABBITS);
+	return jac_search_default;
+}
+
+/*
+	Returns the parallel width to use for a search that is expected to require about steps group operations (baby and giant steps combined).
+	This is JAC_SEARCH_WIDTH (or the width fixed in the context), reduced by powers of 2 (but not below JAC_SEARCH_MIN_M) for searches
+	too short to use it, so the choice depends only on the genus and the size of the search and not on timings.
+*/
+unsigned long jac_search_width (jac_search_ctx_t *ctx, unsigned long steps)
+{
+	register unsigned long m;
+	
+	if ( ctx->fixed_m ) return ctx->fixed_m;
+	for ( m = JAC_SEARCH_WIDTH ; m > JAC_SEARCH_MIN_M && 2*m > steps ; m >>= 1 );
+	return m;
+}
 
 /*
 	The tables below are used to select parameters for BSGS searches in genus 2 and 3
@@ -99,6 +130,15 @@ struct a2tab_entry g3a2tab[] = {
 // various counters used for tuning and testing - none of these are functionally necessary
 unsigned long jac_curve_count, jac_prebaby_gops, jac_baby_gops, jac_pregiant_gops, jac_giant_gops, jac_fastorder_gops, jac_ambexp_gops, jac_exp_gops, jac_charpoly_gops, jac_order_count;
 
+// returns the least n+ke >= n (k >= 0) compatible with what we know about 2-torsion and 3-torsion, or ULONG_MAX if there is none
+static inline unsigned long jac_order_candidate (unsigned long n, unsigned long e, int two_rank, int no3tor)
+{
+	register int i;
+	
+	for ( i = 0 ; i < 6 ; i++, n += e ) if ( (two_rank || (n&0x1)) && ( ! no3tor || (n%3)) ) return n;
+	return ULONG_MAX;
+}
+
 /*
     The function jac_order computes #J(C/F_p) = P(1) given that Min <= #J(C/F_p) <= Max and (optionally in genus < 3)
     given the coefficient a1 of P(T) = L_p(T) (the numerator of Z(C/F_p;T) and (optionally) a list of constraints on the
@@ -111,14 +151,16 @@ unsigned long jac_curve_count, jac_prebaby_gops, jac_baby_gops, jac_pregiant_gop
     value which is then (provably) equal to P(1) = #J(C/F_p).  Otherwise *pP1 is set to the size of the largest,
     which will typically be less than Min.  In this case it is up to the caller to resolve the ambiguity.
 
+    In genus 2 we use the 2-rank and (for large p) the 3-torsion of J(C/F_p) to restrict the possible values of P(1):
+    if the 2-rank is 0 then P(1) is odd, and if there is no rational 3-torsion then 3 does not divide P(1).
+    This often lets us stop after one fewer search, since it suffices for a single candidate to remain in [Min,Max].
+
 
     See [KedlayaSutherland2007] for more details.
 */
 
-int jac_order (unsigned long *pP1, unsigned long Min, unsigned long Max, long a1, long d, int fExponentOnly, int *constraints, hc_poly c[1])
+int jac_order_r (jac_search_ctx_t *ctx, unsigned long *pP1, unsigned long Min, unsigned long Max, long a1, long d, int fExponentOnly, int *constraints, hc_poly c[1])
 {
-	static mpz_t Z;
-	static int init;
 	jac_t g, gen[JAC_MAX_GENERATORS];
 	unsigned long ords[JAC_MAX_GENERATORS];
 	unsigned long q[MPZ_MAX_UI_PP_FACTORS], h[MPZ_MAX_UI_PP_FACTORS];
@@ -127,9 +169,8 @@ int jac_order (unsigned long *pP1, unsigned long Min, unsigned long Max, long a1
 	unsigned long SylowLimit, abandoned_q;
 	double x, z;
 	long t;
-	int full, ambiguous_exponent,tor3;
+	int full, ambiguous_exponent, tor3, no3tor;
 	
-	if ( ! init ) { mpz_init (Z);  init = 1; }
 	full = 0;															// default is to do a fastorder computation, not a full search of the interval
 	p = (unsigned long)_ff_p;
 	x = sqrt((double)p);
@@ -167,7 +208,6 @@ int jac_order (unsigned long *pP1, unsigned long Min, unsigned long Max, long a1
 		} else {
 			W = (unsigned long) ceil(0.8488*x);							// expected distance of a1 from the median is 8pi/3~0.8488...
 		}
-		if ( p > (1UL<<28) ) SMALLJAC_M = 8;								// tweak parallelism
 #endif
 #if HECURVE_GENUS == 2
 		W = (unsigned long) ceil(0.7905*p*x);								// expected distance of a1 from the median is (exactly) 4096/525pi^2 = 0.790498...
@@ -176,11 +216,13 @@ int jac_order (unsigned long *pP1, unsigned long Min, unsigned long Max, long a1
 		err_printf ("%lu: Invalid a1 value in jac_order in genus 3!\n", _ff_p);  exit (0);
 #endif
 	}
+	if ( W > (Max-Min)/2+1 ) W = (Max-Min)/2+1;							// the caller may have given us an interval much narrower than the Weil interval
 //printf ("%lu: M = %ld, W = %ld, a1 = %ld, Min = %ld, Max = %ld\n", p, M, W, a1, Min, Max);
 	ambiguous_exponent = 0;
 
 	two_rank = 0;
 	tor3 = 0;
+	no3tor = 0;
 #if HECURVE_GENUS == 1
 	two_rank = (ff_poly_roots_d3(0,c[0].f)+1)/2;								// this takes < 1 microsecond (AMD Athlon 2.5GHz), equivalent to less than 10 gops
 	if ( ! _ff_p1mod3 ) {													// for now only use 3tor when p=2mod3 and it is fast and easy
@@ -192,6 +234,14 @@ int jac_order (unsigned long *pP1, unsigned long Min, unsigned long Max, long a1
 	two_rank = hc_poly_two_rank (c);
 	// computing 3tor takes 300-500 microseconds, don't use if  p is small or we already know a1.  Our 3tor method only works for depressed quintics!
 	if ( a1 == JAC_INVALID_A1 && _ff_p > SMALLJAC_3TOR_P && c[0].d==5 && _ff_zero(c[0].f[4])  ) tor3 = hecurve_g2_3tor(c[0].f);
+	/*
+		tor3 = 1 means the 3-torsion modular polynomial is squarefree with no roots in F_p, and then 3 does not divide #J(C/F_p).  Its 40 roots are
+		the values of a coordinate of the Mumford representation u of the 40 pairs {D,-D} of nonzero 3-torsion points, and these are all distinct
+		because the polynomial is squarefree.  Every nonzero 3-torsion point has deg u = 2: if 3(P-oo) = 0 for a point P then 3P-3oo would be the
+		divisor of a function in L(3oo), but for an odd degree model L(3oo) = <1,x> contains no function with a pole of order 3 at oo.
+		So a rational point of order 3, which exists if 3 | #J(C/F_p), would give a root in F_p.  This is verified by check_3tor.
+	*/
+	no3tor = ( tor3 == 1 );
 #endif
 #if HECURVE_GENUS > 2
 	if ( !(c[0].d&1) ) { err_printf ("Curve degree must be odd in genus > 2 in jac_order\n"); exit (0); }
@@ -211,17 +261,15 @@ int jac_order (unsigned long *pP1, unsigned long Min, unsigned long Max, long a1
 			if ( ! _jac_is_identity (g) ) break;
 		}
 		if ( i == SMALLJAC_RETRIES ) { ambiguous_exponent = 1;  break; }
-		o = jac_parallel_search (&g, M2, W2, Min/e, _ui_ceil_ratio(Max,e), full,  (two_rank?0:1), c);
-		if ( ! o ) { err_printf ("%lu: search failed with e=%lu, M=%lu, W=%lu, m=%lu for element: ", p, e, M, W, SMALLJAC_M);  _jac_print(g);  return 0; }
+		o = jac_parallel_search (ctx, &g, M2, W2, Min/e, _ui_ceil_ratio(Max,e), full,  (two_rank?0:1), c);
+		if ( ! o ) { err_printf ("%lu: search failed with e=%lu, M=%lu, W=%lu, m=%lu for element: ", p, e, M, W, ctx->m);  _jac_print(g);  return 0; }
 		e *= o;
 		if ( fExponentOnly ) continue;
 		e2 = e;
 		if ( two_rank > 1&& ! full ) e2 <<= (two_rank-1);		// use knowledge of 2-rank but only when doing an order computation rather than a full search
-		order = _ui_ceil_ratio(Min,e2) * e2;
-		if ( ! two_rank && ! (order&0x1) ) { order += e2; assert (order&0x1); }		// if 2-rank is 0, order must be odd
+		order = jac_order_candidate (_ui_ceil_ratio(Min,e2) * e2, e2, two_rank, no3tor);		// if 2-rank is 0, order must be odd (and prime to 3 if there is no 3-torsion)
 		if ( order > Max ) { err_printf ("%7lu: No multiple of exponent %lu in interval (%lu,%lu) with 2-rank %d after computing order %lu with full = %d for element:   ", p, e, Min, Max, two_rank, o, full);  _jac_print(g);  ff_poly_print(c->f, c->d); puts (""); return 0; }
-		if ( order+e2 > Max ) break;
-		if ( ! two_rank && !((order+e2)&0x1) && order + 2*e2 > Max ) break;
+		if ( jac_order_candidate (order+e2, e2, two_rank, no3tor) > Max ) break;
 	}
 	if ( ! two_rank && !(e&0x1) ) { err_printf ("%lu: Even exponent %ld found for group with trivial 2-rank\n", p, e);  return 0; }
 	if ( fExponentOnly ) {
@@ -242,6 +290,7 @@ int jac_order (unsigned long *pP1, unsigned long Min, unsigned long Max, long a1
 				cnt = 0;
 				for ( o = _ui_ceil_ratio(Min,e2)*e2 ; o <= Max ; o += e2 ) {
 					register int *pcon;
+					if ( jac_order_candidate (o, e2, two_rank, no3tor) != o ) continue;
 					for ( pcon = constraints ; *pcon >= 0 ; pcon++ ) {
 						if ( (o % (2*(p+1))) == *pcon ) {
 							cnt++;
@@ -249,15 +298,13 @@ int jac_order (unsigned long *pP1, unsigned long Min, unsigned long Max, long a1
 						}
 					}
 				}
-				if ( cnt == 1 ) { printf ("%lu: Ambiguity resolved via modular constraint.\n", p);  break; }
+				if ( cnt == 1 ) { info_printf ("%lu: Ambiguity resolved via modular constraint.\n", p);  break; }
 				if ( ! cnt ) { err_printf ("%lu: No orders satisfy modularity constraints!\n", p);  return 0; }
 			}
 			if ( q[i]*e2 <= Max ) {
 				for ( j = 0, o = e2 ; j < h[i] ; j++, o/= q[i] );
 				m = Max/o;
-				// set M to the largest power of q[i] <= m, but use mpz to avoid overflow
-				mpz_set_ui (Z, q[i]);
-				while ( mpz_cmp_ui(Z,m) <= 0  ) { M = mpz_get_ui(Z);  mpz_mul_ui (Z, Z, q[i]); }
+				for ( M = q[i] ; M <= m/q[i] ; M *= q[i] );				// set M to the largest power of q[i] <= m (note m >= q[i])
 				for ( m = M ; m > SylowLimit ; m /= q[i] );
 				q_rank = jac_sylow (gen, ords, q[i], e2, M, m, c);
 				if ( q_rank < 0 ) {
@@ -272,11 +319,9 @@ int jac_order (unsigned long *pP1, unsigned long Min, unsigned long Max, long a1
 				} else {
 					dbg_printf ("%7lu: %lu-Sylow computation failed to enlarge subgroup\n", p, q[i]);
 				}
-				order = _ui_ceil_ratio(Min,e2)*e2;
-				if ( ! two_rank && ! (order&0x1) ) order += e2;		// if 2-rank is 0, order must be odd
+				order = jac_order_candidate (_ui_ceil_ratio(Min,e2)*e2, e2, two_rank, no3tor);
 				if ( order > Max ) { err_printf ("%lu: No multiple of subgroup order %lu in interval (%lu,%lu) after %lu-Sylow computation, 2-rank = %d\n", p, e2, Min, Max, q[i], two_rank); return 0; }
-				if ( order + e2 > Max ) break;
-				if ( ! two_rank && !((order+e2)&0x1) && order + 2*e2 > Max ) break;
+				if ( jac_order_candidate (order+e2, e2, two_rank, no3tor) > Max ) break;
 				order = 0;
 			}
 		}
@@ -315,10 +360,11 @@ int jac_order (unsigned long *pP1, unsigned long Min, unsigned long Max, long a1
 	6/1/2008: Many of the optimizations below are primarily relevant in genus 1, but these are now handled by the new code in hecurve1x.c.
 			We may eventually want to take these out to simplify things, but for the moment we won't change anything.
 */
-unsigned long jac_parallel_search (jac_t a[1],  unsigned long M, unsigned long W, unsigned long Min, unsigned long Max, int full, int parity, hc_poly c[1])
+unsigned long jac_parallel_search (jac_search_ctx_t *ctx, jac_t a[1],  unsigned long M, unsigned long W, unsigned long Min, unsigned long Max, int full, int parity, hc_poly c[1])
 {
-	jac_t babys[SMALLJAC_M], giants[SMALLJAC_M], gsteps[SMALLJAC_M];
-	jac_t b[64];		// needs to be at least as big as 2*SMALLJAC_M and SMALLJAC_VBITS
+	jac_t babys[JAC_SEARCH_MAX_M], giants[JAC_SEARCH_MAX_M], gsteps[JAC_SEARCH_MAX_M];
+	jac_t b[64];		// needs to be at least as big as 2*JAC_SEARCH_MAX_M and SMALLJAC_VBITS
+	jac_t *baby_stash = ctx->baby_stash;
 	jac_t s1, s2;
 	register unsigned long GS, dvalue, uvalue;
 	long e, n, o, o1;
@@ -327,7 +373,7 @@ unsigned long jac_parallel_search (jac_t a[1],  unsigned long M, unsigned long W
 	register uint32_t value, vstep;
 	uint32_t matches[SMALLJAC_MAX_MATCHES];
 	register int sign, stash;
-	unsigned long tabbits;
+	unsigned long tabbits, m;
 	int w;
 	unsigned long p[MPZ_MAX_FACTORS], h[MPZ_MAX_FACTORS];
 
@@ -349,60 +395,61 @@ unsigned long jac_parallel_search (jac_t a[1],  unsigned long M, unsigned long W
 			baby_steps = (unsigned)ceil(sqrt((double)2.0*W));		// don't use inverse optimization - only for comparison
 		}
 	}
-	baby_span = (parity ? 2*SMALLJAC_M*_ui_ceil_ratio(baby_steps,SMALLJAC_M) : SMALLJAC_M*_ui_ceil_ratio(baby_steps,SMALLJAC_M));
+	ctx->m = m = jac_search_width (ctx, 2*baby_steps);
+	baby_span = (parity ? 2*m*_ui_ceil_ratio(baby_steps,m) : m*_ui_ceil_ratio(baby_steps,m));
 	if ( baby_span >= (1<<SMALLJAC_VBITS) ) { err_printf ("SMALLJAC_VBITS = %d is too small for baby span %d, increase SMALLJAC_VBITS\n", SMALLJAC_VBITS, baby_span);  exit (0); }
 	stash = baby_span;
-	if ( stash >= SMALLJAC_BABY_STASHSIZE ) stash = 0;
+	if ( stash >= JAC_SEARCH_STASHSIZE ) stash = 0;
 //printf ("%lu: stash=%d\n", _ff_p, stash);
 	
 	_jac_set (babys[0], a[0]);
-	for ( i = 1 ; i < SMALLJAC_M ; i += i ) jac_parallel_mult_1 (babys+i, babys, babys+i-1, c, i);
+	for ( i = 1 ; i < m ; i += i ) jac_parallel_mult_1 (babys+i, babys, babys+i-1, c, i);
 	if ( ! stash ) {									// if stash isn't big enough, precompute baby powers to use for reconstruction
-		for ( i = 0 ; (1<<i) <= SMALLJAC_M ; i++ ) _jac_set (b[i], babys[(1<<i)-1]);
+		for ( i = 0 ; (1<<i) <= m ; i++ ) _jac_set (b[i], babys[(1<<i)-1]);
 		for ( i-- ; i < SMALLJAC_VBITS ; i++ ) _jac_square (b[i+1], b[i], c[0]);
 	}
 	if ( parity ) {
-		for ( i = 2 ; i < SMALLJAC_M ; i += 2 ) _jac_set (babys[(i+1)/2], babys[i]);
-		_jac_set (s1, babys[SMALLJAC_M-1]);			// overlap is probably ok, but no need to push it
-		jac_parallel_mult_1(babys+SMALLJAC_M/2, babys, &s1, c, SMALLJAC_M/2);
-		_jac_mult (s1, babys[0], babys[SMALLJAC_M-1], c[0]);	// m-th baby has odd index 2m-1, we add one to get s1 = 2m: (1,3,...,2m-1) -> (2m+1,2m+3,...,4m-1)
+		for ( i = 2 ; i < m ; i += 2 ) _jac_set (babys[(i+1)/2], babys[i]);
+		_jac_set (s1, babys[m-1]);			// overlap is probably ok, but no need to push it
+		jac_parallel_mult_1(babys+m/2, babys, &s1, c, m/2);
+		_jac_mult (s1, babys[0], babys[m-1], c[0]);	// m-th baby has odd index 2m-1, we add one to get s1 = 2m: (1,3,...,2m-1) -> (2m+1,2m+3,...,4m-1)
 		vstep = 2;
 	} else {
-		_jac_set (s1, babys[SMALLJAC_M-1]);			// s1 = m-th baby:  (1,2,...,m) -> (m+1,m+2,...,2m)
+		_jac_set (s1, babys[m-1]);			// s1 = m-th baby:  (1,2,...,m) -> (m+1,m+2,...,2m)
 		vstep = 1;
 	}
 //printf ("%lu: Beginning baby steps\n", _ff_p);
 	// put identity in table
 	_jac_set_identity (baby_stash[0]);
 	for ( tabbits = 8 ; (1<<tabbits) < 2*baby_steps ; tabbits++ );
-	smalljac_table_init (tabbits);
-	smalljac_table_insert (baby_stash, 0);
+	smalljac_table_init (&ctx->tab, tabbits);
+	smalljac_table_insert (&ctx->tab, baby_stash, 0);
 	// take baby steps
 	o = o1 = 0;
 	value = 1;
 	n = jac_gops;
 	if ( stash ) {
 		for (;; ) {
-			for ( i = 0 ; i < SMALLJAC_M ; i++ ) {
+			for ( i = 0 ; i < m ; i++ ) {
 				if ( _jac_is_identity (babys[i]) ) { o = value;  goto found; }
 //printf ("%lu: inserting baby value %d: ", _ff_p, value);  _jac_print(babys[i]);
-				smalljac_table_insert (babys+i, value);
+				smalljac_table_insert (&ctx->tab, babys+i, value);
 				_jac_set (baby_stash[value], babys[i]);					// we could avoid copying here, but parity makes it awkward
 				value += vstep;
 			}
 			if ( value > baby_span ) break;									// value is now the index of the next baby we will compute - one (or two) greater than the last
-			jac_parallel_mult_1 (babys, babys, &s1, c, SMALLJAC_M);
+			jac_parallel_mult_1 (babys, babys, &s1, c, m);
 		}
 	} else {
 		for (;; ) {
-			for ( i = 0 ; i < SMALLJAC_M ; i++ ) {
+			for ( i = 0 ; i < m ; i++ ) {
 				if ( _jac_is_identity (babys[i]) ) { o = value;  goto found; }
 //printf ("%lu: inserting baby value %d: ", _ff_p, value);  _jac_print(babys[i]);
-				smalljac_table_insert (babys+i, value);
+				smalljac_table_insert (&ctx->tab, babys+i, value);
 				value += vstep;
 			}
 			if ( value > baby_span ) break;									// value is now the index of the next baby we will compute - one (or two) greater than the last
-			jac_parallel_mult_1 (babys, babys, &s1, c, SMALLJAC_M);
+			jac_parallel_mult_1 (babys, babys, &s1, c, m);
 		}
 	}
 	value -= vstep;													// set value to index of last baby computed
@@ -413,10 +460,10 @@ unsigned long jac_parallel_search (jac_t a[1],  unsigned long M, unsigned long W
 	if ( parity && (e&1) ) e++;											// we use the largest baby to get the first giant by tweaking M to be a multiple of value (with the right parity)
 	M = e * value;														// this adds at most one giant step.
 	n = jac_gops;
-	jac_exp_ui (giants, babys+SMALLJAC_M-1, e, c);							// exponentiate biggest baby to get first giant
+	jac_exp_ui (giants, babys+m-1, e, c);							// exponentiate biggest baby to get first giant
 	jac_exp_gops += jac_gops-n;
 	
-	_jac_square (s1, babys[SMALLJAC_M-1], c[0]);								// s1 is double last baby
+	_jac_square (s1, babys[m-1], c[0]);								// s1 is double last baby
 	if ( parity ) {
 		if ( full < 2 ) GS = 2*value;
 		else GS = ( (value&1) ? value+1 : value );							// giant spacing must be even if babys are odd
@@ -425,29 +472,30 @@ unsigned long jac_parallel_search (jac_t a[1],  unsigned long M, unsigned long W
 		if ( full < 2 ) GS = 2*value+1; else GS = value;
 	}
 	// compute m/2 giants - currently done serially
-	for ( i = 1 ; i < SMALLJAC_M/2 ; i++ ) _jac_mult (giants[i], giants[i-1], s1, c[0]);
-	for ( i = 1 ; i < SMALLJAC_M/2 ; i += i ) _jac_square (s1, s1, c[0]);				// power up s1 so that each giant will step m/2 giant spacings
+	for ( i = 1 ; i < m/2 ; i++ ) _jac_mult (giants[i], giants[i-1], s1, c[0]);
+	for ( i = 1 ; i < m/2 ; i += i ) _jac_square (s1, s1, c[0]);				// power up s1 so that each giant will step m/2 giant spacings
 	_jac_set (s2, s1);
-	if ( _jac_is_identity (s2) ) { o = GS*(SMALLJAC_M/2);  goto found; }				// unlikely but possible and the giants won't get very far if this happens
+	if ( _jac_is_identity (s2) ) { o = GS*(m/2);  goto found; }				// unlikely but possible and the giants won't get very far if this happens
 	_jac_invert (s2);													// s2 = -s1 is used for downward steps
-	jac_parallel_mult_1 (giants+SMALLJAC_M/2, giants, &s2, c, SMALLJAC_M/2);		// have m/2 up giants step down once to form m/2 down giants - this means down giants are in reverse order but we can cope
-	for ( i = 0 ; i < SMALLJAC_M/2 ; i++ ) {									// gsteps array is just m/2 copies of s1 and s2, used to perform up and down steps in parallel
+	jac_parallel_mult_1 (giants+m/2, giants, &s2, c, m/2);		// have m/2 up giants step down once to form m/2 down giants - this means down giants are in reverse order but we can cope
+	for ( i = 0 ; i < m/2 ; i++ ) {									// gsteps array is just m/2 copies of s1 and s2, used to perform up and down steps in parallel
 		_jac_set (gsteps[i],s1);
-		_jac_set (gsteps[i+SMALLJAC_M/2],s2);
+		_jac_set (gsteps[i+m/2],s2);
 	}
 
 	uvalue = M;														// index of first up giant
-	dvalue = M-GS;													// index of "last" down giant giants[SMALLJAC_M-1] - this is the one with the largest index
+	dvalue = M-GS;													// index of "last" down giant giants[m-1] - this is the one with the largest index
 
 //printf ("%lu: Beginning giant steps GS = %ld, uvalue = %ld, dvalue = %ld, used %lu gops\n", _ff_p, GS, uvalue, dvalue, jac_gops-n);	
 
 	//giant steps 
 	// the code duplication below is intentional.  it could be avoided, but at the cost of more conditional code inside the loops
 	for ( j = 0 ; ; j++ ) {												// search until we find it - could add Min/Max check
+		for ( i = 0 ; i < m ; i++ ) smalljac_table_prefetch (&ctx->tab, giants+i);		// lookups are random accesses, get them all started now
 		if ( uvalue ) {
-			for ( i = 0 ; i < SMALLJAC_M/2 ; i++ ) {						// up giants
+			for ( i = 0 ; i < m/2 ; i++ ) {						// up giants
 //printf ("%lu: checking up giant = %lu ", _ff_p, uvalue);  _jac_print(giants[i]);
-				if ( (cnt = smalljac_table_lookup (matches, giants+i)) > 0 ) {
+				if ( (cnt = smalljac_table_lookup (&ctx->tab, matches, giants+i)) > 0 ) {
 //printf ("%9lu: matched %d up\n", _ff_p, cnt);
 					for ( k = 0 ; k < cnt ; k++ ) {
 //printf ("%d\n", matches[k]);
@@ -485,9 +533,9 @@ unsigned long jac_parallel_search (jac_t a[1],  unsigned long M, unsigned long W
 		}
 udone:
 		if ( dvalue ) {
-			for ( i = SMALLJAC_M-1 ; dvalue && i >= SMALLJAC_M/2 ; i-- ) {			// down giants - process largest dvalue first
+			for ( i = m-1 ; dvalue && i >= m/2 ; i-- ) {			// down giants - process largest dvalue first
 //printf ("%lu: checking down giant = %lu ", _ff_p, dvalue);  _jac_print(giants[i]);
-				if ( (cnt = smalljac_table_lookup (matches, giants+i)) > 0 ) {
+				if ( (cnt = smalljac_table_lookup (&ctx->tab, matches, giants+i)) > 0 ) {
 //printf ("%9lu: matched %d down\n", _ff_p, cnt);
 					for ( k = 0 ; k < cnt ; k++ ) {
 						if ( stash ) {
@@ -527,11 +575,11 @@ ddone:
 		if ( dvalue+baby_span < Min ) dvalue = 0;
 		if ( ! dvalue && ! uvalue ) break;
 		if ( ! dvalue ) {
-			jac_parallel_mult_c (giants, giants, gsteps, c, SMALLJAC_M/2);
+			jac_parallel_mult_c (giants, giants, gsteps, c, m/2);
 		} else if ( ! uvalue ) {
-			jac_parallel_mult_c (giants+SMALLJAC_M/2, giants+SMALLJAC_M/2, gsteps+SMALLJAC_M/2, c, SMALLJAC_M/2);
+			jac_parallel_mult_c (giants+m/2, giants+m/2, gsteps+m/2, c, m/2);
 		} else {
-			jac_parallel_mult_c (giants, giants, gsteps, c, SMALLJAC_M);
+			jac_parallel_mult_c (giants, giants, gsteps, c, m);
 		}
 	}
 	jac_giant_gops += jac_gops-n;
@@ -551,7 +599,7 @@ found:
 	if ( o < 0 ) { err_printf("%lu: Negative exponent %ld found with full=%d, o1=%ld for element ", _ff_p, o, full, o1);  _jac_print(a[0]);  return 0; }
 
 //printf ("found, used %lu gops\n", jac_gops-n);	
-//if ( j > 3*baby_s ) printf ("%9u: Long search - %d baby steps, %d giant steps, W = %ld\n", _ff_p, baby_s*SMALLJAC_M, j*SMALLJAC_M, W); 
+//if ( j > 3*baby_s ) printf ("%9u: Long search - %d baby steps, %d giant steps, W = %ld\n", _ff_p, baby_s*m, j*m, W); 
 //printf ("giant steps in order computation, used %lu gops\n", jac_gops-n);	
 	jac_giant_gops += jac_gops-n;
 	n = jac_gops;
@@ -576,11 +624,10 @@ found:
 // Finds least two matches in interval, returns number of matches found
 // If repeats is nonzero, it specifies the number of calls the caller plans to make using the same base point
 // All calls after the first call should have new_a=0 (but keep repeats the same)
-int jac_search (mpz_t e[2], jac_t new_a[1],  unsigned long m, mpz_t Min, mpz_t Max, int repeats, hc_poly c[1])
+int jac_search_r (jac_search_ctx_t *ctx, mpz_t e[2], jac_t new_a[1],  unsigned long m, mpz_t Min, mpz_t Max, int repeats, hc_poly c[1])
 {
-	static int init;
-	static mpz_t o, o1, o2, G;
-	static jac_t a[1], b[32];
+	mpz_t o, o1, o2, G;
+	jac_t *a = &ctx->search_base, *b = ctx->search_powers;
 	jac_t baby, giant;
 	jac_t s1, step, babystep;
 	unsigned long S, tabbits, s, gs; 
@@ -588,7 +635,7 @@ int jac_search (mpz_t e[2], jac_t new_a[1],  unsigned long m, mpz_t Min, mpz_t M
 	uint32_t matches[SMALLJAC_MAX_MATCHES];
 	int sign;
 
-	if ( ! init ) { mpz_init (o);  mpz_init(o1);  mpz_init (o2);  mpz_init(G); init = 1; }
+	mpz_init (o);  mpz_init(o1);  mpz_init (o2);  mpz_init(G);
 	mpz_sub (G, Max, Min);
 	assert ( mpz_sgn (G) >= 0 );
 	if ( ! repeats ) repeats = 1;
@@ -621,10 +668,10 @@ int jac_search (mpz_t e[2], jac_t new_a[1],  unsigned long m, mpz_t Min, mpz_t M
 	if ( new_a ) _jac_set (a[0], new_a[0]);
 	if ( new_a ) {
 		for ( tabbits = 8 ; (1<<tabbits) < 2*s ; tabbits++ );
-		smalljac_table_init (tabbits);
+		smalljac_table_init (&ctx->tab, tabbits);
 		// put identity in table
 		_jac_set_identity (step);
-		smalljac_table_insert (&step, 0);
+		smalljac_table_insert (&ctx->tab, &step, 0);
 		// Compute babystep = first baby
 		jac_exp_ui (&babystep, a, m, c);
 		_jac_set (baby, babystep);
@@ -633,7 +680,7 @@ int jac_search (mpz_t e[2], jac_t new_a[1],  unsigned long m, mpz_t Min, mpz_t M
 		for ( i = 1 ; i < 32 ; i++ ) _jac_square(b[i], b[i-1], c[0]);
 		// take baby steps
 		for ( i = 1 ; ; i++ ) {
-			smalljac_table_insert (&baby, i);
+			smalljac_table_insert (&ctx->tab, &baby, i);
 			if ( i == s ) break;
 			_jac_mult (baby, baby, babystep, c[0]);
 		}
@@ -648,7 +695,7 @@ int jac_search (mpz_t e[2], jac_t new_a[1],  unsigned long m, mpz_t Min, mpz_t M
 	mpz_set_ui (o, 0);
 	mpz_set_ui (o1, 0);  mpz_set_ui (o2, 0);
 	for ( j = 0 ; j < gs ; j++ ) {
-		if ( (cnt = smalljac_table_lookup (matches, &giant)) > 0 ) {
+		if ( (cnt = smalljac_table_lookup (&ctx->tab, matches, &giant)) > 0 ) {
 			for ( k = 0 ; k < cnt ; k++ ) {
 				if ( matches[k] ) {
 					// reconstruct baby for comparison
@@ -686,5 +733,7 @@ int jac_search (mpz_t e[2], jac_t new_a[1],  unsigned long m, mpz_t Min, mpz_t M
 //gmp_out_printf ("o1=%Zd, o2=%Zd\n", o1, o2);
 	mpz_set (e[0], o1);
 	mpz_set (e[1], o2);
-	return ( mpz_sgn(o2) ? 2 : ( mpz_sgn(o1) ? 1 : 0 ));
+	cnt = ( mpz_sgn(o2) ? 2 : ( mpz_sgn(o1) ? 1 : 0 ));
+	mpz_clear (o);  mpz_clear (o1);  mpz_clear (o2);  mpz_clear (G);
+	return cnt;
 }
@@ -9,6 +9,7 @@
 #include <limits.h>
 #include "jac.h"
 #include "hcpoly.h"
+#include "smalljactab.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -29,9 +30,47 @@ struct a2tab_entry {
 	double a2mae;
 };
 
-int jac_order (unsigned long *pP1, unsigned long Min, unsigned long Max,  long a1, long d,  int fExponentOnly, int *constraints, hc_poly c[1]);
-unsigned long jac_parallel_search (jac_t a[1],  unsigned long M, unsigned long W, unsigned long Min, unsigned long Max, int tiny, int parity, hc_poly c[1]);
-int jac_search (mpz_t e[2], jac_t a[1],  unsigned long m, mpz_t Min, mpz_t Max, int repeats, hc_poly c[1]);
+#define JAC_SEARCH_MIN_M			4				// bounds on the number of group operations performed simultaneously by jac_parallel_search (must be powers of 2)
+#define JAC_SEARCH_MAX_M			32				// 2*JAC_SEARCH_MAX_M can't exceed 64
+#define JAC_SEARCH_STASHSIZE		4096
+
+// default number of group operations performed simultaneously by jac_parallel_search, may be overridden at compile time (must be a power of 2 in [JAC_SEARCH_MIN_M,JAC_SEARCH_MAX_M])
+#ifndef JAC_SEARCH_WIDTH
+#if HECURVE_GENUS == 1
+#define JAC_SEARCH_WIDTH			4
+#else
+#define JAC_SEARCH_WIDTH			32
+#endif
+#endif
+
+/*
+	A search context holds all the state used by the BSGS searches: the baby step table, the baby stash, and the
+	parallel width m (the number of group operations performed simultaneously).  Each thread of execution
+	should use its own context (allocate one per worker), the functions that don't take a context use a default context.
+
+	Unless fixed_m is set, the width is JAC_SEARCH_WIDTH, reduced for searches that are too short to use it (see jac_search_width).
+*/
+typedef struct jac_search_ctx_struct {
+	smalljac_tab_t tab;						// baby step table
+	jac_t *baby_stash;						// JAC_SEARCH_STASHSIZE babies, saves reconstructing babies when matched
+	unsigned long m;						// width used by the most recent search
+	unsigned long fixed_m;					// if nonzero, use this width for every search (must be a power of 2 in [JAC_SEARCH_MIN_M,JAC_SEARCH_MAX_M])
+	jac_t search_base, search_powers[32];		// saved by jac_search_r for repeated searches with the same base
+} jac_search_ctx_t;
+
+jac_search_ctx_t *jac_search_ctx_alloc (int tabbits);
+void jac_search_ctx_free (jac_search_ctx_t *ctx);
+jac_search_ctx_t *jac_search_default_ctx (void);
+unsigned long jac_search_width (jac_search_ctx_t *ctx, unsigned long steps);
+
+int jac_order_r (jac_search_ctx_t *ctx, unsigned long *pP1, unsigned long Min, unsigned long Max,  long a1, long d,  int fExponentOnly, int *constraints, hc_poly c[1]);
+unsigned long jac_parallel_search (jac_search_ctx_t *ctx, jac_t a[1],  unsigned long M, unsigned long W, unsigned long Min, unsigned long Max, int tiny, int parity, hc_poly c[1]);
+int jac_search_r (jac_search_ctx_t *ctx, mpz_t e[2], jac_t a[1],  unsigned long m, mpz_t Min, mpz_t Max, int repeats, hc_poly c[1]);
+
+static inline int jac_order (unsigned long *pP1, unsigned long Min, unsigned long Max,  long a1, long d,  int fExponentOnly, int *constraints, hc_poly c[1])
+	{ return jac_order_r (jac_search_default_ctx(), pP1, Min, Max, a1, d, fExponentOnly, constraints, c); }
+static inline int jac_search (mpz_t e[2], jac_t a[1],  unsigned long m, mpz_t Min, mpz_t Max, int repeats, hc_poly c[1])
+	{ return jac_search_r (jac_search_default_ctx(), e, a, m, Min, Max, repeats, c); }
 
 #ifdef __cplusplus
 }
@@ -9,6 +9,7 @@
 #include "hecurve.h"
 #include "hcpoly.h"
 #include "smalljactab.h"
+#include "jacorder.h"
 #include "cstd.h"
 
 /*
@@ -25,6 +26,61 @@
 
 int jac_vector_logarithm (unsigned long e[], jac_t a[], unsigned long ords[], int k, jac_t b[1], hc_poly c[1]);
 
+/*
+	Given b = a^(E/(Q[0]*...*Q[k-1])), where the Q[i] are pairwise coprime divisors of E, sets o[i] = a^(E/Q[i]), the projection of a onto
+	the Q[i]-part of the group.  We use a product tree: raise b to the product of the right half of the Q[i] to kill it and recurse on
+	the left half, and vice versa.  This uses O(lg(Q[0]*...*Q[k-1])*lg(k)) gops, versus O(k*lg(E)) to compute each o[i] directly.
+*/
+static void jac_sylow_projections (jac_t o[], jac_t b[1], unsigned long Q[], int k, hc_poly c[1])
+{
+	jac_t x;
+	unsigned long L, R;
+	register int i, j;
+
+	if ( k == 1 ) { _jac_set (o[0], b[0]);  return; }
+	j = k/2;
+	for ( L = 1, i = 0 ; i < j ; i++ ) L *= Q[i];
+	for ( R = 1 ; i < k ; i++ ) R *= Q[i];
+	jac_exp_ui (&x, b, R, c);
+	jac_sylow_projections (o, &x, Q, j, c);
+	jac_exp_ui (&x, b, L, c);
+	jac_sylow_projections (o+j, &x, Q+j, k-j, c);
+}
+
+/*
+	Before performing p-Sylow subgroup computations, expend some effort trying to prove the p-Sylow subgroups are cyclic - we
+	expect this to often be the case and it only requires O(lg(N)) gops.  Rather than exponentiating a random element by N/p
+	separately for each p, we project each random element onto all the p-Sylow subgroups that remain in question at once.
+	Sets cyclic[i] to 1 if the p[i]-Sylow subgroup is proven to be cyclic (which requires N to be the group order).
+*/
+static void jac_cyclic_sylow_tests (int cyclic[], unsigned long p[], unsigned long h[], int w, unsigned long N, hc_poly c[1])
+{
+	jac_t x[1], y[JAC_MAX_FACTORS], r[JAC_CYCLIC_TESTS];
+	unsigned long Q[JAC_MAX_FACTORS];
+	int idx[JAC_MAX_FACTORS];
+	register unsigned long M;
+	register int i, j, k;
+
+	for ( i = k = 0 ; i < w ; i++ ) {
+		cyclic[i] = 0;
+		if ( h[i] == 1 ) continue;
+		for ( Q[k] = p[i], j = 1 ; j < h[i] ; j++ ) Q[k] *= p[i];
+		idx[k++] = i;
+	}
+	if ( k ) jac_random_batch (r, c, JAC_CYCLIC_TESTS);
+	for ( j = 0 ; k && j < JAC_CYCLIC_TESTS ; j++ ) {
+		for ( M = N, i = 0 ; i < k ; i++ ) M /= Q[i];
+		jac_exp_ui (x, r+j, M, c);
+		jac_sylow_projections (y, x, Q, k, c);
+		for ( i = 0 ; i < k ; ) {
+			jac_exp_ui (x, y+i, Q[i]/p[idx[i]], c);
+			if ( _jac_is_identity (x[0]) ) { i++;  continue; }
+			cyclic[idx[i]] = 1;											// y[i] has order Q[i]
+			k--;  idx[i] = idx[k];  Q[i] = Q[k];  _jac_set (y[i], y[k]);
+		}
+	}
+}
+
 /*
 	Given the order (or multiple of the exponent) of the group, N = #J(C/F_q), jac_structure computes the abelian group structure of J(C/F_q)
 	as a product of cylclic groups Z_m[0] x ... x Z_m[n-1] with m[0] | m[1] | ... | m[n-1] and returns n.  The flag fExponent, when set, indicates that N is only
@@ -38,15 +94,18 @@ int jac_structure (long m[], hc_poly c[1], unsigned long N, int fExponent)
 	unsigned long p[JAC_MAX_FACTORS];
 	unsigned long t[JAC_MAX_GENERATORS];
 	unsigned long ords[JAC_MAX_GENERATORS];
-	jac_t x[1], a[JAC_MAX_GENERATORS];
+	int cyclic[JAC_MAX_FACTORS];
+	jac_t a[JAC_MAX_GENERATORS];
 	register int i, j, k, n, r, w, maxj;
 	register unsigned long max, q, M;
 
 	w = ui_factor (p, h, N);
 	if ( ! w ) { err_printf ("ui_factor_small failed");  exit (0); }
 	n = 1;
-	for ( i = 0 ; i < c->d-1 ; i++ ) t[i] = 1;
+	for ( i = 0 ; i < 2*c->g ; i++ ) t[i] = 1;					// note that c->d may be 2g+1 or 2g+2
 		
+	// The cyclic tests rely on N being the group order
+	if ( ! fExponent ) jac_cyclic_sylow_tests (cyclic, p, h, w, N, c);
 	// could add code here to optimize rank 1 2-Sylow subgroups by counting the factors of f(x)
 	for ( i = 0 ; i < w ; i++ ) {
 		if ( ! fExponent ) {
@@ -54,16 +113,7 @@ int jac_structure (long m[], hc_poly c[1], unsigned long N, int fExponent)
 			if ( h[i] == 1 ) { t[0] *= p[i];  continue; }
 			for ( q = p[i]*p[i], j = 2 ; j < h[i] ; j++ ) q *= p[i];
 			// Todo: Add genus 1 check for divisibility of _ff_p-1
-			// Before performing a p-Sylow subgroup computation, expend some effort trying to
-			// prove the p-Sylow subgroup is cyclic - we expect this to often be the case and
-			// it only requires O(lg(N)) gops.
-			M = N/p[i];		// was N/q which can't be right
-			for ( j = 0 ; j < JAC_CYCLIC_TESTS ; j++ ) {
-				_jac_random (x[0], c[0]);
-				jac_exp_ui (x, x, M, c);
-				if ( ! _jac_is_identity (x[0]) ) break;
-			}
-			if ( j < JAC_CYCLIC_TESTS ) { for ( j = 0 ; j < h[i] ; j++ ) t[0] *= p[i]; continue; }
+			if ( cyclic[i] ) { t[0] *= q;  continue; }
 		} else {
 			q = 0;
 		}
@@ -86,7 +136,7 @@ int jac_structure (long m[], hc_poly c[1], unsigned long N, int fExponent)
 		}
 	}
 	// sanity checks - can be removed eventually (but probably better to leave them in, they take no time)
-	if ( n > c->d-1 ) { err_printf ("jac_structure failed - computed rank %d > 2g = %d\n", n, c->d-1);  exit (0); }
+	if ( n > 2*c->g ) { err_printf ("jac_structure failed - computed rank %d > 2g = %d\n", n, 2*c->g);  exit (0); }
 	if ( ! fExponent ) {
 	for ( M = 1, i = 0 ; i < n ; i++ ) M *= t[i];
 	if ( M != N ) { err_printf ("jac_structure failed - computed order %lu not equal to given order %lu\n", M, N);  exit (0); }
@@ -99,6 +149,19 @@ int jac_structure (long m[], hc_poly c[1], unsigned long N, int fExponent)
 }
 
 
+// sets o to the next element of the pool of random elements raised to the power E, refilling the pool (with a larger batch) if it is empty
+static inline void jac_sylow_random (jac_t o[1], jac_t pool[], int *npool, int *pool_size, unsigned long E, hc_poly c[1])
+{
+	if ( ! *npool ) {
+		*npool = *pool_size;
+		jac_random_batch (pool, c, *npool);
+		jac_exp_ui_batch (pool, pool, E, c, *npool);
+		if ( *pool_size < JAC_EXP_BATCH ) *pool_size *= 2;
+	}
+	(*npool)--;
+	_jac_set (o[0], pool[*npool]);
+}
+
 /*
     jac_sylow computes the p-Sylow subgroup of the jacobian using a provided exponent E (E can be any multiple of the group exponent)
     M is an upper bound on the maximum size of the p-Sylow subgroup - if this value is too small, jac_sylow will compute a
@@ -115,11 +178,11 @@ int jac_structure (long m[], hc_poly c[1], unsigned long N, int fExponent)
 
 int jac_sylow (jac_t a[JAC_MAX_GENERATORS], unsigned long ords[JAC_MAX_GENERATORS], unsigned long p, unsigned long E, unsigned long M, unsigned long limit, hc_poly c[1])
 {
-	jac_t b;
+	jac_t b, pool[JAC_EXP_BATCH];
 	unsigned long h;
 	unsigned long e[JAC_MAX_GENERATORS];
 	unsigned long m, q, x, temp;
-	int k, n, cnt, retries, min, d;
+	int k, n, cnt, retries, min, d, npool, pool_size;
 	int sts;
 
 	for ( h = 0 ; ! (E%p) ; h++ ) E/= p;
@@ -128,10 +191,11 @@ int jac_sylow (jac_t a[JAC_MAX_GENERATORS], unsigned long ords[JAC_MAX_GENERATOR
 	dbg_printf ("%ld: jac_sylow computing %ld-sylow subgroup with h=%ld, reduced E=%ld, M=%ld, limit=%ld\n", _ff_p, p, h, E, M, limit);
 //printf ("Curve over F_%ld is: ", _ff_p); ff_poly_print (c[0].f, 6);
 	k = 0;
+	// random elements are raised to the power E in batches (see jac_exp_ui_batch), we usually stop early when M is reached so start small
+	npool = 0;  pool_size = 2;
 	// Get initial generator
 	for ( cnt = 0 ; cnt < CONFIDENCE ; cnt++ ) {
-		_jac_random (a[k], c[0]);
-		jac_exp_ui (a+k, a+k, E, c);
+		jac_sylow_random (a+k, pool, &npool, &pool_size, E, c);
 		_jac_set (b, a[k]);
 		ords[k] = jac_pp_order_ui (&b, p, h, c);
 		if ( ords[k] > 1 ) break;
@@ -150,8 +214,7 @@ int jac_sylow (jac_t a[JAC_MAX_GENERATORS], unsigned long ords[JAC_MAX_GENERATOR
 		if ( M && x > M/p ) { dbg_printf ("Sylow subgroup computation successfully terminated due to bound M = %ld\n", M);  break; }
 		// note that we keep searching even if we have 2g generators, because we could need to extend the order of one of them, but k should never exceed 2g+1
 		assert ( k <= 2*c->g );
-		_jac_random (a[k], c[0]);
-		jac_exp_ui (a+k, a+k, E, c);
+		jac_sylow_random (a+k, pool, &npool, &pool_size, E, c);
 repeat:
 		if ( _jac_is_identity (a[k]) ) continue;
 		_jac_set (b, a[k]);
@@ -254,12 +317,13 @@ repeat:
      
      This algorithm is a straight copy of the generic version and does not include any optimizations for fast inverses
      or parallel group operations.   smalljac uses this very infrequently, so we don't bother optimizing it.
+     The table and stash are allocated for each call (rather than shared), so this is reentrant.
 */
 
 int jac_vector_logarithm (unsigned long e[], jac_t a[], unsigned long ords[], int k, jac_t beta[1], hc_poly hc[1])
 {
-	static int stashsize;
-	static jac_t *stash;
+	jac_t *stash;
+	smalljac_tab_t T[1];
 	jac_t g, h, ht, betainverse;
 	unsigned long E;
 	register long i, b, c, ct, d, u, s, t, j, l;
@@ -294,18 +358,11 @@ int jac_vector_logarithm (unsigned long e[], jac_t a[], unsigned long ords[], in
 
 	// Note that we will be giant stepping via alpha[d]^c
 	
-	// initialize table and init/expand stash if needed
+	// allocate and initialize the table and stash
 	for ( bits = 10, i = (1<<10) ; i < 2*b ; i <<= 1, bits++ );		// aim for a load factor of 0.5
-	smalljac_table_init (bits);
-	if ( b >= stashsize ) {
-		if ( stash ) {
-			for ( stashsize *= 2 ; stashsize < b ; stashsize *= 2 );
-			stashsize *= 2;  stash = (jac_t *) realloc (stash, stashsize*sizeof(*stash));
-		} else {
-			for ( stashsize = 1024 ; stashsize < b ; stashsize *= 2 );
-			stash = (jac_t *) mem_alloc (stashsize*sizeof(*stash));
-		}
-	}
+	smalljac_table_alloc (T, bits);
+	smalljac_table_init (T, bits);
+	stash = (jac_t *) mem_alloc (b*sizeof(*stash));
 
 	_jac_set_identity (g);
 	// baby steps - we currently don't bother trying to do these in parallel
@@ -313,7 +370,7 @@ int jac_vector_logarithm (unsigned long e[], jac_t a[], unsigned long ords[], in
 		_jac_mult (g, g, a[0], hc[0]);
 		for ( j = 0, m = ords[0] ; (i%m) == 0 ; m *= ords[++j] ) _jac_mult (g, g, a[j+1], hc[0]);
 		if ( _jac_cmp (g, beta[0]) == 1 ) break;
-		smalljac_table_insert (&g, i);
+		smalljac_table_insert (T, &g, i);
 		_jac_set (stash[i], g);
 	}
 	if ( _jac_cmp (g, beta[0]) == 1 ) { 
@@ -364,7 +421,7 @@ int jac_vector_logarithm (unsigned long e[], jac_t a[], unsigned long ords[], in
 			m = 0;
 			found = 1;
 		} else {
-			n = smalljac_table_lookup (matches, &g);
+			n = smalljac_table_lookup (T, matches, &g);
 			for ( i = 0 ; i < n ; i++ ) if ( _jac_cmp(stash[matches[i]], g) == 1 ) break;
 			if ( i < n ) { found = 1;  m = matches[i]; } else found = 0;
 		}
@@ -378,7 +435,7 @@ done:
 		}
 		_jac_invert (h);
 		_jac_mult (g, h, betainverse, hc[0]);
-		n = smalljac_table_lookup (matches, &g);
+		n = smalljac_table_lookup (T, matches, &g);
 		for ( i = 0 ; i < n ; i++ ) if ( _jac_cmp(stash[matches[i]], g) == 1 ) break;
 		if ( i < n ) { found = 1;  m = matches[i]; } else found = 0;
 		if ( ! found && ! _jac_is_identity (g) ) goto finish;
@@ -401,6 +458,8 @@ done:
 	}
 	sts = 1;
 finish:
+	smalljac_table_free (T);
+	mem_free (stash);
 	return sts;
 
 	// verification code - comment this out eventually
@@ -22,11 +22,13 @@ struct callback_ctx {
 	unsigned long count;
 	unsigned long missing_count;
 	long trace_sum;
-	FILE *fp;
+	smalljac_writer_t w;		// set when writing a text file
+	smalljac_lpfile_t lf;		// set when writing a binary file
+	smalljac_colfile_t cf;		// set when writing a columnar file
 };
 
 /*
-	This callback function simply outputs L_p(T) coefficients a_1,...a_g to ctx->fp and computes a1_sum.
+	This callback function simply outputs L_p(T) coefficients a_1,...a_g to the output file and computes a1_sum.
 */
 int dump_lpoly (smalljac_curve_t curve, unsigned long p, int good, long a[], int n, void *arg)
 {
@@ -37,17 +39,21 @@ int dump_lpoly (smalljac_curve_t curve, unsigned long p, int good, long a[], int
 	ctx->count++;
 
 	if ( ! n ) {
-		printf ("Lpoly not computed at %ld\n", p); ctx->missing_count++; fprintf (ctx->fp, "%ld,?\n", p); 
-		return 1;
+		printf ("Lpoly not computed at %ld\n", p); ctx->missing_count++;
+		if ( ctx->lf ) return smalljac_lpfile_append (ctx->lf, p, 0, a, 0);
+		if ( ctx->cf ) return smalljac_colfile_append (ctx->cf, p, 0, a, 0);
+		return smalljac_writer_lpoly (ctx->w, p, 0, a, 0);
 	}
 	ctx->trace_sum -= a[0];
-	switch (n) {
-	case 1: fprintf(ctx->fp,"%ld,%ld\n", p, a[0]); break;
-	case 2: fprintf(ctx->fp,"%ld,%ld,%ld\n", p, a[0], a[1]); break;
-	case 3: fprintf(ctx->fp,"%ld,%ld,%ld,%ld\n", p, a[0], a[1], a[2]); break;
-	default: printf ("\rUnexpected number of Lpoly coefficients %d\n", n);  return 0;
+	if ( ctx->lf ) {
+		if ( ! smalljac_lpfile_append (ctx->lf, p, 1, a, n) ) return 0;
+	} else if ( ctx->cf ) {
+		if ( ! smalljac_colfile_append (ctx->cf, p, 1, a, n) ) return 0;
+	} else {
+		if ( n > 3 ) { printf ("\rUnexpected number of Lpoly coefficients %d\n", n);  return 0; }
+		if ( ! smalljac_writer_lpoly (ctx->w, p, 1, a, n) ) return 0;
 	}
-	if ( ! ((++cnt)&0xFFFF) ) printf ("\r%lu\r", p);  fflush(stdout);
+	if ( ! ((++cnt)&0xFFFF) ) { printf ("\r%lu\r", p);  fflush(stdout); }
 	return 1;	
 }
 
@@ -60,7 +66,9 @@ int main (int argc, char *argv[])
 	struct callback_ctx context;
 	unsigned long flags;
 	long result;
-	int i, err, jobs, jobid;
+	char curvestr[1024], header[1024+64];
+	int i, err, jobs, jobid, binary, columnar, compress;
+	char *suffix;
 	long minp, maxp;
 	char *s,*t;
 	
@@ -71,16 +79,20 @@ int main (int argc, char *argv[])
 		printf ("          lpdata 31a \"[1,-1-a,a,0,0] / (a^2-a-1)\" 10e6\n");
 		printf ("          lpdata foo \"[x^3 + (z^3+z-1)*x + 3*z^2-4] / (z^4+z^3+z^2+z+1)\" 2e20 4\n");
 		puts ("");
-		printf ("flags&1 => SMALLJAC_GOOD_ONLY, flags&2 => SMALLJAC_A1_ONLY, flags&4 => SMALLJAC_DEGREE1.\n");
+		printf ("flags&1 => SMALLJAC_GOOD_ONLY, flags&2 => SMALLJAC_A1_ONLY, flags&4 => SMALLJAC_DEGREE1, flags&8 => binary output (.lpd),\n");
+		printf ("flags&16 => compressed columnar output (.lpc), flags&32 => gzip compressed text output (.txt.gz).\n");
 		printf ("smalljac version %s\n", SMALLJAC_VERSION_STRING);
 		return 0;
 	}
 	
 	flags = 0;
-	jobs = jobid = 0;
+	jobs = jobid = binary = columnar = compress = 0;
 	if ( argc > 4 ) {
 		i = atol (argv[4]);
-		if ( i < 0 || i > 7 ) { printf ("Unknown/unsupported flags specified\n"); return 0; }
+		if ( i < 0 || i > 63 || (i&24) == 24 || ((i&32) && (i&24)) ) { printf ("Unknown/unsupported flags specified\n"); return 0; }
+		if ( i&8 ) binary = 1;
+		if ( i&16 ) columnar = 1;
+		if ( i&32 ) compress = 1;
 		if ( i&1 ) flags |= SMALLJAC_GOOD_ONLY;
 		if ( i&2 ) flags |= SMALLJAC_A1_ONLY;
 		if ( i&4 ) flags |= SMALLJAC_DEGREE1_ONLY;
@@ -120,16 +132,27 @@ int main (int argc, char *argv[])
 
 	memset (&context,0,sizeof(context));
 	
-	if ( jobs ) sprintf (filename, "%s_lpdata_%d_%d.txt", argv[1], jobs, jobid); else sprintf (filename, "%s_lpdata.txt", argv[1]);
-	context.fp = fopen (filename,"w");
-	if ( ! context.fp ) { printf ("Error creating file %s\n", filename); return 0; }
-	
-	// write header line
-	if ( argv[2][0] != '[' ) fprintf (context.fp, "[%s]", argv[2]); else fprintf (context.fp,"%s",argv[2]);
-	fprintf (context.fp, " %ld %ld", minp, maxp);
-	if ( jobs ) fprintf(context.fp, " %d %d", jobs, jobid);
-	fprintf (context.fp, "\n");
-	fflush (context.fp);		// important to flush before calling parallel Lpolys!!
+	suffix = ( binary ? "lpd" : ( columnar ? "lpc" : ( compress ? "txt.gz" : "txt" ) ) );
+	if ( jobs ) sprintf (filename, "%s_lpdata_%d_%d.%s", argv[1], jobs, jobid, suffix); else sprintf (filename, "%s_lpdata.%s", argv[1], suffix);
+	if ( strlen(argv[2]) + 3 > sizeof(curvestr) ) { printf ("Curve string too long\n"); return 0; }
+	if ( argv[2][0] != '[' ) sprintf (curvestr, "[%s]", argv[2]); else strcpy (curvestr, argv[2]);
+	if ( binary ) {
+		context.lf = smalljac_lpfile_create (filename, curvestr, minp, maxp, smalljac_curve_genus(curve), (flags&SMALLJAC_A1_ONLY) ? 1 : smalljac_curve_genus(curve));
+		if ( ! context.lf ) { printf ("Error creating file %s\n", filename); return 0; }
+	} else if ( columnar ) {
+		context.cf = smalljac_colfile_create (filename, (flags&SMALLJAC_A1_ONLY) ? 1 : smalljac_curve_genus(curve), SMALLJAC_COLFILE_COMPRESS);
+		if ( ! context.cf ) { printf ("Error creating file %s\n", filename); return 0; }
+		smalljac_colfile_curve (context.cf, curvestr);
+	} else {
+		context.w = smalljac_writer_create (filename, compress ? SMALLJAC_WRITER_COMPRESS : 0, -1);
+		if ( ! context.w ) { printf ("Error creating file %s\n", filename); return 0; }
+		
+		// write header line (the writer does its own buffering, so nothing is duplicated when parallel Lpolys forks)
+		s = header + sprintf (header, "%s %ld %ld", curvestr, minp, maxp);
+		if ( jobs ) s += sprintf (s, " %d %d", jobs, jobid);
+		strcpy (s, "\n");
+		smalljac_writer_write (context.w, header, strlen(header));
+	}
 	
 	context.trace_sum = 0;
 
@@ -139,7 +162,9 @@ int main (int argc, char *argv[])
 //	result = smalljac_Lpolys (curve, minp, maxp, flags, dump_lpoly, (void*)&context);
 	end_time = time(0);
 	
-	fclose (context.fp);
+	if ( context.lf ) { if ( ! smalljac_lpfile_close (context.lf) ) printf ("Error writing file %s\n", filename); }
+	else if ( context.cf ) { if ( ! smalljac_colfile_close (context.cf) ) printf ("Error writing file %s\n", filename); }
+	else if ( ! smalljac_writer_close (context.w) ) printf ("Error writing file %s\n", filename);
 	smalljac_curve_clear (curve);
 	
 	if ( result < 0 ) {  printf ("smalljac_Lpolys returned error %ld\n", result);  return 0; }
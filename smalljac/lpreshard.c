@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ff_poly.h"
+#include "mpzutil.h"
+#include "smalljac.h"
+#include "cstd.h"
+
+/*
+    Copyright (c) 2026 The smalljac contributors
+    See LICENSE file for license details.
+*/
+
+// Program to merge, split, or convert the data files written by lpdata (e.g. to combine the output of a 256-job run into a single file)
+
+int main (int argc, char *argv[])
+{
+	time_t start_time, end_time;
+	unsigned long flags, minp, maxp;
+	long result;
+	int i, injobs, outjobs, format;
+	char *s, *t;
+
+	if ( argc < 5 ) {
+		printf ("Usage:    lpreshard in-prefix in-jobs out-prefix out-jobs [flags interval]\n\n");
+		printf ("Reads in-prefix_in-jobs_i.lpd/.txt/.txt.gz for 0 <= i < in-jobs (or the single file in-prefix if in-jobs is 0)\n");
+		printf ("and writes the same data to out-prefix_out-jobs_j.txt for 0 <= j < out-jobs (or out-prefix.txt if out-jobs is 0).\n");
+		printf ("Job counts must be 0 or 2^k with 1 <= k <= 8.  For curves over Q, every good prime in the interval must be present.\n\n");
+		printf ("Examples:\n");
+		printf ("          lpreshard mycurve_lpdata 256 mycurve 0\n");
+		printf ("          lpreshard mycurve_lpdata.txt 0 mycurve 16 8 [1..1e9]\n");
+		puts ("");
+		printf ("flags&1 => SMALLJAC_GOOD_ONLY, flags&2 => SMALLJAC_A1_ONLY, flags&8 => binary output (.lpd),\n");
+		printf ("flags&16 => compressed columnar output (.lpc), flags&32 => gzip compressed text output (.txt.gz).\n");
+		printf ("smalljac version %s\n", SMALLJAC_VERSION_STRING);
+		return 0;
+	}
+
+	injobs = atoi (argv[2]);
+	outjobs = atoi (argv[4]);
+	for ( i = 0 ; i < 9 ; i++ ) if ( injobs == (1<<i) ) break;
+	if ( injobs && i == 9 ) { printf ("in-jobs must be 0 or 2^k with 1 <= k <= 8\n"); return 0; }
+	for ( i = 0 ; i < 9 ; i++ ) if ( outjobs == (1<<i) ) break;
+	if ( outjobs && i == 9 ) { printf ("out-jobs must be 0 or 2^k with 1 <= k <= 8\n"); return 0; }
+
+	flags = 0;  format = SMALLJAC_FORMAT_TEXT;
+	if ( argc > 5 ) {
+		i = atol (argv[5]);
+		if ( i < 0 || i > 63 || (i&4) || (i&24) == 24 || ((i&32) && (i&24)) ) { printf ("Unknown/unsupported flags specified\n"); return 0; }
+		if ( i&8 ) format = SMALLJAC_FORMAT_BINARY;
+		if ( i&16 ) format = SMALLJAC_FORMAT_COLUMNAR;
+		if ( i&32 ) format = SMALLJAC_FORMAT_GZIP;
+		if ( i&1 ) flags |= SMALLJAC_GOOD_ONLY;
+		if ( i&2 ) flags |= SMALLJAC_A1_ONLY;
+	}
+	minp = maxp = 0;
+	if ( argc > 6 ) {
+		if ( (t = strstr(argv[6],"..")) ) {
+			*t = '\0';
+			s = argv[6]; if ( *s == '[' ) s++;
+			minp = atol_exp(s);
+			maxp = atol_exp(t+2);
+		} else {
+			minp = 1; maxp = atol_exp(argv[6]);
+		}
+	}
+
+	start_time = time(0);
+	result = smalljac_reshard (argv[1], injobs, argv[3], outjobs, format, minp, maxp, flags);
+	end_time = time(0);
+	if ( result < 0 ) { printf ("smalljac_reshard returned error %ld\n", result);  return -1; }
+	printf ("Wrote %ld records to %d file%s in %ld seconds\n", result, outjobs ? outjobs : 1, outjobs > 1 ? "s" : "", end_time-start_time);
+	return 0;
+}
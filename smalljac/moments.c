@@ -143,12 +143,16 @@ int main (int argc, char *argv[])
 	time_t start_time, end_time;
 	unsigned long start, end;
 	smalljac_curve_t curve;
-	char *s, *t;
+	smalljac_lpfile_t lf;
+	char *s, *t, *datafile;
+	long result;
 	int i, j, m, n, err, genus;
 	char filter1[MAXM], filter2[MAXM], buf[256], *STgroup;
 	double *moments;
 	struct filter_param filter_param;
 	int (*filter_func)(smalljac_curve_t, unsigned long, void *) = NULL;
+	smalljac_prime_set_t S = 0;
+	unsigned long r[MAXM];
 	
 	if ( argc < 4 ) {
 		puts ("moments start end curve [n filter split]");
@@ -156,7 +160,7 @@ int main (int argc, char *argv[])
 		puts ("The parmater n indicates that moments should be computed for L-poly coeffs a_1, a_2, ..., a_n.  By default n is set to the genus.");
 		puts ("The filter \"11[1,3,4,5,9]\" restricts the scan to primes congruent to 1,3,4,5, or 9 mod 11.");
 		puts ("The split parameter specifies a polynomial and restricts scan to primes p for which the polynomial factors completely mod p");
-		puts ("You may specify a filename as the curve parameter to use precomputed lpoly data (in which case you get everything, not just a1).");
+		puts ("You may specify a data file written by lpdata as the curve parameter to use precomputed lpoly data (filters are not supported in this case).");
 		return 0;
 	}
 	start = atol_exp (argv[1]);
@@ -269,30 +273,34 @@ int main (int argc, char *argv[])
 		}
 	}
 
-	/*
-	// if curve parameter contains the string "data" assume it is a file of Lpoly data, not a curve specification
-	if ( strstr(argv[3],"data") ) {
-		printf ("Reading Lpoly data from file %s\n", argv[3]);
-		start_time = time(0);
-		result = smalljac_Lpolys_from_file (argv[3], start, end, flags, moments, (void*)&context);
-		if ( result < 0 ) {  printf ("smalljac_Lpolys_from_file returned error %ld\n", result);  return 0; }
-		context.cpu_musecs = clock()-start_cpu;  end_time = time(0);
-		goto done;
-	}*/
-	
-	// create the curve - give an explanation of the error if there is a problem
-	curve = smalljac_curve_init (argv[3], &err);
-	if ( ! curve ) { 
-		switch (err) {
-		case SMALLJAC_PARSE_ERROR: printf ("Unable to parse curve string: %s\n", argv[3]); break;
-		case SMALLJAC_UNSUPPORTED_CURVE: puts ("Specified curve not supported, check equation\n");  break;
-		case SMALLJAC_SINGULAR_CURVE: puts ("Specified curve is singular\n");  break;
-		default: printf ("smalljac_curve_init returned error %d\n", err);
+	// if the curve parameter is a readable file, assume it contains precomputed Lpoly data (text or binary, as written by lpdata)
+	datafile = 0;
+	if ( ! access (argv[3], R_OK) ) {
+		if ( filter_func || filter_param.mod.mod ) { puts ("Filters are not supported with precomputed Lpoly data.");  return 0; }
+		if ( ! (lf = smalljac_lpfile_open (argv[3])) ) { printf ("%s is not a valid Lpoly data file\n", argv[3]);  return 0; }
+		smalljac_lpfile_info (lf, &s, 0, 0, 0, 0, 0);
+		printf ("Reading Lpoly data for %s from file %s\n", s, argv[3]);
+		curve = smalljac_curve_init (s, &err);
+		smalljac_lpfile_close (lf);
+		if ( ! curve ) { printf ("Unable to parse curve string in %s (error %d)\n", argv[3], err);  return 0; }
+		genus = smalljac_curve_genus(curve);
+		datafile = argv[3];
+	} else {
+		// create the curve - give an explanation of the error if there is a problem
+		curve = smalljac_curve_init (argv[3], &err);
+		if ( ! curve ) { 
+			switch (err) {
+			case SMALLJAC_PARSE_ERROR: printf ("Unable to parse curve string: %s\n", argv[3]); break;
+			case SMALLJAC_UNSUPPORTED_CURVE: puts ("Specified curve not supported, check equation\n");  break;
+			case SMALLJAC_SINGULAR_CURVE: puts ("Specified curve is singular\n");  break;
+			default: printf ("smalljac_curve_init returned error %d\n", err);
+			}
+			return 0;
 		}
-		return 0;
+		genus = smalljac_curve_genus(curve);
 	}
 
-	n = genus = smalljac_curve_genus(curve);
+	n = genus;
 	if ( argc > 4 ) {
 		i = atoi(argv[4]);
 		if ( i > n ) { printf ("n cannot exceed the genus, which is %d\n", n); return 0; }
@@ -304,9 +312,25 @@ int main (int argc, char *argv[])
 
 	if ( n == genus && genus < 3 ) { STgroup = buf; 	STgroup[0] = '\0'; } else { STgroup = 0; }
 
+	// restrict to the allowed residue classes up front rather than filtering every prime with a callback
+	// filter_mod only passes classes marked 1, but the other filters reject only unmarked classes (they also pass the -1 classes), see !filter[p%mod] above
+	if ( filter_param.mod.mod ) {
+		for ( i = j = 0 ; i < filter_param.mod.mod ; i++ )
+			if ( filter_func == filter_mod ? filter_param.mod.filter[i] == 1 : filter_param.mod.filter[i] != 0 ) r[j++] = i;
+		if ( ! j ) { puts ("No primes satisfy the specified filter.");  return 0; }
+		S = smalljac_prime_set_residues (filter_param.mod.mod, r, j);
+		if ( filter_func == filter_mod ) filter_func = NULL;
+	}
+
 	start_time = time(0);
-	smalljac_moments(curve, start, end, moments, n, m, STgroup, filter_func, &filter_param);
+	if ( datafile ) {
+		result = smalljac_moments_file (datafile, start, end, moments, n, m, STgroup);
+		if ( result < 0 ) { printf ("smalljac_moments_file returned error %ld\n", result);  return 0; }
+	} else {
+		smalljac_moments_set (curve, start, end, S, moments, n, m, STgroup, filter_func, &filter_param);
+	}
 	end_time = time(0);
+	smalljac_prime_set_clear (S);
 
 	for ( i = 0 ; i < n ; i++ ) {
 		printf("a%d Moments: 1,  ", i + 1);
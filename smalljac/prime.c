@@ -3,9 +3,14 @@
 #include <stdio.h>
 #include <limits.h>
 #include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <gmp.h>
 #include "prime.h"
 #include "bitmap.h"
+#include "asm.h"
 
 /*
 	Copyright 2007-2014 Andrew V. Sutherland
@@ -26,25 +31,36 @@ static inline void *_calloc (size_t size) { return calloc (size,1); }
 	
 int _prime_inited;
 
-static int small_primes[PRIME_SMALL_PRIMES+1];
-static int small_prime_index[PRIME_MAX_SMALL_INTEGER+1];
-static short small_primorial_map[PRIME_SMALL_PRIMORIAL];		// i-th entry is 0 if gcd(i,PRIME_SMALL_PRIMORIAL)>1, otherwise it indicates that i is the k-th integer in F_P*, where 1 is the 1st.
+static int _small_primes[PRIME_SMALL_PRIMES+1];
+static int _small_prime_index[PRIME_MAX_SMALL_INTEGER+1];
+static int *small_primes = _small_primes;						// these point into _prime_map when the tables are loaded from a file
+static int *small_prime_index = _small_prime_index;
 
 static long _primorials[PRIME_MAX_PRIMORIAL_W+1];
 static long _primorial_phis[PRIME_MAX_PRIMORIAL_W+1];
 wheel_t _small_wheels[PRIME_SMALL_PRIMORIAL_W+1];
 
+static int _wheel_primes[PRIME_SMALL_PRIMORIAL_W+1] = { 0, 2, 3, 5, 7, 11, 13 };
 static unsigned char _wheel_gaps0[1] = { 1 };		// The trivial wheel - every number is relatively prime to 1
 static unsigned char _wheel_gaps1[2] = { 2 };		// The first wheel - odd numbers
 
 static long prime_logsize, prime_logstart, prime_logindex, prime_logvalue;
 
+static void *_prime_map;										// read-only mapping of a prime file (see prime_load_file), null if the tables were computed
+static size_t _prime_map_len;
+
 void prime_cleanup()
 {
 	register int i;
 	
 	if ( ! _prime_inited ) return;
-	for ( i = 2 ; i <= PRIME_SMALL_PRIMORIAL_W ; i++ ) free (_small_wheels[i].gaps);
+	if ( _prime_map ) {
+		munmap (_prime_map, _prime_map_len);
+		_prime_map = 0;
+		small_primes = _small_primes;  small_prime_index = _small_prime_index;
+	} else {
+		for ( i = 2 ; i <= PRIME_SMALL_PRIMORIAL_W ; i++ ) free (_small_wheels[i].gaps);
+	}
 	_prime_inited = 0;
 }
 
@@ -54,16 +70,22 @@ int *prime_small_primes ()
 	return small_primes;
 }
 
+static int _prime_file_setup (char *filename);
+
 void _prime_setup ()
 {
 	register unsigned char *mp, *np;
 	register unsigned char *_small_map;
 	register int  i, j, k, p, maxp, w, gap, maxgap;
+	char *filename;
 
 	if ( _prime_inited ) return;
 	
 	assert (LONG_BITS >= 64);									// life is too short to support 32-bit code
 
+	// if SMALLJAC_PRIME_FILE names a file created by prime_save_file, map it rather than sieving (falls through if the file can't be used)
+	if ( (filename = getenv ("SMALLJAC_PRIME_FILE")) && *filename && _prime_file_setup (filename) ) return;
+
 	_primorials[0] = 1;
 	_primorial_phis[0] = 1;
 	_primorials[1] = 2;
@@ -163,13 +185,6 @@ void _prime_setup ()
 		_primorial_phis[i] = _primorial_phis[i-1]*(small_primes[i]-1);
 	}
 
-	// roll small primorial wheel to create map of integers mod PRIME_MAX_SMALL_PRIMORIAL
-	w = PRIME_SMALL_PRIMORIAL_W;
-	for ( j = 0, k = 1; j < _small_wheels[w].phi ; j++ ) {
-		small_primorial_map[k] = j+1;
-		k += _small_wheels[w].gaps[j];
-	}
-	
 	_prime_inited = 1;
 }
 
@@ -223,89 +238,199 @@ long pi_bound (long n)
 }
 
 
-static wheel_t *_primorial_wheel_alloc (int w)
+// Montgomery arithmetic modulo an odd n < 2^64 with R = 2^64, where ni = -1/n mod R (used by prime_bpsw)
+static inline unsigned long _mont_redc (unsigned long z1, unsigned long z0, unsigned long n, unsigned long ni)
 {
-	wheel_t *wheel;
-	char *map, *mp, *np;
-	unsigned char *small_gaps, gap;
-	long i, j, p, small_phi;
-	
-	prime_setup ();
-	if ( w <= PRIME_SMALL_PRIMORIAL_W ) return _small_wheels+w;
-	if ( w > PRIME_MAX_WHEEL_W ) {fprintf (stderr, "Requested wheel exceeds PRIME_MAX_WHEEL_W %d > %d\n", w, PRIME_MAX_WHEEL_W);  abort(); }
-	wheel = (wheel_t*) _calloc (sizeof(*wheel));
-	wheel->n = _primorials[w];
-	wheel->phi = _primorial_phis[w];
-	wheel->gaps = (unsigned char *) _calloc (_primorial_phis[w]);
-	map = (char *) _calloc (wheel->n+1);
-	np = map + wheel->n + 1;
-	*np = 1;		// end marker to bound the last gap;
-	small_phi = _small_wheels[PRIME_SMALL_PRIMORIAL_W].phi;
-	small_gaps = _small_wheels[PRIME_SMALL_PRIMORIAL_W].gaps;
-	for ( i = PRIME_SMALL_PRIMORIAL_W+1 ; i <= w ; i++ ) {
-		p = small_primes[i];
-		mp = map+p;
-		j = 0;
-		while ( mp < np ) {		// wheel the prime over the map
-			*mp = 1;
-			if ( j == small_phi ) j = 0;
-			mp += p*small_gaps[j++];
-		}
+	register unsigned long t1, t0, s;
+
+	t0 = z0*ni;
+	_asm_mult_1_1 (t1, t0, t0, n);								// z0+t0 = 0 mod R, with a carry iff z0 != 0
+	z1 += ( z0 != 0 );											// z1 < n-1, so this can't overflow
+	s = z1 + t1;
+	return ( s < z1 || s >= n ? s-n : s );							// the sum is less than 2n but may exceed R
+}
+static inline unsigned long _mont_mult (unsigned long x, unsigned long y, unsigned long n, unsigned long ni)
+	{ register unsigned long z1, z0;  _asm_mult_1_1 (z1, z0, x, y);  return _mont_redc (z1, z0, n, ni); }
+static inline unsigned long _mont_add (unsigned long x, unsigned long y, unsigned long n)
+	{ register unsigned long s = x+y;  return ( s < x || s >= n ? s-n : s ); }
+static inline unsigned long _mont_sub (unsigned long x, unsigned long y, unsigned long n)
+	{ return ( x >= y ? x-y : x-y+n ); }
+static inline unsigned long _mont_half (unsigned long x, unsigned long n)
+	{ return ( (x&1) ? (x>>1) + (n>>1) + 1 : x>>1 ); }
+
+// Jacobi symbol (a/n) for odd n > 0
+static int _jacobi (long a, unsigned long n)
+{
+	register unsigned long x, y, t;
+	register int s;
+
+	x = ( a < 0 ? n - ((unsigned long)(-a)) % n : (unsigned long)a % n );
+	for ( y = n, s = 1 ; x ; ) {
+		while ( ! (x&1) ) { x >>= 1;  if ( (y&7) == 3 || (y&7) == 5 ) s = -s; }
+		if ( (x&3) == 3 && (y&3) == 3 ) s = -s;
+		t = x;  x = y % t;  y = t;
 	}
-	// compute the gaps by rolling the small wheel and skipping marked entries
-	gap = 0;
-	i = j = 0;
-	mp = map+1;
-	while ( mp < np ) {
-		if ( j == small_phi  ) j = 0;
-		mp += small_gaps[j];
-		gap += small_gaps[j];
-		if ( ! *mp ) {
-			wheel->gaps[i++] = gap;
-			if ( gap > wheel->maxgap ) wheel->maxgap = gap;
-			gap = 0;
+	return ( y == 1 ? s : 0 );
+}
+
+/*
+	Baillie-PSW test: a strong Fermat test to the base 2 followed by a strong Lucas test with parameters chosen by Selfridge's method A.
+	There are no BPSW pseudoprimes below 2^64, so this is a deterministic primality test for unsigned longs.
+*/
+int prime_bpsw (unsigned long n)
+{
+	register unsigned long d, x, one, mone, ni, r2, u, v, qk, dm, qm;
+	register long D;
+	register int i, s, j;
+
+	if ( n <= PRIME_MAX_SMALL_PRIME ) return is_small_prime ((int)n);
+	if ( ! (n&1) || n == ~0UL ) return 0;
+	for ( ni = n, i = 0 ; i < 5 ; i++ ) ni *= 2-n*ni;						// Newton iteration gives 1/n mod 2^64
+	ni = -ni;
+	one = (-n) % n;  mone = n-one;										// R mod n and -R mod n
+	for ( r2 = one, i = 0 ; i < 64 ; i++ ) r2 = _mont_add (r2, r2, n);			// R^2 mod n
+
+	// strong base-2 test
+	d = n-1;  s = __builtin_ctzl (d);  d >>= s;
+	for ( x = one, i = 63-__builtin_clzl(d) ; i >= 0 ; i-- ) { x = _mont_mult (x, x, n, ni);  if ( (d>>i)&1 ) x = _mont_add (x, x, n); }
+	if ( x != one && x != mone ) {
+		for ( i = 1 ; i < s ; i++ ) { x = _mont_mult (x, x, n, ni);  if ( x == mone ) break;  if ( x == one ) return 0; }
+		if ( i == s ) return 0;
+	}
+
+	// strong Lucas test with P = 1 and Q = (1-D)/4, where D is the first of 5,-7,9,-11,... with (D/n) = -1 (which won't exist if n is a square)
+	x = (unsigned long) sqrt ((double)n);
+	if ( x > 0xFFFFFFFFUL ) x = 0xFFFFFFFFUL;
+	while ( x*x > n ) x--;
+	while ( x < 0xFFFFFFFFUL && (x+1)*(x+1) <= n ) x++;
+	if ( x*x == n ) return 0;
+	for ( D = 5 ;; D = ( D > 0 ? -D-2 : -D+2 ) ) {
+		j = _jacobi (D, n);
+		if ( j < 0 ) break;
+		if ( ! j ) return 0;												// n > |D| has a factor in common with D
+	}
+	dm = _mont_mult ((D < 0 ? n - (unsigned long)(-D) : (unsigned long)D), r2, n, ni);
+	qm = ( D < 0 ? _mont_mult ((unsigned long)(1-D)/4, r2, n, ni) : n - _mont_mult ((unsigned long)(D-1)/4, r2, n, ni) );
+	d = n+1;  s = __builtin_ctzl (d);  d >>= s;
+	// U_{2k} = U_k V_k, V_{2k} = V_k^2 - 2Q^k, U_{k+1} = (U_k + V_k)/2, V_{k+1} = (D U_k + V_k)/2
+	for ( u = v = one, qk = qm, i = 62-__builtin_clzl(d) ; i >= 0 ; i-- ) {
+		u = _mont_mult (u, v, n, ni);
+		v = _mont_sub (_mont_mult (v, v, n, ni), _mont_add (qk, qk, n), n);
+		qk = _mont_mult (qk, qk, n, ni);
+		if ( (d>>i)&1 ) {
+			x = _mont_half (_mont_add (u, v, n), n);
+			v = _mont_half (_mont_add (_mont_mult (dm, u, n, ni), v, n), n);
+			u = x;
+			qk = _mont_mult (qk, qm, n, ni);
 		}
-		j++;
 	}
-	if ( mp != np) { fprintf (stderr, "wheel alignment error creating wheel for w = %d, %ld != %ld\n", w, mp-map, np-map);  abort(); }
-	if ( i != wheel->phi-1 ) { fprintf (stderr, "gap count error creating wheel for w = %d, %ld != %ld\n", w, i, wheel->phi);  abort(); }
-	wheel->gaps[i] = 2;	// the last gap is always 2
-	return wheel;		
+	if ( ! u || ! v ) return 1;
+	for ( i = 1 ; i < s ; i++ ) {
+		v = _mont_sub (_mont_mult (v, v, n, ni), _mont_add (qk, qk, n), n);
+		if ( ! v ) return 1;
+		qk = _mont_mult (qk, qk, n, ni);
+	}
+	return 0;
+}
+
+// adds the large prime p to the bucket for the segment containing the odd multiple of p with index i (relative to the current segment)
+static inline void _prime_bucket_push (prime_enum_ctx_t *ctx, unsigned long p, unsigned long i)
+{
+	register int b;
+
+	b = ctx->cb + (i>>PRIME_SEGMENT_LG_BITS);
+	if ( b >= ctx->nb ) b -= ctx->nb;
+	if ( ctx->bcnt[b] == ctx->bmax[b] ) {
+		ctx->bmax[b] *= 2;
+		ctx->bucket[b] = realloc (ctx->bucket[b], ctx->bmax[b]*sizeof(**ctx->bucket));
+		if ( ! ctx->bucket[b] ) { fprintf (stderr, "Fatal error, realloc failed in _prime_bucket_push\n");  abort(); }
+	}
+	ctx->bucket[b][ctx->bcnt[b]++] = (p<<32) | (i&(PRIME_SEGMENT_BITS-1));
 }
 
+// returns the index of the least odd multiple of p that is >= max(p^2,n), relative to the odd integer n (avoids overflow for n near 2^64)
+static inline unsigned long _prime_first_multiple (unsigned long p, unsigned long n)
+{
+	register unsigned long r, i;
+
+	if ( p*p >= n ) return (p*p-n)>>1;
+	r = n % p;  i = ( r ? p-r : 0 );								// n+i is the least multiple of p >= n
+	if ( (i&1) ) i += p;										// n is odd, so n+i is odd iff i is even
+	return i>>1;
+}
 
-static void _primorial_wheel_free (wheel_t *wheel)
+// sieves the segment starting at ctx->segbase
+static void _prime_sieve_segment (prime_enum_ctx_t *ctx)
 {
-	if ( wheel->n <= PRIME_SMALL_PRIMORIAL ) return;
-	free (wheel->gaps);
-	free (wheel);
+	register unsigned long *seg, *e, *f;
+	register unsigned long i, p;
+	register long j;
+
+	seg = ctx->seg;
+	memset (seg, 0, PRIME_SEGMENT_WORDS*sizeof(*seg));
+	for ( j = 2 ; j <= ctx->mw ; j++ ) {
+		p = small_primes[j];
+		for ( i = ctx->so[j] ; i < PRIME_SEGMENT_BITS ; i += p ) seg[i>>6] |= 1UL << (i&0x3F);
+		ctx->so[j] = i - PRIME_SEGMENT_BITS;
+	}
+	if ( ctx->w <= ctx->mw ) return;
+	// add large primes whose squares lie in this segment (the squares of p_lw,...,p_w are all >= segbase)
+	for ( j = ctx->lw ; j <= ctx->w && (unsigned long)small_primes[j]*small_primes[j] - ctx->segbase < 2*PRIME_SEGMENT_BITS ; j++ ) { p = small_primes[j];  _prime_bucket_push (ctx, p, (p*p-ctx->segbase)>>1); }
+	ctx->lw = j;
+	// each large prime in the bucket for this segment hits it exactly once, after which it moves to the bucket for its next hit
+	e = ctx->bucket[ctx->cb];  f = e + ctx->bcnt[ctx->cb];
+	ctx->bcnt[ctx->cb] = 0;
+	for ( ; e < f ; e++ ) {
+		p = (*e)>>32;  i = (*e)&(PRIME_SEGMENT_BITS-1);
+		seg[i>>6] |= 1UL << (i&0x3F);
+		_prime_bucket_push (ctx, p, i+p);
+	}
+	if ( ++ctx->cb == ctx->nb ) ctx->cb = 0;
 }
 
 /*
-	Fast prime enumeration for p <= L <= 2^PRIME_BITS based on a wheeled sieve.
+	Fast prime enumeration for p <= L < 2^64 based on a segmented sieve of Eratosthenes.
+
+	Each segment is a bitmap of PRIME_SEGMENT_BITS odd integers, small enough to stay in L1 cache.  Primes less than
+	PRIME_SEGMENT_BITS (medium primes) are sieved by striding across the segment.  Larger primes (which are only
+	needed for L > 2^36) hit each segment at most once, so we put each in a bucket for the next segment it hits
+	and only look at it again when we get there (bucket sieving), rather than checking every large prime in every segment.
+	Primes are then enumerated directly from the bitmap a word at a time.
+
+	For L <= PRIME_MAX_ENUM we sieve with all the primes up to L^{1/2}.  Beyond this we sieve with all the small primes
+	(up to 2^PRIME_SMALL_BITS), which leaves only a few composites with no small factor, and these are removed using prime_bpsw.
+	This makes it practical to enumerate primes in windows anywhere below 2^64, e.g. [2^50,2^50+2^30], without a larger
+	table of sieving primes.  Prime powers are only supported for L <= PRIME_MAX_ENUM.  Note that start and L are
+	interpreted as unsigned values, as are the primes returned by prime_enum.
 */
 prime_enum_ctx_t *prime_enum_start (long start, long L, int powers)
 {
 	prime_enum_ctx_t *ctx;
-	register long k, m;
-	register long i, n, p;
+	register unsigned long m, n;
+	register long i;
 
-	if ( start > L ) { fprintf (stderr, "Invalid prime enumeration, start must be less than or equal to L\n");  return 0; }
+	if ( (unsigned long)start > (unsigned long)L ) { fprintf (stderr, "Invalid prime enumeration, start must be less than or equal to L\n");  return 0; }
 	prime_setup ();
-	if ( L > (1L<<PRIME_BITS) ) { fprintf (stderr, "Attempted prime enumeration too large %ld > 2^%d\n", L, PRIME_BITS);  abort(); }
+	if ( (unsigned long)L > PRIME_MAX_ENUM && powers > 1 ) { fprintf (stderr, "Prime power enumeration is only supported up to 2^%d\n", PRIME_BITS);  abort(); }
 	prime_stop_logging();								// avoid any possible confusion with earlier log
 	
 	ctx = (prime_enum_ctx_t *) _calloc (sizeof(*ctx));
 	memset (ctx, 0, sizeof(*ctx));
-	p = small_primes[PRIME_SMALL_PRIMORIAL_W+1];
 	ctx->L = ctx->end = L;
 	ctx->h = ui_len(L);										// 2^h <= L <=2^{h+1}
 	ctx->powers = ui_min(powers,ctx->h);						// indicates enumeration of prime powers p^h with h <= powers
+	ctx->vmin = ~0UL;
+	if ( ctx->L > PRIME_MAX_ENUM ) {
+		ctx->e[2] = PRIME_SMALL_PRIMES;
+		ctx->vmin = (unsigned long)PRIME_MAX_SMALL_PRIME*PRIME_MAX_SMALL_PRIME;	// survivors above this bound need to be verified
+	}
 	m = start;  if ( m < 2 ) m = 2;
-	for ( i = 2 ; i <= powers || i <= 2 ; i++ ) {
-		n = (long) floor(pow((double)L,1.0/(double)i));			// n^i <= L < (n+1)^i
+	for ( i = 2 ; ctx->L <= PRIME_MAX_ENUM && (i <= powers || i <= 2) ; i++ ) {
+		n = (long) floor(pow((double)ctx->L,1.0/(double)i));		// n^i <= L < (n+1)^i
+		if ( n > PRIME_MAX_SMALL_INTEGER ) n = PRIME_MAX_SMALL_INTEGER;	// only happens for L = 2^PRIME_BITS, which is not prime
 		ctx->e[i] = small_prime_index[n];					// e(i) = pi(L^{1/i})			// we actually don't currently use anything other than e[2]
 		n = (long) floor(pow((double)m,1.0/(double)i));			// n^i <= m < (n+1)^i
+		if ( n > PRIME_MAX_SMALL_INTEGER ) n = PRIME_MAX_SMALL_INTEGER;
 		// set q[i] to the least ith power of a prime (identified by its index s[i]) that is greater than or equal to m (be careful to handle the case that m is itself a prime power)
 		ctx->s[i] = small_prime_index[n];
 		ctx->q[i] = ipow (small_primes[ctx->s[i]], i);
@@ -318,71 +443,25 @@ prime_enum_ctx_t *prime_enum_start (long start, long L, int powers)
 	for ( i = 2 ; i <= ctx->powers ; i++ )
 		if ( ctx->q[i] < ctx->q[ctx->k] ) ctx->k = i;				// q[k] is the least ith power of a prime greater than m, for any i in [2,powers]
 
-	ctx->wheel = _primorial_wheel_alloc (PRIME_SMALL_PRIMORIAL_W);
-	ctx->w = ctx->e[2];									// p_w <= L^{1/2} < p_{w+1} so it suffices to sieve by the first w primes
-	ctx->wv = (long *) _calloc ((ctx->w+1)*sizeof(*ctx->wv));		// the entry wv[i] stores the value of the i-th prime modulo PRIME_SMALL_PRIMORIAL = ctx->wheel->n
-	ctx->wi = (long *) _calloc ((ctx->w+1)*sizeof(*ctx->wi));		// the entry wi[i] stores the index of the next wheel gap for the i-th prime - see below
-	for ( i =1; i <= ctx->w ; i++ ) ctx->wv[i] = small_primes[i];		// these values aren't necessarily reduced mod PRIME_SMALL_PRIMORIAL, but that's ok, the code below doesn't assume this
-	ctx->map = (unsigned char*) _calloc (ctx->wheel->n);
-	/*
-		The only relevant entries of our map are ones relatively prime to PRIME_SMALL_PRIMORIAL, since we enumerate the map via the wheel.
-		Thus we only need to sieve multiples of primes whose index lies in [PRIME_SMALL_PRIMORIAL_W+1,ctx->w] and we only need to worry
-	        about those multiples which are relatively prime to PRIME_SMALL_PRIMORIAL.  Thus for each prime, we effectively use the same wheel
-	        to enumerate these multiples.  The value wi[i] holds the index into the wheel for the i-th prime.
-	
-		If the starting point is far from 0, we can skip ahead by starting at the first multiple of PRIME_SMALL_PRIMORIAL below start, call it n.
-	        For simplicity, we avoid special code for the first ctx->w primes by always forcing enumeration of the first w primes
-		For each prime p <= ctx->w we need to compute the least multiple kp > start where k is relatively prime to PRIME_SMALL_PRIMORIAL
-	        and then set wv[i] = kp - n and set wi[i] = index of gap between k and next integer relatively prime to PRIME_SMALL_PRIMORIAL in wheel.
-	
-		To keep this simple, we set m to the first multiple of p*PRIME_SMALL_PRIMORIAL below start, set wv[i] = p, wi[i] = 0 and roll forward from there.
-	*/
-	if ( start > 2 ) {
-		mpz_t P;
-		// This is a bit awkward but removes the need for any conditional code in prime_enum to handle startup.
-		// We want to enumerate just up to the greatest prime below start.  To facilitate this we backup start as required
-		mpz_init (P);
-		n = ui_len(start);
-		for ( k = 2 ;; k += n ) {
-			if ( k > start ) k = start;
-			mpz_set_ui (P, start-k);
-			mpz_nextprime (P, P);
-			if ( mpz_cmp_ui(P,start) < 0 ) break;
-		}
-		do {
-			m = mpz_get_ui(P);
-			mpz_nextprime (P, P);
-		} while ( mpz_cmp_ui(P,start) < 0 );
-		mpz_clear (P);
-		start = m;
-	} else {
-		start = 0;
-	}
-	if ( start > PRIME_SMALL_PRIMORIAL && start > small_primes[ctx->w] ) {
-		n = (start/PRIME_SMALL_PRIMORIAL) * PRIME_SMALL_PRIMORIAL;
-		for ( i = PRIME_SMALL_PRIMORIAL_W+1 ; i <= ctx->w ; i++ ) {
-			p = small_primes[i];
-			ctx->wv[i] = p;
-			m = ui_ceil_ratio(n,p)*(long)p;										// m is the least multiple of p >= n - could be > PRIME_MAX_PRIME
-			m /= p;
-			k = m % PRIME_SMALL_PRIMORIAL;
-			while ( ! small_primorial_map[k] ) k++;								// find least k >= m%PRIME_SMALL_PRIMORIAL relatively prime to PRIME_SMALL_PRIMORIAL
-			m = (long)p*((m/PRIME_SMALL_PRIMORIAL)*PRIME_SMALL_PRIMORIAL+k) - n;
-			ctx->wv[i] = (long) m;
-			ctx->wi[i] = small_primorial_map[k]-1;								// gap index i gives gap between (i+1)st and (i+2)nd integers relatively prime to PRIME_SMALL_PRIMORIAL
-		}
-		ctx->pi = PRIME_SMALL_PRIMES;		// just need to make it bigger than ctx->w and PRIME_SMALL_PRIMORIAL_W
-		ctx->p = n-1;
-	} else {
-		ctx->pi = 1;
-		ctx->p = 0;
-	}
-	ctx->j = ctx->wheel->phi-1;
-
-	if ( start ) {
-		while ( (p=prime_enum(ctx)) < start );
-		if ( p != start ) { fprintf (stderr, "Unable to find start prime, p = %lu, start = %lu, L = %lu\n", p, start, L);  abort(); }
-	}
+	// the sieve starts at the least odd integer n >= max(start,3), odd primes up to L^{1/2} are used to sieve (sieving starts at p^2, so they are not sieved out themselves)
+	ctx->two = ( (unsigned long)start <= 2 );
+	n = ( (unsigned long)start < 3 ? 3 : (start|1) );
+	ctx->segbase = n;
+	ctx->w = ctx->e[2];
+	for ( ctx->mw = 1 ; ctx->mw < ctx->w && small_primes[ctx->mw+1] < PRIME_SEGMENT_BITS ; ctx->mw++ );
+	ctx->seg = (unsigned long *) malloc (PRIME_SEGMENT_WORDS*sizeof(*ctx->seg));
+	ctx->so = (long *) _calloc ((ctx->mw+1)*sizeof(*ctx->so));
+	for ( i = 2 ; i <= ctx->mw ; i++ ) ctx->so[i] = _prime_first_multiple (small_primes[i], n);
+	ctx->nb = ( ctx->w > ctx->mw ? (small_primes[ctx->w]>>PRIME_SEGMENT_LG_BITS) + 2 : 1 );
+	ctx->bucket = (unsigned long **) _calloc (ctx->nb*sizeof(*ctx->bucket));
+	ctx->bcnt = (int *) _calloc (ctx->nb*sizeof(*ctx->bcnt));
+	ctx->bmax = (int *) _calloc (ctx->nb*sizeof(*ctx->bmax));
+	for ( i = 0 ; i < ctx->nb ; i++ ) { ctx->bmax[i] = 1024;  ctx->bucket[i] = (unsigned long *) malloc (ctx->bmax[i]*sizeof(**ctx->bucket)); }
+	// large primes whose square is below the starting point go into buckets now, the rest are added as the sieve reaches their squares
+	for ( i = ctx->mw+1 ; i <= ctx->w && (unsigned long)small_primes[i]*small_primes[i] < n ; i++ ) _prime_bucket_push (ctx, small_primes[i], _prime_first_multiple (small_primes[i], n));
+	ctx->lw = i;
+	_prime_sieve_segment (ctx);
+	ctx->si = 0;  ctx->x = ( n <= ctx->end ? ~ctx->seg[0] : 0 );  ctx->pbase = ctx->segbase;
 	return ctx;
 }
 
@@ -477,64 +556,48 @@ long prime_enum_powers (prime_enum_ctx_t *ctx)
 
 long _prime_enum (prime_enum_ctx_t *ctx)
 {
-	register long gap;
-	register unsigned char *mp, *np;
-	register long i, p;
+	register unsigned long p, b;
 
-	// The first ctx->w primes need to be enumerated seperately, since they have all been sieved out of the map
-	// Note that if ctx->w > PRIME_SMALL_PRIMORIAL this means the first map is effectively empty, but that's ok.
-	// Prime powers are only relevant for the first ctx->w primes since ctx->w was chosen to ensure pi(ctx->w)^2 > L
-	if ( ctx->pi <= ctx->w || ctx->pi <= PRIME_SMALL_PRIMORIAL_W ) {
-		p = small_primes[ctx->pi++];
-		if ( p > ctx->end ) return 0;
-		if ( prime_logvalue ) prime_log (p);
-		return p;
+	if ( ctx->two ) {
+		ctx->two = 0;
+		if ( 2 > ctx->end ) return 0;
+		if ( prime_logvalue ) prime_log (2);
+		return 2;
 	}
 	for (;;) {
-		if ( ctx->j == ctx->wheel->phi-1 ) {
-			memset (ctx->map, 0, ctx->wheel->n);
-			np = ctx->map + ctx->wheel->n;
-			for ( i = PRIME_SMALL_PRIMORIAL_W+1 ; i <= ctx->w ; i++ ) {
-				p = small_primes[i];
-				mp = ctx->map+ctx->wv[i];
-				while ( mp < np ) {
-					*mp = 1;
-					gap = p*ctx->wheel->gaps[ctx->wi[i]++];
-					if ( ctx->wi[i] == ctx->wheel->phi ) ctx->wi[i] = 0;
-					ctx->wv[i] += gap;
-					mp += gap;
-				}
-				ctx->wv[i] -= ctx->wheel->n;
-			}
-			ctx->mp = ctx->map+1;
-			if ( ctx->p ) {
-				ctx->p += 2;									// last gap is always 2
-				ctx->j = 0;
-			} else {
-				ctx->p = 1+ctx->wheel->gaps[0]; 					// special case - skip 1
-				ctx->mp += ctx->wheel->gaps[0]; 
-				ctx->j = 1;
+		// we are careful never to compute anything past end, which may be close to 2^64
+		while ( ! ctx->x ) {
+			if ( ctx->pbase > ctx->end || ctx->end - ctx->pbase < 128 ) return 0;	// the current word contains end
+			if ( ++ctx->si == PRIME_SEGMENT_WORDS ) {
+				// note that _prime_sieve_segment uses the bucket index cb rather than segbase to locate large primes, so we must not skip segments
+				ctx->segbase += 2*PRIME_SEGMENT_BITS;
+				_prime_sieve_segment (ctx);
+				ctx->si = 0;
 			}
-		} else {
-			gap = ctx->wheel->gaps[ctx->j++];
-			ctx->mp += gap;
-			ctx->p += gap;
-		}
-		if ( ctx->p > ctx->end ) return 0;
-		if ( ! *ctx->mp ) {
-			if ( prime_logvalue ) prime_log (ctx->p);
-			return ctx->p;
+			ctx->x = ~ctx->seg[ctx->si];
+			ctx->pbase += 128;
 		}
+		b = 2*__builtin_ctzl(ctx->x);
+		ctx->x &= ctx->x-1;
+		if ( b > ctx->end - ctx->pbase ) { ctx->x = 0;  return 0; }
+		p = ctx->pbase + b;
+		if ( p > ctx->vmin && ! prime_bpsw (p) ) continue;
+		if ( prime_logvalue ) prime_log (p);
+		return p;
 	}
 }
 
 void prime_enum_end (prime_enum_ctx_t *ctx)
 {
+	register int i;
+
 	if ( ctx->la_gaps ) free (ctx->la_gaps);
-	free (ctx->map);
-	free (ctx->wv);
-	free (ctx->wi);
-	_primorial_wheel_free (ctx->wheel);
+	for ( i = 0 ; i < ctx->nb ; i++ ) free (ctx->bucket[i]);
+	free (ctx->bucket);
+	free (ctx->bcnt);
+	free (ctx->bmax);
+	free (ctx->so);
+	free (ctx->seg);
 	free (ctx);
 }
 
@@ -558,7 +621,7 @@ prime_enum_ctx_t *prime_enum_start_w (long start, long end, long window)
 	} else {
 		if ( (window&1) ) window++;
 		window += 4096;								// pad to cover prime gaps (this is surely overkill, the largest known gap is 1476, which covers all p < 2^60).
-		if ( ! (ctx = prime_enum_start (start-window/2,end+window/2,0)) ) return 0;
+		if ( ! (ctx = prime_enum_start ((start > window/2 ? start-window/2 : 0),end+window/2,0)) ) return 0;
 	}
 	ctx->la_end = end;
 	size = window/8+256;
@@ -619,6 +682,173 @@ long _prime_enum_w (prime_enum_ctx_t *ctx)
 	return p;
 }
 
+/*
+	Enumeration of primes in a union of residue classes modulo m.
+
+	Rather than enumerating all primes and discarding those in the wrong classes, we sieve only the arithmetic progressions
+	m*t+r for the k classes r coprime to m.  The sieve bitmap interleaves the progressions, bit t*k+j corresponds to m*(tbase+t)+r[j],
+	so with the classes sorted a word at a time scan of the bitmap enumerates primes in increasing order.  A sieving prime q
+	hits the progression for r[j] every q rows, we keep the next row for each pair (q,r[j]) and carry it from one segment to
+	the next.  The cost is proportional to k/m times the cost of a full sieve plus the cost of visiting each pair once per segment,
+	which makes this worthwhile when the classes are sparse (we require k*8 <= m).  Otherwise, or if the number of pairs is too large,
+	we just enumerate all the primes and test p mod m against a bitmap of the classes, or, if m is too large for a bitmap (e.g. a CRT
+	modulus), by a binary search of the sorted list of classes.
+
+	A class r that is not coprime to m contains at most one prime, namely gcd(r,m), and only if gcd(r,m) is a prime p with p = r mod m.
+	So the exceptional primes are the prime divisors of m whose classes are in the set, there are fewer than 16 of them (m < 2^64),
+	and they are merged into the output of the sieve.
+*/
+
+static inline unsigned long _ui_gcd (unsigned long a, unsigned long b)
+	{ register unsigned long t;  while ( b ) { t = a%b;  a = b;  b = t; }  return a; }
+
+// returns the inverse of a modulo q for 0 < a < q with gcd(a,q) = 1
+static unsigned long _ui_inverse (unsigned long a, unsigned long q)
+{
+	register long r0, r1, s0, s1, t;
+
+	for ( r0 = q, r1 = a, s0 = 0, s1 = 1 ; r1 ; ) { t = r0/r1;  r0 -= t*r1;  s0 -= t*s1;  t = r0;  r0 = r1;  r1 = t;  t = s0;  s0 = s1;  s1 = t; }
+	return ( s0 < 0 ? s0+q : s0 );
+}
+
+static int _ui_cmp (const void *a, const void *b)
+	{ return ( *(unsigned long *)a < *(unsigned long *)b ? -1 : ( *(unsigned long *)a > *(unsigned long *)b ? 1 : 0 ) ); }
+
+// sieves the k progressions over rows tbase,...,tbase+T-1
+static void _prime_mod_sieve_segment (prime_enum_mod_ctx_t *ctx)
+{
+	register unsigned long *seg;
+	register unsigned long t, b, qk, T;
+	register unsigned *o;
+	register long i, j, k;
+
+	seg = ctx->seg;  k = ctx->k;  T = ctx->T;
+	memset (seg, 0, ctx->words*sizeof(*seg));
+	for ( i = 0 ; i < ctx->nq ; i++ ) {
+		qk = ctx->q[i]*k;
+		o = ctx->off + i*k;
+		for ( j = 0 ; j < k ; j++ ) {
+			for ( t = o[j], b = t*k+j ; t < T ; t += ctx->q[i], b += qk ) seg[b>>6] |= 1UL << (b&0x3F);
+			o[j] = t - T;
+		}
+	}
+	if ( (ctx->bits&0x3F) ) seg[ctx->words-1] |= ~0UL << (ctx->bits&0x3F);				// rule out the unused bits of the last word
+}
+
+prime_enum_mod_ctx_t *prime_enum_mod_start (long start, long end, unsigned long m, unsigned long r[], int k)
+{
+	prime_enum_mod_ctx_t *ctx;
+	register unsigned long c, g, t, x, q, mi, *v;
+	register long i, j, n, w;
+
+	if ( ! m || k <= 0 ) { fprintf (stderr, "Invalid residue class specification in prime_enum_mod_start\n");  return 0; }
+	if ( (unsigned long)start > (unsigned long)end ) { fprintf (stderr, "Invalid prime enumeration, start must be less than or equal to end\n");  return 0; }
+	prime_setup();
+	ctx = (prime_enum_mod_ctx_t *) _calloc (sizeof(*ctx));
+	ctx->m = m;  ctx->start = start;  ctx->end = end;
+
+	// reduce, sort, and remove duplicates, then separate out the classes that are not coprime to m
+	v = (unsigned long *) malloc (k*sizeof(*v));
+	for ( i = 0 ; i < k ; i++ ) v[i] = r[i] % m;
+	qsort (v, k, sizeof(*v), _ui_cmp);
+	for ( i = j = 0 ; i < k ; i++ ) if ( ! j || v[i] != v[j-1] ) v[j++] = v[i];
+	n = j;
+	ctx->r = (unsigned long *) malloc (n*sizeof(*ctx->r));
+	for ( i = 0 ; i < n ; i++ ) {
+		g = _ui_gcd (v[i], m);
+		if ( g == 1 ) { ctx->r[ctx->k++] = v[i];  continue; }
+		if ( g % m == v[i] && g >= ctx->start && g <= ctx->end && prime_bpsw (g) ) ctx->xp[ctx->nx++] = g;		// v is sorted, so xp will be too
+	}
+
+	if ( ! ctx->k ) { ctx->done = 1;  free (v);  return ctx; }
+	w = ( ctx->end > PRIME_MAX_ENUM ? PRIME_SMALL_PRIMES : small_prime_pi ((int) floor(sqrt((double)ctx->end))) );
+	if ( ctx->k*8 > m || w*ctx->k > PRIME_MOD_MAX_STATE ) {
+		ctx->all = prime_enum_start (start, end, 0);
+		ctx->nx = 0;
+		if ( m > PRIME_MOD_MAX_BITMAP ) { free (ctx->r);  ctx->r = v;  ctx->k = n;  return ctx; }
+		ctx->bm = (unsigned long *) _calloc ((m/64+1)*sizeof(*ctx->bm));
+		for ( i = 0 ; i < n ; i++ ) ctx->bm[v[i]>>6] |= 1UL << (v[i]&0x3F);
+		free (v);
+		return ctx;
+	}
+	free (v);
+
+	ctx->vmin = ( ctx->end > PRIME_MAX_ENUM ? (unsigned long)PRIME_MAX_SMALL_PRIME*PRIME_MAX_SMALL_PRIME : ~0UL );
+	ctx->q = (int *) malloc ((w+1)*sizeof(*ctx->q));
+	for ( i = 1 ; i <= w ; i++ ) if ( m % small_primes[i] ) ctx->q[ctx->nq++] = small_primes[i];
+	ctx->T = ui_ceil_ratio (PRIME_MOD_SEGMENT_BITS, ctx->k);
+	ctx->bits = ctx->T*ctx->k;
+	ctx->words = (ctx->bits+63)>>6;
+	ctx->seg = (unsigned long *) malloc (ctx->words*sizeof(*ctx->seg));
+	ctx->off = (unsigned *) malloc (ctx->nq*ctx->k*sizeof(*ctx->off));
+	ctx->tbase = ctx->start / m;  ctx->tmax = ctx->end / m;
+	for ( i = 0 ; i < ctx->nq ; i++ ) {
+		q = ctx->q[i];
+		mi = _ui_inverse (m%q, q);
+		c = ((m%q)*(ctx->tbase%q)) % q;									// m*tbase mod q
+		for ( j = 0 ; j < ctx->k ; j++ ) {
+			x = (c + ctx->r[j]%q) % q;
+			t = ( x ? ((q-x)*mi) % q : 0 );									// least t >= 0 with m*(tbase+t)+r[j] = 0 mod q
+			if ( ctx->tbase+t <= q/m && m*(ctx->tbase+t)+ctx->r[j] == q ) t += q;		// don't sieve out q itself
+			ctx->off[i*ctx->k+j] = t;
+		}
+	}
+	_prime_mod_sieve_segment (ctx);
+	ctx->wi = 0;  ctx->x = ~ctx->seg[0];
+	return ctx;
+}
+
+// returns the next prime in the sieved progressions, or 0 if there are none left
+static unsigned long _prime_enum_mod_sieve (prime_enum_mod_ctx_t *ctx)
+{
+	register unsigned long b, t, p;
+	register long j;
+
+	if ( ctx->done ) return 0;
+	for (;;) {
+		while ( ! ctx->x ) {
+			if ( ++ctx->wi == ctx->words ) {
+				if ( ctx->tmax - ctx->tbase < ctx->T ) { ctx->done = 1;  return 0; }
+				ctx->tbase += ctx->T;
+				_prime_mod_sieve_segment (ctx);
+				ctx->wi = 0;
+			}
+			ctx->x = ~ctx->seg[ctx->wi];
+		}
+		b = (ctx->wi<<6) + __builtin_ctzl (ctx->x);
+		ctx->x &= ctx->x-1;
+		t = ctx->tbase + b/ctx->k;  j = b%ctx->k;
+		if ( t >= ctx->tmax && (t > ctx->tmax || ctx->r[j] > ctx->end - ctx->m*t) ) { ctx->done = 1;  return 0; }
+		p = ctx->m*t + ctx->r[j];
+		if ( p < ctx->start || p == 1 ) continue;
+		if ( p > ctx->vmin && ! prime_bpsw (p) ) continue;
+		return p;
+	}
+}
+
+long prime_enum_mod (prime_enum_mod_ctx_t *ctx)
+{
+	register unsigned long p;
+	unsigned long x;
+
+	if ( ctx->all ) {
+		if ( ! ctx->bm ) { while ( (p = _prime_enum (ctx->all)) ) { x = p % ctx->m;  if ( bsearch (&x, ctx->r, ctx->k, sizeof(*ctx->r), _ui_cmp) ) return p; }  return 0; }
+		while ( (p = _prime_enum (ctx->all)) ) { x = p % ctx->m;  if ( (ctx->bm[x>>6]>>(x&0x3F))&1 ) return p; }
+		return 0;
+	}
+	if ( ! ctx->next ) ctx->next = _prime_enum_mod_sieve (ctx);
+	if ( ctx->xi < ctx->nx && (! ctx->next || ctx->xp[ctx->xi] < ctx->next) ) return ctx->xp[ctx->xi++];
+	p = ctx->next;  ctx->next = 0;
+	return p;
+}
+
+void prime_enum_mod_end (prime_enum_mod_ctx_t *ctx)
+{
+	if ( ctx->all ) prime_enum_end (ctx->all);
+	free (ctx->bm);  free (ctx->r);  free (ctx->seg);  free (ctx->q);  free (ctx->off);
+	free (ctx);
+}
+
 long next_prime (long p)
 {
 	mpz_t P;
@@ -680,6 +910,7 @@ static inline long *_summarize_level (long *detail, long len)
 void gap_table_init (prime_table_t tab, long off, unsigned char *gaps, long n)
 {
 	assert ( !gaps[n] );
+	tab->map = 0;  tab->maplen = 0;
 	tab->si = 0;  tab->ti = n;
 	tab->sp = off;
 	tab->gaps = gaps;
@@ -724,8 +955,202 @@ void gap_table_clear (gap_table_t tab)
 {
 	tab->si = tab->ti = 0;
 	tab->sp = tab->tp = 0;
-	free (tab->gaps);  tab->gaps = 0;
-	for ( int i = 0 ; i <= tab->top ; i++ ) { free (tab->levels[i]); tab->levels[i] = 0; }
+	if ( tab->map ) {
+		munmap (tab->map, tab->maplen);
+		tab->map = 0;  tab->maplen = 0;
+		tab->gaps = 0;
+		for ( int i = 0 ; i <= tab->top ; i++ ) tab->levels[i] = 0;
+	} else {
+		free (tab->gaps);  tab->gaps = 0;
+		for ( int i = 0 ; i <= tab->top ; i++ ) { free (tab->levels[i]); tab->levels[i] = 0; }
+	}
 	tab->top = 0;
 }
 
+/*
+	Prime files hold the small prime tables and wheels computed by _prime_setup, and optionally a prime table, in a form
+	that can be memory mapped read-only and used in place.  Startup then costs a few page faults rather than a sieve, and
+	the pages are shared by all the processes using the file.  The file is specific to the values of PRIME_SMALL_BITS and
+	PRIME_SMALL_PRIMORIAL_W it was created with (and to the byte order of the machine), which the loader checks.
+
+	Every section starts at a multiple of 8 bytes, the offsets in the header are relative to the start of the file.
+*/
+
+#define PRIME_FILE_MAGIC			0x31454d4952504a53UL			// "SJPRIME1"
+
+struct prime_file_header {
+	uint64_t magic;
+	uint64_t size;												// total file size
+	uint64_t small_bits, small_primes, wheel_w;
+	uint64_t primes_off, index_off;
+	uint64_t wheel_off[PRIME_SMALL_PRIMORIAL_W+1], wheel_maxgap[PRIME_SMALL_PRIMORIAL_W+1];
+	int64_t si, ti, sp, tp, top;									// ti = 0 if there is no prime table
+	uint64_t gaps_off;
+	uint64_t level_off[PRIME_TABLE_MAX_LEVELS], level_len[PRIME_TABLE_MAX_LEVELS];
+};
+
+static inline uint64_t _prime_file_align (uint64_t off) { return (off+7) & ~7UL; }
+
+// maps the specified prime file read-only and checks its header, returns null if the file is unusable
+static struct prime_file_header *_prime_file_map (char *filename, size_t *len)
+{
+	struct prime_file_header *h;
+	struct stat st;
+	register uint64_t size;
+	register int i;
+	void *map;
+	int fd;
+
+	if ( (fd = open (filename, O_RDONLY)) < 0 ) { fprintf (stderr, "Unable to open prime file %s\n", filename);  return 0; }
+	if ( fstat (fd, &st) < 0 || st.st_size < sizeof(*h) ) { fprintf (stderr, "%s is not a valid prime file\n", filename);  close (fd);  return 0; }
+	map = mmap (0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close (fd);
+	if ( map == MAP_FAILED ) { fprintf (stderr, "mmap failed on prime file %s\n", filename);  return 0; }
+	h = (struct prime_file_header *) map;
+	size = st.st_size;
+	if ( h->magic != PRIME_FILE_MAGIC || h->size != size ) goto bad;
+	if ( h->small_bits != PRIME_SMALL_BITS || h->small_primes != PRIME_SMALL_PRIMES || h->wheel_w != PRIME_SMALL_PRIMORIAL_W ) {
+		fprintf (stderr, "Prime file %s was created with different prime table parameters\n", filename);
+		munmap (map, st.st_size);
+		return 0;
+	}
+	if ( h->primes_off + (PRIME_SMALL_PRIMES+1)*sizeof(int) > size || h->index_off + (PRIME_MAX_SMALL_INTEGER+1)*sizeof(int) > size ) goto bad;
+	for ( i = 2 ; i <= PRIME_SMALL_PRIMORIAL_W ; i++ ) if ( h->wheel_off[i] + _primorial_phis[i] > size ) goto bad;
+	if ( h->ti ) {
+		if ( h->ti <= h->si || h->top < 0 || h->top >= PRIME_TABLE_MAX_LEVELS || h->gaps_off + (h->ti-h->si+1) > size ) goto bad;
+		for ( i = 0 ; i <= h->top ; i++ ) if ( ! h->level_len[i] || h->level_off[i] + h->level_len[i]*sizeof(long) > size ) goto bad;
+	}
+	*len = st.st_size;
+	return h;
+bad:
+	fprintf (stderr, "%s is not a valid prime file\n", filename);
+	munmap (map, st.st_size);
+	return 0;
+}
+
+// installs the small prime tables and wheels from a prime file in place of _prime_setup
+static int _prime_file_setup (char *filename)
+{
+	struct prime_file_header *h;
+	size_t len;
+	register int i;
+
+	// the wheel sizes are needed to validate the file, and they only depend on the first few primes
+	_primorials[0] = _primorial_phis[0] = 1;
+	for ( i = 1 ; i <= PRIME_SMALL_PRIMORIAL_W ; i++ ) {
+		_primorials[i] = _primorials[i-1]*_wheel_primes[i];
+		_primorial_phis[i] = _primorial_phis[i-1]*(_wheel_primes[i]-1);
+	}
+	if ( ! (h = _prime_file_map (filename, &len)) ) return 0;
+	_prime_map = h;  _prime_map_len = len;
+	small_primes = (int *)((char *)h + h->primes_off);
+	small_prime_index = (int *)((char *)h + h->index_off);
+	for ( i = PRIME_SMALL_PRIMORIAL_W+1 ; i <= PRIME_MAX_PRIMORIAL_W ; i++ ) {
+		_primorials[i] = _primorials[i-1]*small_primes[i];
+		_primorial_phis[i] = _primorial_phis[i-1]*(small_primes[i]-1);
+	}
+	_small_wheels[0].n = 1;  _small_wheels[0].phi = 1;  _small_wheels[0].gaps = _wheel_gaps0;
+	_small_wheels[1].n = 2;  _small_wheels[1].phi = 1;  _small_wheels[1].gaps = _wheel_gaps1;
+	for ( i = 2 ; i <= PRIME_SMALL_PRIMORIAL_W ; i++ ) {
+		_small_wheels[i].n = _primorials[i];
+		_small_wheels[i].phi = _primorial_phis[i];
+		_small_wheels[i].gaps = (unsigned char *)h + h->wheel_off[i];
+		_small_wheels[i].maxgap = h->wheel_maxgap[i];
+	}
+	_prime_inited = 1;
+	return 1;
+}
+
+static int _prime_file_write (FILE *fp, void *data, uint64_t len, uint64_t *off)
+{
+	static char zeros[8];
+	register uint64_t pad;
+
+	pad = _prime_file_align (*off+len) - (*off+len);
+	if ( fwrite (data, 1, len, fp) != len || fwrite (zeros, 1, pad, fp) != pad ) return 0;
+	*off += len+pad;
+	return 1;
+}
+
+/*
+	Writes the small prime tables and wheels (and the prime table tab, if not null) to a prime file.  The file is written under a
+	temporary name and then renamed, so processes that map the file concurrently will see either the old file or the new one.
+*/
+int prime_save_file (char *filename, prime_table_t tab)
+{
+	struct prime_file_header h;
+	char *tmpname;
+	uint64_t off;
+	register long i, j;
+	FILE *fp;
+
+	prime_setup();
+	memset (&h, 0, sizeof(h));
+	h.magic = PRIME_FILE_MAGIC;
+	h.small_bits = PRIME_SMALL_BITS;  h.small_primes = PRIME_SMALL_PRIMES;  h.wheel_w = PRIME_SMALL_PRIMORIAL_W;
+	off = _prime_file_align (sizeof(h));
+	h.primes_off = off;  off = _prime_file_align (off + (PRIME_SMALL_PRIMES+1)*sizeof(int));
+	h.index_off = off;  off = _prime_file_align (off + (PRIME_MAX_SMALL_INTEGER+1)*sizeof(int));
+	for ( i = 2 ; i <= PRIME_SMALL_PRIMORIAL_W ; i++ ) {
+		h.wheel_off[i] = off;  off = _prime_file_align (off + _small_wheels[i].phi);
+		h.wheel_maxgap[i] = _small_wheels[i].maxgap;
+	}
+	if ( tab && tab->ti ) {
+		h.si = tab->si;  h.ti = tab->ti;  h.sp = tab->sp;  h.tp = tab->tp;  h.top = tab->top;
+		h.gaps_off = off;  off = _prime_file_align (off + (tab->ti-tab->si+1));
+		for ( i = 0 ; i <= tab->top ; i++ ) {
+			for ( j = 0 ; tab->levels[i][j] != LONG_MAX ; j++ );		// each level is terminated by LONG_MAX
+			h.level_len[i] = j+1;
+			h.level_off[i] = off;  off = _prime_file_align (off + h.level_len[i]*sizeof(long));
+		}
+	}
+	h.size = off;
+
+	tmpname = malloc (strlen(filename)+16);
+	sprintf (tmpname, "%s.%d.tmp", filename, (int)getpid());
+	if ( ! (fp = fopen (tmpname, "wb")) ) { fprintf (stderr, "Unable to create prime file %s\n", tmpname);  free (tmpname);  return 0; }
+	off = 0;
+	if ( ! _prime_file_write (fp, &h, sizeof(h), &off) ) goto err;
+	if ( ! _prime_file_write (fp, small_primes, (PRIME_SMALL_PRIMES+1)*sizeof(int), &off) ) goto err;
+	if ( ! _prime_file_write (fp, small_prime_index, (PRIME_MAX_SMALL_INTEGER+1)*sizeof(int), &off) ) goto err;
+	for ( i = 2 ; i <= PRIME_SMALL_PRIMORIAL_W ; i++ ) if ( ! _prime_file_write (fp, _small_wheels[i].gaps, _small_wheels[i].phi, &off) ) goto err;
+	if ( h.ti ) {
+		if ( ! _prime_file_write (fp, tab->gaps, h.ti-h.si+1, &off) ) goto err;
+		for ( i = 0 ; i <= h.top ; i++ ) if ( ! _prime_file_write (fp, tab->levels[i], h.level_len[i]*sizeof(long), &off) ) goto err;
+	}
+	if ( fclose (fp) != 0 ) { fp = 0;  goto err; }
+	assert (off == h.size);
+	if ( rename (tmpname, filename) < 0 ) { fprintf (stderr, "Unable to rename %s to %s\n", tmpname, filename);  unlink (tmpname);  free (tmpname);  return 0; }
+	free (tmpname);
+	return 1;
+err:
+	fprintf (stderr, "Error writing prime file %s\n", tmpname);
+	if ( fp ) fclose (fp);
+	unlink (tmpname);
+	free (tmpname);
+	return 0;
+}
+
+/*
+	Uses the prime file created by prime_save_file for the small prime tables (unless they have already been set up)
+	and, if tab is not null, maps the prime table stored in the file into tab (which should be released with prime_table_clear).
+	Returns 1 on success, 0 if the file is not usable (or has no prime table when one was requested).
+*/
+int prime_load_file (char *filename, prime_table_t tab)
+{
+	struct prime_file_header *h;
+	size_t len;
+	register int i;
+
+	if ( ! _prime_inited && ! _prime_file_setup (filename) ) return 0;
+	if ( ! tab ) return 1;
+	if ( ! (h = _prime_file_map (filename, &len)) ) return 0;
+	if ( ! h->ti ) { fprintf (stderr, "Prime file %s does not contain a prime table\n", filename);  munmap (h, len);  return 0; }
+	memset (tab, 0, sizeof(*tab));
+	tab->map = h;  tab->maplen = len;
+	tab->si = h->si;  tab->ti = h->ti;  tab->sp = h->sp;  tab->tp = h->tp;  tab->top = h->top;
+	tab->gaps = (unsigned char *)h + h->gaps_off;
+	for ( i = 0 ; i <= tab->top ; i++ ) tab->levels[i] = (long *)((char *)h + h->level_off[i]);
+	return 1;
+}
+
@@ -50,26 +50,37 @@ struct wheel_struct {
 };
 typedef struct wheel_struct wheel_t;
 
+#define PRIME_SEGMENT_LG_WORDS		12							// sieve segments of 2^12 64-bit words (32KB, L1 sized), each covering 2^19 integers
+#define PRIME_SEGMENT_WORDS			(1<<PRIME_SEGMENT_LG_WORDS)
+#define PRIME_SEGMENT_LG_BITS		(PRIME_SEGMENT_LG_WORDS+6)
+#define PRIME_SEGMENT_BITS			(1<<PRIME_SEGMENT_LG_BITS)		// one bit for each odd integer in the segment
+
 struct prime_enum_ctx_struct {
-	long L, end;											// usually L = end, but for windowed enumeration L may need to be greater than end
+	unsigned long L, end;										// usually L = end, but for windowed enumeration L may need to be greater than end
 	long s[PRIME_BITS];										// for i > 1, s[i] is the index of the greatest prime q st q^i < p
 	long e[PRIME_BITS];									// for i > 1, e[i] is the index of the least prime q st q^i >= L
 	long q[PRIME_BITS];									// for i > 1 q[i] = s^i
 	long h;
-	long w;
-	long *wi;
-	long *wv;
-	long p, bufp;
-	long pi;
-	long j;
-	long start;
-	wheel_t *wheel;
-	unsigned char *map;
-	unsigned char *mp;
+	long w;												// index of the largest prime <= L^{1/2}, primes p_2,...,p_w are used to sieve
+	long bufp;
 	int powers;
 	int k;												// if powers > 1, then q[k] is the minimum q[i] for 2 <= i <= powers
 	int d;												// if powers > 1, then the most recently enumerated prime power is b^d
 	long b;
+	// segmented sieve (see _prime_sieve_segment)
+	unsigned long *seg;										// bit i is set iff segbase+2i is composite
+	unsigned long segbase;									// odd integer corresponding to bit 0 of the current segment
+	unsigned long pbase;									// integer corresponding to bit 0 of the current word x
+	unsigned long vmin;										// survivors greater than vmin are verified with prime_bpsw (only when L > PRIME_MAX_ENUM)
+	unsigned long x;										// complement of the current word of seg (bits that are yet to be enumerated)
+	int si;												// index of the current word in seg
+	int two;												// set if 2 is yet to be enumerated
+	long mw;												// primes p_2,...,p_mw are less than PRIME_SEGMENT_BITS (medium primes)
+	long lw;												// primes p_{mw+1},...,p_{lw-1} are in buckets (large primes), p_lw^2 lies beyond the current segment
+	long *so;												// for medium primes, so[i] is the index of the next odd multiple of p_i to sieve (relative to the current segment)
+	unsigned long **bucket;									// large primes are stored in the bucket for the next segment containing one of their multiples
+	int *bcnt, *bmax;										// as (p<<32)|i where i is the index of the multiple in that segment
+	int nb, cb;											// number of buckets and the bucket for the current segment
 	// entries below are for lookahead in prime_enum_w
 	unsigned char *la_gaps;
 	int la_i, la_j, la_n, la_window;
@@ -87,6 +98,7 @@ void prime_cleanup();
 prime_enum_ctx_t *prime_enum_start_w (long start, long end, long window);	// enumerates primes in [start,end],  and optionally logs primes in window
 																// use window < 0 for trailing window, window >0 centered, window=0 for no window
 prime_enum_ctx_t *prime_enum_start (long start, long end, int powers);		// enumerates primes (or prime powers p^k with k <= powers) in [start,end]
+																// end may be as large as 2^64-1 (start and end are treated as unsigned), but powers requires end <= PRIME_MAX_ENUM
 long _prime_enum (prime_enum_ctx_t *ctx);
 long _prime_enum_w (prime_enum_ctx_t *ctx);
 static inline long prime_enum (prime_enum_ctx_t *ctx) { return ctx->la_window ? _prime_enum_w(ctx) : _prime_enum(ctx); }
@@ -98,6 +110,38 @@ static inline int prime_enum_base (prime_enum_ctx_t *ctx)					// if powers is se
 long prime_power_enum (prime_enum_ctx_t *ctx);
 void prime_enum_end (prime_enum_ctx_t *ctx);
 
+#define PRIME_MOD_SEGMENT_BITS		(1<<21)						// size of the bitmap used to sieve arithmetic progressions (256KB)
+#define PRIME_MOD_MAX_STATE			(1<<24)						// max number of (prime,class) sieving offsets, denser residue sets fall back to prime_enum
+#define PRIME_MOD_MAX_BITMAP		(1UL<<24)					// largest m for which the fallback to prime_enum tests p mod m with a bitmap (2MB), otherwise it uses bsearch
+
+struct prime_enum_mod_ctx_struct {
+	unsigned long m, start, end;
+	unsigned long *r;										// sorted list of the k classes mod m that are sieved (those coprime to m), or of all the classes if all is set and bm is not
+	int k;
+	unsigned long xp[16];										// prime divisors of m that lie in one of the specified classes (see prime_enum_mod_start)
+	int nx, xi;
+	unsigned long next;										// next prime from the sieve (used to merge in xp), 0 if not yet computed
+	int done;
+	// when the classes are too dense to be worth sieving individually we enumerate all primes and test p mod m
+	prime_enum_ctx_t *all;
+	unsigned long *bm;										// bit i set iff i mod m is an allowed class (only used with all, and only if m <= PRIME_MOD_MAX_BITMAP)
+	// the sieve bitmap holds T rows of k bits, bit t*k+j corresponds to m*(tbase+t)+r[j]
+	unsigned long *seg;
+	long T, bits, words, wi;
+	unsigned long tbase, tmax;									// the last row containing integers <= end is tmax
+	unsigned long x;										// complement of the current word of seg (bits that are yet to be enumerated)
+	int *q;												// odd sieving primes not dividing m, q[0] = 2 if m is odd
+	unsigned *off;											// off[i*k+j] is the index of the next row (relative to the current segment) containing a multiple of q[i] in class r[j]
+	long nq;
+	unsigned long vmin;										// survivors greater than vmin are verified with prime_bpsw (only when end > PRIME_MAX_ENUM)
+};
+typedef struct prime_enum_mod_ctx_struct prime_enum_mod_ctx_t;
+
+// enumerates primes in [start,end] (which may extend to 2^64-1) that are congruent mod m to one of r[0],...,r[k-1], in increasing order
+prime_enum_mod_ctx_t *prime_enum_mod_start (long start, long end, unsigned long m, unsigned long r[], int k);
+long prime_enum_mod (prime_enum_mod_ctx_t *ctx);
+void prime_enum_mod_end (prime_enum_mod_ctx_t *ctx);
+
 void prime_start_logging (long start, int window);							// explictly turn on logging to keep a record of primes enumerated within a trailing window
 int prime_check_log (long n);
 void prime_stop_logging (void);
@@ -112,6 +156,8 @@ long pi_bound (long n);
 long primorial (int w);
 long primorial_phi (int w);
 
+int prime_bpsw (unsigned long n);										// Baillie-PSW primality test, which is deterministic for n < 2^64
+
 long next_prime (long p);											// for large primes just calls GMP, create a prime table if you care about speed
 
 #define PRIME_TABLE_MAX_LEVELS			16
@@ -128,6 +174,8 @@ struct gaptab_struct {
 	unsigned char *gaps;
 	long *levels[PRIME_TABLE_MAX_LEVELS];
 	int top;
+	void *map;												// non-null if gaps and levels point into a mapped prime file (see prime_load_file)
+	size_t maplen;
 };
 typedef struct gaptab_struct gap_table_t[1], prime_table_t[1];
 
@@ -136,6 +184,11 @@ void prime_table_init (prime_table_t tab, long start_pi, long end_pi);
 void gap_table_clear (gap_table_t tab);
 static inline void prime_table_clear (prime_table_t tab) { gap_table_clear (tab); }
 
+// Prime files let short-lived processes skip prime_setup and prime_table_init by mapping precomputed tables read-only (shared across processes).
+// If the environment variable SMALLJAC_PRIME_FILE is set, prime_setup will use the small prime tables in the file it names.
+int prime_save_file (char *filename, prime_table_t tab);						// writes the small prime tables and tab (which may be null) to filename
+int prime_load_file (char *filename, prime_table_t tab);						// uses the small prime tables in filename and (if tab is not null) maps its prime table into tab
+
 // returns the least integer p >= x that lies in the table (0 if none) and sets *pgap to point to gap between p and the next entry in the table (0 if last entry)
 static inline long gap_table_next_gap (gap_table_t tab, unsigned char **pgap, long x)
 {
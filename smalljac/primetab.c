@@ -0,0 +1,40 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "prime.h"
+
+/*
+    Copyright (c) 2026 The smalljac contributors
+    See LICENSE file for license details.
+*/
+
+// command-line program to create a prime file that can be memory mapped by prime_load_file (or via the SMALLJAC_PRIME_FILE environment variable)
+
+int main (int argc, char *argv[])
+{
+	clock_t start, end;
+	prime_table_t tab;
+	long n;
+
+	if ( argc < 2 ) {
+		puts ("primetab filename [n]");
+		puts ("   writes the small prime tables to filename, along with a table of the primes p_2,...,p_n if n is specified");
+		puts ("   \"primetab primes.dat 100000000\"");
+		return 0;
+	}
+	n = ( argc > 2 ? atol(argv[2]) : 0 );
+	if ( n && (n < 3 || n > PRIME_TABLE_MAX_PI) ) { printf ("n must be between 3 and %ld\n", PRIME_TABLE_MAX_PI);  return 0; }
+
+	start = clock();
+	if ( n ) prime_table_init (tab, 2, n);
+	if ( ! prime_save_file (argv[1], n ? tab : 0) ) return -1;
+	end = clock();
+	if ( n ) {
+		printf ("Wrote small prime tables and primes %ld to %ld to %s\n", prime_table_nth_prime (tab, 2), prime_table_nth_prime (tab, n), argv[1]);
+		prime_table_clear (tab);
+	} else {
+		printf ("Wrote small prime tables to %s\n", argv[1]);
+	}
+	if ( end > start ) printf ("%.3f secs\n", (double)(end-start)/CLOCKS_PER_SEC);
+	return 0;
+}
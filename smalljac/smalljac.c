@@ -5,6 +5,7 @@
 #include <math.h>
 #include <ctype.h>
 #include <assert.h>
+#include <unistd.h>
 #include <gmp.h>
 #include "ff_poly.h"
 #include "mpzutil.h"
@@ -52,7 +53,7 @@ static int _smalljac_initted;
 void smalljac_init (void)
 {
 	if ( _smalljac_initted ) return;
-	smalljac_table_alloc (SMALLJAC_TABBITS);
+	jac_search_default_ctx ();
 	pointcount_init (SMALLJAC_INIT_COUNT_P);
 	_smalljac_initted = 1;
 }
@@ -141,48 +142,22 @@ int smalljac_Lpoly_callback (smalljac_curve_t curve, unsigned long p, int good,
 	{ int i; if ( good ) { ((long*)arg)[0] = n;  for ( i = 0 ; i < n ; i++ ) ((long*)arg)[i+1] = a[i]; } else { ((long*)arg)[0] = 0; } return 1; }
 
 /*
-	For the sake of simplicity, smalljac_Lpoly is implemented via a call to smalljac_Lpolys with start=end=p.
-	This is slightly slower, but performance is not a major consideration for an individual call to smalljac_Lpoly.
+	smalljac_Lpoly simply parses the curve and calls smalljac_curve_Lpoly (see below), which does not involve any
+	parsing or allocation, so callers making repeated queries on the same curve should create the curve once and use
+	smalljac_curve_Lpoly or smalljac_Lpolys_list directly.
 
 	Those interested in computing Lpolys for large sets of curves will almost certainly want to use the underlying
 	functionality directly (e.g. pointcount.c, which supports multi-curve point-counting, for example).
 */
 int smalljac_Lpoly (long a[], char *curve, unsigned long q, unsigned long flags)
 {
-	mpz_t P;
 	smalljac_curve *sc;
-	unsigned long p;
-	long b[SMALLJAC_MAX_GENUS+1];
-	long sts;
-	int i, h, n, error;
-
-	mpz_init (P);
-	mpz_set_ui (P, q);
-	h = mpz_pp_base (P, P);
-	p = mpz_get_ui (P);
-	mpz_clear (P);
-		
-	if ( ! h ) return SMALLJAC_INVALID_PP;
-	if ( h > 1 ) {
-		if ( (flags&SMALLJAC_GROUP) ) return SMALLJAC_INVALID_PP;			// group computation is currently supported only for prime fields
-		if ( (flags&SMALLJAC_A1_ONLY) ) flags &= ~SMALLJAC_A1_ONLY; 		// turn off A1_ONLY flag if q is a prime power
-	}
+	int n, error;
 
 	sc = smalljac_curve_init (curve, &error);
 	if ( ! sc ) return error;
-	if ( ! sc->Qflag ) { smalljac_curve_clear (sc); return SMALLJAC_NOT_OVER_Q; }
-	if ( p > smalljac_curve_max_p(sc) && ! sc->special ) { smalljac_curve_clear (sc); return SMALLJAC_INVALID_PP; }
-	b[0] = 0;
-
-	sts = smalljac_Lpolys (sc, q, q, flags, smalljac_Lpoly_callback, b);
+	n = smalljac_curve_Lpoly (a, sc, q, flags);
 	smalljac_curve_clear (sc);
-	
-	if ( sts <= 0 ) return sts;
-	n = b[0];
-	if ( ! n ) return 0;
-	for ( i = 0 ; i < n ; i++ ) a[i] = b[i+1];
-	
-	if ( h > 1 )  if ( ! smalljac_Lpoly_extend (a, n, p, h) ) return SMALLJAC_INTERNAL_ERROR;
 	return n;
 }
 
@@ -206,90 +181,187 @@ int smalljac_parse_file_header (char buf[SMALLJAC_CURVE_STRING_LEN+256], long *p
 	return 1;
 }
 
-// parse data line of input file to smalljac_Lpolys_from_file(s), which should be in the form "q,a1,a2,...a_n\n" or "q,?",
-// where the integer q is a prime power and the integers a_1,...a_n are L-poly coefficients, with either n=1 or n=g.  ? indicates bad reduction
-// returns n for success, 0 for bad reduction, or -1 for format error
-static int smalljac_parse_file_record (long *q, long a[SMALLJAC_MAX_GENUS], int n, char buf[])
+// reads the next record from lf, returns n for success, 0 for bad reduction, -1 at end of file, or -2 for a format error
+// (which includes a good record with fewer than n coefficients)
+static inline int smalljac_lpfile_read (smalljac_lpfile_t lf, unsigned long *q, long a[SMALLJAC_MAX_GENUS], int n)
 {
-	register char *s;
-	int i;
-	
-	*q = atol (buf);
-	if ( ! *q ) return -1;
-	s = buf;
-	for ( i = 0 ; i < n ; i++ ) {
-		for ( ; *s && *s != ',' ; s++ );
-		if ( !*s++ ) return -1;
-		if ( *s == '?' ) return 0;
-		a[i] = atol(s);
+	register int sts;
+
+	sts = smalljac_lpfile_next (lf, q, a);
+	if ( sts > 0 ) return ( sts < n ? -2 : n );
+	return sts;
+}
+
+// creates a curve for the data file lf and sets *pn to the number of coefficients to be passed to the callback for good records
+// if the genus is specified in the data file we just allocate a curve structure, otherwise we parse the curve string
+// returns null and sets *err on failure
+smalljac_curve *smalljac_lpfile_curve (smalljac_lpfile_t lf, char *filename, unsigned long flags, int *pn, int *err)
+{
+	smalljac_curve *sc;
+	char cstr[SMALLJAC_CURVE_STRING_LEN];
+	char *curve;
+	int g, fn;
+
+	smalljac_lpfile_info (lf, &curve, 0, 0, &g, &fn, 0);
+	if ( strlen (curve) >= SMALLJAC_CURVE_STRING_LEN ) { err_printf ("curve string in data file %s is too long\n", filename);  *err = SMALLJAC_BADFILE;  return 0; }
+	strcpy (cstr, curve);
+	if ( g ) {
+		sc = smalljac_curve_alloc();
+		strcpy (sc->str, cstr);
+		sc->genus = g;
+	} else {
+		sc = smalljac_curve_init (cstr, err);
+		if ( ! sc ) { err_printf ("unable to parse curve string in file %s\n%s\n", filename, curve);  return 0; }
 	}
-	return n;
+	*pn = ( (flags&SMALLJAC_A1_ONLY) ? 1 : sc->genus );
+	if ( fn && *pn > fn ) { err_printf ("data file %s only contains a1 coefficients (set SMALLJAC_A1_ONLY)\n", filename);  smalljac_curve_clear (sc);  *err = SMALLJAC_BADFILE;  return 0; }
+	return sc;
+}
+
+// makes callbacks for the records in lf (or its current chunk) with norms in [start,end], as smalljac_Lpolys would
+// returns the norm at which the callback returned 0, end if it never did, or an error code
+long smalljac_lpfile_scan (smalljac_lpfile_t lf, smalljac_curve *sc, int n, char *filename, unsigned long start, unsigned long end, unsigned long flags,
+				       int (*callback)(smalljac_curve_t curve, unsigned long q, int good, long a[], int n, void *arg), void *arg)
+{
+	unsigned long q;
+	int sts;
+
+	smalljac_lpfile_seek (lf, start);
+	while ( (sts = smalljac_lpfile_read (lf, &q, sc->a, n)) != -1 ) {
+		if ( sts < 0 ) { err_printf ("smalljac file format error in %s\n", filename);  return SMALLJAC_BADFILE; }
+		if ( q > end ) break;
+		if ( (flags & SMALLJAC_FILTER) )  if ( ! (*callback)  (sc, q, -1, 0, 0, arg) ) continue;
+		if ( ! sts ) { if ( !(flags&SMALLJAC_GOOD_ONLY) ) if ( ! (*callback) (sc, q, 0, 0, 0, arg) ) return q;  continue; }
+		sc->q = q; sc->n = n;
+		if ( ! (*callback) (sc, sc->q, 1, sc->a, sc->n, arg) ) return q;
+	}
+	return end;
 }
 
 // simulate smalljac_Lpolys using precomputed data -- MAKES NO ATTEMPT TO VALIDATE DATA
 // expected format is [curve] in the first line of the file (and possbily several subsequent lines) followed by lines of text q,a_1,a_2,...,a_n\n
 // where q,a_1,...,a_n are integers, with a_1,...a_n representing L-poly coefficients for the curve at a prime of norm q
 // lines begining q,? indicate primes of bad reduction
+// binary data files (see smalljac_lpfile.c) and gzip compressed text files are also accepted.  Either way the file is memory mapped and parsed in place.
 long smalljac_Lpolys_from_file (char *filename, unsigned long start, unsigned long end, unsigned long flags,
 						int (*callback)(smalljac_curve_t curve, unsigned long q, int good, long a[], int n, void *arg), void *arg)
 {
 	smalljac_curve *sc;
-	char buf[SMALLJAC_CURVE_STRING_LEN+256];
-	long q, fstart, fend;
-	FILE *fp;
-	int quit, err, sts, g, n;
-	
-	fp = fopen (filename, "r");
-	if ( ! fp ) return SMALLJAC_FILENOTFOUND;
+	smalljac_lpfile_t lf;
+	unsigned long fstart, fend;
+	long q;
+	int err, n;
 	
 	if ( start <= 0 ) start = 1;
-	
-	// get curve string, and file start and end norms from the first line of the file
-	if ( ! fgets(buf,sizeof(buf),fp) || buf[0] != '[' ) { err_printf ("curve spec missing from first line of data file %s\n", filename); fclose(fp); return SMALLJAC_BADFILE; }
-	if ( ! smalljac_parse_file_header (buf, &fstart, &fend, &g) ) { err_printf ("unable to find curve spec and prime range in the first line of the specified field %s\n", filename); fclose(fp); return SMALLJAC_BADFILE; }
+	if ( ! (lf = smalljac_lpfile_open (filename)) ) return ( access (filename, R_OK) ? SMALLJAC_FILENOTFOUND : SMALLJAC_BADFILE );
+	smalljac_lpfile_info (lf, 0, &fstart, &fend, 0, 0, 0);
 	if ( start < fstart ) { info_printf ("Increasing requested start from %ld to %ld\n", start, fstart); start = fstart; }
 	if ( end > fend )  { info_printf ("Decreasing requested end from %ld to %ld\n", end, fend); end = fend; }
-	if ( g ) {
-		sc = smalljac_curve_alloc();
-		strcpy (sc->str, buf);
-		sc->genus =g;
-	} else {
-		sc = smalljac_curve_init (buf, &err);
-		if ( ! sc ) { err_printf ("unable to parse curve string in file %s\n%s", filename, buf); fclose(fp); return err; }
-	}
-	quit = 0;
-	n =  ( (flags&SMALLJAC_A1_ONLY) ? 1 : sc->genus );
-	while ( fgets(buf,sizeof(buf),fp) ) {
-		if ( buf[0] == '[' ) continue;	// ignore repeated curve spec -- handy for merged lpdata files
-		sts = smalljac_parse_file_record (&q, sc->a, n, buf);
-		if ( sts < 0 ) { err_printf ("smalljac file format error in %s\n%s", filename, buf);  fclose (fp); return SMALLJAC_BADFILE; }
-		if ( q < start ) continue;  if ( q > end ) break;
-		if ( (flags & SMALLJAC_FILTER) )  if ( ! (*callback)  (sc, q, -1, 0, 0, arg) ) continue;
-		if ( ! sts ) { if ( !(flags&SMALLJAC_GOOD_ONLY) ) if ( ! (*callback) (sc, q, 0, 0, 0, arg) ) { quit = 1; break; } continue; }
-		sc->q = q; sc->n = n;
-		if ( ! (*callback) (sc, sc->q, 1, sc->a, sc->n, arg) ) { quit = 1; break; }
-	}
-	if ( ! quit ) q = end;
+	if ( ! (sc = smalljac_lpfile_curve (lf, filename, flags, &n, &err)) ) { smalljac_lpfile_close (lf);  return err; }
+	q = smalljac_lpfile_scan (lf, sc, n, filename, start, end, flags, callback, arg);
 	smalljac_curve_clear (sc);
-	fclose (fp);
+	smalljac_lpfile_close (lf);
 	return q;
 }
 
+// opens the data file for the specified job, using prefix_jobs_jobid.lpd if it exists, otherwise prefix_jobs_jobid.txt (or .txt.gz)
+// returns null and sets *err on failure, filename is set in either case
+smalljac_lpfile_t smalljac_lpfile_open_job (char filename[], char *fileprefix, int jobs, int jobid, int *err)
+{
+	smalljac_lpfile_t lf;
+
+	sprintf (filename, "%s_%d_%d.lpd", fileprefix, jobs, jobid);
+	if ( (lf = smalljac_lpfile_open (filename)) ) return lf;
+	sprintf (filename, "%s_%d_%d.txt", fileprefix, jobs, jobid);
+	if ( (lf = smalljac_lpfile_open (filename)) ) return lf;
+	sprintf (filename, "%s_%d_%d.txt.gz", fileprefix, jobs, jobid);
+	if ( (lf = smalljac_lpfile_open (filename)) ) return lf;
+	sprintf (filename, "%s_%d_%d.txt", fileprefix, jobs, jobid);
+	if ( access (filename, R_OK) ) { err_printf ("Error opening file %s\n", filename);  *err = SMALLJAC_FILENOTFOUND; } else *err = SMALLJAC_BADFILE;
+	return 0;
+}
+
+// the merge heap is ordered by (q[i],i), so records with the same norm are taken from files in index order
+#define _merge_lt(q,i,j)		( (q)[i] < (q)[j] || ((q)[i] == (q)[j] && (i) < (j)) )
+
+static inline void smalljac_merge_sift (int h[], int k, int j, unsigned long q[])
+{
+	register int c, t;
+
+	t = h[j];
+	while ( (c = 2*j+1) < k ) {
+		if ( c+1 < k && _merge_lt (q, h[c+1], h[c]) ) c++;
+		if ( ! _merge_lt (q, h[c], t) ) break;
+		h[j] = h[c];  j = c;
+	}
+	h[j] = t;
+}
+
+/*
+	Merges the records with norms in [start,end] from the open data files lf[0],...,lf[files-1] (each of which is in norm order) using a heap,
+	making callbacks as smalljac_Lpolys would.  Returns the norm at which the callback returned 0, end if it never did, or an error code.
+	Name is used in error messages.
+*/
+long smalljac_lpfile_merge (smalljac_lpfile_t lf[], int files, smalljac_curve *sc, int n, char *name, unsigned long start, unsigned long end, unsigned long flags,
+					    int (*callback)(smalljac_curve_t curve, unsigned long q, int good, long a[], int n, void *arg), void *arg)
+{
+	unsigned long q[SMALLJAC_MAX_JOBS];
+	long a[SMALLJAC_MAX_JOBS][SMALLJAC_MAX_GENUS];
+	int h[SMALLJAC_MAX_JOBS];
+	int sts, k;
+	register int i, j;
+
+	if ( files > SMALLJAC_MAX_JOBS ) { err_printf ("number of files cannot exceed SMALLJAC_MAX_JOBS = %d\n", SMALLJAC_MAX_JOBS); return SMALLJAC_INTERNAL_ERROR; }
+	for ( i = k = 0 ; i < files ; i++ ) {
+		smalljac_lpfile_seek (lf[i], start);
+		sts = smalljac_lpfile_read (lf[i], q+i, a[i], n);
+		if ( sts == -1 ) continue;
+		if ( sts < 0 ) { err_printf ("smalljac file format error in file %d of %d in %s\n", i, files, name);  return SMALLJAC_BADFILE; }
+		if ( ! sts ) a[i][0] = JAC_INVALID_A1;		// indicate bad reduction with an invalid a1 value
+		if ( q[i] <= end ) h[k++] = i;
+	}
+	for ( j = k/2-1 ; j >= 0 ; j-- ) smalljac_merge_sift (h, k, j, q);
+	while ( k ) {
+		// take the next record, ordered by q
+		i = h[0];
+		sc->q = q[i];  sc->n = ( a[i][0] == JAC_INVALID_A1 ? 0 : n );
+		for ( j = 0 ; j < sc->n ; j++ ) sc->a[j] = a[i][j];
+
+		// replace the data we just used
+		sts = smalljac_lpfile_read (lf[i], q+i, a[i], n);
+		if ( sts < -1 ) { err_printf ("smalljac file format error in file %d of %d in %s\n", i, files, name);  return SMALLJAC_BADFILE; }
+		if ( sts >= 0 && q[i] < sc->q ) { err_printf ("records out of order in file %d of %d in %s (%lu follows %lu)\n", i, files, name, q[i], sc->q);  return SMALLJAC_BADFILE; }
+		if ( ! sts ) a[i][0] = JAC_INVALID_A1;
+		if ( sts == -1 || q[i] > end ) h[0] = h[--k];
+		if ( k ) smalljac_merge_sift (h, k, 0, q);
+
+		// process the data
+		if ( sc->q < start ) continue;
+		if ( (flags & SMALLJAC_FILTER) )  if ( ! (*callback)  (sc, sc->q, -1, 0, 0, arg) ) continue;
+		if ( ! sc->n ) {
+			if ( !(flags&SMALLJAC_GOOD_ONLY) ) if ( ! (*callback) (sc, sc->q, 0, 0, 0, arg) ) return sc->q;
+			continue;
+		}
+		if ( ! (*callback) (sc, sc->q, 1, sc->a, sc->n, arg) ) return sc->q;
+	}
+	return end;
+}
+
 // simulate smalljac_Lpolys using precomputed data stored in multiple files (typically created using the lpdata program) -- MAKES NO ATTEMPT TO VALIDATE DATA
 // note: unlike smalljac_Lpoly or smalljac_Lpoly_from_file, there is no implicit ordering among degree-1 primes of the same norm
+// for each job the binary file prefix_jobs_jobid.lpd is used if it exists, otherwise the text file prefix_jobs_jobid.txt
 long smalljac_Lpolys_from_files (char *fileprefix, int jobs, unsigned long start, unsigned long end, unsigned long flags,
 						 int (*callback)(smalljac_curve_t curve, unsigned long q, int good, long a[], int n, void *arg), void *arg)
 {
 	smalljac_curve *sc;
 	char filename[1024];
-	char buf[SMALLJAC_CURVE_STRING_LEN+256];
 	char cstr[SMALLJAC_CURVE_STRING_LEN];
-	long q[SMALLJAC_MAX_JOBS];
-	long a[SMALLJAC_MAX_JOBS][SMALLJAC_MAX_GENUS];
-	FILE *fp[SMALLJAC_MAX_JOBS];
-	long fstart, fend, qend;
-	int sts, quit, err, genus;
-	register int i, j, n;
+	smalljac_lpfile_t lf[SMALLJAC_MAX_JOBS];
+	unsigned long fstart, fend;
+	char *curve;
+	long qend;
+	int err, fn, n;
+	register int i;
 	
 	if ( strlen(fileprefix) + 64 > sizeof(filename) ) { err_printf ("specified file prefix is too long for buffer\n"); return SMALLJAC_INTERNAL_ERROR; }
 	if ( jobs > SMALLJAC_MAX_JOBS ) { err_printf ("jobs cannot exceed SMALLJAC_MAX_JOBS = %d\n", SMALLJAC_MAX_JOBS); return SMALLJAC_INTERNAL_ERROR; }
@@ -297,65 +369,25 @@ long smalljac_Lpolys_from_files (char *fileprefix, int jobs, unsigned long start
 	if ( start <= 0 ) start = 1;
 	
 	err = 0; qend = 0; sc = 0; n = 0;
-	for ( i = 0 ; i < jobs ; i++ ) fp[i] = 0;
+	for ( i = 0 ; i < jobs ; i++ ) lf[i] = 0;
 	for ( i = 0 ; i < jobs ; i++ ) {
-		sprintf (filename, "%s_%d_%d.txt", fileprefix, jobs, i);
-		fp[i] = fopen (filename, "r");
-		if ( ! fp[i] ) { err_printf ("Error opening file %s\n", buf); err = SMALLJAC_FILENOTFOUND; goto done; }
-		if ( ! fgets(buf,sizeof(buf),fp[i]) || buf[0] != '[' ) { err_printf ("curve spec missing from first line of data file %s\n", filename); err = SMALLJAC_NODATA; goto done; }
-		if ( ! smalljac_parse_file_header (buf, &fstart, &fend, &genus) ) { err_printf ("unable to find curve spec and prime range in the first line of the specified field %s\n", filename); err = SMALLJAC_BADFILE; goto done; }
+		if ( ! (lf[i] = smalljac_lpfile_open_job (filename, fileprefix, jobs, i, &err)) ) goto done;
+		smalljac_lpfile_info (lf[i], &curve, &fstart, &fend, 0, &fn, 0);
 		if ( start < fstart || end > fend ) { err_printf ("Requested data range [%ld,%ld] extends outside the data range [%ld,%ld] in the file %s\n", start, end, fstart, fend, filename);  err = SMALLJAC_NODATA; goto done; }
 		if ( ! i ) {
-			strcpy (cstr, buf);
-			if ( genus ) {
-				sc = smalljac_curve_alloc();
-				strcpy (sc->str, buf);
-				sc->genus = genus;
-			} else {
-				sc = smalljac_curve_init (cstr, &err);
-				if ( ! sc ) { err_printf ("unable to parse curve string in file %s\n%s", filename, buf); fclose(fp[i]); return err; }
-			}
-			n = (flags&SMALLJAC_A1_ONLY) ? 1 : sc->genus;
-		} else {
-			if ( strcmp (buf, cstr) != 0 ) { err_printf ("inconsistent curve string in file %s\n%s", filename, buf);  err = SMALLJAC_BADFILE; goto done; }
-		}
-		if ( ! fgets(buf,sizeof(buf),fp[i]) ) { q[i] = 0; continue; }
-		sts = smalljac_parse_file_record (q+i, a[i], n, buf);
-		if ( sts < 0 ) { err_printf ("smalljac file format error in %s\n%s", filename, buf);  err = SMALLJAC_BADFILE; goto done; }
-		if ( ! sts ) a[i][0] = JAC_INVALID_A1;		// indicate bad reduction with an invalid a1 value
-	}
-
-	quit = 0;
-	for (;;) {
-		// get data for the next record, ordered by q
-		for ( i = 0 ; i < jobs && ! q[i] ; i++ );
-		if ( i == jobs ) break;
-		for ( j = 1 ; j < jobs ; j++ ) if ( q[j] && q[i] > q[j] ) i = j;
-		sc->q = q[i];  sc->n = ( a[i][0] == JAC_INVALID_A1 ? 0 : n );
-		
-		// replace the data we just used
-		for ( j = 0 ; j < sc->n ; j++ ) sc->a[j] = a[i][j];
-		if ( ! fgets(buf,sizeof(buf),fp[i]) ) {
-			q[i] = 0;
+			if ( ! (sc = smalljac_lpfile_curve (lf[i], filename, flags, &n, &err)) ) goto done;
+			strcpy (cstr, curve);
 		} else {
-			sts = smalljac_parse_file_record (q+i, a[i], n, buf);
-			if ( sts < 0 ) { err_printf ("smalljac file format error in %s\n%s", filename, buf);  err = SMALLJAC_BADFILE; goto done; }
-			if ( ! sts ) a[i][0] = JAC_INVALID_A1;		// indicate bad reduction with an invalid a1 value
-		}
-			
-		// process the data
-		if ( sc->q < start ) continue;  if ( sc->q > end ) { q[i] = 0; continue; }
-		if ( (flags & SMALLJAC_FILTER) )  if ( ! (*callback)  (sc, sc->q, -1, 0, 0, arg) ) continue;
-		if ( ! sc->n ) {
-			if ( !(flags&SMALLJAC_GOOD_ONLY) ) if ( ! (*callback) (sc, sc->q, 0, 0, 0, arg) ) { quit = 1; break; }
-			continue;
+			if ( strcmp (curve, cstr) != 0 ) { err_printf ("inconsistent curve string in file %s\n%s\n", filename, curve);  err = SMALLJAC_BADFILE; goto done; }
+			if ( fn && n > fn ) { err_printf ("data file %s only contains a1 coefficients (set SMALLJAC_A1_ONLY)\n", filename);  err = SMALLJAC_BADFILE; goto done; }
 		}
-		if ( ! (*callback) (sc, sc->q, 1, sc->a, sc->n, arg) ) { quit = 1; break; }
 	}
-	qend = ( quit ? q[i] : end );
+	sprintf (filename, "files with prefix %s", fileprefix);
+	qend = smalljac_lpfile_merge (lf, jobs, sc, n, filename, start, end, flags, callback, arg);
+	if ( qend < 0 ) err = qend;
 done:
 	if ( sc ) smalljac_curve_clear (sc);
-	for ( i = 0 ; i < jobs ; i++ ) if ( fp[i] ) fclose (fp[i]);
+	for ( i = 0 ; i < jobs ; i++ ) if ( lf[i] ) smalljac_lpfile_close (lf[i]);
 	return (err ? err : qend );
 }
 
@@ -379,26 +411,104 @@ static inline int smalljac_reduce_nf_poly (smalljac_curve *sc, long p, int e, in
 }
 
 
+// verifies that the specified flags are valid for the curve, returns 0 if so, and a (negative) error code otherwise
+int smalljac_Lpolys_check_flags (smalljac_curve *sc, unsigned long flags)
+{
+	if ( (flags&SMALLJAC_A1_ONLY) && (flags&SMALLJAC_GROUP) ) return SMALLJAC_INVALID_FLAGS;
+	if ( sc->genus > SMALLJAC_GENUS && ! (flags&SMALLJAC_A1_ONLY) && ! sc->special ) { err_printf ("The SMALLJAC_A1_ONLY flag must be set for curves of genus %d (or change SMALLJAC_GENUS and recompile)\n", sc->genus); return SMALLJAC_UNSUPPORTED_CURVE; }
+	if ( sc->genus != 1 && flags&SMALLJAC_PRIME_ORDER ) { err_printf ("SMALLJAC_PRIME_ORDER flag only supported in genus 1\n");  return SMALLJAC_INVALID_FLAGS; }
+	return 0;
+}
+
+// precompute delta values for pointcounting, if needed (but only when curve is defined over Q)
+void smalljac_Lpolys_Q_setup (smalljac_curve *sc, unsigned long start)
+{
+	if ( (start <= smalljac_count_p(sc->genus) || sc->genus > 2) && ! (sc->flags&SMALLJAC_CURVE_FLAG_DELTA) ) {
+		smalljac_curve_init_Deltas(sc);
+		pointcount_precompute (sc->Deltas, sc->f, sc->degree);
+		sc->flags |= SMALLJAC_CURVE_FLAG_DELTA;
+	}
+}
+
+/*
+	Processes a single prime p for a curve defined over Q (or at a degree-1 prime of a number field), making the appropriate callbacks.
+	The caller is responsible for prime filtering and for determining whether p is a prime of good reduction.
+	Returns 1 to continue, 0 if the callback function asked us to stop, and -1 for an internal error.
+*/
+int smalljac_Lpolys_Q_prime (smalljac_curve *sc, unsigned long p, int good, unsigned long flags,
+					    int (*callback)(smalljac_curve_t curve, unsigned long p, int good, long a[], int n, void *arg), void *arg)
+{
+	smalljac_curve_t curve = (smalljac_curve_t) sc;
+	mpz_t D;
+	unsigned long d;
+	int i, k, good_only;
+
+	good_only = (flags&SMALLJAC_GOOD_ONLY);
+	sc->q = p;
+	if ( ! good ) {
+		if ( good_only ) return 1;
+		if ( (sc->flags&SMALLJAC_CURVE_FLAG_WS) ) {
+			// sc->f holds curve in short ws form
+			mpz_init (D);
+			mpz_mul (D, sc->f[0], sc->f[1]);
+			mpz_mul_2exp (D, D, 1);
+			mpz_neg (D, D);
+			sc->a[0] = -mpz_kronecker_ui (D, p);		// at bad primes the Frobenius trace is (-2AB/p) for y^2=x^3+Ax+B
+			mpz_clear (D);
+			sc->n = 1;
+			if ( (sc->flags&SMALLJAC_GROUP) ) sc->a[0] += p;
+			return (*callback) (curve, p, 0, sc->a, sc->n, arg) ? 1 : 0;
+		}
+		return (*callback) (curve, p, 0, 0, 0, arg) ? 1 : 0;
+	}
+	k = 1;
+	if ( sc->nfd > 1 ) {
+		k = nf_poly_reduce_setup (sc->nfp, p, 1);
+		if ( ! k ) return 1;
+	}
+	// handle tiny primes separately
+	if ( p <= smalljac_tiny_p(sc->genus) ) {
+		sc->n = smalljac_tiny_Lpoly (sc->a, sc, p, flags);	// returns -1 for bad reduction but will still compute ap=-1,0,1 correctly for genus 1 curves in weierstrass form at 2 and 3
+		if ( sc->n < -1 ) return -1;
+		if ( sc->n < 0 ) {
+			if ( ! good_only ) if ( ! (*callback) (curve, p, 0, sc->a, (sc->genus == 1 ? 1 : 0), arg) ) return 0;
+			return 1;
+		}
+		if ( sc->genus==1 ) {
+			if ( (flags&SMALLJAC_LOW_ORDER) && sc->a[0] >= -1 ) return 1;
+			if ( (flags&SMALLJAC_PRIME_ORDER) && ! ui_is_prime(p+1+sc->a[0]) ) return 1;	// note a[0] is the negated trace of Frobenius
+		}
+		// callback once for each degree-1 prime
+		for ( i = 0 ; i < k ; i++ ) if ( ! (*callback) (curve, sc->q, 1, sc->a, sc->n, arg) ) return 0;
+		return 1;
+	}
+	// if only prime order groups are requested in genus=1, use Stickelberger to quickly rule out cases that must have a point of order 2
+	if ( (flags& SMALLJAC_PRIME_ORDER) && sc->genus==1 ) { d = mpz_fdiv_ui(sc->disc,p);  if ( ui_legendre(d,p) < 0 ) return 1; }
+	sc->n = smalljac_internal_Lpoly_Q (sc->a, sc, p, flags);
+	if ( sc->n == 0 ) return 1;																	// indicates this case is excluded by flag settings (e.g. non-prime group order)
+	if ( sc->n == -1 ) { if ( ! good_only ) if ( ! (*callback) (curve, sc->q, 0, sc->a, sc->n, arg) ) return 0; return 1; }	// currently this can never happen
+	if ( sc->n < -1 ) return -1;
+	// callback once for each degree-1 prime
+	for ( i = 0 ; i < k ; i++ ) if ( ! (*callback) (curve, sc->q, 1, sc->a, sc->n, arg) ) return 0;
+	return 1;
+}
+
 long smalljac_Lpolys (smalljac_curve_t curve, unsigned long start, unsigned long end, unsigned long flags,
 				   int (*callback)(smalljac_curve_t curve, unsigned long p, int good, long a[], int n, void *arg), void *arg)
 {
-	static mpz_t P, D;
 	static int init;
 	smalljac_curve *sc;
 	prime_enum_ctx_t *ctx;
 	unsigned long h[SMALLJAC_MAX_BAD_PRIMES], badp[SMALLJAC_MAX_BAD_PRIMES];
-	register unsigned long p, d, pbitmask, pbits;
+	register unsigned long p, pbitmask, pbits;
 	long window;
-	int e, i, k, filter, good, good_only,  error, badpi, badpk;
+	int e, i, k, filter, good, good_only,  error, badpi, badpk, sts;
 
-	if ( ! init ) { smalljac_init();  mpz_init (P);  mpz_init (D); init = 1; }
-	if ( (flags&SMALLJAC_A1_ONLY) && (flags&SMALLJAC_GROUP) ) return SMALLJAC_INVALID_FLAGS;
+	if ( ! init ) { smalljac_init();  init = 1; }
 	sc = (smalljac_curve *)curve;
 	if ( end < start || end > smalljac_curve_max_p(sc) ) { printf ("start=%lu, end=%lu, maxp=%lu\n", start, end, smalljac_max_p(sc->genus)); return SMALLJAC_INVALID_INTERVAL; }
-
-	if ( flags&SMALLJAC_GROUP && !(sc->degree&1) ) { err_printf ("Currently group computations are supported only for hyperelliptic curves of the form y^2=f(x) with deg f = 2g+1 odd\n"); return SMALLJAC_UNSUPPORTED_CURVE; }
-		
-	if ( sc->genus > SMALLJAC_GENUS && ! (flags&SMALLJAC_A1_ONLY) && ! sc->special ) { err_printf ("The SMALLJAC_A1_ONLY flag must be set for curves of genus %d (or change SMALLJAC_GENUS and recompile)\n", sc->genus); return SMALLJAC_UNSUPPORTED_CURVE; }
+	if ( (sts = smalljac_Lpolys_check_flags (sc, flags)) < 0 ) return sts;
+	if ( smalljac_store_eligible (sc, flags) ) return smalljac_store_Lpolys (sc, start, end, flags, callback, arg, smalljac_Lpolys);
 	
 	good_only = (flags&SMALLJAC_GOOD_ONLY);
 	filter = (flags&SMALLJAC_FILTER);
@@ -406,21 +516,14 @@ long smalljac_Lpolys (smalljac_curve_t curve, unsigned long start, unsigned long
 	pbitmask = (flags&SMALLJAC_SPLIT)>>SMALLJAC_SPLIT_SHIFT;
 	pbits = (flags&SMALLJAC_HIGH)>>SMALLJAC_HIGH_SHIFT;
 	
-	if ( sc->genus != 1 && flags&SMALLJAC_PRIME_ORDER ) { err_printf ("SMALLJAC_PRIME_ORDER flag only supported in genus 1\n");  return SMALLJAC_INVALID_FLAGS; }
 	/*
 		The standard (and most optimized) case is that we have a curve that is defined over Q, possibly being considered over a larger number field, but then only at degree-1 primes.
 		It suffices to compute the Lpoly in Fp (just once per p), and then make multiple callbacks to account for the number of degree-1 primes above p (exactly 1 in Q)
 		
-		The code below is a bit unpleasant (compare to the number field case, which is much cleaner) and should probably be re-worked at some point (much of the unpleasantness
-		has to do with trying to make the typical case (good reduction at a largish prime) as fast as possible, while still handling all the special cases.
+		The per-prime work is done by smalljac_Lpolys_Q_prime, which is shared with smalljac_curve_Lpoly and smalljac_Lpolys_list.
 	*/
 	if  ( sc->Qflag && (sc->nfd == 1 || (flags&SMALLJAC_DEGREE1_ONLY)) ) {
-		// Precompute delta values for pointcounting, if needed (but only when curve is defined over Q)
-		if ( (start <= smalljac_count_p(sc->genus) || sc->genus > 2) && ! (sc->flags&SMALLJAC_CURVE_FLAG_DELTA) ) {
-			smalljac_curve_init_Deltas(sc);
-			pointcount_precompute (sc->Deltas, sc->f, sc->degree);
-			sc->flags |= SMALLJAC_CURVE_FLAG_DELTA;
-		}
+		smalljac_Lpolys_Q_setup (sc, start);
 		
 		// If D is small, factor it to save time on bad reduction checks (but note that D is currently only used for curves over Q)
 		badpk = badpi = 0;
@@ -429,12 +532,11 @@ long smalljac_Lpolys (smalljac_curve_t curve, unsigned long start, unsigned long
 		badpi = 0;
 
 		error = 0;  window = 0;
-		// use fast prime enumeration (based on a wheeled sieve) in all cases (now supports up to 2^40, as of Feb 2010)
+		// use fast prime enumeration (based on a segmented sieve) in all cases (supports up to 2^44)
 		if ( sc->genus==1 && (flags & SMALLJAC_PRIME_ORDER) ) {
 			if ( flags&SMALLJAC_LOW_ORDER ) window = -2*sqrt(end);
 			else window = 4*sqrt(end);
 		}
-		k = 1;
 		ctx = fast_prime_enum_start_w (start, end, window);
 		while ( (p = fast_prime_enum(ctx)) ) {
 			if ( (p&pbitmask) != pbits ) continue;
@@ -446,53 +548,9 @@ long smalljac_Lpolys (smalljac_curve_t curve, unsigned long start, unsigned long
 			} else {
 				good = ! mpz_divisible_ui_p (sc->D,p);
 			}
-			if ( ! good ) {
-				if ( ! good_only ) {
-					if ( (sc->flags&SMALLJAC_CURVE_FLAG_WS) ) {
-						// sc->f holds curve in short ws form
-						mpz_mul (D, sc->f[0], sc->f[1]);
-						mpz_mul_2exp (D, D, 1);
-						mpz_neg (D, D);
-						sc->a[0] = -mpz_kronecker_ui (D, p);		// at bad primes the Frobenius trace is (-2AB/p) for y^2=x^3+Ax+B
-						sc->n = 1;
-						if ( (sc->flags&SMALLJAC_GROUP) ) sc->a[0] += p;
-						if ( ! (*callback) (curve, p, 0, sc->a, sc->n, arg) ) break;	
-					} else {
-						if ( ! (*callback) (curve, p, 0, 0, 0, arg) ) break;
-					}
-				}
-				continue;
-			}
-			if ( sc->nfd > 1 ) {
-				k = nf_poly_reduce_setup (sc->nfp, p, 1);
-				if ( ! k ) continue;
-			}
-			// handle tiny primes separately
-			if ( p <= smalljac_tiny_p(sc->genus) ) {
-				sc->n = smalljac_tiny_Lpoly (sc->a, sc, p, flags);	// returns -1 for bad reduction but will still compute ap=-1,0,1 correctly for genus 1 curves in weierstrass form at 2 and 3
-				if ( sc->n < -1 ) return SMALLJAC_INTERNAL_ERROR;
-				if ( sc->n < 0 ) {
-					if ( ! good_only ) if ( ! (*callback) (curve, p, 0, sc->a, (sc->genus == 1 ? 1 : 0), arg) ) break;
-					continue;
-				}
-				if ( sc->genus==1 ) {
-					if ( (flags&SMALLJAC_LOW_ORDER) && sc->a[0] >= -1 ) continue;
-					if ( (flags&SMALLJAC_PRIME_ORDER) && ! ui_is_prime(p+1+sc->a[0]) ) continue;	// note a[0] is the negated trace of Frobenius
-				}
-				// callback once for each degree-1 prime
-				for ( i = 0 ; i < k ; i++ ) if ( ! (*callback) (curve, sc->q, 1, sc->a, sc->n, arg) ) break;
-				if ( i < k ) break;
-				continue;
-			}
-			// if only prime order groups are requested in genus=1, use Stickelberger to quickly rule out cases that must have a point of order 2
-			if ( (flags& SMALLJAC_PRIME_ORDER) && sc->genus==1 ) { d = mpz_fdiv_ui(sc->disc,p);  if ( ui_legendre(d,p) < 0 ) continue; }
-			sc->n = smalljac_internal_Lpoly_Q (sc->a, sc, p, flags);
-			if ( sc->n == 0 ) continue;																	// indicates this case is excluded by flag settings (e.g. non-prime group order)
-			if ( sc->n == -1 ) { if ( ! good_only ) if ( ! (*callback) (curve, sc->q, 0, sc->a, sc->n, arg) ) break; continue; }	// currently this can never happen
-			if ( sc->n < -1 ) { error = 1;  break; }
-			// callback once for each degree-1 prime
-			for ( i = 0 ; i < k ; i++ ) if ( ! (*callback) (curve, sc->q, 1, sc->a, sc->n, arg) ) break;
-			if ( i < k ) break;
+			sts = smalljac_Lpolys_Q_prime (sc, p, good, flags, callback, arg);
+			if ( sts < 0 ) { error = 1;  break; }
+			if ( ! sts ) break;
 		}
 		fast_prime_enum_end (ctx);
 		if ( ! p ) p = end;
@@ -563,6 +621,87 @@ long smalljac_Lpolys (smalljac_curve_t curve, unsigned long start, unsigned long
 	err_printf ("Fell through to unhandled case in smalljac_Lpolys sc->Qflag=%d, sc->nfd=%d, flags=%lx!\n", sc->Qflag, sc->nfd, flags); abort();
 }
 
+/*
+	Computes L_q(T) (or the group structure) for an existing curve over Q at a single prime (or prime power) q.  Unlike smalljac_Lpoly this does not
+	reparse the curve or allocate anything, and the precomputation done for the curve (e.g. Delta values for pointcounting) is retained for subsequent calls.
+	If the result cache is enabled (see smalljac_cache_enable) it is consulted before doing any computation.
+*/
+int smalljac_curve_Lpoly (long a[], smalljac_curve_t curve, unsigned long q, unsigned long flags)
+{
+	mpz_t P;
+	smalljac_curve *sc;
+	unsigned long p;
+	long b[2*SMALLJAC_MAX_GENUS+1];
+	int i, h, n, sts;
+
+	if ( ! _smalljac_initted ) smalljac_init();
+	sc = (smalljac_curve *)curve;
+	if ( ! sc->Qflag ) return SMALLJAC_NOT_OVER_Q;
+	if ( sc->nfd > 1 && ! (flags&SMALLJAC_DEGREE1_ONLY) ) return SMALLJAC_INVALID_FLAGS;
+
+	mpz_init (P);
+	mpz_set_ui (P, q);
+	h = mpz_pp_base (P, P);
+	p = mpz_get_ui (P);
+	mpz_clear (P);
+		
+	if ( ! h ) return SMALLJAC_INVALID_PP;
+	if ( h > 1 ) {
+		if ( (flags&SMALLJAC_GROUP) ) return SMALLJAC_INVALID_PP;			// group computation is currently supported only for prime fields
+		if ( sc->genus > 1 ) return SMALLJAC_INVALID_PP;					// smalljac_Lpoly_extend currently only handles the trace
+		if ( (flags&SMALLJAC_A1_ONLY) ) flags &= ~SMALLJAC_A1_ONLY; 		// turn off A1_ONLY flag if q is a prime power
+	}
+	if ( p > smalljac_curve_max_p(sc) && ! sc->special ) return SMALLJAC_INVALID_PP;
+	if ( (sts = smalljac_Lpolys_check_flags (sc, flags)) < 0 ) return sts;
+
+	if ( smalljac_cache_enabled() && smalljac_cache_lookup (a, &n, sc, q, flags) ) return n;
+
+	smalljac_Lpolys_Q_setup (sc, p);
+	b[0] = 0;
+	sts = smalljac_Lpolys_Q_prime (sc, p, ! mpz_divisible_ui_p (sc->D,p), flags, smalljac_Lpoly_callback, b);
+	if ( sts < 0 ) { printf ("smalljac internal error at p=%lu\n", p);  return SMALLJAC_INTERNAL_ERROR; }
+	n = b[0];
+	for ( i = 0 ; i < n ; i++ ) a[i] = b[i+1];
+	
+	if ( n && h > 1 )  if ( ! smalljac_Lpoly_extend (a, n, p, h) ) return SMALLJAC_INTERNAL_ERROR;
+	if ( smalljac_cache_enabled() ) smalljac_cache_store (sc, q, flags, a, n);
+	return n;
+}
+
+/*
+	Same as smalljac_Lpolys, except that only the primes in the list primes[0],...,primes[n-1] are processed.  The list must be sorted in increasing order
+	and its entries must be primes (this is not verified).  The split/high flags are ignored (the caller controls partitioning via the list), SMALLJAC_FILTER
+	is still honored.  Currently only supported for curves defined over Q (or at degree-1 primes).
+	Returns the last prime processed, or a negative error code.
+*/
+long smalljac_Lpolys_list (smalljac_curve_t curve, unsigned long primes[], long n,  unsigned long flags,
+					 int (*callback)(smalljac_curve_t curve, unsigned long p, int good, long a[], int n, void *arg), void *arg)
+{
+	smalljac_curve *sc;
+	register unsigned long p;
+	register long i;
+	int sts;
+
+	if ( ! _smalljac_initted ) smalljac_init();
+	sc = (smalljac_curve *)curve;
+	if ( n <= 0 ) return 0;
+	for ( i = 1 ; i < n ; i++ ) if ( primes[i] <= primes[i-1] ) { err_printf ("smalljac_Lpolys_list: prime list is not sorted (%lu <= %lu)\n", primes[i], primes[i-1]);  return SMALLJAC_INVALID_INTERVAL; }
+	if ( primes[0] < 2 || primes[n-1] > smalljac_curve_max_p(sc) ) return SMALLJAC_INVALID_INTERVAL;
+	if ( ! sc->Qflag ) return SMALLJAC_NOT_OVER_Q;
+	if ( sc->nfd > 1 && ! (flags&SMALLJAC_DEGREE1_ONLY) ) { err_printf ("smalljac_Lpolys_list: SMALLJAC_DEGREE1_ONLY flag must be set for curves over number fields\n");  return SMALLJAC_INVALID_FLAGS; }
+	if ( (sts = smalljac_Lpolys_check_flags (sc, flags)) < 0 ) return sts;
+
+	smalljac_Lpolys_Q_setup (sc, primes[0]);
+	for ( i = 0 ; i < n ; i++ ) {
+		p = primes[i];
+		if ( (flags&SMALLJAC_FILTER) && ! (*callback) (curve, p, -1, 0, 0, arg) ) continue;
+		sts = smalljac_Lpolys_Q_prime (sc, p, ! mpz_divisible_ui_p (sc->D,p), flags, callback, arg);
+		if ( sts < 0 ) { printf ("smalljac internal error at p=%lu\n", p);  return SMALLJAC_INTERNAL_ERROR; }
+		if ( ! sts ) break;
+	}
+	return (long) ( i < n ? primes[i] : primes[n-1] );
+}
+
 /*
 	The following convention applies to the return value n of all the smalljac_*_Lpoly_* functions:
 
@@ -789,7 +928,7 @@ unsigned long smalljac_pointcount_modp (smalljac_curve *sc,  long p)
 int smalljac_generic_Lpoly (long a[], hc_poly *c, long pts, unsigned long flags)
 {
 	hc_poly twist;
-	unsigned long Min, Max;
+	unsigned long Min, Max, TMin, TMax;
 	unsigned long e, te, P1, PN1;
 	unsigned long m;
 	long a1, d, tcon, p;
@@ -839,11 +978,17 @@ int smalljac_generic_Lpoly (long a[], hc_poly *c, long pts, unsigned long flags)
 			return 2;
 		} else {
 			if ( ! smalljac_genus2_charpoly_from_P1 (a, P1, Min, Max, c) ) {
-				// If we can't deduce the charpoly from P1 (very rare) go ahead and compute PN1 from scratch
-				// This is a bit silly, since we know the value of PN1 mod 2(p+1) and could use this knowledge to speed things up,
-				// but it happens so rarely that we don't bother
+				// If we can't deduce the charpoly from P1 (rare, but not on every family) compute PN1 directly.  We know that
+				// PN1 = P1 - 2(p+1)a1 with |a1| bounded as in smalljac_genus2_charpoly_from_P1, so rather than searching the whole
+				// Weil interval we only search the O(p) interval of compatible twist orders, and constrain PN1 = P1 mod 2(p+1).
 				hc_poly_twist (&twist, c);
-				k = jac_order (&PN1, Min, Max, JAC_INVALID_A1, 0, 0, 0, &twist);
+				m = 2*(p+1);
+				tcon = ((long)P1 - (long)(p*p+1) + 6*p)/(p+1) + 1;							// upper bound on a1 (plus one for safety)
+				TMin = ( (long)P1 - (long)m*tcon > (long)Min ? (unsigned long)((long)P1 - (long)m*tcon) : Min );
+				tcon = ((long)P1 - (long)(p*p+1) - 6*p)/(p+1) - 1;							// lower bound on a1 (minus one for safety)
+				TMax = ( (long)P1 - (long)m*tcon < (long)Max ? (unsigned long)((long)P1 - (long)m*tcon) : Max );
+				constraints[0] = (int)(P1 % m);  constraints[1] = -1;
+				k = jac_order (&PN1, TMin, TMax, JAC_INVALID_A1, 0, 0, constraints, &twist);
 				if ( k <= 0 ) { printf ("%lu: Attempted twist order computation failed\n", p);  return -2; }
 				if ( k > 1 ) { printf ("%lu: Ambiguous result in genus 2 not handled\n", p);  return -2; }		// should be impossible
 				if ( ! smalljac_genus2_charpoly (a, p, x, P1, PN1) ) { err_printf ("%lu: smalljac_genus2_charpoly failed\n", p);  return -2; }
@@ -121,6 +121,7 @@ static inline int smalljac_count_p (int g)		// primes below count_p will use poi
 #define SMALLJAC_BADFILE				-10			// bad file format
 #define SMALLJAC_NODATA				-11			// requested data not present in file
 #define SMALLJAC_NOT_OVER_Q			-12			// specified curve is not defined over Q
+#define SMALLJAC_WRITE_ERROR			-13			// error creating or writing an output file
 
 #define SMALLJAC_CURVE_STRING_LEN		1024
 
@@ -160,13 +161,80 @@ long smalljac_Lpolys (smalljac_curve_t c,					// curve created via smalljac_Qcur
                                       void *arg),						// forwarded arg from caller
                      void *arg);								// pass-through arg uninterpreted by smalljac
 
+// Same as smalljac_Lpolys but only processes the primes in primes[0..n-1], which must be sorted in increasing order (need not be an interval).
+// The SPLIT/HIGH flags are ignored.  Currently only supported for curves defined over Q (or at degree-1 primes).
+long smalljac_Lpolys_list (smalljac_curve_t c, unsigned long primes[], long n, unsigned long flags,
+					 int (*callback)(smalljac_curve_t c, unsigned long q, int good, long a[], int n, void *arg), void *arg);
+
+// Prime sets restrict smalljac_Lpolys_set to a precomputed set of primes, avoiding a SMALLJAC_FILTER callback for every prime in the interval.
+// A prime set is a sorted list of primes, a bitmap over [start,end] (bit i of bm set iff start+i is in the set), or a union of residue classes mod m
+// (the class test is compiled into a bitmap once).  List entries and bitmap bits are assumed to be primes (not verified).  The data is copied.
+#define SMALLJAC_PRIME_SET_MAX_MODULUS	(1UL<<26)
+typedef void *smalljac_prime_set_t;
+smalljac_prime_set_t smalljac_prime_set_list (unsigned long primes[], long n);
+smalljac_prime_set_t smalljac_prime_set_bitmap (unsigned long bm[], unsigned long start, unsigned long end);
+smalljac_prime_set_t smalljac_prime_set_residues (unsigned long m, unsigned long r[], int k);			// primes p with p mod m in {r[0],...,r[k-1]}
+int smalljac_prime_set_contains (smalljac_prime_set_t S, unsigned long p);
+void smalljac_prime_set_clear (smalljac_prime_set_t S);
+
+// Same as smalljac_Lpolys but only processes primes in [start,end] that lie in S (SPLIT/HIGH and FILTER flags are honored)
+// Currently only supported for curves defined over Q (or at degree-1 primes).
+long smalljac_Lpolys_set (smalljac_curve_t c, unsigned long start, unsigned long end, smalljac_prime_set_t S, unsigned long flags,
+				      int (*callback)(smalljac_curve_t c, unsigned long q, int good, long a[], int n, void *arg), void *arg);
+
 // simulates smalljac_Lpolys using data file pre-computed using the lpdata program - note that the data is NOT VALIDATED in any way
 long smalljac_Lpolys_from_file (char *filename, unsigned long start, unsigned long end, unsigned long flags,
 						int (*callback)(smalljac_curve_t curve, unsigned long q, int good, long a[], int n, void *arg), void *arg);
 // handles multiple files of the form sprintf("%s_%d_%d.txt", prefix, jobs, jobid), where jobid ranges from 0 to jobs-1
+// (binary files named with the suffix .lpd in place of .txt are used when present, as are compressed text files with the suffix .txt.gz)
 long smalljac_Lpolys_from_files (char *prefix, int jobs, unsigned long start, unsigned long end, unsigned long flags,
 						 int (*callback)(smalljac_curve_t curve, unsigned long q, int good, long a[], int n, void *arg), void *arg);
 
+// Binary L-poly data files (see smalljac_lpfile.c).  These are written in norm order, one record per callback, and support O(log n) seeks.
+// smalljac_Lpolys_from_file(s) automatically recognize binary (and gzip compressed) files, so they can be used in place of text files written by lpdata.
+// smalljac_lpfile_open also accepts text files (which are then parsed in place), in which case n and records are reported as 0 (unknown),
+// and smalljac_lpfile_next returns the number of coefficients present on each line.
+typedef void *smalljac_lpfile_t;
+smalljac_lpfile_t smalljac_lpfile_create (char *filename, char *curve, unsigned long start, unsigned long end, int genus, int n);	// n = 1 or genus coefficients per record
+int smalljac_lpfile_append (smalljac_lpfile_t F, unsigned long q, int good, long a[], int n);			// returns 0 on error, norms must be nondecreasing
+smalljac_lpfile_t smalljac_lpfile_open (char *filename);											// returns null if filename is not a valid data file
+void smalljac_lpfile_info (smalljac_lpfile_t F, char **curve, unsigned long *start, unsigned long *end, int *genus, int *n, unsigned long *records);	// pointers may be null
+void smalljac_lpfile_seek (smalljac_lpfile_t F, unsigned long q);									// next record read will be the first with norm >= q
+int smalljac_lpfile_next (smalljac_lpfile_t F, unsigned long *q, long a[]);							// returns n (good), 0 (bad), -1 (end of file), or -2 (corrupt data)
+int smalljac_lpfile_close (smalljac_lpfile_t F);												// returns 0 if an error occurred writing the file
+
+// Columnar data files (see smalljac_colfile.c), for export to columnar analysis tools.  Records are stored in chunks, one column per field
+// (curve id, q, good, and n values a1..an or m0..m(n-1)), with min/max statistics for each column chunk.  A file may hold data for many curves.
+#define SMALLJAC_COLFILE_COMPRESS		1			// delta/varint encode column chunks (otherwise they are plain 64-bit integers)
+#define SMALLJAC_COLFILE_GROUPS		2			// value columns hold group invariants m0,...,m(n-1) rather than L-poly coefficients a1,...,an
+#define SMALLJAC_COLFILE_CURVE_COL		0			// column indices
+#define SMALLJAC_COLFILE_Q_COL			1
+#define SMALLJAC_COLFILE_GOOD_COL		2
+#define SMALLJAC_COLFILE_VALUE_COL		3			// first value column
+#define SMALLJAC_COLFILE_MAX_CHUNK		65536		// max rows per chunk
+typedef void *smalljac_colfile_t;
+smalljac_colfile_t smalljac_colfile_create (char *filename, int n, int flags);							// n value columns
+long smalljac_colfile_curve (smalljac_colfile_t F, char *curve);										// subsequent records are for this curve, returns its id
+int smalljac_colfile_append (smalljac_colfile_t F, unsigned long q, int good, long a[], int n);			// returns 0 on error
+int smalljac_colfile_callback (smalljac_curve_t curve, unsigned long q, int good, long a[], int n, void *arg);	// use with arg = F, calls smalljac_colfile_curve when curve changes
+smalljac_colfile_t smalljac_colfile_open (char *filename);											// returns null if filename is not a valid columnar file
+void smalljac_colfile_info (smalljac_colfile_t F, int *n, int *flags, unsigned long *rows, unsigned long *chunks, unsigned long *curves);	// pointers may be null
+char *smalljac_colfile_curve_string (smalljac_colfile_t F, unsigned long id);
+char *smalljac_colfile_column_name (smalljac_colfile_t F, int col);
+long smalljac_colfile_chunk_stats (smalljac_colfile_t F, unsigned long k, int col, long *min, long *max);	// returns rows in chunk k (-1 if invalid)
+long smalljac_colfile_read (smalljac_colfile_t F, unsigned long k, int col, long values[]);				// decodes a column chunk, returns rows (-1 if invalid)
+int smalljac_colfile_close (smalljac_colfile_t F);												// returns 0 if an error occurred writing the file
+
+// Buffered (and optionally compressed) output for data files (see smalljac_writer.c).  Text records are formatted without stdio, and with
+// SMALLJAC_WRITER_COMPRESS the file is written as a sequence of independent gzip members (readable by zcat and smalljac_lpfile_open)
+// that are compressed by background processes.
+#define SMALLJAC_WRITER_COMPRESS		1
+typedef void *smalljac_writer_t;
+smalljac_writer_t smalljac_writer_create (char *filename, int flags, int threads);						// threads = background compression processes, -1 for default
+int smalljac_writer_write (smalljac_writer_t W, void *data, unsigned long len);							// returns 0 on error
+int smalljac_writer_lpoly (smalljac_writer_t W, unsigned long q, int good, long a[], int n);				// writes "q,a_1,...,a_n" or "q,?", returns 0 on error
+int smalljac_writer_close (smalljac_writer_t W);												// returns 0 if an error occurred writing the file
+
 // counts project points over F_p^n for curves defined over Q, assumes good reduction but does not actually verify this, results are undefined in the bad reduction case
 long smalljac_curve_points (smalljac_curve_t c, unsigned long p, int n);
 
@@ -185,12 +253,36 @@ static inline long smalljac_groups (smalljac_curve_t curve, unsigned long start,
 // Returns the number of coefficients computed (1 or g), 0 for bad reduction, or a negative error code
 int smalljac_Lpoly (long a[], char *curve_str, unsigned long p, unsigned long flags);
     
+// Same as smalljac_Lpoly but for an existing curve, avoids reparsing/reallocating and reuses precomputed data (use this for repeated queries on the same curve)
+// Prime powers q=p^h with h > 1 are currently only supported in genus 1.
+int smalljac_curve_Lpoly (long a[], smalljac_curve_t c, unsigned long q, unsigned long flags);
+
 // One shot version for computing a single group structure.  Computes m[0],...,m[n-1] s.t.
 // J(C/F_q) is isomorphic to Z_m[0] x ... x Z_m[r] with m[0] | m[1] | ... | m[n-1], where 1 <= n <= 2g.
 // Returns n, the number of invariant factors, 0 for bad reduction, or a negative error code
 // Currently q must be prime, the curve must be defined over Q, and no flag values are used.
 static inline int smalljac_group (long m[], char *curve_str, unsigned long q, unsigned long flags)
     { return smalljac_Lpoly (m, curve_str, q, flags|SMALLJAC_GROUP); }
+
+// Optional result cache for smalljac_Lpoly and smalljac_group (disabled by default).  Results are keyed by the canonical model of the curve,
+// the prime power q, and the relevant flag bits (curves with very large coefficients are not cached).  entries is the capacity of the in-memory
+// LRU table (0 for the default).  If filename is non-null the LRU table is backed by a memory-mapped hash table stored in the specified file,
+// which is created with file_slots entries (0 for the default, each entry takes 280 bytes) if it does not already exist.  The file may be shared
+// by concurrent processes.  Returns 1 on success, 0 on failure (in which case caching is disabled).
+#define SMALLJAC_CACHE_DEFAULT_ENTRIES		(1<<16)
+#define SMALLJAC_CACHE_DEFAULT_FILE_SLOTS	(1<<18)
+int smalljac_cache_enable (unsigned long entries, char *filename, unsigned long file_slots);
+void smalljac_cache_disable (void);
+void smalljac_cache_stats (unsigned long *hits, unsigned long *misses, unsigned long *disk_hits);	// any of the pointers may be null
+
+// Optional L-series store for smalljac_Lpolys and smalljac_parallel_Lpolys (disabled by default).  The store is a directory (which may be shared
+// by many processes and machines) of binary data files holding L-poly data over prime ranges, keyed by the canonical model of the curve.
+// Requests read whatever part of [start,end] is already stored and only compute (and store) the rest.  The store is enabled by calling
+// smalljac_store_enable, or by setting the environment variable SMALLJAC_STORE to the directory.  It only handles curves over Q, and
+// requests with flags other than SMALLJAC_GOOD_ONLY, SMALLJAC_A1_ONLY, and SMALLJAC_DEGREE1_ONLY bypass it.
+int smalljac_store_enable (char *dir);												// creates dir if needed, returns 0 on failure
+void smalljac_store_disable (void);
+void smalljac_store_stats (unsigned long *stored, unsigned long *computed);							// number of records read from the store and computed
     
 // Computes moments E[a_i^k] for 0 <= i < n and 0 <= k < m of normalized a_i coefficients over primes in [start,end]
 // moments should contain space for n*m entries -- the moment for a_i^k will go in the (m*i)+k entry (note 0th moments are set to 1)
@@ -199,6 +291,50 @@ static inline int smalljac_group (long m[], char *curve_str, unsigned long q, un
 int smalljac_moments (smalljac_curve_t curve, unsigned long start, unsigned long end, double moments[], int n, int m,
 				    char STgroup[16], int (*filter_callback)(smalljac_curve_t curve, unsigned long q, void *arg), void *arg);
 
+// Same as smalljac_moments but restricted to primes in the prime set S (if S is null this is identical to smalljac_moments)
+int smalljac_moments_set (smalljac_curve_t curve, unsigned long start, unsigned long end, smalljac_prime_set_t S, double moments[], int n, int m,
+				    char STgroup[16], int (*filter_callback)(smalljac_curve_t curve, unsigned long q, void *arg), void *arg);
+
+// Same as smalljac_moments (without filtering) but using the precomputed data in filename (text or binary), which is scanned in parallel
+// by smalljac_Lpolys_reduce_file.  Returns the number of records used, or an error code.
+long smalljac_moments_file (char *filename, unsigned long start, unsigned long end, double moments[], int n, int m, char STgroup[16]);
+
+// Mestre-Nagao sums for ranking elliptic curves over Q by (heuristic) rank (see smalljac_nagao.c).  For a bound N the sums are taken over good primes p <= N:
+//	S_1 = sum (1-(p-1)/#E(F_p)) log p				(Nagao)
+//	S_2 = -(1/N) sum a_p log p					(tends to r - 1/2, under GRH and assuming it converges, the -1/2 comes from the prime squares)
+//	S_3 = -(1/log N) sum a_p log p / p				(also tends to r - 1/2, by partial summation from S_2)
+//	S_4 = sum log(#E(F_p)/p)						(Mestre, the log of prod #E(F_p)/p)
+//	S_5 = -sum a_p / p							(heuristically (r - 1/2) log log N)
+//	S_6 = -(average of a_p/sqrt(p))					(the bias of the normalized traces)
+// All the sums are oriented so that larger values suggest higher rank.
+#define SMALLJAC_NAGAO_SUMS			6
+#define SMALLJAC_NAGAO_S1			0x01
+#define SMALLJAC_NAGAO_S2			0x02
+#define SMALLJAC_NAGAO_S3			0x04
+#define SMALLJAC_NAGAO_S4			0x08
+#define SMALLJAC_NAGAO_S5			0x10
+#define SMALLJAC_NAGAO_S6			0x20
+#define SMALLJAC_NAGAO_ALL			0x3F
+
+// Computes the sums selected by the bitmap sums for the curves specified by the strings curves[0],...,curves[k-1] (in parallel when multiple cores are available).
+// S_j for curve i goes in S[SMALLJAC_NAGAO_SUMS*i+j-1] (unselected sums are set to 0) and last[i] is set to the bound N used (0 if the curve is invalid or not supported).
+// If checkpoint is nonzero, at the first prime p >= start+checkpoint, start+2*checkpoint, start+4*checkpoint, ..., a curve whose sum S_stop (for the bound p) is below
+// threshold is dropped, in which case last[i] = p (a curve dropped at p = end has last[i] = end and S_stop < threshold).  Returns the number of curves
+// that reached end without being dropped, or an error code.
+long smalljac_nagao_sums (char *curves[], long k, unsigned long start, unsigned long end, int sums, double S[], unsigned long last[],
+				         unsigned long checkpoint, int stop, double threshold);
+
+// Computes the sums selected by sums for the single curve whose L-poly data is in filename (text or binary), scanned in parallel by smalljac_Lpolys_reduce_file,
+// with S_j in S[j-1].  The bound N is end (or the end of the data in the file, if smaller).  Returns N, or an error code.
+long smalljac_nagao_sums_file (char *filename, unsigned long start, unsigned long end, int sums, double S[SMALLJAC_NAGAO_SUMS]);
+
+// Computes an upper bound on the analytic rank r of an elliptic curve E/Q specified in Weierstrass form (with a minimal model), assuming GRH, via the Weil explicit formula
+// (see smalljac_rank.c).  The test function is (sin(t log(X)/2)/(t log(X)/2))^2, whose Fourier transform is supported on [-log X, log X], so only a_p for p <= X are needed.
+// The bound converges to r (from above) roughly like (log N)/log X.  If N is nonzero it is used as the conductor, otherwise the conductor is derived from
+// the discriminant and the reduction type at each bad prime.  If logN is non-null it is set to the log of the conductor used.
+// Returns 1 if the conductor used is exact, 0 if it is an upper bound (in which case the rank bound is still valid), or an error code.
+int smalljac_analytic_rank_bound (smalljac_curve_t curve, unsigned long N, unsigned long X, double *bound, double *logN);
+
 // returns the ST group name for the specified genus and index in [0,SMALLJAC_Gx_ST_GROUPS)
 int smalljac_STgroup (char STgroup[16], int genus, int index);
     
@@ -225,10 +361,38 @@ int smalljac_lookup_g2_STgroup (char STgroup[16], double z1, double z2[5], doubl
 
 long smalljac_parallel_Lpolys (smalljac_curve_t curve, unsigned long start, unsigned long end, unsigned long flags, int (*callback)(smalljac_curve_t curve, unsigned long q, int good, long m[], int n, void *arg), void *arg);
 
+long smalljac_parallel_Lpolys_set (smalljac_curve_t curve, unsigned long start, unsigned long end, smalljac_prime_set_t S, unsigned long flags, int (*callback)(smalljac_curve_t curve, unsigned long q, int good, long m[], int n, void *arg), void *arg);
+
 static inline long smalljac_parallel_groups (smalljac_curve_t curve, unsigned long start, unsigned long end, unsigned long flags, int (*callback)(smalljac_curve_t curve, unsigned long q, int good, long m[], int n, void *arg), void *arg) {
 	return smalljac_parallel_Lpolys(curve, start, end, flags|SMALLJAC_GROUP, callback, arg);
 }
 
+// Parallel scans of precomputed data files (text or binary) for statistics that do not depend on the order in which records are seen.
+// The records are split into chunks that are processed by child processes, each of which makes callbacks (as smalljac_Lpolys_from_file would)
+// on its own copy of the state_size bytes at state, and merge(state,child_state) is then called in the parent once for each child.
+// state must be initialized to an identity for merge and must not contain pointers (it is copied through a pipe).
+// If the callback returns 0 the process that made it stops (other processes continue).  Returns the number of records processed, or an error code.
+// The number of child processes used by these and the other parallel functions is the number of online cores (or the value of the environment variable
+// SMALLJAC_THREADS, if set), rounded down to a power of 2.  With a single process the callbacks are made on state directly and merge is not called.
+long smalljac_Lpolys_reduce_file (char *filename, unsigned long start, unsigned long end, unsigned long flags,
+						 int (*callback)(smalljac_curve_t curve, unsigned long q, int good, long a[], int n, void *state),
+						 void *state, unsigned long state_size, void (*merge)(void *state, void *child_state));
+long smalljac_Lpolys_reduce_files (char *prefix, int jobs, unsigned long start, unsigned long end, unsigned long flags,
+						  int (*callback)(smalljac_curve_t curve, unsigned long q, int good, long a[], int n, void *state),
+						  void *state, unsigned long state_size, void (*merge)(void *state, void *child_state));
+
+// Resharding of data sets (see smalljac_reshard.c).  Reads the files prefix_injobs_i.lpd/.txt/.txt.gz (as written by lpdata with the specified
+// number of jobs, or the single file prefix if injobs = 0) and writes the same records as outprefix_outjobs_j.ext (or outprefix.ext if outjobs = 0),
+// partitioned as lpdata partitions jobs, so the output can be read by smalljac_Lpolys_from_files (except in columnar format).
+// Job counts must be 0 or powers of 2.  For curves over Q every output file is verified to contain a record for every good prime in its share of [start,end].
+// start = end = 0 uses the range of the input.  Only the flags SMALLJAC_GOOD_ONLY and SMALLJAC_A1_ONLY are supported.
+// Returns the number of records written, or an error code.
+#define SMALLJAC_FORMAT_TEXT			0			// .txt
+#define SMALLJAC_FORMAT_GZIP			1			// .txt.gz (see smalljac_writer_create)
+#define SMALLJAC_FORMAT_BINARY		2			// .lpd (see smalljac_lpfile_create)
+#define SMALLJAC_FORMAT_COLUMNAR		3			// .lpc (see smalljac_colfile_create)
+long smalljac_reshard (char *prefix, int injobs, char *outprefix, int outjobs, int format, unsigned long start, unsigned long end, unsigned long flags);
+
 
 #ifdef __cplusplus
 }
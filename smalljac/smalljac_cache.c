@@ -0,0 +1,359 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <gmp.h>
+#include "smalljac.h"
+#include "smalljac_internal.h"
+#include "cstd.h"
+
+/*
+    Copyright (c) 2026 The smalljac contributors
+    See LICENSE file for license details.
+*/
+
+/*
+	Result cache for smalljac_Lpoly and smalljac_group (disabled by default, see smalljac_cache_enable).
+
+	Results are keyed by the canonical model of the curve (the integer coefficients of y^2=f(x) obtained after
+	normalization, together with the curve discriminant D, so that different presentations of the same model share
+	entries), the prime power q, and the flag bits that affect the result.  Entries are located using a 64-bit hash
+	of the model, but each entry also holds the model itself, which is compared on lookup, so a hash collision is
+	just a miss.  Curves whose canonical model does not fit in SMALLJAC_CACHE_MAX_MODEL bytes are not cached.
+
+	The first level is an in-memory LRU table of fixed capacity.  The optional second level is a file of fixed
+	size holding an open addressed hash table that is memory mapped (shared) so that it persists across processes
+	and can be used by several processes concurrently.  Entries in the file carry a check value computed over the
+	entire entry.  Readers copy an entry before validating it, so a reader that races with a writer sees a check
+	value that does not match its copy and simply treats it as a miss.
+*/
+
+#define SMALLJAC_CACHE_MAX_N			6							// max number of coefficients/invariant factors stored per entry (covers genus <= 3 Lpolys and genus 2 groups)
+#define SMALLJAC_CACHE_MAX_MODEL		192							// max size in bytes of the canonical model stored in each entry (must be a multiple of 8)
+#define SMALLJAC_CACHE_FILE_MAGIC		0x32484341434a53UL			// "SJCACH2"
+#define SMALLJAC_CACHE_FILE_PROBES		8							// number of slots to probe in the file table before giving up (on insert the last one is overwritten)
+#define SMALLJAC_CACHE_NIL				0xFFFFFFFFU
+
+// flag bits that do not affect the value returned by smalljac_Lpoly
+#define SMALLJAC_CACHE_IGNORED_FLAGS	(SMALLJAC_GOOD_ONLY|SMALLJAC_SPLIT|SMALLJAC_HIGH|SMALLJAC_FILTER)
+
+struct smalljac_cache_entry {
+	uint64_t key;
+	uint64_t q;
+	uint32_t flags;
+	int32_t n;
+	int64_t a[SMALLJAC_CACHE_MAX_N];
+	uint32_t mlen, reserved;
+	unsigned char model[SMALLJAC_CACHE_MAX_MODEL];				// canonical model of the curve (see _sjc_model), zero padded
+	uint64_t check;											// only used in the file table
+};
+
+struct smalljac_cache_file_header {
+	uint64_t magic;
+	uint64_t slots;												// always a power of 2
+	uint64_t entry_size;
+	uint64_t reserved;
+};
+
+struct smalljac_cache_node {
+	struct smalljac_cache_entry e;
+	uint32_t prev, next;										// LRU list (most recently used at head)
+	uint32_t chain;											// hash chain
+};
+
+static struct smalljac_cache_state {
+	struct smalljac_cache_node *nodes;
+	uint32_t *buckets;
+	uint32_t size, used, head, tail;
+	uint64_t bmask;
+	struct smalljac_cache_file_header *map;						// null if no file backing
+	struct smalljac_cache_entry *slots;
+	size_t map_len;
+	unsigned long hits, misses, disk_hits;
+} _sjc;
+
+static inline uint64_t _sjc_mix (uint64_t h, uint64_t x)
+	{ h ^= x;  h *= 0x9E3779B97F4A7C15UL;  h ^= h >> 29;  return h; }
+
+static inline uint64_t _sjc_mix_mpz (uint64_t h, mpz_t z)
+{
+	register long i, n;
+
+	n = mpz_size(z);
+	h = _sjc_mix (h, (uint64_t) mpz_sgn(z));
+	for ( i = 0 ; i < n ; i++ ) h = _sjc_mix (h, mpz_getlimbn(z,i));
+	return h;
+}
+
+static inline uint64_t _sjc_bucket (uint64_t key, uint64_t q)
+	{ return _sjc_mix (key, q); }
+
+static inline uint64_t _sjc_check (struct smalljac_cache_entry *e)
+{
+	register uint64_t h;
+	uint64_t w;
+	register int i;
+
+	h = _sjc_mix (_sjc_mix (e->key, e->q), ((uint64_t)e->flags<<32) | (uint32_t)e->n);
+	for ( i = 0 ; i < SMALLJAC_CACHE_MAX_N ; i++ ) h = _sjc_mix (h, (uint64_t)e->a[i]);
+	h = _sjc_mix (h, e->mlen);
+	for ( i = 0 ; i < SMALLJAC_CACHE_MAX_MODEL ; i += 8 ) { memcpy (&w, e->model+i, 8);  h = _sjc_mix (h, w); }
+	return h | 1;												// zero check value marks an empty (or in progress) slot
+}
+
+// returns 1 if e holds the result for the curve, q, and flags specified in x
+static inline int _sjc_match (struct smalljac_cache_entry *e, struct smalljac_cache_entry *x)
+	{ return e->key == x->key && e->q == x->q && e->flags == x->flags && e->mlen == x->mlen && ! memcmp (e->model, x->model, x->mlen); }
+
+// appends z to the model in b[0..len-1] as a sign byte, a 2-byte length, and the absolute value in big-endian order, returns the new length or 0 if it does not fit
+static int _sjc_model_mpz (unsigned char b[SMALLJAC_CACHE_MAX_MODEL], int len, mpz_t z)
+{
+	size_t bytes;
+
+	bytes = ( mpz_sgn(z) ? (mpz_sizeinbase(z,2)+7)/8 : 0 );
+	if ( len+3+bytes > SMALLJAC_CACHE_MAX_MODEL ) return 0;
+	b[len] = mpz_sgn(z)+1;  b[len+1] = bytes>>8;  b[len+2] = bytes&0xFF;
+	if ( bytes ) mpz_export (b+len+3, 0, 1, 1, 0, 0, z);
+	return len+3+bytes;
+}
+
+// writes the canonical model of the curve (the same data used by smalljac_cache_curve_key) to b, returns its length or 0 if it is too big
+static int _sjc_model (unsigned char b[SMALLJAC_CACHE_MAX_MODEL], smalljac_curve *sc)
+{
+	register int i, len;
+
+	b[0] = sc->type;  b[1] = sc->genus;  b[2] = sc->degree;  b[3] = sc->f_inits;
+	for ( len = 4, i = 0 ; i < sc->f_inits && len ; i++ ) len = _sjc_model_mpz (b, len, sc->f[i]);
+	return ( len ? _sjc_model_mpz (b, len, sc->D) : 0 );
+}
+
+// sets up the key, q, flags, and model fields of e, returns 0 if the curve cannot be cached
+static int _sjc_entry_init (struct smalljac_cache_entry *e, smalljac_curve *sc, unsigned long q, unsigned long flags)
+{
+	memset (e, 0, sizeof(*e));
+	if ( ! (e->mlen = _sjc_model (e->model, sc)) ) return 0;
+	e->key = smalljac_cache_curve_key (sc);  e->q = q;  e->flags = flags & ~SMALLJAC_CACHE_IGNORED_FLAGS;
+	return 1;
+}
+
+// computes the cache key for a curve over Q from its canonical model
+uint64_t smalljac_cache_curve_key (smalljac_curve *sc)
+{
+	register uint64_t h;
+	register int i;
+
+	h = _sjc_mix (0x736d616c6c6a6163UL, ((uint64_t)sc->type<<32) | ((uint64_t)sc->degree<<16) | (uint64_t)sc->genus);
+	for ( i = 0 ; i < sc->f_inits ; i++ ) h = _sjc_mix_mpz (h, sc->f[i]);
+	h = _sjc_mix_mpz (h, sc->D);
+	return h;
+}
+
+static void _sjc_unlink (uint32_t i)
+{
+	register struct smalljac_cache_node *x = _sjc.nodes+i;
+
+	if ( x->prev != SMALLJAC_CACHE_NIL ) _sjc.nodes[x->prev].next = x->next; else _sjc.head = x->next;
+	if ( x->next != SMALLJAC_CACHE_NIL ) _sjc.nodes[x->next].prev = x->prev; else _sjc.tail = x->prev;
+}
+
+static void _sjc_push_front (uint32_t i)
+{
+	register struct smalljac_cache_node *x = _sjc.nodes+i;
+
+	x->prev = SMALLJAC_CACHE_NIL;  x->next = _sjc.head;
+	if ( _sjc.head != SMALLJAC_CACHE_NIL ) _sjc.nodes[_sjc.head].prev = i; else _sjc.tail = i;
+	_sjc.head = i;
+}
+
+static void _sjc_unchain (uint32_t i)
+{
+	register uint32_t *pj;
+	register struct smalljac_cache_entry *e = &_sjc.nodes[i].e;
+
+	for ( pj = _sjc.buckets + (_sjc_bucket(e->key,e->q)&_sjc.bmask) ; *pj != SMALLJAC_CACHE_NIL ; pj = &_sjc.nodes[*pj].chain )
+		if ( *pj == i ) { *pj = _sjc.nodes[i].chain;  return; }
+}
+
+static struct smalljac_cache_entry *_sjc_mem_lookup (struct smalljac_cache_entry *x)
+{
+	register uint32_t i;
+	register struct smalljac_cache_entry *e;
+
+	for ( i = _sjc.buckets[_sjc_bucket(x->key,x->q)&_sjc.bmask] ; i != SMALLJAC_CACHE_NIL ; i = _sjc.nodes[i].chain ) {
+		e = &_sjc.nodes[i].e;
+		if ( _sjc_match (e, x) ) {
+			if ( _sjc.head != i ) { _sjc_unlink (i);  _sjc_push_front (i); }
+			return e;
+		}
+	}
+	return 0;
+}
+
+static void _sjc_mem_insert (struct smalljac_cache_entry *e)
+{
+	register uint32_t i, b;
+
+	if ( _sjc.used < _sjc.size ) {
+		i = _sjc.used++;
+	} else {
+		i = _sjc.tail;										// evict least recently used entry
+		_sjc_unlink (i);
+		_sjc_unchain (i);
+	}
+	_sjc.nodes[i].e = *e;
+	b = _sjc_bucket(e->key,e->q)&_sjc.bmask;
+	_sjc.nodes[i].chain = _sjc.buckets[b];
+	_sjc.buckets[b] = i;
+	_sjc_push_front (i);
+}
+
+// copies the file entry matching x (if any) into e and returns 1, or returns 0
+static int _sjc_file_lookup (struct smalljac_cache_entry *e, struct smalljac_cache_entry *x)
+{
+	register struct smalljac_cache_entry *s;
+	register uint64_t h, mask;
+	register int i;
+
+	mask = _sjc.map->slots-1;
+	h = _sjc_bucket (x->key, x->q);
+	for ( i = 0 ; i < SMALLJAC_CACHE_FILE_PROBES ; i++ ) {
+		s = _sjc.slots + ((h+i)&mask);
+		if ( ! s->check ) return 0;
+		if ( s->key == x->key && s->q == x->q && s->flags == x->flags ) {
+			// another process may be rewriting the slot, so take a copy first and validate the copy
+			__sync_synchronize();
+			memcpy (e, s, sizeof(*e));
+			__sync_synchronize();
+			return ( e->check && e->check == _sjc_check(e) && _sjc_match (e, x) );
+		}
+	}
+	return 0;
+}
+
+static void _sjc_file_insert (struct smalljac_cache_entry *e)
+{
+	register struct smalljac_cache_entry *s;
+	register uint64_t h, mask;
+	register int i;
+
+	mask = _sjc.map->slots-1;
+	h = _sjc_bucket (e->key, e->q);
+	for ( i = 0 ; i < SMALLJAC_CACHE_FILE_PROBES-1 ; i++ ) {
+		s = _sjc.slots + ((h+i)&mask);
+		if ( ! s->check || (s->key == e->key && s->q == e->q && s->flags == e->flags) ) break;
+	}
+	s = _sjc.slots + ((h+i)&mask);
+	s->check = 0;
+	__sync_synchronize();
+	s->key = e->key;  s->q = e->q;  s->flags = e->flags;  s->n = e->n;
+	memcpy (s->a, e->a, sizeof(s->a));
+	s->mlen = e->mlen;  s->reserved = 0;
+	memcpy (s->model, e->model, sizeof(s->model));
+	__sync_synchronize();
+	s->check = _sjc_check (s);
+}
+
+static int _sjc_file_open (char *filename, unsigned long slots)
+{
+	struct smalljac_cache_file_header hdr;
+	struct stat st;
+	size_t len;
+	void *map;
+	int fd;
+
+	fd = open (filename, O_RDWR|O_CREAT, 0644);
+	if ( fd < 0 ) { err_printf ("smalljac_cache: unable to open cache file %s\n", filename);  return 0; }
+	if ( fstat (fd, &st) < 0 ) { close (fd);  return 0; }
+	if ( st.st_size == 0 ) {
+		memset (&hdr, 0, sizeof(hdr));
+		hdr.magic = SMALLJAC_CACHE_FILE_MAGIC;  hdr.entry_size = sizeof(struct smalljac_cache_entry);
+		for ( hdr.slots = 1024 ; hdr.slots < slots ; hdr.slots <<= 1 );
+		len = sizeof(hdr) + hdr.slots*sizeof(struct smalljac_cache_entry);
+		if ( ftruncate (fd, len) < 0 || pwrite (fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) ) { err_printf ("smalljac_cache: unable to create cache file %s\n", filename);  close (fd);  return 0; }
+	} else {
+		if ( pread (fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) || hdr.magic != SMALLJAC_CACHE_FILE_MAGIC || hdr.entry_size != sizeof(struct smalljac_cache_entry)
+		     || (hdr.slots&(hdr.slots-1)) || st.st_size != sizeof(hdr) + hdr.slots*sizeof(struct smalljac_cache_entry) ) {
+			err_printf ("smalljac_cache: %s is not a valid smalljac cache file\n", filename);  close (fd);  return 0;
+		}
+		len = st.st_size;
+	}
+	map = mmap (0, len, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	close (fd);
+	if ( map == MAP_FAILED ) { err_printf ("smalljac_cache: mmap failed on cache file %s\n", filename);  return 0; }
+	_sjc.map = map;  _sjc.map_len = len;
+	_sjc.slots = (struct smalljac_cache_entry *)((char *)map + sizeof(hdr));
+	return 1;
+}
+
+int smalljac_cache_enable (unsigned long entries, char *filename, unsigned long file_slots)
+{
+	register uint32_t i;
+
+	smalljac_cache_disable ();
+	if ( ! entries ) entries = SMALLJAC_CACHE_DEFAULT_ENTRIES;
+	if ( entries >= SMALLJAC_CACHE_NIL ) return 0;
+	_sjc.size = entries;
+	for ( _sjc.bmask = 1 ; _sjc.bmask < entries ; _sjc.bmask <<= 1 );
+	_sjc.nodes = mem_alloc (entries*sizeof(*_sjc.nodes));
+	_sjc.buckets = malloc (_sjc.bmask*sizeof(*_sjc.buckets));
+	if ( ! _sjc.buckets ) { err_printf ("smalljac_cache: unable to allocate %lu buckets\n", (unsigned long)_sjc.bmask);  smalljac_cache_disable();  return 0; }
+	for ( i = 0 ; i < _sjc.bmask ; i++ ) _sjc.buckets[i] = SMALLJAC_CACHE_NIL;
+	_sjc.bmask--;
+	_sjc.head = _sjc.tail = SMALLJAC_CACHE_NIL;
+	if ( filename && ! _sjc_file_open (filename, ( file_slots ? file_slots : SMALLJAC_CACHE_DEFAULT_FILE_SLOTS )) ) { smalljac_cache_disable();  return 0; }
+	return 1;
+}
+
+void smalljac_cache_disable (void)
+{
+	if ( _sjc.map ) munmap (_sjc.map, _sjc.map_len);
+	if ( _sjc.nodes ) mem_free (_sjc.nodes);
+	if ( _sjc.buckets ) free (_sjc.buckets);
+	memset (&_sjc, 0, sizeof(_sjc));
+}
+
+void smalljac_cache_stats (unsigned long *hits, unsigned long *misses, unsigned long *disk_hits)
+{
+	if ( hits ) *hits = _sjc.hits;
+	if ( misses ) *misses = _sjc.misses;
+	if ( disk_hits ) *disk_hits = _sjc.disk_hits;
+}
+
+int smalljac_cache_enabled (void) { return _sjc.nodes ? 1 : 0; }
+
+// returns 1 and sets *n and a[] if there is an entry for (curve,q,flags), 0 otherwise
+int smalljac_cache_lookup (long a[], int *n, smalljac_curve *sc, unsigned long q, unsigned long flags)
+{
+	struct smalljac_cache_entry *e, x, f;
+	register int i;
+
+	if ( ! _sjc.nodes ) return 0;
+	if ( ! _sjc_entry_init (&x, sc, q, flags) ) return 0;
+	e = _sjc_mem_lookup (&x);
+	if ( ! e && _sjc.map && _sjc_file_lookup (&f, &x) ) {
+		_sjc_mem_insert (&f);  _sjc.disk_hits++;
+		e = &f;
+	}
+	if ( ! e ) { _sjc.misses++;  return 0; }
+	_sjc.hits++;
+	*n = e->n;
+	for ( i = 0 ; i < e->n ; i++ ) a[i] = e->a[i];
+	return 1;
+}
+
+void smalljac_cache_store (smalljac_curve *sc, unsigned long q, unsigned long flags, long a[], int n)
+{
+	struct smalljac_cache_entry e;
+	register int i;
+
+	if ( ! _sjc.nodes || n < 0 || n > SMALLJAC_CACHE_MAX_N ) return;
+	if ( ! _sjc_entry_init (&e, sc, q, flags) ) return;
+	e.n = n;
+	for ( i = 0 ; i < n ; i++ ) e.a[i] = a[i];
+	_sjc_mem_insert (&e);
+	if ( _sjc.map ) _sjc_file_insert (&e);
+}
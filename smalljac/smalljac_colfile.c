@@ -0,0 +1,384 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <gmp.h>
+#include "smalljac.h"
+#include "smalljac_internal.h"
+#include "cstd.h"
+
+/*
+    Copyright (c) 2026 The smalljac contributors
+    See LICENSE file for license details.
+*/
+
+/*
+	Columnar data files for L-polynomial and group structure data (intended for export to columnar analysis tools).
+
+	Records passed to smalljac_colfile_append (whose arguments match those of a smalljac_Lpolys or smalljac_groups callback) are
+	buffered by column and written in chunks of SMALLJAC_COLFILE_CHUNK rows, with each column of a chunk stored contiguously,
+	so that a reader can extract one column without touching the others.  The columns are
+
+		curve			index of the curve in the list of curve strings (see smalljac_colfile_curve), so one file may hold many curves
+		q				norm of the prime
+		good			1 for good reduction, 0 for bad reduction (in which case the value columns are 0)
+		a1,...,an		L-poly coefficients (or m0,...,m(n-1), the invariant factors of the group, for group data)
+
+	Each column chunk is either stored as plain 64-bit integers (8-byte aligned, so they can be used in place from a memory map), or,
+	with SMALLJAC_COLFILE_COMPRESS, as zigzag varints of the differences between successive values (for curve and q) or of the
+	values themselves (for the rest).  The footer holds the column names, the curve strings, and a directory listing the number
+	of rows in each chunk followed by the offset, length, encoding, and min/max values of each of its column chunks, which allows
+	readers to skip chunks that cannot satisfy a predicate.  As with the other binary data files, integers are in native byte order.
+*/
+
+#define SMALLJAC_COLFILE_MAGIC		0x314c4f434a53UL			// "SJCOL1"
+#define SMALLJAC_COLFILE_VERSION		1
+#define SMALLJAC_COLFILE_CHUNK		SMALLJAC_COLFILE_MAX_CHUNK		// rows per chunk
+#define SMALLJAC_COLFILE_BUFSIZE		(1<<20)						// stdio buffer size for the writer
+#define SMALLJAC_COLFILE_NAMELEN		8							// column names are padded to this length in the footer
+
+#define SMALLJAC_COLFILE_PLAIN		0							// column chunk encodings
+#define SMALLJAC_COLFILE_VARINT		1
+#define SMALLJAC_COLFILE_DELTA		2
+
+struct smalljac_colfile_header {
+	uint64_t magic;
+	uint32_t version, flags;
+	uint32_t ncols, n;										// ncols = n+3
+	uint64_t rows, chunks, curves;
+	uint64_t footer, footerlen;								// file offset and length of the footer (the footer ends the file)
+};
+
+struct smalljac_colfile_column {
+	uint64_t offset, len;
+	int64_t min, max;
+	uint32_t encoding, reserved;
+};
+
+typedef struct smalljac_colfile_struct {
+	struct smalljac_colfile_header hdr;
+	char **curves;											// curve strings
+	struct smalljac_colfile_column *dir;						// directory entry of chunk k is at dir + k*ncols
+	uint64_t *chunkrows;
+	// writer
+	FILE *fp;
+	char *buf;
+	long *cols;												// buffered values of the current chunk, column i at cols + i*SMALLJAC_COLFILE_CHUNK
+	unsigned char *enc;
+	unsigned long rows, maxchunks, maxcurves, offset;
+	long curve;												// id of the current curve (-1 if none)
+	// reader
+	unsigned char *map;
+	size_t len;
+} smalljac_colfile;
+
+/*
+	Creates a columnar data file with n value columns (L-poly coefficients a1,...,an, or group invariants m0,...,m(n-1) if flags
+	includes SMALLJAC_COLFILE_GROUPS).  Returns null if the file cannot be created.
+*/
+smalljac_colfile_t smalljac_colfile_create (char *filename, int n, int flags)
+{
+	smalljac_colfile *F;
+
+	if ( n < 1 || n > 2*SMALLJAC_MAX_GENUS ) { err_printf ("smalljac_colfile_create: invalid number of value columns %d\n", n);  return 0; }
+	F = mem_alloc (sizeof(*F));
+	F->fp = fopen (filename, "w");
+	if ( ! F->fp ) { err_printf ("smalljac_colfile_create: unable to create file %s\n", filename);  mem_free (F);  return 0; }
+	F->buf = mem_alloc (SMALLJAC_COLFILE_BUFSIZE);
+	setvbuf (F->fp, F->buf, _IOFBF, SMALLJAC_COLFILE_BUFSIZE);
+	F->hdr.magic = SMALLJAC_COLFILE_MAGIC;  F->hdr.version = SMALLJAC_COLFILE_VERSION;
+	F->hdr.flags = flags;  F->hdr.n = n;  F->hdr.ncols = n+3;
+	F->cols = mem_alloc (F->hdr.ncols*SMALLJAC_COLFILE_CHUNK*sizeof(*F->cols));
+	F->enc = mem_alloc (10*SMALLJAC_COLFILE_CHUNK+8);
+	F->maxchunks = 64;
+	F->dir = mem_alloc (F->maxchunks*F->hdr.ncols*sizeof(*F->dir));
+	F->chunkrows = mem_alloc (F->maxchunks*sizeof(*F->chunkrows));
+	F->maxcurves = 16;
+	F->curves = mem_alloc (F->maxcurves*sizeof(*F->curves));
+	F->curve = -1;
+	if ( fwrite (&F->hdr, sizeof(F->hdr), 1, F->fp) != 1 ) {
+		err_printf ("smalljac_colfile_create: error writing file %s\n", filename);  fclose (F->fp);  F->fp = 0;  smalljac_colfile_close (F);  return 0;
+	}
+	fflush (F->fp);				// flush now so that processes forked later (e.g. by smalljac_parallel_Lpolys) do not write the header again on exit
+	F->offset = sizeof(F->hdr);
+	return (smalljac_colfile_t) F;
+}
+
+// starts a new curve, subsequent records will have its id in the curve column, returns the id
+long smalljac_colfile_curve (smalljac_colfile_t file, char *curve)
+{
+	smalljac_colfile *F = (smalljac_colfile *) file;
+
+	if ( ! F->fp ) return -1;
+	if ( F->hdr.curves == F->maxcurves ) {
+		F->maxcurves *= 2;
+		F->curves = realloc (F->curves, F->maxcurves*sizeof(*F->curves));
+		if ( ! F->curves ) { fprintf (stderr, "Fatal error, realloc failed in smalljac_colfile_curve\n");  abort(); }
+	}
+	F->curves[F->hdr.curves] = mem_alloc (strlen(curve)+1);
+	strcpy (F->curves[F->hdr.curves], curve);
+	F->curve = F->hdr.curves++;
+	return F->curve;
+}
+
+// writes the buffered rows as a chunk
+static int _cf_flush (smalljac_colfile *F)
+{
+	static char zeros[8];
+	struct smalljac_colfile_column *c;
+	register unsigned long len, pad;
+	register long *v, prev;
+	register int i, j;
+
+	if ( ! F->rows ) return 1;
+	if ( F->hdr.chunks == F->maxchunks ) {
+		F->maxchunks *= 2;
+		F->dir = realloc (F->dir, F->maxchunks*F->hdr.ncols*sizeof(*F->dir));
+		F->chunkrows = realloc (F->chunkrows, F->maxchunks*sizeof(*F->chunkrows));
+		if ( ! F->dir || ! F->chunkrows ) { fprintf (stderr, "Fatal error, realloc failed in smalljac_colfile_append\n");  abort(); }
+	}
+	F->chunkrows[F->hdr.chunks] = F->rows;
+	for ( i = 0 ; i < F->hdr.ncols ; i++ ) {
+		c = F->dir + F->hdr.chunks*F->hdr.ncols + i;
+		v = F->cols + i*SMALLJAC_COLFILE_CHUNK;
+		c->min = c->max = v[0];
+		for ( j = 1 ; j < F->rows ; j++ ) { if ( v[j] < c->min ) c->min = v[j];  if ( v[j] > c->max ) c->max = v[j]; }
+		c->offset = F->offset;
+		if ( F->hdr.flags&SMALLJAC_COLFILE_COMPRESS ) {
+			if ( i <= SMALLJAC_COLFILE_Q_COL ) {
+				c->encoding = SMALLJAC_COLFILE_DELTA;
+				for ( j = 0, prev = 0, len = 0 ; j < F->rows ; j++ ) { len += smalljac_put_varint (F->enc+len, smalljac_zigzag (v[j]-prev));  prev = v[j]; }
+			} else {
+				c->encoding = SMALLJAC_COLFILE_VARINT;
+				for ( j = 0, len = 0 ; j < F->rows ; j++ ) len += smalljac_put_varint (F->enc+len, smalljac_zigzag (v[j]));
+			}
+			if ( fwrite (F->enc, 1, len, F->fp) != len ) return 0;
+		} else {
+			c->encoding = SMALLJAC_COLFILE_PLAIN;
+			len = F->rows*sizeof(*v);
+			if ( fwrite (v, 1, len, F->fp) != len ) return 0;
+		}
+		c->len = len;
+		pad = (8 - (len&7)) & 7;								// keep column chunks 8-byte aligned
+		if ( pad && fwrite (zeros, 1, pad, F->fp) != pad ) return 0;
+		F->offset += len + pad;
+	}
+	F->hdr.chunks++;
+	F->rows = 0;
+	return 1;
+}
+
+/*
+	Appends a record for the current curve.  n must be 0 for bad reduction, otherwise for L-poly data it must be at least the
+	number of value columns (any extra are ignored), for group data missing invariant factors are recorded as 1.
+	Returns 1 on success, 0 on error.
+*/
+int smalljac_colfile_append (smalljac_colfile_t file, unsigned long q, int good, long a[], int n)
+{
+	smalljac_colfile *F = (smalljac_colfile *) file;
+	register long *v;
+	register int i;
+
+	if ( ! F->fp ) return 0;
+	if ( F->curve < 0 ) { err_printf ("smalljac_colfile_append: no curve specified (see smalljac_colfile_curve)\n");  return 0; }
+	if ( good && n && n < (int)F->hdr.n && ! (F->hdr.flags&SMALLJAC_COLFILE_GROUPS) ) { err_printf ("smalljac_colfile_append: expected %d coefficients, got %d\n", F->hdr.n, n);  return 0; }
+	if ( ! n ) good = 0;
+	v = F->cols + F->rows;
+	v[SMALLJAC_COLFILE_CURVE_COL*SMALLJAC_COLFILE_CHUNK] = F->curve;
+	v[SMALLJAC_COLFILE_Q_COL*SMALLJAC_COLFILE_CHUNK] = (long) q;
+	v[SMALLJAC_COLFILE_GOOD_COL*SMALLJAC_COLFILE_CHUNK] = ( good ? 1 : 0 );
+	for ( i = 0 ; i < F->hdr.n ; i++ ) v[(SMALLJAC_COLFILE_VALUE_COL+i)*SMALLJAC_COLFILE_CHUNK] = ( good ? ( i < n ? a[i] : 1 ) : 0 );
+	F->hdr.rows++;
+	if ( ++F->rows == SMALLJAC_COLFILE_CHUNK && ! _cf_flush (F) ) { err_printf ("smalljac_colfile_append: write failed\n");  fclose (F->fp);  F->fp = 0;  return 0; }
+	return 1;
+}
+
+/*
+	Callback for smalljac_Lpolys and smalljac_groups (with arg set to the colfile), starts a new curve whenever the curve changes.
+	We compare curve strings rather than handles, since a handle may be reused once a curve is cleared.
+*/
+int smalljac_colfile_callback (smalljac_curve_t curve, unsigned long q, int good, long a[], int n, void *arg)
+{
+	smalljac_colfile *F = (smalljac_colfile *) arg;
+	char *s;
+
+	s = (char *)smalljac_curve_string ((smalljac_curve *)curve);
+	if ( F->curve < 0 || strcmp (s, F->curves[F->curve]) != 0 )
+		if ( smalljac_colfile_curve (F, s) < 0 ) return 0;
+	return smalljac_colfile_append (F, q, good, a, n);
+}
+
+// closes a file opened for reading or writing, when writing flushes the last chunk and writes the footer, returns 0 if a write error occurred
+int smalljac_colfile_close (smalljac_colfile_t file)
+{
+	static char zeros[8];
+	smalljac_colfile *F = (smalljac_colfile *) file;
+	char name[SMALLJAC_COLFILE_NAMELEN];
+	register unsigned long i, len;
+	int sts;
+
+	sts = 1;
+	if ( F->map ) {
+		munmap (F->map, F->len);
+		mem_free (F->curves);
+		mem_free (F);
+		return 1;
+	}
+	if ( F->fp ) {
+		if ( ! _cf_flush (F) ) sts = 0;
+		F->hdr.footer = F->offset;
+		for ( i = 0 ; sts && i < F->hdr.ncols ; i++ ) {
+			memset (name, 0, sizeof(name));
+			switch (i) {
+			case SMALLJAC_COLFILE_CURVE_COL: strcpy (name, "curve");  break;
+			case SMALLJAC_COLFILE_Q_COL: strcpy (name, "q");  break;
+			case SMALLJAC_COLFILE_GOOD_COL: strcpy (name, "good");  break;
+			default: sprintf (name, ( (F->hdr.flags&SMALLJAC_COLFILE_GROUPS) ? "m%lu" : "a%lu" ), ( (F->hdr.flags&SMALLJAC_COLFILE_GROUPS) ? i-SMALLJAC_COLFILE_VALUE_COL : i-SMALLJAC_COLFILE_VALUE_COL+1 ));
+			}
+			if ( fwrite (name, 1, sizeof(name), F->fp) != sizeof(name) ) sts = 0;
+		}
+		len = 0;
+		for ( i = 0 ; sts && i < F->hdr.curves ; i++ ) { if ( fwrite (F->curves[i], 1, strlen(F->curves[i])+1, F->fp) != strlen(F->curves[i])+1 ) sts = 0;  len += strlen(F->curves[i])+1; }
+		if ( sts && (len&7) && fwrite (zeros, 1, 8-(len&7), F->fp) != 8-(len&7) ) sts = 0;
+		len = F->hdr.ncols*SMALLJAC_COLFILE_NAMELEN + ((len+7)&~7UL);
+		if ( sts && F->hdr.chunks ) {
+			if ( fwrite (F->chunkrows, sizeof(*F->chunkrows), F->hdr.chunks, F->fp) != F->hdr.chunks ) sts = 0;
+			if ( fwrite (F->dir, sizeof(*F->dir), F->hdr.chunks*F->hdr.ncols, F->fp) != F->hdr.chunks*F->hdr.ncols ) sts = 0;
+		}
+		F->hdr.footerlen = len + F->hdr.chunks*(sizeof(*F->chunkrows) + F->hdr.ncols*sizeof(*F->dir));
+		// rewrite the header now that we know the counts
+		if ( sts && (fseek (F->fp, 0, SEEK_SET) != 0 || fwrite (&F->hdr, sizeof(F->hdr), 1, F->fp) != 1) ) sts = 0;
+		if ( fclose (F->fp) != 0 ) sts = 0;
+		if ( ! sts ) err_printf ("smalljac_colfile_close: error writing file\n");
+	} else {
+		sts = 0;
+	}
+	for ( i = 0 ; i < F->hdr.curves ; i++ ) mem_free (F->curves[i]);
+	mem_free (F->curves);  mem_free (F->dir);  mem_free (F->chunkrows);
+	mem_free (F->cols);  mem_free (F->enc);  mem_free (F->buf);
+	mem_free (F);
+	return sts;
+}
+
+// opens a columnar data file for reading (the file is memory mapped), returns null if filename is not a valid columnar data file
+smalljac_colfile_t smalljac_colfile_open (char *filename)
+{
+	smalljac_colfile *F;
+	struct smalljac_colfile_header hdr;
+	struct smalljac_colfile_column *c;
+	struct stat st;
+	unsigned char *map, *s, *end;
+	register unsigned long i, len;
+	int fd;
+
+	fd = open (filename, O_RDONLY);
+	if ( fd < 0 ) return 0;
+	if ( fstat (fd, &st) < 0 || st.st_size < sizeof(hdr) || pread (fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) || hdr.magic != SMALLJAC_COLFILE_MAGIC ) {
+		err_printf ("smalljac_colfile_open: %s is not a columnar data file\n", filename);  close (fd);  return 0;
+	}
+	if ( hdr.version != SMALLJAC_COLFILE_VERSION || hdr.n < 1 || hdr.n > 2*SMALLJAC_MAX_GENUS || hdr.ncols != hdr.n+3 || hdr.footer < sizeof(hdr)
+	     || hdr.footer + hdr.footerlen != st.st_size || hdr.footerlen < hdr.ncols*SMALLJAC_COLFILE_NAMELEN + hdr.chunks*(sizeof(uint64_t)+hdr.ncols*sizeof(*c)) ) {
+		err_printf ("smalljac_colfile_open: %s is not a valid columnar data file (it may be incomplete)\n", filename);  close (fd);  return 0;
+	}
+	map = mmap (0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close (fd);
+	if ( map == MAP_FAILED ) { err_printf ("smalljac_colfile_open: mmap failed on file %s\n", filename);  return 0; }
+	F = mem_alloc (sizeof(*F));
+	F->hdr = hdr;  F->map = map;  F->len = st.st_size;
+	F->curves = mem_alloc ((hdr.curves+1)*sizeof(*F->curves));
+	s = map + hdr.footer + hdr.ncols*SMALLJAC_COLFILE_NAMELEN;
+	end = map + st.st_size - hdr.chunks*(sizeof(uint64_t)+hdr.ncols*sizeof(*c));
+	for ( i = 0 ; i < hdr.curves ; i++ ) {
+		F->curves[i] = (char *) s;
+		while ( s < end && *s ) s++;
+		if ( s++ == end ) goto bad;
+	}
+	len = s - (map + hdr.footer);
+	F->chunkrows = (uint64_t *)(map + hdr.footer + ((len+7)&~7UL));
+	F->dir = (struct smalljac_colfile_column *)(F->chunkrows + hdr.chunks);
+	if ( (unsigned char *)(F->dir + hdr.chunks*hdr.ncols) != map + st.st_size ) goto bad;
+	for ( i = 0, len = 0 ; i < hdr.chunks*hdr.ncols ; i++ ) {
+		c = F->dir + i;
+		if ( c->offset < sizeof(hdr) || c->offset + c->len > hdr.footer || c->encoding > SMALLJAC_COLFILE_DELTA ) goto bad;
+		if ( c->encoding == SMALLJAC_COLFILE_PLAIN && (c->len != F->chunkrows[i/hdr.ncols]*sizeof(long) || (c->offset&7)) ) goto bad;
+		if ( ! (i%hdr.ncols) ) len += F->chunkrows[i/hdr.ncols];
+	}
+	if ( len != hdr.rows ) goto bad;
+	return (smalljac_colfile_t) F;
+bad:
+	err_printf ("smalljac_colfile_open: %s is not a valid columnar data file\n", filename);
+	munmap (map, st.st_size);
+	mem_free (F->curves);
+	mem_free (F);
+	return 0;
+}
+
+void smalljac_colfile_info (smalljac_colfile_t file, int *n, int *flags, unsigned long *rows, unsigned long *chunks, unsigned long *curves)
+{
+	smalljac_colfile *F = (smalljac_colfile *) file;
+
+	if ( n ) *n = F->hdr.n;
+	if ( flags ) *flags = F->hdr.flags;
+	if ( rows ) *rows = F->hdr.rows;
+	if ( chunks ) *chunks = F->hdr.chunks;
+	if ( curves ) *curves = F->hdr.curves;
+}
+
+char *smalljac_colfile_curve_string (smalljac_colfile_t file, unsigned long id)
+{
+	smalljac_colfile *F = (smalljac_colfile *) file;
+
+	return ( id < F->hdr.curves ? F->curves[id] : 0 );
+}
+
+char *smalljac_colfile_column_name (smalljac_colfile_t file, int col)
+{
+	smalljac_colfile *F = (smalljac_colfile *) file;
+
+	if ( ! F->map || col < 0 || col >= F->hdr.ncols ) return 0;
+	return (char *) F->map + F->hdr.footer + col*SMALLJAC_COLFILE_NAMELEN;
+}
+
+// returns the number of rows in chunk k and sets min/max (if non-null) to the min/max of column col in chunk k, or -1 if k or col is invalid
+long smalljac_colfile_chunk_stats (smalljac_colfile_t file, unsigned long k, int col, long *min, long *max)
+{
+	smalljac_colfile *F = (smalljac_colfile *) file;
+	struct smalljac_colfile_column *c;
+
+	if ( ! F->map || k >= F->hdr.chunks || col < 0 || col >= F->hdr.ncols ) return -1;
+	c = F->dir + k*F->hdr.ncols + col;
+	if ( min ) *min = c->min;
+	if ( max ) *max = c->max;
+	return F->chunkrows[k];
+}
+
+// decodes column col of chunk k into values[] (which must have room for SMALLJAC_COLFILE_MAX_CHUNK entries), returns the number of rows, or -1 on error
+long smalljac_colfile_read (smalljac_colfile_t file, unsigned long k, int col, long values[])
+{
+	smalljac_colfile *F = (smalljac_colfile *) file;
+	struct smalljac_colfile_column *c;
+	unsigned char *s, *end;
+	unsigned long x;
+	register long i, n, prev;
+
+	if ( ! F->map || k >= F->hdr.chunks || col < 0 || col >= F->hdr.ncols ) return -1;
+	c = F->dir + k*F->hdr.ncols + col;
+	n = F->chunkrows[k];
+	s = F->map + c->offset;  end = s + c->len;
+	switch ( c->encoding ) {
+	case SMALLJAC_COLFILE_PLAIN:
+		memcpy (values, s, n*sizeof(*values));
+		return n;
+	case SMALLJAC_COLFILE_VARINT:
+		for ( i = 0 ; i < n ; i++ ) { if ( ! (s = smalljac_get_varint (&x, s, end)) ) return -1;  values[i] = smalljac_unzigzag (x); }
+		return n;
+	case SMALLJAC_COLFILE_DELTA:
+		for ( i = 0, prev = 0 ; i < n ; i++ ) { if ( ! (s = smalljac_get_varint (&x, s, end)) ) return -1;  values[i] = prev = prev + smalljac_unzigzag (x); }
+		return n;
+	}
+	return -1;
+}
@@ -6,6 +6,7 @@
     See LICENSE file for license details.
 */
 
+#include <stdint.h>
 #include <gmp.h>
 #include "ff_poly.h"
 #include "smalljac.h"
@@ -96,8 +97,64 @@ int smalljac_generic_Lpoly (long a[], hc_poly *hc, long pts, unsigned long flags
 int smalljac_padic_Lpoly (long a[], smalljac_curve *sc, long p, unsigned long flags);
 unsigned long smalljac_pointcount_modp (smalljac_curve *sc,  long p);
 
+// building blocks of smalljac_Lpolys for curves over Q (or at degree-1 primes), shared with the other drivers (see smalljac_primeset.c)
+int smalljac_Lpolys_check_flags (smalljac_curve *sc, unsigned long flags);							// returns 0 if flags are valid for the curve, a negative error code otherwise
+void smalljac_Lpolys_Q_setup (smalljac_curve *sc, unsigned long start);								// must be called before smalljac_Lpolys_Q_prime is first called with p >= start
+int smalljac_Lpolys_Q_prime (smalljac_curve *sc, unsigned long p, int good, unsigned long flags,			// returns 1 to continue, 0 to stop, -1 for an internal error
+				    int (*callback)(smalljac_curve_t curve, unsigned long p, int good, long a[], int n, void *arg), void *arg);
+
 int smalljac_Lpoly_extend (long a[], int n, long p, int h);						        // extend coefficients for prime field p to extension field of size q = p^h			
 
+// precomputed data files, used by smalljac_Lpolys_from_file(s) and smalljac_Lpolys_reduce_file(s) (see smalljac_lpfile.c)
+int smalljac_parse_file_header (char buf[SMALLJAC_CURVE_STRING_LEN+256], long *pstart, long *pend, int *pgenus);		// modifies buf to hold the curve string
+void smalljac_lpfile_chunk (smalljac_lpfile_t lf, int k, int m);								// restricts lf to the kth of m chunks of its records
+smalljac_lpfile_t smalljac_lpfile_open_job (char filename[], char *fileprefix, int jobs, int jobid, int *err);	// opens prefix_jobs_jobid.lpd, .txt, or .txt.gz
+void smalljac_lpfile_set_range (smalljac_lpfile_t lf, unsigned long start, unsigned long end);				// for writers
+smalljac_curve *smalljac_lpfile_curve (smalljac_lpfile_t lf, char *filename, unsigned long flags, int *pn, int *err);
+long smalljac_lpfile_scan (smalljac_lpfile_t lf, smalljac_curve *sc, int n, char *filename, unsigned long start, unsigned long end, unsigned long flags,
+				       int (*callback)(smalljac_curve_t curve, unsigned long q, int good, long a[], int n, void *arg), void *arg);
+long smalljac_lpfile_merge (smalljac_lpfile_t lf[], int files, smalljac_curve *sc, int n, char *name, unsigned long start, unsigned long end, unsigned long flags,
+					    int (*callback)(smalljac_curve_t curve, unsigned long q, int good, long a[], int n, void *arg), void *arg);
+
+// variable length integer encoding used in binary data files (7 bits per byte, high bit set on all but the last byte)
+static inline int smalljac_put_varint (unsigned char *s, unsigned long x)
+{
+	register int i;
+
+	for ( i = 0 ; x >= 0x80 ; x >>= 7 ) s[i++] = (unsigned char)(x|0x80);
+	s[i++] = (unsigned char)x;
+	return i;
+}
+
+// returns 0 if the varint runs past end
+static inline unsigned char *smalljac_get_varint (unsigned long *x, unsigned char *s, unsigned char *end)
+{
+	register unsigned long y;
+	register int k;
+
+	for ( y = 0, k = 0 ; s < end && k < 64 ; s++, k += 7 ) { y |= (unsigned long)(*s&0x7F) << k;  if ( ! (*s&0x80) ) { *x = y;  return s+1; } }
+	return 0;
+}
+
+static inline unsigned long smalljac_zigzag (long x) { return ( x < 0 ? ((unsigned long)(-(x+1))<<1)|1 : (unsigned long)x<<1 ); }
+static inline long smalljac_unzigzag (unsigned long x) { return ( (x&1) ? -(long)(x>>1)-1 : (long)(x>>1) ); }
+
+// result cache used by smalljac_Lpoly (see smalljac_cache.c)
+int smalljac_cache_enabled (void);
+uint64_t smalljac_cache_curve_key (smalljac_curve *sc);
+int smalljac_cache_lookup (long a[], int *n, smalljac_curve *sc, unsigned long q, unsigned long flags);
+void smalljac_cache_store (smalljac_curve *sc, unsigned long q, unsigned long flags, long a[], int n);
+
+int smalljac_parallel_threads (void);															// number of child processes used by parallel functions (a power of 2)
+long smalljac_parallel_fork (int procs, long (*work)(void *arg, int i, int procs, void *state), void *arg,		// runs work in procs child processes and merges their states
+					   void *state, unsigned long state_size, void (*merge)(void *state, void *child_state));		// (see smalljac_parallel.c)
+
+// L-series store used by smalljac_Lpolys and smalljac_parallel_Lpolys (see smalljac_store.c)
+int smalljac_store_eligible (smalljac_curve *sc, unsigned long flags);
+long smalljac_store_Lpolys (smalljac_curve *sc, unsigned long start, unsigned long end, unsigned long flags,
+				       int (*callback)(smalljac_curve_t curve, unsigned long q, int good, long a[], int n, void *arg), void *arg,
+				       long (*compute)(smalljac_curve_t, unsigned long, unsigned long, unsigned long, int (*)(smalljac_curve_t, unsigned long, int, long[], int, void *), void *));
+
 static inline unsigned long smalljac_curve_max_p (smalljac_curve *sc)
 {
 	if ( sc->special && (sc->flags&SMALLJAC_A1_ONLY) ) return (1L<<44);		// MAX_ENUM_PRIME
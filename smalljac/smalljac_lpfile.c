@@ -0,0 +1,464 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include <gmp.h>
+#include "smalljac.h"
+#include "smalljac_internal.h"
+#include "cstd.h"
+
+/*
+    Copyright (c) 2026 The smalljac contributors
+    See LICENSE file for license details.
+*/
+
+/*
+	Binary L-polynomial data files (an alternative to the text files written by lpdata).
+
+	The file consists of a fixed header, the curve string (null terminated), the data blocks, and a block index.
+	Each block holds SMALLJAC_LPFILE_BLOCK records (the last may hold fewer), and each record is encoded as a
+	varint (q-q0)<<1|bad, where q0 is the norm of the previous record in the same block (0 for the first record
+	of the block), followed, for good records, by n zigzag varints a_1,...,a_n.  Blocks can thus be decoded
+	independently, and the index, which lists the first norm and file offset of each block, allows a reader to
+	seek to any norm with a binary search.  Multiple records with the same norm are permitted (this happens over
+	number fields), but norms must be nondecreasing.
+
+	Readers memory map the file, so nothing is read that is not used.  All integers in the header and index are
+	stored in native byte order (as with the cache file).  The reader also handles text files written by lpdata,
+	which are parsed in place (no copying through stdio buffers), so the same interface works with either format.
+
+	Text files may also be gzip compressed.  If every gzip member carries the "SJ" extra field written by smalljac_writer
+	(which records the length of the member), the members are located without decompressing anything and each chunk of
+	the file decompresses only its own members (so parallel readers decompress in parallel); otherwise the whole file is
+	decompressed as a single chunk.  Members written by smalljac_writer always end on a line boundary.
+*/
+
+#define SMALLJAC_LPFILE_MAGIC		0x3144504c4a53UL			// "SJLPD1"
+#define SMALLJAC_LPFILE_VERSION		1
+#define SMALLJAC_LPFILE_BLOCK		4096						// records per block
+#define SMALLJAC_LPFILE_BUFSIZE		(1<<20)						// stdio buffer size for the writer
+#define SMALLJAC_LPFILE_MAX_RECORD	(10*(SMALLJAC_MAX_GENUS+1))	// max bytes in an encoded record
+
+struct smalljac_lpfile_header {
+	uint64_t magic;
+	uint32_t version, n;									// n is the number of coefficients stored for good records (1 or g)
+	uint32_t genus, block;
+	uint64_t start, end;									// range of norms covered by the data (as in the text header)
+	uint64_t records, blocks;
+	uint64_t index;										// file offset of the block index
+	uint32_t curvelen, reserved;								// length of the curve string (including the terminating null)
+};
+
+struct smalljac_lpfile_index_entry {
+	uint64_t q;											// norm of the first record in the block
+	uint64_t offset;										// file offset of the block
+};
+
+struct smalljac_lpfile_gzmember {
+	unsigned long offset, len, size;							// offset and length of a gzip member in the file, and its uncompressed size (0 if unknown)
+};
+
+typedef struct smalljac_lpfile_struct {
+	struct smalljac_lpfile_header hdr;
+	char *curve;
+	// writer
+	FILE *fp;
+	char *buf;
+	struct smalljac_lpfile_index_entry *index;
+	unsigned long maxblocks, offset, lastq;
+	// reader
+	unsigned char *map, *ptr, *data, *dataend;
+	size_t len;
+	unsigned long rec, q;
+	unsigned long b0, b1, recend;								// current chunk of a binary file (block range and record bound)
+	unsigned char *lo, *end;									// current chunk of a text file
+	int text;
+	struct smalljac_lpfile_gzmember *gz;							// members of a compressed text file
+	unsigned long gzmembers, g0, g1;							// g0..g1-1 are the members in the current chunk
+	unsigned char *gzbuf;									// uncompressed data for the current chunk
+	int gzload;											// set if the current chunk still needs to be decompressed
+	char line[SMALLJAC_CURVE_STRING_LEN+256];					// header line of a text file
+} smalljac_lpfile;
+
+/*
+	Creates a binary data file for the curve with the specified string (as it would appear in the first line of an lpdata text file).
+	n is the number of coefficients to be stored for each good record (1 or genus).  Returns null if the file cannot be created.
+*/
+smalljac_lpfile_t smalljac_lpfile_create (char *filename, char *curve, unsigned long start, unsigned long end, int genus, int n)
+{
+	smalljac_lpfile *F;
+
+	if ( genus < 1 || genus > SMALLJAC_MAX_GENUS || n < 1 || n > genus ) { err_printf ("smalljac_lpfile_create: invalid genus %d or coefficient count %d\n", genus, n);  return 0; }
+	F = mem_alloc (sizeof(*F));
+	F->fp = fopen (filename, "w");
+	if ( ! F->fp ) { err_printf ("smalljac_lpfile_create: unable to create file %s\n", filename);  mem_free (F);  return 0; }
+	F->buf = mem_alloc (SMALLJAC_LPFILE_BUFSIZE);
+	setvbuf (F->fp, F->buf, _IOFBF, SMALLJAC_LPFILE_BUFSIZE);
+	F->hdr.magic = SMALLJAC_LPFILE_MAGIC;  F->hdr.version = SMALLJAC_LPFILE_VERSION;
+	F->hdr.n = n;  F->hdr.genus = genus;  F->hdr.block = SMALLJAC_LPFILE_BLOCK;
+	F->hdr.start = start;  F->hdr.end = end;
+	F->hdr.curvelen = strlen(curve)+1;
+	F->maxblocks = 1024;
+	F->index = mem_alloc (F->maxblocks*sizeof(*F->index));
+	if ( fwrite (&F->hdr, sizeof(F->hdr), 1, F->fp) != 1 || fwrite (curve, 1, F->hdr.curvelen, F->fp) != F->hdr.curvelen ) {
+		err_printf ("smalljac_lpfile_create: error writing file %s\n", filename);  fclose (F->fp);  mem_free (F->buf);  mem_free (F->index);  mem_free (F);  return 0;
+	}
+	fflush (F->fp);				// flush now so that processes forked later (e.g. by smalljac_parallel_Lpolys) do not write the header again on exit
+	F->offset = sizeof(F->hdr) + F->hdr.curvelen;
+	return (smalljac_lpfile_t) F;
+}
+
+// changes the range of norms recorded in the header of a file being written (e.g. when a computation stops early)
+void smalljac_lpfile_set_range (smalljac_lpfile_t file, unsigned long start, unsigned long end)
+	{ smalljac_lpfile *F = (smalljac_lpfile *) file;  F->hdr.start = start;  F->hdr.end = end; }
+
+/*
+	Appends a record (the arguments match those of a smalljac_Lpolys callback, so this can be called directly from one).
+	n must be 0 for bad reduction, otherwise at least the number of coefficients specified when the file was created (any extra are ignored).
+	Returns 1 on success, 0 on error.
+*/
+int smalljac_lpfile_append (smalljac_lpfile_t file, unsigned long q, int good, long a[], int n)
+{
+	smalljac_lpfile *F = (smalljac_lpfile *) file;
+	unsigned char rec[SMALLJAC_LPFILE_MAX_RECORD];
+	register unsigned long b, q0;
+	register int i, k;
+
+	if ( ! F->fp ) return 0;
+	if ( q < F->lastq ) { err_printf ("smalljac_lpfile_append: norms must be nondecreasing (%lu < %lu)\n", q, F->lastq);  return 0; }
+	if ( good && n < (int)F->hdr.n ) { err_printf ("smalljac_lpfile_append: expected %d coefficients, got %d\n", F->hdr.n, n);  return 0; }
+	b = F->hdr.records / SMALLJAC_LPFILE_BLOCK;
+	if ( ! (F->hdr.records % SMALLJAC_LPFILE_BLOCK) ) {
+		if ( b == F->maxblocks ) {
+			F->maxblocks *= 2;
+			F->index = realloc (F->index, F->maxblocks*sizeof(*F->index));
+			if ( ! F->index ) { fprintf (stderr, "Fatal error, realloc failed in smalljac_lpfile_append\n");  abort(); }
+		}
+		F->index[b].q = q;  F->index[b].offset = F->offset;
+		q0 = 0;
+	} else {
+		q0 = F->lastq;
+	}
+	k = smalljac_put_varint (rec, ((q-q0)<<1) | (good ? 0 : 1));
+	if ( good ) for ( i = 0 ; i < F->hdr.n ; i++ ) k += smalljac_put_varint (rec+k, smalljac_zigzag (a[i]));
+	if ( fwrite (rec, 1, k, F->fp) != k ) { err_printf ("smalljac_lpfile_append: write failed\n");  return 0; }
+	F->offset += k;  F->lastq = q;  F->hdr.records++;
+	return 1;
+}
+
+// returns a pointer to the start of the line following the one containing s (or end)
+static inline unsigned char *_lpf_next_line (unsigned char *s, unsigned char *end)
+	{ while ( s < end && *s != '\n' ) s++;  return ( s < end ? s+1 : end ); }
+
+// parses a text record "q,a_1,...,a_n" or "q,?" at *ps (see smalljac_Lpolys_from_file), and advances *ps to the next line
+// returns n, 0 for bad reduction, or -2 for a format error
+static int _lpf_parse_text (unsigned long *q, long a[], unsigned char **ps, unsigned char *end)
+{
+	register unsigned char *s;
+	register unsigned long x;
+	register int i, neg;
+
+	s = *ps;
+	for ( x = 0 ; s < end && *s >= '0' && *s <= '9' ; s++ ) x = 10*x + (*s-'0');
+	if ( ! x ) return -2;
+	*q = x;
+	for ( i = 0 ; s < end && *s == ',' ; ) {
+		for ( s++ ; s < end && *s == ' ' ; s++ );
+		if ( s < end && *s == '?' ) { *ps = _lpf_next_line (s, end);  return 0; }
+		if ( i == SMALLJAC_MAX_GENUS ) return -2;
+		if ( (neg = (s < end && *s == '-')) ) s++;
+		if ( s == end || *s < '0' || *s > '9' ) return -2;
+		for ( x = 0 ; s < end && *s >= '0' && *s <= '9' ; s++ ) x = 10*x + (*s-'0');
+		a[i++] = ( neg ? -(long)x : (long)x );
+	}
+	if ( ! i || (s < end && *s != '\n' && *s != '\r') ) return -2;
+	*ps = _lpf_next_line (s, end);
+	return i;
+}
+
+static inline unsigned long _lpf_get16 (unsigned char *s)  { return s[0] | (unsigned long)s[1]<<8; }
+static inline unsigned long _lpf_get32 (unsigned char *s)  { return s[0] | (unsigned long)s[1]<<8 | (unsigned long)s[2]<<16 | (unsigned long)s[3]<<24; }
+
+// locates the members of a gzip file using the "SJ" extra field (see smalljac_writer.c), if any member lacks it the file is treated as one member
+static void _lpf_gz_index (smalljac_lpfile *F, unsigned char *map, unsigned long len)
+{
+	unsigned long o, x, n, max;
+	register unsigned char *s, *t;
+
+	max = 16;
+	F->gz = mem_alloc (max*sizeof(*F->gz));
+	for ( o = 0, n = 0 ; o < len ; o += F->gz[n++].len ) {
+		s = map + o;
+		if ( len - o < 18 || s[0] != 0x1f || s[1] != 0x8b || s[2] != 8 || ! (s[3]&4) ) break;
+		x = _lpf_get16 (s+10);
+		if ( len - o < 12 + x ) break;
+		for ( t = s+12 ; t+4 <= s+12+x ; t += 4 + _lpf_get16(t+2) ) if ( t[0] == 'S' && t[1] == 'J' && _lpf_get16(t+2) == 8 ) break;
+		if ( t+12 > s+12+x ) break;
+		if ( (x = _lpf_get32 (t+4)) < 20 || x > len - o ) break;
+		if ( n == max ) {
+			max *= 2;
+			F->gz = realloc (F->gz, max*sizeof(*F->gz));
+			if ( ! F->gz ) { fprintf (stderr, "Fatal error, realloc failed in smalljac_lpfile_open\n");  abort(); }
+		}
+		F->gz[n].offset = o;  F->gz[n].len = x;  F->gz[n].size = _lpf_get32 (t+8);
+	}
+	if ( o != len ) { F->gz[0].offset = 0;  F->gz[0].len = len;  F->gz[0].size = 0;  n = 1; }
+	F->gzmembers = n;
+}
+
+// decompresses a gzip member (or a sequence of them) into *pbuf at offset pos, growing *pbuf (of size *psize) as required, returns the new offset or 0 on error
+static unsigned long _lpf_gz_inflate (unsigned char **pbuf, unsigned long *psize, unsigned long pos, unsigned char *src, unsigned long len)
+{
+	z_stream z;
+	int sts;
+
+	memset (&z, 0, sizeof(z));
+	if ( inflateInit2 (&z, 16+MAX_WBITS) != Z_OK ) return 0;
+	z.next_in = src;  z.avail_in = len;
+	for (;;) {
+		if ( pos == *psize || ! *pbuf ) {
+			if ( pos == *psize ) *psize = 2*(*psize) + 4096;
+			*pbuf = realloc (*pbuf, *psize);
+			if ( ! *pbuf ) { fprintf (stderr, "Fatal error, realloc failed in smalljac_lpfile_next\n");  abort(); }
+		}
+		z.next_out = *pbuf + pos;  z.avail_out = *psize - pos;
+		sts = inflate (&z, Z_NO_FLUSH);
+		pos = *psize - z.avail_out;
+		if ( sts == Z_STREAM_END ) { if ( ! z.avail_in ) break;  if ( inflateReset (&z) != Z_OK ) { pos = 0;  break; }  continue; }	// concatenated members
+		if ( sts != Z_OK && sts != Z_BUF_ERROR ) { pos = 0;  break; }
+		if ( sts == Z_BUF_ERROR && z.avail_out ) { pos = 0;  break; }							// truncated input
+	}
+	inflateEnd (&z);
+	return pos;
+}
+
+// decompresses the members in the current chunk of a compressed text file, returns 0 on error (and will do so again if called again)
+static int _lpf_gz_load (smalljac_lpfile *F)
+{
+	unsigned long i, pos, size;
+
+	for ( size = 0, i = F->g0 ; i < F->g1 ; i++ ) size += F->gz[i].size;
+	if ( F->gzbuf ) mem_free (F->gzbuf);
+	F->gzbuf = malloc (size ? size : 1);
+	if ( ! F->gzbuf ) { fprintf (stderr, "Fatal error, attempted memory allocation of %lu bytes failed.\n", size);  abort(); }
+	for ( pos = 0, i = F->g0 ; i < F->g1 ; i++ ) if ( ! (pos = _lpf_gz_inflate (&F->gzbuf, &size, pos, F->map + F->gz[i].offset, F->gz[i].len)) ) break;
+	F->lo = F->ptr = F->gzbuf;  F->end = F->gzbuf + pos;
+	F->gzload = ( i < F->g1 );
+	return ! F->gzload;
+}
+
+// parses the header line of a text file at s, returns a pointer to the next line or null if there is no valid header
+static unsigned char *_lpf_text_header (smalljac_lpfile *F, unsigned char *s, unsigned char *end, char *filename)
+{
+	unsigned char *t;
+	long start, stop;
+	int genus;
+
+	t = _lpf_next_line (s, end);
+	if ( s[0] != '[' || t-s >= SMALLJAC_CURVE_STRING_LEN+256 ) { err_printf ("curve spec missing from first line of data file %s\n", filename);  return 0; }
+	memcpy (F->line, s, t-s);  F->line[t-s] = '\0';
+	if ( ! smalljac_parse_file_header (F->line, &start, &stop, &genus) ) {
+		err_printf ("unable to find curve spec and prime range in the first line of the specified field %s\n", filename);  return 0;
+	}
+	F->text = 1;
+	F->curve = F->line;
+	F->hdr.start = start;  F->hdr.end = stop;  F->hdr.genus = genus;
+	return t;
+}
+
+/*
+	Opens an existing data file for reading, either a binary file or a text file written by lpdata (the format is detected automatically).
+	The file is memory mapped and records are parsed in place.  Returns null if the file cannot be opened or is not a valid data file.
+*/
+smalljac_lpfile_t smalljac_lpfile_open (char *filename)
+{
+	smalljac_lpfile *F;
+	struct smalljac_lpfile_header hdr;
+	struct stat st;
+	unsigned char *map, *s;
+	unsigned long size, len;
+	int fd;
+
+	fd = open (filename, O_RDONLY);
+	if ( fd < 0 ) return 0;
+	if ( fstat (fd, &st) < 0 || ! st.st_size ) { err_printf ("smalljac_lpfile_open: %s is empty\n", filename);  close (fd);  return 0; }
+	if ( st.st_size >= sizeof(hdr) && pread (fd, &hdr, sizeof(hdr), 0) == sizeof(hdr) && hdr.magic == SMALLJAC_LPFILE_MAGIC ) {
+		if ( hdr.version != SMALLJAC_LPFILE_VERSION || hdr.n < 1 || hdr.n > SMALLJAC_MAX_GENUS || ! hdr.block || hdr.blocks != (hdr.records+hdr.block-1)/hdr.block
+		     || ! hdr.curvelen || sizeof(hdr) + hdr.curvelen > hdr.index || hdr.index + hdr.blocks*sizeof(struct smalljac_lpfile_index_entry) != st.st_size ) {
+			err_printf ("smalljac_lpfile_open: %s is not a valid binary data file (it may be incomplete)\n", filename);  close (fd);  return 0;
+		}
+	} else {
+		hdr.magic = 0;
+	}
+	map = mmap (0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close (fd);
+	if ( map == MAP_FAILED ) { err_printf ("smalljac_lpfile_open: mmap failed on file %s\n", filename);  return 0; }
+	if ( hdr.magic ) {
+		if ( map[sizeof(hdr)+hdr.curvelen-1] ) { err_printf ("smalljac_lpfile_open: %s is not a valid binary data file\n", filename);  munmap (map, st.st_size);  return 0; }
+		F = mem_alloc (sizeof(*F));
+		F->hdr = hdr;
+		F->curve = (char *)map + sizeof(hdr);
+		F->index = (struct smalljac_lpfile_index_entry *)(map + hdr.index);
+		F->data = map + sizeof(hdr) + hdr.curvelen;  F->dataend = map + hdr.index;
+	} else if ( st.st_size >= 18 && map[0] == 0x1f && map[1] == 0x8b ) {
+		// compressed text file, decompress the first member to get the header line
+		F = mem_alloc (sizeof(*F));
+		F->map = map;
+		_lpf_gz_index (F, map, st.st_size);
+		size = F->gz[0].size;  s = 0;
+		len = _lpf_gz_inflate (&s, &size, 0, map, F->gz[0].len);
+		if ( ! len || ! _lpf_text_header (F, s, s+len, filename) ) {
+			if ( ! len ) err_printf ("smalljac_lpfile_open: error decompressing %s\n", filename);
+			free (s);  munmap (map, st.st_size);  mem_free (F->gz);  mem_free (F);  return 0;
+		}
+		free (s);
+		F->data = F->dataend = 0;
+	} else {
+		// text file, the first line should be a header of the form "[curve] start end" (possibly with a genus specifier, see smalljac_parse_file_header)
+		F = mem_alloc (sizeof(*F));
+		if ( ! (s = _lpf_text_header (F, map, map+st.st_size, filename)) ) { munmap (map, st.st_size);  mem_free (F);  return 0; }
+		F->data = s;  F->dataend = map + st.st_size;
+	}
+	madvise (map, st.st_size, MADV_SEQUENTIAL);
+	F->map = map;  F->len = st.st_size;
+	smalljac_lpfile_chunk ((smalljac_lpfile_t) F, 0, 1);
+	return (smalljac_lpfile_t) F;
+}
+
+// For text files genus is 0 if it is not specified in the header, and n and records are always 0 (unknown)
+void smalljac_lpfile_info (smalljac_lpfile_t file, char **curve, unsigned long *start, unsigned long *end, int *genus, int *n, unsigned long *records)
+{
+	smalljac_lpfile *F = (smalljac_lpfile *) file;
+
+	if ( curve ) *curve = ( F->map ? F->curve : 0 );
+	if ( start ) *start = F->hdr.start;
+	if ( end ) *end = F->hdr.end;
+	if ( genus ) *genus = F->hdr.genus;
+	if ( n ) *n = F->hdr.n;
+	if ( records ) *records = F->hdr.records;
+}
+
+/*
+	Restricts the reader to the k-th of m chunks of the file (0 <= k < m) and positions it at the start of the chunk.
+	The chunks partition the records of the file, breaking at block boundaries for binary files, at line boundaries
+	for text files, and at member boundaries for compressed text files, so that they can be processed independently
+	(e.g. in parallel, see smalljac_Lpolys_reduce_file).  Compressed chunks are decompressed when they are first read.
+*/
+void smalljac_lpfile_chunk (smalljac_lpfile_t file, int k, int m)
+{
+	smalljac_lpfile *F = (smalljac_lpfile *) file;
+	unsigned long len;
+
+	if ( F->gz ) {
+		F->g0 = (F->gzmembers*k)/m;  F->g1 = (F->gzmembers*(k+1))/m;
+		F->lo = F->end = F->ptr = 0;
+		F->gzload = 1;
+	} else if ( F->text ) {
+		len = F->dataend - F->data;
+		F->lo = ( k ? _lpf_next_line (F->data + (len*k)/m - 1, F->dataend) : F->data );
+		F->end = ( k+1 < m ? _lpf_next_line (F->data + (len*(k+1))/m - 1, F->dataend) : F->dataend );
+		F->ptr = F->lo;
+	} else {
+		F->b0 = (F->hdr.blocks*k)/m;  F->b1 = (F->hdr.blocks*(k+1))/m;
+		F->rec = F->b0*F->hdr.block;
+		F->recend = ( F->b1*F->hdr.block < F->hdr.records ? F->b1*F->hdr.block : F->hdr.records );
+		F->ptr = ( F->b0 < F->hdr.blocks ? F->map + F->index[F->b0].offset : F->dataend );
+	}
+}
+
+/*
+	Positions the reader so that the next record returned by smalljac_lpfile_next is the first record (in the current chunk) with norm >= q.
+	Uses a binary search on the block index for binary files (so at most one block is decoded), and a binary search on line
+	boundaries for text files (which are assumed to be sorted by norm, as are the files written by lpdata).
+*/
+void smalljac_lpfile_seek (smalljac_lpfile_t file, unsigned long q)
+{
+	smalljac_lpfile *F = (smalljac_lpfile *) file;
+	unsigned long a[SMALLJAC_MAX_GENUS], p, q0, r0;
+	register unsigned long lo, hi, mid;
+	unsigned char *s, *t, *u;
+
+	if ( F->text ) {
+		if ( F->gzload && ! _lpf_gz_load (F) ) return;
+		// invariant: every record before s has norm < q, and the record at u (if any) has norm >= q
+		for ( s = F->lo, u = F->end ; u-s > 4096 ; ) {
+			for ( t = _lpf_next_line (s+(u-s)/2, u) ; t < u && *t == '[' ; t = _lpf_next_line (t, u) );
+			if ( t >= u ) break;
+			F->ptr = t;
+			if ( _lpf_parse_text (&p, (long *)a, &F->ptr, u) < 0 ) break;						// leave it to the linear scan
+			if ( p < q ) s = t; else u = t;
+		}
+		F->ptr = s;
+	} else {
+		// find the last block in the chunk whose first norm is less than q (repeated norms may straddle a block boundary)
+		for ( lo = F->b0, hi = F->b1 ; lo < hi ; ) { mid = (lo+hi)/2;  if ( F->index[mid].q < q ) lo = mid+1; else hi = mid; }
+		if ( lo > F->b0 ) lo--;
+		F->rec = lo*F->hdr.block;
+		F->ptr = ( lo < F->hdr.blocks ? F->map + F->index[lo].offset : F->dataend );
+	}
+	for (;;) {
+		s = F->ptr;  q0 = F->q;  r0 = F->rec;
+		if ( smalljac_lpfile_next (file, &p, (long *)a) < 0 ) break;
+		if ( p >= q ) { F->ptr = s;  F->q = q0;  F->rec = r0;  break; }		// back up one record (the gap of the next record is relative to q0)
+	}
+}
+
+/*
+	Reads the next record, setting *q and, for good records, a[0..n-1], where n is the number of coefficients stored in the file.
+	Returns n for a good record, 0 for bad reduction, -1 at the end of the file (or chunk), and -2 if the data is corrupt.
+*/
+int smalljac_lpfile_next (smalljac_lpfile_t file, unsigned long *q, long a[])
+{
+	smalljac_lpfile *F = (smalljac_lpfile *) file;
+	unsigned long x;
+	register int i;
+
+	if ( F->text ) {
+		if ( F->gzload && ! _lpf_gz_load (F) ) return -2;
+		for (;;) {
+			if ( F->ptr >= F->end ) return -1;
+			if ( *F->ptr != '[' && *F->ptr != '\n' && *F->ptr != '\r' ) break;
+			F->ptr = _lpf_next_line (F->ptr, F->end);									// skip repeated headers (handy for merged files) and blank lines
+		}
+		return _lpf_parse_text (q, a, &F->ptr, F->end);
+	}
+	if ( F->rec >= F->recend ) return -1;
+	if ( ! (F->rec % F->hdr.block) ) F->q = 0;
+	if ( ! (F->ptr = smalljac_get_varint (&x, F->ptr, F->dataend)) ) return -2;
+	F->q += x>>1;  *q = F->q;  F->rec++;
+	if ( (x&1) ) return 0;
+	for ( i = 0 ; i < F->hdr.n ; i++ ) { if ( ! (F->ptr = smalljac_get_varint (&x, F->ptr, F->dataend)) ) return -2;  a[i] = smalljac_unzigzag (x); }
+	return F->hdr.n;
+}
+
+/*
+	Closes a file opened for reading or writing.  For writers this writes the block index and finalizes the header,
+	returns 1 on success and 0 if an error occurred (in which case the file should be considered invalid).
+*/
+int smalljac_lpfile_close (smalljac_lpfile_t file)
+{
+	smalljac_lpfile *F = (smalljac_lpfile *) file;
+	int sts;
+
+	sts = 1;
+	if ( F->fp ) {
+		F->hdr.blocks = (F->hdr.records+SMALLJAC_LPFILE_BLOCK-1) / SMALLJAC_LPFILE_BLOCK;
+		F->hdr.index = F->offset;
+		if ( fwrite (F->index, sizeof(*F->index), F->hdr.blocks, F->fp) != F->hdr.blocks ) sts = 0;
+		if ( fseek (F->fp, 0, SEEK_SET) || fwrite (&F->hdr, sizeof(F->hdr), 1, F->fp) != 1 ) sts = 0;
+		if ( fclose (F->fp) ) sts = 0;
+		if ( ! sts ) err_printf ("smalljac_lpfile_close: error writing data file\n");
+		mem_free (F->buf);
+		mem_free (F->index);
+	}
+	if ( F->map ) munmap (F->map, F->len);
+	if ( F->gz ) mem_free (F->gz);
+	if ( F->gzbuf ) mem_free (F->gzbuf);
+	mem_free (F);
+	return sts;
+}
@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
 #include "smalljac.h"
 #include "smalljac_internal.h"
 
@@ -98,76 +99,125 @@ int smalljac_moments_callback (smalljac_curve_t curve, unsigned long p, int good
 	return 1;
 }
 
-int smalljac_moments (smalljac_curve_t curve, unsigned long start, unsigned long end, double moments[], int n, int m, char STgroup[16], smalljac_filter_callback filter_callback, void *arg)
+// identifies the ST group (if STgroup is non-null) and normalizes the moments accumulated in ctx
+static void smalljac_moments_finish (struct smalljac_moments_ctx *ctx, int genus, double moments[], int n, int m, char STgroup[16])
 {
-	struct smalljac_moments_ctx ctx;
-	int genus, r, i;
-	unsigned long flags;
 	double z1, z2[5], m1sq[3], m2[4];
-
-	genus = smalljac_curve_genus(curve);
-	if ( genus < n ) { err_printf ("Invalid n=%d > genus=%d in smalljac_moments\n", n, genus); return SMALLJAC_INVALID_FLAGS; }
-
-	flags = 0;
-	flags |= SMALLJAC_DEGREE1_ONLY;
-
-	if ( n == 1 ) flags |= SMALLJAC_A1_ONLY;
-	
-	smalljac_moments_ctx_init(&ctx);
-
-	if ( filter_callback ) {
-		ctx.filter_callback = filter_callback;
-		ctx.filter_arg = arg;
-		flags |= SMALLJAC_FILTER;
-	}
-	
-	//smalljac_moments_compute(curve, start, end, flags, &ctx);
-	smalljac_parallel_Lpolys(curve, start, end, flags, smalljac_moments_callback, &ctx);
+	int r, i;
 
 	if ( STgroup ) {
 		if ( genus == 2 && n == 2 ) {
 			// Compute signature
-			z1 = (double)ctx.zero_count/ctx.good_count;
+			z1 = (double)ctx->zero_count/ctx->good_count;
 			for ( i = 0 ; i < 5 ; i++ ) {
-				z2[i] = (double)ctx.a2_icounts[A2MAX-2+i]/ctx.good_count;
+				z2[i] = (double)ctx->a2_icounts[A2MAX-2+i]/ctx->good_count;
 			}
 
-			m1sq[1] = ctx.moments[2]/ctx.good_count;
-			m1sq[2] = ctx.moments[4]/ctx.good_count;
-			m2[1] = ctx.a2moments[1]/ctx.good_count;
-			m2[2] = ctx.a2moments[2]/ctx.good_count;
-			m2[3] = ctx.a2moments[3]/ctx.good_count;
+			m1sq[1] = ctx->moments[2]/ctx->good_count;
+			m1sq[2] = ctx->moments[4]/ctx->good_count;
+			m2[1] = ctx->a2moments[1]/ctx->good_count;
+			m2[2] = ctx->a2moments[2]/ctx->good_count;
+			m2[3] = ctx->a2moments[3]/ctx->good_count;
 
 			// Look up signature
 			r = smalljac_lookup_g2_STgroup (STgroup, z1, z2, m1sq, m2);
 			if ( ! r ) STgroup[0] = '\0';
 		} else if ( genus == 1 ) {
 			// Compute signature
-			z1 = (double)ctx.zero_count/ctx.good_count;
-			m1sq[1] = ctx.moments[2]/ctx.good_count;
-			m1sq[2] = ctx.moments[4]/ctx.good_count;
+			z1 = (double)ctx->zero_count/ctx->good_count;
+			m1sq[1] = ctx->moments[2]/ctx->good_count;
+			m1sq[2] = ctx->moments[4]/ctx->good_count;
 
 			// Look up signature
 			r = smalljac_lookup_g1_STgroup (STgroup, z1, m1sq);
 			if ( ! r ) STgroup[0] = '\0';
 		}
 	}
-	if ( ! moments || ! m || ! n ) return 0;
+	if ( ! moments || ! m || ! n ) return;
 	moments[0] = 1.0;
 	for ( int i = 1; i < m; i++ ) {
-		moments[i] = ctx.moments[i] / ctx.good_count;
+		moments[i] = ctx->moments[i] / ctx->good_count;
 	}
 	if ( 2 <= n) {
 		moments[m] = 1.0;
 		for ( int i = 1; i < m; i++) {
-			moments[i + m] = ctx.a2moments[i] / ctx.good_count;
+			moments[i + m] = ctx->a2moments[i] / ctx->good_count;
 		}
 	}
 	if ( 3 <= n) {
 		moments[2*m] = 1.0;
 		for ( int i = 1; i < m; i++) {
-			moments[i + 2*m] = ctx.a3moments[i] / ctx.good_count;
+			moments[i + 2*m] = ctx->a3moments[i] / ctx->good_count;
 		}
 	}
-    return 0;
+}
+
+int smalljac_moments (smalljac_curve_t curve, unsigned long start, unsigned long end, double moments[], int n, int m, char STgroup[16], smalljac_filter_callback filter_callback, void *arg)
+	{ return smalljac_moments_set (curve, start, end, 0, moments, n, m, STgroup, filter_callback, arg); }
+
+// if S is non-null only primes in S are considered, and filter_callback (if any) is only called for these primes
+int smalljac_moments_set (smalljac_curve_t curve, unsigned long start, unsigned long end, smalljac_prime_set_t S, double moments[], int n, int m, char STgroup[16], smalljac_filter_callback filter_callback, void *arg)
+{
+	struct smalljac_moments_ctx ctx;
+	int genus;
+	unsigned long flags;
+
+	genus = smalljac_curve_genus(curve);
+	if ( genus < n ) { err_printf ("Invalid n=%d > genus=%d in smalljac_moments\n", n, genus); return SMALLJAC_INVALID_FLAGS; }
+
+	flags = 0;
+	flags |= SMALLJAC_DEGREE1_ONLY;
+
+	if ( n == 1 ) flags |= SMALLJAC_A1_ONLY;
+	
+	smalljac_moments_ctx_init(&ctx);
+
+	if ( filter_callback ) {
+		ctx.filter_callback = filter_callback;
+		ctx.filter_arg = arg;
+		flags |= SMALLJAC_FILTER;
+	}
+	
+	//smalljac_moments_compute(curve, start, end, flags, &ctx);
+	if ( S ) smalljac_parallel_Lpolys_set (curve, start, end, S, flags, smalljac_moments_callback, &ctx);
+	else smalljac_parallel_Lpolys (curve, start, end, flags, smalljac_moments_callback, &ctx);
+
+	smalljac_moments_finish (&ctx, genus, moments, n, m, STgroup);
+	return 0;
+}
+
+// adds the counts and sums of the child context child_state to the context state (for smalljac_Lpolys_reduce_file)
+static void smalljac_moments_merge (void *state, void *child_state)
+{
+	struct smalljac_moments_ctx *ctx = (struct smalljac_moments_ctx *) state, *child = (struct smalljac_moments_ctx *) child_state;
+	int i;
+
+	ctx->ap_total += child->ap_total;  ctx->tot_count += child->tot_count;  ctx->good_count += child->good_count;
+	ctx->bad_count += child->bad_count;  ctx->zero_count += child->zero_count;
+	for ( i = 0 ; i < 2*A2MAX+1 ; i++ ) ctx->a2_icounts[i] += child->a2_icounts[i];
+	for ( i = 0 ; i < MOMENTS ; i++ ) { ctx->moments[i] += child->moments[i];  ctx->a2moments[i] += child->a2moments[i];  ctx->a3moments[i] += child->a3moments[i]; }
+}
+
+// same as smalljac_moments but using the precomputed data in filename (scanned in parallel), returns the number of records used or an error code
+long smalljac_moments_file (char *filename, unsigned long start, unsigned long end, double moments[], int n, int m, char STgroup[16])
+{
+	struct smalljac_moments_ctx ctx;
+	smalljac_lpfile_t lf;
+	smalljac_curve *sc;
+	long result;
+	int genus, fn, err;
+
+	if ( ! (lf = smalljac_lpfile_open (filename)) ) return ( access (filename, R_OK) ? SMALLJAC_FILENOTFOUND : SMALLJAC_BADFILE );
+	sc = smalljac_lpfile_curve (lf, filename, ( n == 1 ? SMALLJAC_A1_ONLY : 0 ), &fn, &err);
+	smalljac_lpfile_close (lf);
+	if ( ! sc ) return err;
+	genus = sc->genus;
+	smalljac_curve_clear (sc);
+	if ( genus < n ) { err_printf ("Invalid n=%d > genus=%d in smalljac_moments_file\n", n, genus); return SMALLJAC_INVALID_FLAGS; }
+
+	smalljac_moments_ctx_init(&ctx);
+	result = smalljac_Lpolys_reduce_file (filename, start, end, ( n == 1 ? SMALLJAC_A1_ONLY : 0 ), smalljac_moments_callback, &ctx, sizeof(ctx), smalljac_moments_merge);
+	if ( result < 0 ) return result;
+	smalljac_moments_finish (&ctx, genus, moments, n, m, STgroup);
+	return result;
 }
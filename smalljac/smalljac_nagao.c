@@ -0,0 +1,276 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <unistd.h>
+#include <gmp.h>
+#include "smalljac.h"
+#include "smalljac_internal.h"
+#include "cstd.h"
+
+/*
+    Copyright (c) 2026 The smalljac contributors
+    See LICENSE file for license details.
+*/
+
+/*
+	Mestre-Nagao sums for ranking elliptic curves by (heuristic) rank, see smalljac.h for the definitions of S_1,...,S_6.
+
+	Each curve is handled by a call to smalljac_Lpolys with SMALLJAC_A1_ONLY|SMALLJAC_GOOD_ONLY (the fast genus 1 path), whose callback
+	just saves (p,a_p) in a block.  Full blocks are reduced by computing the terms of each selected sum into an array and adding
+	them up in SMALLJAC_NAGAO_LANES independent accumulators, which lets the compiler vectorize the loops without reassociating
+	floating point sums (the result does not depend on the compiler).  Early termination is checked at the primes start+w, start+2w,
+	start+4w, ... (w = the initial checkpoint), where the block is flushed and the selected sum is compared to the threshold.
+
+	Curves are distributed among child processes by smalljac_parallel_fork, each of which computes the sums for its curves into its
+	copy of a zeroed array of results that are then added up.  smalljac_nagao_sums_file computes the sums for a single curve from a
+	precomputed data file using smalljac_Lpolys_reduce_file, whose child processes each accumulate raw sums for a chunk of the file
+	that are then added up.
+*/
+
+#define SMALLJAC_NAGAO_BLOCK		1024			// must be a multiple of SMALLJAC_NAGAO_LANES
+#define SMALLJAC_NAGAO_LANES		4
+
+struct smalljac_nagao_ctx {
+	double p[SMALLJAC_NAGAO_BLOCK], a[SMALLJAC_NAGAO_BLOCK];		// batched primes and traces
+	double t[SMALLJAC_NAGAO_BLOCK], lp[SMALLJAC_NAGAO_BLOCK];
+	double r[SMALLJAC_NAGAO_SUMS];								// raw sums (see smalljac_nagao_eval)
+	unsigned long count;										// number of primes in the raw sums
+	unsigned long next, w;										// next checkpoint and current checkpoint interval (next = 0 if none)
+	double threshold;
+	int k, sums, stop, dropped;
+};
+
+// adds t[0],...,t[k-1] (k a multiple of SMALLJAC_NAGAO_LANES) using independent accumulators
+static inline double smalljac_nagao_reduce (double t[], int k)
+{
+	double acc[SMALLJAC_NAGAO_LANES];
+	register int i, j;
+
+	for ( j = 0 ; j < SMALLJAC_NAGAO_LANES ; j++ ) acc[j] = 0.0;
+	for ( i = 0 ; i < k ; i += SMALLJAC_NAGAO_LANES ) for ( j = 0 ; j < SMALLJAC_NAGAO_LANES ; j++ ) acc[j] += t[i+j];
+	for ( j = 1 ; j < SMALLJAC_NAGAO_LANES ; j++ ) acc[0] += acc[j];
+	return acc[0];
+}
+
+// adds the batched primes into the raw sums
+static void smalljac_nagao_flush (struct smalljac_nagao_ctx *ctx)
+{
+	register double *p = ctx->p, *a = ctx->a, *t = ctx->t, *lp = ctx->lp;
+	register int i, k;
+
+	if ( ! ctx->k ) return;
+	ctx->count += ctx->k;
+	for ( k = ctx->k ; k % SMALLJAC_NAGAO_LANES ; k++ ) { p[k] = 2.0;  a[k] = 0.0; }		// pad with harmless values (their terms are zeroed below)
+	if ( (ctx->sums&(SMALLJAC_NAGAO_S1|SMALLJAC_NAGAO_S2|SMALLJAC_NAGAO_S3)) ) for ( i = 0 ; i < k ; i++ ) lp[i] = log(p[i]);
+	if ( (ctx->sums&SMALLJAC_NAGAO_S1) ) {
+		for ( i = 0 ; i < k ; i++ ) t[i] = (1.0 - (p[i]-1.0)/(p[i]+1.0-a[i])) * lp[i];
+		for ( i = ctx->k ; i < k ; i++ ) t[i] = 0.0;
+		ctx->r[0] += smalljac_nagao_reduce (t, k);
+	}
+	if ( (ctx->sums&SMALLJAC_NAGAO_S2) ) {
+		for ( i = 0 ; i < k ; i++ ) t[i] = a[i] * lp[i];
+		ctx->r[1] += smalljac_nagao_reduce (t, k);
+	}
+	if ( (ctx->sums&SMALLJAC_NAGAO_S3) ) {
+		for ( i = 0 ; i < k ; i++ ) t[i] = a[i] * lp[i] / p[i];
+		ctx->r[2] += smalljac_nagao_reduce (t, k);
+	}
+	if ( (ctx->sums&SMALLJAC_NAGAO_S4) ) {
+		for ( i = 0 ; i < k ; i++ ) t[i] = log1p ((1.0-a[i])/p[i]);
+		for ( i = ctx->k ; i < k ; i++ ) t[i] = 0.0;
+		ctx->r[3] += smalljac_nagao_reduce (t, k);
+	}
+	if ( (ctx->sums&SMALLJAC_NAGAO_S5) ) {
+		for ( i = 0 ; i < k ; i++ ) t[i] = a[i] / p[i];
+		ctx->r[4] += smalljac_nagao_reduce (t, k);
+	}
+	if ( (ctx->sums&SMALLJAC_NAGAO_S6) ) {
+		for ( i = 0 ; i < k ; i++ ) t[i] = a[i] / sqrt(p[i]);
+		ctx->r[5] += smalljac_nagao_reduce (t, k);
+	}
+	ctx->k = 0;
+}
+
+// normalizes the raw sums for the bound N (S[i] is set to 0 for sums that are not selected)
+static void smalljac_nagao_eval (double S[SMALLJAC_NAGAO_SUMS], struct smalljac_nagao_ctx *ctx, unsigned long N)
+{
+	double x = (double) N;
+	int i;
+
+	S[0] = ctx->r[0];
+	S[1] = -ctx->r[1] / x;
+	S[2] = ( N > 2 ? -ctx->r[2] / log(x) : 0.0 );
+	S[3] = ctx->r[3];
+	S[4] = -ctx->r[4];
+	S[5] = ( ctx->count ? -ctx->r[5] / ctx->count : 0.0 );
+	for ( i = 0 ; i < SMALLJAC_NAGAO_SUMS ; i++ ) if ( ! (ctx->sums&(1<<i)) ) S[i] = 0.0;
+}
+
+static int smalljac_nagao_callback (smalljac_curve_t curve, unsigned long p, int good, long a[], int n, void *arg)
+{
+	struct smalljac_nagao_ctx *ctx = (struct smalljac_nagao_ctx *) arg;
+	double S[SMALLJAC_NAGAO_SUMS];
+
+	if ( ! good ) return 1;
+	ctx->p[ctx->k] = (double) p;  ctx->a[ctx->k] = -(double) a[0];		// a[0] is the coefficient a_1 = #E(F_p)-p-1 of L_p(T), the trace is a_p = -a_1
+	if ( ++ctx->k == SMALLJAC_NAGAO_BLOCK ) smalljac_nagao_flush (ctx);
+	if ( ctx->next && p >= ctx->next ) {
+		smalljac_nagao_flush (ctx);
+		smalljac_nagao_eval (S, ctx, p);
+		if ( S[ctx->stop-1] < ctx->threshold ) { ctx->dropped = 1;  return 0; }
+		ctx->next = ( ctx->w > ULONG_MAX - ctx->next ? 0 : ctx->next + ctx->w );
+		ctx->w *= 2;
+	}
+	return 1;
+}
+
+// computes the sums for a single curve, returns 1 if it got to end, 0 if it was dropped, or an error code
+static int smalljac_nagao_curve (char *str, unsigned long start, unsigned long end, int sums, double S[SMALLJAC_NAGAO_SUMS], unsigned long *last,
+						   unsigned long checkpoint, int stop, double threshold)
+{
+	struct smalljac_nagao_ctx *ctx;
+	smalljac_curve_t curve;
+	long result;
+	int err;
+
+	memset (S, 0, SMALLJAC_NAGAO_SUMS*sizeof(S[0]));
+	*last = 0;
+	if ( ! (curve = smalljac_curve_init (str, &err)) ) return err;
+	if ( smalljac_curve_genus (curve) != 1 || smalljac_curve_nf_degree (curve) != 1 ) { smalljac_curve_clear (curve);  return SMALLJAC_UNSUPPORTED_CURVE; }
+	ctx = mem_alloc (sizeof(*ctx));
+	ctx->sums = sums;  ctx->stop = stop;  ctx->threshold = threshold;
+	if ( checkpoint ) { ctx->w = checkpoint;  ctx->next = ( start > ULONG_MAX - checkpoint ? 0 : start + checkpoint ); }
+	result = smalljac_Lpolys (curve, start, end, SMALLJAC_A1_ONLY|SMALLJAC_GOOD_ONLY, smalljac_nagao_callback, ctx);
+	smalljac_curve_clear (curve);
+	if ( result < 0 ) { mem_free (ctx);  return (int) result; }
+	smalljac_nagao_flush (ctx);
+	smalljac_nagao_eval (S, ctx, (unsigned long) result);
+	*last = (unsigned long) result;
+	result = ! ctx->dropped;												// a curve may be dropped at p = end
+	mem_free (ctx);
+	return (int) result;
+}
+
+struct smalljac_nagao_job {
+	char **curves;
+	long k;
+	unsigned long start, end, checkpoint;
+	int sums, stop;
+	double threshold;
+};
+
+/*
+	The state shared by smalljac_nagao_range and smalljac_nagao_merge_range is an array of k+1 unsigned longs L, where L[0] = k and L[i+1] is the bound used
+	for curve i, followed by the SMALLJAC_NAGAO_SUMS*k sums T.  Each child process fills in the entries for its curves, so when we add up the
+	states of the children (which start out zeroed) we get exactly the values they computed.
+*/
+static long smalljac_nagao_range (void *arg, int i, int procs, void *state)
+{
+	struct smalljac_nagao_job *job = (struct smalljac_nagao_job *) arg;
+	unsigned long *L = (unsigned long *) state;
+	double *T = (double *) (L + job->k + 1);
+	long count, j;
+	int sts;
+
+	for ( count = 0, j = i ; j < job->k ; j += procs ) {
+		sts = smalljac_nagao_curve (job->curves[j], job->start, job->end, job->sums, T + SMALLJAC_NAGAO_SUMS*j, L+j+1, job->checkpoint, job->stop, job->threshold);
+		if ( sts < 0 ) err_printf ("smalljac_nagao_sums: error %d for curve %s\n", sts, job->curves[j]);
+		if ( sts > 0 ) count++;
+	}
+	return count;
+}
+
+static void smalljac_nagao_merge_range (void *state, void *child_state)
+{
+	unsigned long *L = (unsigned long *) state, *M = (unsigned long *) child_state;
+	double *T = (double *) (L + L[0] + 1), *U = (double *) (M + L[0] + 1);
+	long i;
+
+	for ( i = 1 ; i <= L[0] ; i++ ) L[i] += M[i];
+	for ( i = 0 ; i < SMALLJAC_NAGAO_SUMS*L[0] ; i++ ) T[i] += U[i];
+}
+
+/*
+	Computes the selected Mestre-Nagao sums for the elliptic curves over Q specified by the strings curves[0],...,curves[k-1] over the primes in [start,end].
+	See smalljac.h for details.
+*/
+long smalljac_nagao_sums (char *curves[], long k, unsigned long start, unsigned long end, int sums, double S[], unsigned long last[],
+				         unsigned long checkpoint, int stop, double threshold)
+{
+	struct smalljac_nagao_job job;
+	unsigned long size, *L;
+	long count;
+	int procs;
+
+	if ( k <= 0 ) return 0;
+	if ( ! start ) start = 1;
+	if ( end < start || end > smalljac_max_p (1) ) return SMALLJAC_INVALID_INTERVAL;
+	if ( ! sums || (sums&~SMALLJAC_NAGAO_ALL) ) { err_printf ("smalljac_nagao_sums: invalid set of sums %d\n", sums);  return SMALLJAC_INVALID_FLAGS; }
+	if ( checkpoint && (stop < 1 || stop > SMALLJAC_NAGAO_SUMS || ! (sums&(1<<(stop-1)))) ) { err_printf ("smalljac_nagao_sums: early termination requires a selected sum\n");  return SMALLJAC_INVALID_FLAGS; }
+
+	procs = smalljac_parallel_threads();
+	if ( procs > k ) procs = k;
+	job.curves = curves;  job.k = k;  job.start = start;  job.end = end;  job.checkpoint = checkpoint;
+	job.sums = sums;  job.stop = stop;  job.threshold = threshold;
+	size = (k+1)*sizeof(unsigned long) + SMALLJAC_NAGAO_SUMS*k*sizeof(double);
+	L = mem_alloc (size);
+	L[0] = k;
+	count = smalljac_parallel_fork (procs, smalljac_nagao_range, &job, L, size, smalljac_nagao_merge_range);
+	memcpy (last, L+1, k*sizeof(unsigned long));
+	memcpy (S, L+k+1, SMALLJAC_NAGAO_SUMS*k*sizeof(double));
+	mem_free (L);
+	return count;
+}
+
+// flushes the batch of the child context child_state and adds its raw sums to the context state (for smalljac_Lpolys_reduce_file)
+static void smalljac_nagao_merge (void *state, void *child_state)
+{
+	struct smalljac_nagao_ctx *ctx = (struct smalljac_nagao_ctx *) state, *child = (struct smalljac_nagao_ctx *) child_state;
+	int i;
+
+	smalljac_nagao_flush (child);
+	for ( i = 0 ; i < SMALLJAC_NAGAO_SUMS ; i++ ) ctx->r[i] += child->r[i];
+	ctx->count += child->count;
+}
+
+/*
+	Computes the selected sums for the elliptic curve over Q whose L-poly data for [start,end] is in filename (text or binary, see smalljac_lpfile_open).
+	See smalljac.h for details.
+*/
+long smalljac_nagao_sums_file (char *filename, unsigned long start, unsigned long end, int sums, double S[SMALLJAC_NAGAO_SUMS])
+{
+	struct smalljac_nagao_ctx *ctx;
+	smalljac_lpfile_t lf;
+	smalljac_curve_t curve;
+	unsigned long fend;
+	char *str;
+	long result;
+	int err;
+
+	memset (S, 0, SMALLJAC_NAGAO_SUMS*sizeof(S[0]));
+	if ( ! sums || (sums&~SMALLJAC_NAGAO_ALL) ) { err_printf ("smalljac_nagao_sums_file: invalid set of sums %d\n", sums);  return SMALLJAC_INVALID_FLAGS; }
+	if ( ! (lf = smalljac_lpfile_open (filename)) ) return ( access (filename, R_OK) ? SMALLJAC_FILENOTFOUND : SMALLJAC_BADFILE );
+	smalljac_lpfile_info (lf, &str, 0, &fend, 0, 0, 0);
+	curve = smalljac_curve_init (str, &err);
+	smalljac_lpfile_close (lf);
+	if ( ! curve ) return err;
+	err = ( smalljac_curve_genus (curve) != 1 || smalljac_curve_nf_degree (curve) != 1 );
+	smalljac_curve_clear (curve);
+	if ( err ) return SMALLJAC_UNSUPPORTED_CURVE;
+	if ( end > fend ) end = fend;
+	if ( ! start ) start = 1;
+	if ( end < start ) return SMALLJAC_INVALID_INTERVAL;
+
+	ctx = mem_alloc (sizeof(*ctx));
+	ctx->sums = sums;
+	result = smalljac_Lpolys_reduce_file (filename, start, end, SMALLJAC_A1_ONLY, smalljac_nagao_callback, ctx, sizeof(*ctx), smalljac_nagao_merge);
+	if ( result >= 0 ) {
+		smalljac_nagao_flush (ctx);
+		smalljac_nagao_eval (S, ctx, end);
+		result = end;
+	}
+	mem_free (ctx);
+	return result;
+}
@@ -3,8 +3,11 @@
 #include <sys/wait.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
+#include <gmp.h>
 #include "cstd.h"
 #include "smalljac.h"
+#include "smalljac_internal.h"
 #include "ff_poly.h"
 
 /*
@@ -12,12 +15,14 @@
     See LICENSE file for license details.
 */
 
-#define MAX_THREADS	256	// Maximum number of threads.  Actual number will be set based on # cores available.
+#define MAX_THREADS	256	// Maximum number of threads.  Actual number will be set based on # cores available (or SMALLJAC_THREADS).
 int smalljac_parallel_threads ()
 {
 	int k, threads;
+	char *s;
 	
-	threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if ( (s = getenv ("SMALLJAC_THREADS")) && *s ) threads = atoi (s);
+	else threads = sysconf(_SC_NPROCESSORS_ONLN);
 	if ( threads <= 0 ) {
 		printf ("Couldn't determine online processor count, assuming just one.\n");
 		threads = 1;
@@ -54,7 +59,8 @@ int smalljac_parallel_argmin(unsigned long *p, int n) {
 	return min_arg;
 }
 
-long smalljac_parallel_Lpolys (smalljac_curve_t curve, unsigned long start, unsigned long end, unsigned long flags, int (*callback)(smalljac_curve_t, unsigned long, int, long[], int, void *), void *arg)
+// runs smalljac_Lpolys (or smalljac_Lpolys_set if S is non-null) in parallel child processes and merges the results
+static long _smalljac_parallel_Lpolys (smalljac_curve_t curve, unsigned long start, unsigned long end, smalljac_prime_set_t S, unsigned long flags, int (*callback)(smalljac_curve_t, unsigned long, int, long[], int, void *), void *arg)
 {
 	int child_rpipe[MAX_THREADS][2], child_wpipe[MAX_THREADS][2];
 	FILE *in[MAX_THREADS], *out[MAX_THREADS];
@@ -77,6 +83,7 @@ long smalljac_parallel_Lpolys (smalljac_curve_t curve, unsigned long start, unsi
 
 	if ( 1 == threads || end - start < 25 ) { // 25 was experimentally determined
 		// Fast-path a one-thread case
+		if ( S ) return smalljac_Lpolys_set (curve, start, end, S, flags, callback, arg);
 		return smalljac_Lpolys(curve, start, end, flags, callback, arg);
 	}
 
@@ -110,7 +117,8 @@ long smalljac_parallel_Lpolys (smalljac_curve_t curve, unsigned long start, unsi
 	}
 
 	if (child) {
-		result = smalljac_Lpolys (curve, start, end, flags, smalljac_parallel_callback, out[i]);
+		if ( S ) result = smalljac_Lpolys_set (curve, start, end, S, flags, smalljac_parallel_callback, out[i]);
+		else result = smalljac_Lpolys (curve, start, end, flags, smalljac_parallel_callback, out[i]);
 		p = -1;
 		fwrite(&p, sizeof(p), 1, out[i]);
 		fclose (out[i]);
@@ -199,3 +207,169 @@ long smalljac_parallel_Lpolys (smalljac_curve_t curve, unsigned long start, unsi
 	exit(1);
 #endif
 }
+
+long smalljac_parallel_Lpolys (smalljac_curve_t curve, unsigned long start, unsigned long end, unsigned long flags, int (*callback)(smalljac_curve_t, unsigned long, int, long[], int, void *), void *arg)
+{
+	if ( smalljac_store_eligible ((smalljac_curve *)curve, flags) ) return smalljac_store_Lpolys ((smalljac_curve *)curve, start, end, flags, callback, arg, smalljac_parallel_Lpolys);
+	return _smalljac_parallel_Lpolys (curve, start, end, 0, flags, callback, arg);
+}
+
+long smalljac_parallel_Lpolys_set (smalljac_curve_t curve, unsigned long start, unsigned long end, smalljac_prime_set_t S, unsigned long flags, int (*callback)(smalljac_curve_t, unsigned long, int, long[], int, void *), void *arg)
+	{ return S ? _smalljac_parallel_Lpolys (curve, start, end, S, flags, callback, arg) : SMALLJAC_INVALID_INTERVAL; }
+
+/*
+	Runs work(arg,i,procs,state) for i = 0,...,procs-1 in child processes, each of which works on its own copy of the state_size bytes at state
+	and sends back the value work returned followed by its copy of the state.  The parent then calls merge(state,child_state) for each child
+	in order of i (if merge is null the child states are discarded), so the result does not depend on the order in which the children finish.
+	The state must not contain pointers and should be an identity for merge when we are called.  If procs is 1 we just call work(arg,0,1,state).
+	Returns the sum of the values returned by work, or an error code (the first negative value returned by work, or SMALLJAC_INTERNAL_ERROR
+	if we could not create a child process or a child did not exit normally).
+*/
+long smalljac_parallel_fork (int procs, long (*work)(void *arg, int i, int procs, void *state), void *arg,
+					   void *state, unsigned long state_size, void (*merge)(void *state, void *child_state))
+{
+	FILE *in[MAX_THREADS];
+	pid_t child_pid[MAX_THREADS];
+	long result, total;
+	int fd[2], i, n, status;
+	char *buf;
+
+	if ( procs <= 1 ) return (*work) (arg, 0, 1, state);
+	if ( procs > MAX_THREADS ) procs = MAX_THREADS;
+	total = 0;
+	fflush(0);	// clear i/o buffers before we fork anything
+	for ( n = 0 ; n < procs ; n++ ) {
+		if ( pipe (fd) == -1 ) { err_printf ("Error creating pipe: %d\n", errno);  total = SMALLJAC_INTERNAL_ERROR;  break; }
+		child_pid[n] = fork();
+		if ( ! child_pid[n] ) {
+			// in child: do share n of the work and send the result followed by our copy of the state
+			close (fd[0]);
+			result = (*work) (arg, n, procs, state);
+			if ( write (fd[1], &result, sizeof(result)) != sizeof(result) || (state_size && write (fd[1], state, state_size) != state_size) ) exit(1);
+			close (fd[1]);
+			exit(0);
+		}
+		if ( child_pid[n] < 0 ) { err_printf ("Error forking child process: %d\n", errno);  close (fd[0]);  close (fd[1]);  total = SMALLJAC_INTERNAL_ERROR;  break; }
+		close (fd[1]);
+		in[n] = fdopen (fd[0], "r");
+	}
+	buf = ( state_size ? mem_alloc (state_size < 8 ? 8 : state_size) : 0 );
+	for ( i = 0 ; i < n ; i++ ) {
+		if ( fread (&result, sizeof(result), 1, in[i]) != 1 || (state_size && fread (buf, 1, state_size, in[i]) != state_size) ) { err_printf ("Unexpected EOF reading result from child %d\n", i);  result = SMALLJAC_INTERNAL_ERROR; }
+		fclose (in[i]);
+		waitpid (child_pid[i], &status, 0);
+		if ( ! WIFEXITED(status) || WEXITSTATUS(status) ) { err_printf ("Unexpected result from waitpid()\n");  result = SMALLJAC_INTERNAL_ERROR; }
+		if ( total < 0 ) continue;
+		if ( result < 0 ) { total = result;  continue; }
+		if ( merge ) (*merge) (state, buf);
+		total += result;
+	}
+	if ( buf ) mem_free (buf);
+	return total;
+}
+
+struct smalljac_reduce_ctx {
+	smalljac_lpfile_t *lf;
+	int files;
+	smalljac_curve *sc;
+	int n;
+	char *name;
+	unsigned long start, end, flags;
+	int (*callback)(smalljac_curve_t, unsigned long, int, long[], int, void *);
+	void *state;
+	long count;
+	int quit;
+};
+
+static int smalljac_reduce_callback (smalljac_curve_t curve, unsigned long q, int good, long a[], int n, void *arg)
+{
+	struct smalljac_reduce_ctx *ctx = (struct smalljac_reduce_ctx *) arg;
+
+	if ( good >= 0 ) ctx->count++;
+	if ( (*ctx->callback) (curve, q, good, a, n, ctx->state) ) return 1;
+	if ( good >= 0 ) ctx->quit = 1;			// a zero return for a filter callback (good=-1) just skips the record
+	return 0;
+}
+
+// scans chunk k of m of each of the files (making callbacks on state), returns the number of records processed or an error code
+static long smalljac_reduce_chunk (void *arg, int k, int m, void *state)
+{
+	struct smalljac_reduce_ctx *ctx = (struct smalljac_reduce_ctx *) arg;
+	long result;
+	int i;
+
+	ctx->state = state;
+	for ( i = 0 ; i < ctx->files && ! ctx->quit ; i++ ) {
+		smalljac_lpfile_chunk (ctx->lf[i], k, m);
+		result = smalljac_lpfile_scan (ctx->lf[i], ctx->sc, ctx->n, ctx->name, ctx->start, ctx->end, ctx->flags, smalljac_reduce_callback, ctx);
+		if ( result < 0 ) return result;
+	}
+	return ctx->count;
+}
+
+// opens a single data file (if filename is non-null) or the files prefix_jobs_jobid.lpd/.txt/.txt.gz and reduces over them in parallel child processes
+// the files are mapped before forking, so the children share the same (read-only) pages
+static long _smalljac_Lpolys_reduce (char *filename, char *prefix, int jobs, unsigned long start, unsigned long end, unsigned long flags,
+						  int (*callback)(smalljac_curve_t, unsigned long, int, long[], int, void *),
+						  void *state, unsigned long state_size, void (*merge)(void *state, void *child_state))
+{
+	smalljac_lpfile_t lf[SMALLJAC_MAX_JOBS];
+	smalljac_curve *sc;
+	struct smalljac_reduce_ctx ctx;
+	char name[1024], cstr[SMALLJAC_CURVE_STRING_LEN];
+	unsigned long fstart, fend;
+	char *curve;
+	long count;
+	int files, i, n, fn, err;
+
+	if ( start <= 0 ) start = 1;
+	if ( filename ) {
+		jobs = 1;
+		if ( ! (lf[0] = smalljac_lpfile_open (filename)) ) return ( access (filename, R_OK) ? SMALLJAC_FILENOTFOUND : SMALLJAC_BADFILE );
+		smalljac_lpfile_info (lf[0], 0, &fstart, &fend, 0, 0, 0);
+		if ( start < fstart ) { info_printf ("Increasing requested start from %ld to %ld\n", start, fstart); start = fstart; }
+		if ( end > fend )  { info_printf ("Decreasing requested end from %ld to %ld\n", end, fend); end = fend; }
+		strcpy (name, filename);
+	} else {
+		if ( strlen(prefix) + 64 > sizeof(name) ) { err_printf ("specified file prefix is too long for buffer\n"); return SMALLJAC_INTERNAL_ERROR; }
+		if ( jobs < 1 || jobs > SMALLJAC_MAX_JOBS ) { err_printf ("jobs must be between 1 and SMALLJAC_MAX_JOBS = %d\n", SMALLJAC_MAX_JOBS); return SMALLJAC_INTERNAL_ERROR; }
+	}
+
+	err = 0;  sc = 0;  n = 0;  files = 0;  count = 0;
+	for ( i = 0 ; i < jobs ; i++ ) {
+		if ( ! filename ) {
+			if ( ! (lf[i] = smalljac_lpfile_open_job (name, prefix, jobs, i, &err)) ) goto done;
+			smalljac_lpfile_info (lf[i], 0, &fstart, &fend, 0, 0, 0);
+			if ( start < fstart || end > fend ) { err_printf ("Requested data range [%ld,%ld] extends outside the data range [%ld,%ld] in the file %s\n", start, end, fstart, fend, name);  files++;  err = SMALLJAC_NODATA;  goto done; }
+		}
+		files++;
+		smalljac_lpfile_info (lf[i], &curve, 0, 0, 0, &fn, 0);
+		if ( ! i ) {
+			if ( ! (sc = smalljac_lpfile_curve (lf[i], name, flags, &n, &err)) ) goto done;
+			strcpy (cstr, curve);
+		} else {
+			if ( strcmp (curve, cstr) != 0 ) { err_printf ("inconsistent curve string in file %s\n%s\n", name, curve);  err = SMALLJAC_BADFILE; goto done; }
+			if ( fn && n > fn ) { err_printf ("data file %s only contains a1 coefficients (set SMALLJAC_A1_ONLY)\n", name);  err = SMALLJAC_BADFILE; goto done; }
+		}
+	}
+	if ( ! filename ) sprintf (name, "file with prefix %s", prefix);
+
+	// each child process handles chunk i of each file
+	ctx.lf = lf;  ctx.files = files;  ctx.sc = sc;  ctx.n = n;  ctx.name = name;  ctx.start = start;  ctx.end = end;  ctx.flags = flags;
+	ctx.callback = callback;  ctx.state = state;  ctx.count = 0;  ctx.quit = 0;
+	if ( (count = smalljac_parallel_fork (smalljac_parallel_threads(), smalljac_reduce_chunk, &ctx, state, state_size, merge)) < 0 ) err = count;
+done:
+	if ( sc ) smalljac_curve_clear (sc);
+	for ( i = 0 ; i < files ; i++ ) smalljac_lpfile_close (lf[i]);
+	return ( err ? err : count );
+}
+
+long smalljac_Lpolys_reduce_file (char *filename, unsigned long start, unsigned long end, unsigned long flags,
+						 int (*callback)(smalljac_curve_t curve, unsigned long q, int good, long a[], int n, void *state),
+						 void *state, unsigned long state_size, void (*merge)(void *state, void *child_state))
+	{ return _smalljac_Lpolys_reduce (filename, 0, 1, start, end, flags, callback, state, state_size, merge); }
+
+long smalljac_Lpolys_reduce_files (char *prefix, int jobs, unsigned long start, unsigned long end, unsigned long flags,
+						  int (*callback)(smalljac_curve_t curve, unsigned long q, int good, long a[], int n, void *state),
+						  void *state, unsigned long state_size, void (*merge)(void *state, void *child_state))
+	{ return _smalljac_Lpolys_reduce (0, prefix, jobs, start, end, flags, callback, state, state_size, merge); }
@@ -0,0 +1,199 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <gmp.h>
+#include "mpzutil.h"
+#include "smalljac.h"
+#include "smalljac_internal.h"
+#include "cstd.h"
+
+/*
+    Copyright (c) 2026 The smalljac contributors
+    See LICENSE file for license details.
+*/
+
+/*
+	Prime sets allow smalljac_Lpolys_set to restrict its attention to a precomputed set of primes without making a
+	SMALLJAC_FILTER callback for every prime in the interval (and then rejecting most of them).  A prime set is
+	either a sorted list of primes, a bitmap of primes over an interval, or a union of residue classes modulo m.
+	The residue class test is compiled into a bitmap indexed by p mod m, so the per-prime cost is a single bit test, and
+	smalljac_Lpolys_set uses prime_enum_mod to sieve only the specified classes (rather than enumerating every prime).
+
+	As with smalljac_Lpolys_list, entries of lists and bits set in bitmaps are assumed to be primes (this is not verified).
+*/
+
+#define SMALLJAC_PRIME_SET_LIST		1
+#define SMALLJAC_PRIME_SET_BITMAP	2
+#define SMALLJAC_PRIME_SET_RESIDUES	3
+
+typedef struct smalljac_prime_set_struct {
+	int type;
+	unsigned long *primes;										// sorted list (type LIST)
+	long n;
+	unsigned long *bm;										// bit i set iff start+i is in the set (type BITMAP), or iff i mod m is an allowed class (type RESIDUES)
+	unsigned long start, end;
+	unsigned long m;
+	unsigned long *r;										// the allowed classes mod m (type RESIDUES)
+	int k;
+} smalljac_prime_set;
+
+smalljac_prime_set_t smalljac_prime_set_list (unsigned long primes[], long n)
+{
+	smalljac_prime_set *S;
+	register long i;
+
+	if ( n <= 0 ) return 0;
+	for ( i = 1 ; i < n ; i++ ) if ( primes[i] <= primes[i-1] ) { err_printf ("smalljac_prime_set_list: prime list is not sorted (%lu <= %lu)\n", primes[i], primes[i-1]);  return 0; }
+	S = mem_alloc (sizeof(*S));
+	S->type = SMALLJAC_PRIME_SET_LIST;
+	S->primes = mem_alloc (n*sizeof(*S->primes));
+	memcpy (S->primes, primes, n*sizeof(*S->primes));
+	S->n = n;  S->start = primes[0];  S->end = primes[n-1];
+	return (smalljac_prime_set_t) S;
+}
+
+smalljac_prime_set_t smalljac_prime_set_bitmap (unsigned long bm[], unsigned long start, unsigned long end)
+{
+	smalljac_prime_set *S;
+	register long w;
+
+	if ( end < start ) return 0;
+	S = mem_alloc (sizeof(*S));
+	S->type = SMALLJAC_PRIME_SET_BITMAP;
+	w = (end-start)/64+1;
+	S->bm = mem_alloc (w*sizeof(*S->bm));
+	memcpy (S->bm, bm, w*sizeof(*S->bm));
+	if ( ((end-start)&0x3F) != 0x3F ) S->bm[w-1] &= (1UL<<(((end-start)&0x3F)+1))-1;		// clear bits past end
+	S->start = start;  S->end = end;
+	return (smalljac_prime_set_t) S;
+}
+
+smalljac_prime_set_t smalljac_prime_set_residues (unsigned long m, unsigned long r[], int k)
+{
+	smalljac_prime_set *S;
+	register int i;
+
+	if ( ! m || m > SMALLJAC_PRIME_SET_MAX_MODULUS || k <= 0 ) return 0;
+	S = mem_alloc (sizeof(*S));
+	S->type = SMALLJAC_PRIME_SET_RESIDUES;
+	S->bm = mem_alloc ((m/64+1)*sizeof(*S->bm));
+	for ( i = 0 ; i < k ; i++ ) S->bm[(r[i]%m)>>6] |= 1UL << ((r[i]%m)&0x3F);
+	S->r = mem_alloc (k*sizeof(*S->r));
+	memcpy (S->r, r, k*sizeof(*S->r));
+	S->m = m;  S->k = k;  S->start = 1;  S->end = ~0UL;
+	return (smalljac_prime_set_t) S;
+}
+
+void smalljac_prime_set_clear (smalljac_prime_set_t set)
+{
+	smalljac_prime_set *S = (smalljac_prime_set *) set;
+
+	if ( ! S ) return;
+	if ( S->primes ) mem_free (S->primes);
+	if ( S->bm ) mem_free (S->bm);
+	if ( S->r ) mem_free (S->r);
+	mem_free (S);
+}
+
+int smalljac_prime_set_contains (smalljac_prime_set_t set, unsigned long p)
+{
+	smalljac_prime_set *S = (smalljac_prime_set *) set;
+	register long lo, hi, mid;
+
+	if ( p < S->start || p > S->end ) return 0;
+	switch ( S->type ) {
+	case SMALLJAC_PRIME_SET_LIST:
+		for ( lo = 0, hi = S->n-1 ; lo <= hi ; ) {
+			mid = (lo+hi)/2;
+			if ( S->primes[mid] == p ) return 1;
+			if ( S->primes[mid] < p ) lo = mid+1; else hi = mid-1;
+		}
+		return 0;
+	case SMALLJAC_PRIME_SET_BITMAP: p -= S->start;  return (S->bm[p>>6]>>(p&0x3F))&1;
+	case SMALLJAC_PRIME_SET_RESIDUES: p %= S->m;  return (S->bm[p>>6]>>(p&0x3F))&1;
+	}
+	return 0;
+}
+
+struct smalljac_set_state {
+	smalljac_curve *sc;
+	unsigned long flags, pbitmask, pbits;
+	int (*callback)(smalljac_curve_t curve, unsigned long p, int good, long a[], int n, void *arg);
+	void *arg;
+	int error;
+};
+
+// returns 1 to continue, 0 to stop (error is set if this is due to an internal error)
+static inline int smalljac_set_process (struct smalljac_set_state *st, unsigned long p)
+{
+	register int sts;
+
+	if ( (p&st->pbitmask) != st->pbits ) return 1;
+	if ( (st->flags&SMALLJAC_FILTER) && ! (*st->callback) ((smalljac_curve_t)st->sc, p, -1, 0, 0, st->arg) ) return 1;
+	sts = smalljac_Lpolys_Q_prime (st->sc, p, ! mpz_divisible_ui_p (st->sc->D,p), st->flags, st->callback, st->arg);
+	if ( sts < 0 ) { st->error = 1;  return 0; }
+	return sts;
+}
+
+/*
+	Same as smalljac_Lpolys, except that only primes in [start,end] that lie in the prime set S are processed.
+	The split/high flags are honored, so jobs may be partitioned as usual (see smalljac_parallel_Lpolys_set).
+	Currently only supported for curves defined over Q (or at degree-1 primes).
+*/
+long smalljac_Lpolys_set (smalljac_curve_t curve, unsigned long start, unsigned long end, smalljac_prime_set_t set, unsigned long flags,
+				      int (*callback)(smalljac_curve_t curve, unsigned long p, int good, long a[], int n, void *arg), void *arg)
+{
+	struct smalljac_set_state st;
+	smalljac_prime_set *S;
+	prime_enum_mod_ctx_t *ctx;
+	register unsigned long p, w, x, i, j, k;
+	int sts, quit;
+
+	smalljac_init ();
+	S = (smalljac_prime_set *) set;
+	st.sc = (smalljac_curve *) curve;
+	if ( ! S ) return SMALLJAC_INVALID_INTERVAL;
+	if ( end < start || end > smalljac_curve_max_p(st.sc) ) return SMALLJAC_INVALID_INTERVAL;
+	if ( ! st.sc->Qflag ) return SMALLJAC_NOT_OVER_Q;
+	if ( st.sc->nfd > 1 && ! (flags&SMALLJAC_DEGREE1_ONLY) ) { err_printf ("smalljac_Lpolys_set: SMALLJAC_DEGREE1_ONLY flag must be set for curves over number fields\n");  return SMALLJAC_INVALID_FLAGS; }
+	if ( (sts = smalljac_Lpolys_check_flags (st.sc, flags)) < 0 ) return sts;
+	if ( start < S->start ) start = S->start;
+	if ( end > S->end ) end = S->end;
+	if ( end < start ) return (long) end;
+
+	st.flags = flags;  st.callback = callback;  st.arg = arg;  st.error = 0;
+	st.pbitmask = (flags&SMALLJAC_SPLIT)>>SMALLJAC_SPLIT_SHIFT;
+	st.pbits = (flags&SMALLJAC_HIGH)>>SMALLJAC_HIGH_SHIFT;
+	smalljac_Lpolys_Q_setup (st.sc, start);
+
+	p = 0;  quit = 1;
+	switch ( S->type ) {
+	case SMALLJAC_PRIME_SET_LIST:
+		for ( i = 0, j = S->n ; i < j ; ) { k = (i+j)/2;  if ( S->primes[k] < start ) i = k+1; else j = k; }		// binary search for the first prime >= start
+		for ( ; i < S->n && (p = S->primes[i]) <= end ; i++ ) if ( ! smalljac_set_process (&st, p) ) goto done;
+		break;
+	case SMALLJAC_PRIME_SET_BITMAP:
+		j = start-S->start;  k = end-S->start;
+		for ( i = j>>6 ; i <= (k>>6) ; i++ ) {
+			x = S->bm[i];
+			if ( i == (j>>6) ) x &= ~0UL << (j&0x3F);
+			while ( x ) {
+				w = __builtin_ctzl (x);  x &= x-1;
+				if ( (i<<6)+w > k ) break;
+				p = S->start + (i<<6) + w;
+				if ( ! smalljac_set_process (&st, p) ) goto done;
+			}
+		}
+		break;
+	case SMALLJAC_PRIME_SET_RESIDUES:
+		ctx = prime_enum_mod_start (start, end, S->m, S->r, S->k);
+		while ( (p = prime_enum_mod(ctx)) ) if ( ! smalljac_set_process (&st, p) ) break;
+		prime_enum_mod_end (ctx);
+		if ( p ) goto done;
+		break;
+	}
+	quit = 0;
+done:
+	if ( st.error ) { printf ("smalljac internal error at p=%lu\n", p);  return SMALLJAC_INTERNAL_ERROR; }
+	return (long) ( quit ? p : end );
+}
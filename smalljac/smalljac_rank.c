@@ -0,0 +1,184 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <gmp.h>
+#include "smalljac.h"
+#include "smalljac_internal.h"
+#include "prime.h"
+#include "cstd.h"
+
+/*
+    Copyright (c) 2026 The smalljac contributors
+    See LICENSE file for license details.
+*/
+
+/*
+	Upper bounds on the analytic rank of an elliptic curve E/Q via the Weil explicit formula (assuming GRH), see smalljac.h.
+
+	With zeros 1+i*gamma of L(E,s), Delta = log X, and the test function h(t) = (sin(Delta*t/2)/(Delta*t/2))^2, whose Fourier transform
+	is the triangle g(u) = (1/Delta)(1-|u|/Delta) supported on [-Delta,Delta], the explicit formula gives
+
+		r <= sum_gamma h(gamma) = (log N - 2log(2pi) - 2*euler_gamma)/Delta + 2(pi^2/6 - Li_2(e^-Delta))/Delta^2
+		                            - (2/Delta) sum_{p^k <= X} c_k(p) log p (1 - k log p/Delta) / p^k
+
+	where c_k(p) = alpha^k + beta^k is the trace of Frobenius over F_{p^k} at good p, and a_p^k at bad p.  The archimedean term
+	is the closed form of (1/2pi) int h(t) 2Re psi(1+it) dt.  The traces over F_{p^k} are obtained from a_p via smalljac_Lpoly_extend.
+
+	The prime sum is split into intervals handled by child processes (see smalljac_parallel_fork), each of which keeps a compensated
+	(Neumaier) sum, and the sums of the children are then combined in order.  At bad primes p > 3 we use the trace computed by smalljac_Lpolys,
+	at 2 and 3 we count points on the given model.  The model is assumed to be minimal.
+*/
+
+#define SMALLJAC_RANK_MIN_CHUNK		(1UL<<20)			// don't bother forking for intervals smaller than this
+#define SMALLJAC_RANK_TRIAL_BOUND	(1L<<20)			// bound for trial division of the discriminant
+#define SMALLJAC_EULER_GAMMA			0.57721566490153286061
+
+struct smalljac_rank_ctx {
+	double s, c;											// compensated sum s+c
+	double delta;
+	unsigned long X;
+	long ap[4];											// traces at 2 and 3 (when bad)
+};
+
+// Neumaier's variant of Kahan summation
+static inline void smalljac_rank_add (double *s, double *c, double x)
+{
+	double t = *s + x;
+
+	if ( fabs(*s) >= fabs(x) ) *c += (*s - t) + x; else *c += (x - t) + *s;
+	*s = t;
+}
+
+static int smalljac_rank_callback (smalljac_curve_t curve, unsigned long p, int good, long a[], int n, void *arg)
+{
+	struct smalljac_rank_ctx *ctx = (struct smalljac_rank_ctx *) arg;
+	double lp, q, t;
+	long b[1], ap;
+	int k;
+
+	lp = log ((double) p);
+	if ( good ) {
+		for ( k = 1, q = p ; q <= ctx->X ; k++, q *= p ) {
+			b[0] = a[0];
+			if ( k > 1 ) smalljac_Lpoly_extend (b, 1, p, k);					// b[0] = -(alpha^k+beta^k)
+			smalljac_rank_add (&ctx->s, &ctx->c, -(double)b[0] * lp * (1.0 - k*lp/ctx->delta) / q);
+		}
+	} else {
+		ap = ( p <= 3 ? ctx->ap[p] : ( n > 0 ? -a[0] : 0 ) );				// a[0] is the negated trace
+		if ( ! ap ) return 1;
+		for ( k = 1, q = p, t = ap ; q <= ctx->X ; k++, q *= p, t *= ap )
+			smalljac_rank_add (&ctx->s, &ctx->c, t * lp * (1.0 - k*lp/ctx->delta) / q);
+	}
+	return 1;
+}
+
+// computes a_p = p+1-#E(F_p) by counting points on the (possibly singular) reduction of the Weierstrass model at a tiny prime p
+static long smalljac_rank_tiny_trace (smalljac_curve *sc, long p)
+{
+	long a1, a2, a3, a4, a6, x, y, N;
+
+	a1 = mpz_fdiv_ui (sc->H[1], p);  a2 = mpz_fdiv_ui (sc->F[2], p);  a3 = mpz_fdiv_ui (sc->H[0], p);
+	a4 = mpz_fdiv_ui (sc->F[1], p);  a6 = mpz_fdiv_ui (sc->F[0], p);
+	for ( N = 1, x = 0 ; x < p ; x++ ) for ( y = 0 ; y < p ; y++ )
+		if ( ! ((y*y + a1*x*y + a3*y - x*x*x - a2*x*x - a4*x - a6) % p) ) N++;
+	return p+1-N;
+}
+
+// computes the compensated sum over the primes in interval i of procs (the state is the context, with s = c = 0), returns 0 or an error code
+static long smalljac_rank_interval (void *arg, int i, int procs, void *state)
+{
+	struct smalljac_rank_ctx *ctx = (struct smalljac_rank_ctx *) state;
+	unsigned long start, end;
+	long result;
+
+	start = ( i ? (ctx->X/procs)*i + 1 : 1 );  end = ( i < procs-1 ? (ctx->X/procs)*(i+1) : ctx->X );
+	result = smalljac_Lpolys ((smalljac_curve_t) arg, start, end, SMALLJAC_A1_ONLY, smalljac_rank_callback, ctx);
+	return ( result < 0 ? result : 0 );
+}
+
+// adds the compensated sum of a child to ours
+static void smalljac_rank_merge (void *state, void *child_state)
+{
+	struct smalljac_rank_ctx *ctx = (struct smalljac_rank_ctx *) state, *child = (struct smalljac_rank_ctx *) child_state;
+
+	smalljac_rank_add (&ctx->s, &ctx->c, child->s);
+	ctx->c += child->c;
+}
+
+/*
+	Computes the log of the conductor N of the curve, using the Weierstrass model to distinguish multiplicative and additive reduction
+	(at p > 3 the reduction is multiplicative iff p does not divide c4).  At additive primes f_p = 2 for p > 3, and at 2 and 3 we use
+	the bounds f_2 <= 8 and f_3 <= 5, along with f_p <= v_p(D) (Ogg's formula).  Any part of D that is not fully factored by
+	trial division contributes its log.  Also sets ap[2] and ap[3].  Returns 1 if the result is exact, 0 if it is an upper bound.
+*/
+static int smalljac_rank_conductor (double *logN, smalljac_curve *sc, long ap[4])
+{
+	prime_enum_ctx_t *ctx;
+	mpz_t D, P;
+	double x;
+	long p, v, f, e;
+	int exact;
+
+	mpz_init (D);  mpz_init (P);
+	mpz_abs (D, sc->D);
+	*logN = 0.0;  exact = 1;
+	ap[2] = ap[3] = 0;
+	ctx = prime_enum_start (2, SMALLJAC_RANK_TRIAL_BOUND, 0);
+	while ( mpz_cmp_ui (D, 1) > 0 && (p = prime_enum (ctx)) ) {
+		if ( ! mpz_divisible_ui_p (D, p) ) continue;
+		mpz_set_ui (P, p);
+		v = mpz_remove (D, D, P);
+		if ( p <= 3 ) {
+			ap[p] = smalljac_rank_tiny_trace (sc, p);
+			if ( ap[p] ) f = 1; else { f = ( p == 2 ? 8 : 5 );  exact = 0; }
+		} else {
+			f = ( mpz_divisible_ui_p (sc->f[1], p) ? 2 : 1 );
+		}
+		if ( f > v ) f = v;
+		*logN += f * log ((double) p);
+	}
+	prime_enum_end (ctx);
+	if ( mpz_cmp_ui (D, 1) > 0 ) {
+		x = mpz_get_d_2exp (&e, D);
+		*logN += log (x) + e * M_LN2;				// if D is prime then v_p(D) = 1 and f_p = 1, otherwise this is an upper bound
+		if ( ! mpz_probab_prime_p (D, 25) ) exact = 0;
+	}
+	mpz_clear (D);  mpz_clear (P);
+	return exact;
+}
+
+/*
+	Computes an upper bound on the analytic rank of the elliptic curve E/Q (specified in Weierstrass form) using the primes up to X.
+	See smalljac.h for details.
+*/
+int smalljac_analytic_rank_bound (smalljac_curve_t curve, unsigned long N, unsigned long X, double *bound, double *logN)
+{
+	smalljac_curve *sc = (smalljac_curve *) curve;
+	struct smalljac_rank_ctx ctx;
+	double s, c, lN, x, li2, t;
+	long result;
+	int k, procs, exact;
+
+	if ( sc->genus != 1 || ! sc->Qflag || sc->nfd > 1 || ! (sc->flags&SMALLJAC_CURVE_FLAG_WS) ) return SMALLJAC_UNSUPPORTED_CURVE;
+	if ( X < 2 || X > smalljac_curve_max_p (sc) ) return SMALLJAC_INVALID_INTERVAL;
+
+	exact = smalljac_rank_conductor (&lN, sc, ctx.ap);
+	if ( N ) { lN = log ((double) N);  exact = 1; }
+	if ( logN ) *logN = lN;
+	ctx.X = X;  ctx.delta = log ((double) X);
+
+	procs = smalljac_parallel_threads();
+	if ( procs > X / SMALLJAC_RANK_MIN_CHUNK ) procs = X / SMALLJAC_RANK_MIN_CHUNK;
+	ctx.s = ctx.c = 0.0;
+	result = smalljac_parallel_fork (procs, smalljac_rank_interval, curve, &ctx, sizeof(ctx), smalljac_rank_merge);
+	if ( result < 0 ) return (int) result;
+	s = ctx.s;  c = ctx.c;
+
+	// Li_2(e^-Delta) = sum x^k/k^2 with x = 1/X <= 1/2
+	x = 1.0 / (double) X;
+	for ( li2 = 0.0, t = x, k = 1 ; t/((double)k*k) > 1e-20 ; k++, t *= x ) li2 += t/((double)k*k);
+	*bound = (lN - 2.0*log(2.0*M_PI) - 2.0*SMALLJAC_EULER_GAMMA) / ctx.delta + 2.0*(M_PI*M_PI/6.0 - li2) / (ctx.delta*ctx.delta)
+		   - 2.0 * (s + c) / ctx.delta;
+	return exact;
+}
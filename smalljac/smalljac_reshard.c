@@ -0,0 +1,254 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <gmp.h>
+#include "mpzutil.h"
+#include "smalljac.h"
+#include "smalljac_internal.h"
+#include "cstd.h"
+
+/*
+    Copyright (c) 2026 The smalljac contributors
+    See LICENSE file for license details.
+*/
+
+/*
+	Resharding of L-poly data sets between job partitions and file formats.
+
+	lpdata job j of J (J = 2^k) handles the norms q with (q>>1) mod J = j, so when the input and output job counts are both powers of 2,
+	output shard j only depends on the input shards i with i = j mod min(J_in,J_out).  Output shards are distributed among child processes,
+	and each process writes its shards in batches, using a single heap merge (see smalljac_lpfile_merge) of the inputs the batch depends on
+	and dispatching each record to its shard.  Each input file is already in norm order, so no sorting is needed, the total work is linear
+	in the size of the data set, and memory use is independent of it.  The inputs are memory mapped before we fork (see smalljac_parallel_fork).
+
+	For curves over Q we also verify that each output shard contains exactly one record for every prime in the shard (the primes in the shard
+	are enumerated using prime_enum_mod), except that primes of bad reduction may be missing (e.g. if the input was written with SMALLJAC_GOOD_ONLY).
+	If any shard in a batch fails verification (or can't be written) all the files in the batch are removed.
+*/
+
+#define SMALLJAC_RESHARD_BATCH		32				// max number of output files a process has open at once (each has its own buffers)
+
+// parameters shared by all the shards
+struct smalljac_reshard_job {
+	smalljac_lpfile_t *lf;										// input files
+	int files, injobs;
+	smalljac_curve *sc;
+	int n;
+	char *curve;
+	char *prefix;												// output prefix
+	int jobs, format, threads;
+	unsigned long start, end, flags;
+};
+
+// state for one output shard
+struct smalljac_reshard_out {
+	smalljac_writer_t w;										// exactly one of w, lf, cf is set
+	smalljac_lpfile_t lf;
+	smalljac_colfile_t cf;
+	prime_enum_mod_ctx_t *pe;									// primes in the shard, null if we are not verifying
+	unsigned long next;											// next prime expected (0 if none)
+	unsigned long count;
+	char name[1024];
+};
+
+struct smalljac_reshard_pass {
+	struct smalljac_reshard_job *job;
+	struct smalljac_reshard_out *out[SMALLJAC_MAX_JOBS];				// indexed by shard, null for shards not in this pass
+	unsigned long mask;											// record q belongs to shard (q>>1)&mask
+	int err;
+};
+
+static int _reshard_callback (smalljac_curve_t curve, unsigned long q, int good, long a[], int n, void *arg)
+{
+	struct smalljac_reshard_pass *pass = (struct smalljac_reshard_pass *) arg;
+	struct smalljac_reshard_out *out;
+	int sts;
+
+	if ( ! (out = pass->out[(q>>1)&pass->mask]) ) return 1;
+	if ( out->pe ) {
+		while ( out->next && out->next < q ) {
+			if ( ! mpz_divisible_ui_p (pass->job->sc->D, out->next) ) { err_printf ("smalljac_reshard: no record for good prime %lu in %s\n", out->next, out->name);  pass->err = SMALLJAC_NODATA;  return 0; }
+			out->next = prime_enum_mod (out->pe);
+		}
+		if ( q != out->next ) { err_printf ("smalljac_reshard: unexpected record for %lu in %s (not prime or a duplicate)\n", q, out->name);  pass->err = SMALLJAC_BADFILE;  return 0; }
+		out->next = prime_enum_mod (out->pe);
+	}
+	if ( ! good && (pass->job->flags&SMALLJAC_GOOD_ONLY) ) return 1;
+	if ( out->lf ) sts = smalljac_lpfile_append (out->lf, q, good, a, n);
+	else if ( out->cf ) sts = smalljac_colfile_append (out->cf, q, good, a, n);
+	else sts = smalljac_writer_lpoly (out->w, q, good, a, n);
+	if ( ! sts ) { err_printf ("smalljac_reshard: error writing %s\n", out->name);  pass->err = SMALLJAC_WRITE_ERROR;  return 0; }
+	out->count++;
+	return 1;
+}
+
+// creates the output file for shard j and sets up verification, returns 0 on error
+static int smalljac_reshard_open (struct smalljac_reshard_job *job, struct smalljac_reshard_out *out, int j)
+{
+	static char *suffix[4] = { "txt", "txt.gz", "lpd", "lpc" };
+	char header[SMALLJAC_CURVE_STRING_LEN+128], *s;
+	unsigned long r[2];
+	int k, sts;
+
+	if ( job->jobs ) sprintf (out->name, "%s_%d_%d.%s", job->prefix, job->jobs, j, suffix[job->format]); else sprintf (out->name, "%s.%s", job->prefix, suffix[job->format]);
+	switch (job->format) {
+	case SMALLJAC_FORMAT_BINARY: sts = ( (out->lf = smalljac_lpfile_create (out->name, job->curve, job->start, job->end, job->sc->genus, job->n)) != 0 );  break;
+	case SMALLJAC_FORMAT_COLUMNAR:
+		if ( (sts = ((out->cf = smalljac_colfile_create (out->name, job->n, SMALLJAC_COLFILE_COMPRESS)) != 0)) ) sts = ( smalljac_colfile_curve (out->cf, job->curve) >= 0 );
+		break;
+	default:
+		if ( ! (out->w = smalljac_writer_create (out->name, job->format == SMALLJAC_FORMAT_GZIP ? SMALLJAC_WRITER_COMPRESS : 0, job->threads)) ) { sts = 0;  break; }
+		s = header + sprintf (header, "%s %lu %lu", job->curve, job->start, job->end);
+		if ( job->jobs ) s += sprintf (s, " %d %d", job->jobs, j);
+		strcpy (s, "\n");
+		sts = smalljac_writer_write (out->w, header, strlen(header));
+	}
+	if ( ! sts ) { err_printf ("smalljac_reshard: error creating file %s\n", out->name);  return 0; }
+
+	// over Q, enumerate the primes in the shard so we can verify coverage: p = 2j+1 mod 2*jobs, plus 2 in shard 1 (since (2>>1) = 1)
+	if ( job->sc->Qflag && job->sc->nfd == 1 ) {
+		if ( job->jobs > 1 ) { r[0] = 2*j+1;  k = 1;  if ( j == 1 ) r[k++] = 2;  out->pe = prime_enum_mod_start (job->start, job->end, 2*job->jobs, r, k); }
+		else { r[0] = 0;  out->pe = prime_enum_mod_start (job->start, job->end, 1, r, 1); }
+		if ( ! out->pe ) return 0;
+		out->next = prime_enum_mod (out->pe);
+	}
+	return 1;
+}
+
+// checks that there are no good primes left in the shard (if we are verifying), returns 0 if there are
+static int smalljac_reshard_verify (struct smalljac_reshard_job *job, struct smalljac_reshard_out *out)
+{
+	if ( ! out->pe ) return 1;
+	for ( ; out->next ; out->next = prime_enum_mod (out->pe) ) {
+		if ( ! mpz_divisible_ui_p (job->sc->D, out->next) ) { err_printf ("smalljac_reshard: no record for good prime %lu in %s\n", out->next, out->name);  return 0; }
+	}
+	return 1;
+}
+
+// closes the output file, returns 0 if an error occurred writing it
+static int smalljac_reshard_close (struct smalljac_reshard_out *out)
+{
+	int sts;
+
+	if ( out->pe ) prime_enum_mod_end (out->pe);
+	sts = 1;
+	if ( out->lf ) sts = smalljac_lpfile_close (out->lf);
+	if ( out->cf ) sts = smalljac_colfile_close (out->cf);
+	if ( out->w ) sts = smalljac_writer_close (out->w);
+	if ( ! sts ) err_printf ("smalljac_reshard: error writing %s\n", out->name);
+	return sts;
+}
+
+// writes the output shards j[0],...,j[k-1] in a single pass over the inputs they depend on, returns the number of records written or an error code
+static long smalljac_reshard_pass (struct smalljac_reshard_job *job, int j[], int k)
+{
+	struct smalljac_reshard_pass pass;
+	struct smalljac_reshard_out *out;
+	smalljac_lpfile_t in[SMALLJAC_MAX_JOBS];
+	unsigned long m;
+	long result, count;
+	int i, t, files;
+
+	memset (&pass, 0, sizeof(pass));
+	pass.job = job;
+	pass.mask = ( job->jobs > 1 ? job->jobs-1 : 0 );
+	out = mem_alloc (k*sizeof(*out));
+
+	// the inputs shard j depends on are those with index i = j mod m (all of them if either side is unpartitioned)
+	m = ( job->injobs > 1 && job->jobs > 1 ? (job->injobs < job->jobs ? job->injobs : job->jobs) : 1 );
+	for ( files = i = 0 ; i < job->files ; i++ ) {
+		for ( t = 0 ; t < k && (i&(m-1)) != (j[t]&(m-1)) ; t++ );
+		if ( t < k ) in[files++] = job->lf[i];
+	}
+	for ( t = 0 ; t < k ; t++ ) {
+		if ( ! smalljac_reshard_open (job, out+t, j[t]) ) { pass.err = SMALLJAC_WRITE_ERROR;  k = t+1;  goto done; }
+		pass.out[j[t]] = out+t;
+	}
+	result = smalljac_lpfile_merge (in, files, job->sc, job->n, job->prefix, job->start, job->end, job->flags&~SMALLJAC_GOOD_ONLY, _reshard_callback, &pass);
+	if ( result < 0 && ! pass.err ) pass.err = result;
+	for ( t = 0 ; t < k && ! pass.err ; t++ ) if ( ! smalljac_reshard_verify (job, out+t) ) pass.err = SMALLJAC_NODATA;
+done:
+	for ( t = 0 ; t < k ; t++ ) if ( ! smalljac_reshard_close (out+t) && ! pass.err ) pass.err = SMALLJAC_WRITE_ERROR;
+	if ( pass.err ) for ( t = 0 ; t < k ; t++ ) if ( out[t].name[0] ) unlink (out[t].name);
+	for ( count = t = 0 ; t < k ; t++ ) count += out[t].count;
+	mem_free (out);
+	return ( pass.err ? pass.err : count );
+}
+
+// writes the output shards i, i+procs, i+2*procs, ... of the job arg in batches, returns the number of records written or an error code
+static long smalljac_reshard_shards (void *arg, int i, int procs, void *state)
+{
+	struct smalljac_reshard_job *job = (struct smalljac_reshard_job *) arg;
+	int j[SMALLJAC_RESHARD_BATCH];
+	long result, count;
+	int k, shards;
+
+	shards = ( job->jobs ? job->jobs : 1 );
+	for ( count = 0 ; i < shards ; ) {
+		for ( k = 0 ; k < SMALLJAC_RESHARD_BATCH && i < shards ; i += procs ) j[k++] = i;
+		if ( (result = smalljac_reshard_pass (job, j, k)) < 0 ) return result;
+		count += result;
+	}
+	return count;
+}
+
+/*
+	Rewrites the data set in the files prefix_injobs_i.lpd/.txt/.txt.gz (or in the single file prefix if injobs = 0) as outprefix_outjobs_j.ext
+	(or outprefix.ext if outjobs = 0), where ext is determined by format, restricted to [start,end] (or the range of the input if start = end = 0).
+	See above for details.
+*/
+long smalljac_reshard (char *prefix, int injobs, char *outprefix, int outjobs, int format, unsigned long start, unsigned long end, unsigned long flags)
+{
+	smalljac_lpfile_t lf[SMALLJAC_MAX_JOBS];
+	smalljac_curve *sc;
+	char name[1024], cstr[SMALLJAC_CURVE_STRING_LEN], curve[SMALLJAC_CURVE_STRING_LEN+2];
+	unsigned long fstart, fend;
+	char *s;
+	struct smalljac_reshard_job job;
+	long count;
+	int files, procs, i, n, fn, err;
+
+	if ( strlen(prefix) + 64 > sizeof(name) || strlen(outprefix) + 64 > sizeof(name) ) { err_printf ("specified file prefix is too long for buffer\n"); return SMALLJAC_INTERNAL_ERROR; }
+	if ( injobs < 0 || injobs > SMALLJAC_MAX_JOBS || (injobs&(injobs-1)) ) { err_printf ("input jobs must be 0 or a power of 2 no larger than SMALLJAC_MAX_JOBS = %d\n", SMALLJAC_MAX_JOBS); return SMALLJAC_INTERNAL_ERROR; }
+	if ( outjobs < 0 || outjobs > SMALLJAC_MAX_JOBS || (outjobs&(outjobs-1)) ) { err_printf ("output jobs must be 0 or a power of 2 no larger than SMALLJAC_MAX_JOBS = %d\n", SMALLJAC_MAX_JOBS); return SMALLJAC_INTERNAL_ERROR; }
+	if ( format < SMALLJAC_FORMAT_TEXT || format > SMALLJAC_FORMAT_COLUMNAR ) { err_printf ("invalid output format %d\n", format);  return SMALLJAC_INVALID_FLAGS; }
+	if ( (flags & ~(SMALLJAC_GOOD_ONLY|SMALLJAC_A1_ONLY)) ) { err_printf ("smalljac_reshard only supports the flags SMALLJAC_GOOD_ONLY and SMALLJAC_A1_ONLY\n");  return SMALLJAC_INVALID_FLAGS; }
+
+	// open all the inputs before forking so the children share the mapped pages, and check that they are consistent and cover [start,end]
+	err = 0;  sc = 0;  n = 0;  count = 0;
+	files = ( injobs ? injobs : 1 );
+	for ( i = 0 ; i < files ; i++ ) lf[i] = 0;
+	for ( i = 0 ; i < files ; i++ ) {
+		if ( injobs ) {
+			if ( ! (lf[i] = smalljac_lpfile_open_job (name, prefix, injobs, i, &err)) ) goto done;
+		} else {
+			strcpy (name, prefix);
+			if ( ! (lf[i] = smalljac_lpfile_open (name)) ) { err = ( access (name, R_OK) ? SMALLJAC_FILENOTFOUND : SMALLJAC_BADFILE );  goto done; }
+		}
+		smalljac_lpfile_info (lf[i], &s, &fstart, &fend, 0, &fn, 0);
+		if ( ! i ) {
+			if ( ! start && ! end ) { start = fstart;  end = fend; }
+			if ( ! start ) start = 1;
+			if ( end < start ) { err_printf ("invalid range [%lu,%lu]\n", start, end);  err = SMALLJAC_INVALID_INTERVAL;  goto done; }
+			if ( ! (sc = smalljac_lpfile_curve (lf[i], name, flags, &n, &err)) ) goto done;
+			strcpy (cstr, s);
+		} else {
+			if ( strcmp (s, cstr) != 0 ) { err_printf ("inconsistent curve string in file %s\n%s\n", name, s);  err = SMALLJAC_BADFILE; goto done; }
+			if ( fn && n > fn ) { err_printf ("data file %s only contains a1 coefficients (set SMALLJAC_A1_ONLY)\n", name);  err = SMALLJAC_BADFILE; goto done; }
+		}
+		if ( start < fstart || end > fend ) { err_printf ("Requested data range [%ld,%ld] extends outside the data range [%ld,%ld] in the file %s\n", start, end, fstart, fend, name);  err = SMALLJAC_NODATA; goto done; }
+	}
+	if ( cstr[0] != '[' ) sprintf (curve, "[%s]", cstr); else strcpy (curve, cstr);
+
+	job.lf = lf;  job.files = files;  job.injobs = injobs;  job.sc = sc;  job.n = n;  job.curve = curve;
+	job.prefix = outprefix;  job.jobs = outjobs;  job.format = format;  job.start = start;  job.end = end;  job.flags = flags;
+	procs = smalljac_parallel_threads();
+	if ( procs > (outjobs ? outjobs : 1) ) procs = ( outjobs ? outjobs : 1 );
+	job.threads = ( procs > 1 ? 0 : -1 );							// when shards are written in parallel, each writer compresses in its own process
+	if ( (count = smalljac_parallel_fork (procs, smalljac_reshard_shards, &job, 0, 0, 0)) < 0 ) err = count;
+done:
+	if ( sc ) smalljac_curve_clear (sc);
+	for ( i = 0 ; i < files ; i++ ) if ( lf[i] ) smalljac_lpfile_close (lf[i]);
+	return ( err ? err : count );
+}
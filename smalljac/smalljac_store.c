@@ -0,0 +1,285 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <gmp.h>
+#include "smalljac.h"
+#include "smalljac_internal.h"
+#include "cstd.h"
+
+/*
+    Copyright (c) 2026 The smalljac contributors
+    See LICENSE file for license details.
+*/
+
+/*
+	L-series store (disabled by default, see smalljac_store_enable).
+
+	The store is a directory with a subdirectory for each curve, named by the 64-bit hash of its canonical model used by
+	the result cache (see smalljac_cache_curve_key), so different presentations of the same model share data.  Each file
+	in a curve directory is a binary data file (see smalljac_lpfile.c) named start_end_n.lpd that holds a record for every
+	prime in [start,end] (including primes of bad reduction), with n coefficients for each good record (1 or genus).
+	The curve string in each file is the one given by whoever computed it, when a file is used we parse it and check that
+	it has the same canonical model as the curve we want (this also guards against hash collisions).
+
+	smalljac_Lpolys (and smalljac_parallel_Lpolys) walk the requested range, replaying stored records where a file covers
+	the current prime and computing the gaps (which are then stored, provided they are at least SMALLJAC_STORE_MIN_SEGMENT
+	long).  Files are written to a temporary name and renamed when complete, so concurrent users of a shared store never see
+	partial files (two processes that make the same request at the same time may both compute it, but the result is the same).
+	Stored segments are never modified, overlapping segments are harmless (we always use the one that extends furthest).
+
+	Bad records are stored without coefficients, but smalljac_Lpolys reports some at bad primes (e.g. the Frobenius trace for
+	elliptic curves), so when a stored bad record is replayed we recompute it (there are only a handful per curve).
+*/
+
+#define SMALLJAC_STORE_MIN_SEGMENT		(1UL<<16)		// don't create files for gaps shorter than this
+#define SMALLJAC_STORE_MAX_DIR		512			// maximum length of the store directory name
+#define SMALLJAC_STORE_MAX_PATH		1024
+
+// the only flags that may be set for requests handled by the store (all others bypass it)
+#define SMALLJAC_STORE_FLAGS			(SMALLJAC_GOOD_ONLY|SMALLJAC_A1_ONLY|SMALLJAC_DEGREE1_ONLY)
+
+struct smalljac_store_segment {
+	unsigned long start, end;
+	int n, bad;
+};
+
+struct smalljac_store_ctx {
+	int (*callback)(smalljac_curve_t curve, unsigned long q, int good, long a[], int n, void *arg);
+	void *arg;
+	smalljac_lpfile_t lf;									// segment being written (null if none)
+	unsigned long q;										// last norm seen
+	unsigned long count, flags;
+	int n, good_only, stopped, replay;
+};
+
+static struct smalljac_store_state {
+	char dir[SMALLJAC_STORE_MAX_DIR];
+	int enabled, init, busy;
+	unsigned long stored, computed;
+} _sjs;
+
+int smalljac_store_enable (char *dir)
+{
+	_sjs.init = 1;
+	_sjs.enabled = 0;
+	if ( strlen(dir) >= SMALLJAC_STORE_MAX_DIR ) { err_printf ("smalljac_store_enable: directory name %s is too long\n", dir);  return 0; }
+	if ( mkdir (dir, 0755) < 0 && errno != EEXIST ) { err_printf ("smalljac_store_enable: unable to create directory %s\n", dir);  return 0; }
+	strcpy (_sjs.dir, dir);
+	_sjs.enabled = 1;
+	return 1;
+}
+
+void smalljac_store_disable (void)
+	{ _sjs.init = 1;  _sjs.enabled = 0; }
+
+void smalljac_store_stats (unsigned long *stored, unsigned long *computed)
+{
+	if ( stored ) *stored = _sjs.stored;
+	if ( computed ) *computed = _sjs.computed;
+}
+
+// returns 1 if a request for sc with the specified flags should go through the store (never while the store is computing a gap)
+int smalljac_store_eligible (smalljac_curve *sc, unsigned long flags)
+{
+	char *s;
+
+	if ( ! _sjs.init ) { _sjs.init = 1;  if ( (s = getenv ("SMALLJAC_STORE")) && *s ) smalljac_store_enable (s); }
+	return ( _sjs.enabled && ! _sjs.busy && sc->Qflag && sc->nfd == 1 && ! (flags&~SMALLJAC_STORE_FLAGS) );
+}
+
+// returns 1 if the two curves have the same canonical model
+static int _sjs_same_curve (smalljac_curve *a, smalljac_curve *b)
+{
+	register int i;
+
+	if ( a->type != b->type || a->genus != b->genus || a->degree != b->degree || a->f_inits != b->f_inits || mpz_cmp (a->D, b->D) ) return 0;
+	for ( i = 0 ; i < a->f_inits ; i++ ) if ( mpz_cmp (a->f[i], b->f[i]) ) return 0;
+	return 1;
+}
+
+// reads the segment names in dir, returns the number of segments (*pseg is allocated and must be freed by the caller)
+static int _sjs_list (char *dir, struct smalljac_store_segment **pseg)
+{
+	struct smalljac_store_segment *seg;
+	struct dirent *e;
+	DIR *d;
+	int k, max, cnt;
+
+	*pseg = 0;
+	if ( ! (d = opendir (dir)) ) return 0;
+	max = 16;  cnt = 0;
+	seg = mem_alloc (max*sizeof(*seg));
+	while ( (e = readdir (d)) ) {
+		if ( e->d_name[0] == '.' ) continue;
+		if ( cnt == max ) {
+			max *= 2;
+			seg = realloc (seg, max*sizeof(*seg));
+			if ( ! seg ) { fprintf (stderr, "Fatal error, realloc failed in smalljac_store\n");  abort(); }
+		}
+		if ( sscanf (e->d_name, "%lu_%lu_%d%n", &seg[cnt].start, &seg[cnt].end, &seg[cnt].n, &k) != 3 || strcmp (e->d_name+k, ".lpd") != 0 ) continue;
+		if ( seg[cnt].start > seg[cnt].end || seg[cnt].n < 1 ) continue;
+		seg[cnt++].bad = 0;
+	}
+	closedir (d);
+	*pseg = seg;
+	return cnt;
+}
+
+// callback for recomputing a bad record during replay
+static int _sjs_bad_callback (smalljac_curve_t curve, unsigned long q, int good, long a[], int n, void *arg)
+{
+	struct smalljac_store_ctx *ctx = (struct smalljac_store_ctx *) arg;
+
+	if ( (*ctx->callback) (curve, q, good, a, n, ctx->arg) ) return 1;
+	ctx->stopped = 1;
+	return 0;
+}
+
+static int _sjs_callback (smalljac_curve_t curve, unsigned long q, int good, long a[], int n, void *arg)
+{
+	struct smalljac_store_ctx *ctx = (struct smalljac_store_ctx *) arg;
+	long r;
+
+	ctx->q = q;
+	ctx->count++;
+	if ( ! good && ctx->replay && ! ctx->good_only ) {
+		_sjs.busy = 1;
+		r = smalljac_Lpolys (curve, q, q, ctx->flags, _sjs_bad_callback, ctx);
+		_sjs.busy = 0;
+		if ( r < 0 ) { err_printf ("smalljac_store: error %ld recomputing bad prime %lu for %s\n", r, q, ((smalljac_curve *)curve)->str);  ctx->stopped = 1; }
+		return ! ctx->stopped;
+	}
+	if ( ctx->lf && ((good && n < ctx->n) || ! smalljac_lpfile_append (ctx->lf, q, good, a, good ? n : 0)) ) {
+		smalljac_lpfile_close (ctx->lf);  ctx->lf = 0;								// give up on storing this segment (the caller removes the file)
+	}
+	if ( ! good && ctx->good_only ) return 1;
+	if ( (*ctx->callback) (curve, q, good, a, n, ctx->arg) ) return 1;
+	ctx->stopped = 1;
+	return 0;
+}
+
+// makes callbacks for the stored records with norms in [x,y] in the segment file name, returns 1 if we should continue, 0 if the callback stopped us, -1 if the file is invalid
+static int _sjs_replay (smalljac_curve *sc, char *name, unsigned long x, unsigned long y, int n, unsigned long flags, struct smalljac_store_ctx *ctx, char *verified)
+{
+	smalljac_curve *fc;
+	smalljac_lpfile_t lf;
+	char *curve;
+	long r;
+	int err, fn, g;
+
+	if ( ! (lf = smalljac_lpfile_open (name)) ) return -1;
+	smalljac_lpfile_info (lf, &curve, 0, 0, &g, &fn, 0);
+	if ( ! curve || g != sc->genus || fn < n ) { smalljac_lpfile_close (lf);  return -1; }
+	if ( strcmp (curve, verified) != 0 ) {
+		if ( strlen (curve) >= SMALLJAC_CURVE_STRING_LEN ) { smalljac_lpfile_close (lf);  return -1; }
+		fc = smalljac_curve_init (curve, &err);
+		if ( ! fc || ! _sjs_same_curve (sc, fc) ) {
+			err_printf ("smalljac_store: curve in %s does not match %s\n", name, sc->str);
+			if ( fc ) smalljac_curve_clear (fc);
+			smalljac_lpfile_close (lf);
+			return -1;
+		}
+		smalljac_curve_clear (fc);
+		strcpy (verified, curve);
+	}
+	ctx->lf = 0;  ctx->count = 0;  ctx->replay = 1;
+	r = smalljac_lpfile_scan (lf, sc, n, name, x, y, flags&SMALLJAC_GOOD_ONLY, _sjs_callback, ctx);
+	smalljac_lpfile_close (lf);
+	_sjs.stored += ctx->count;
+	if ( r < 0 ) return -1;
+	return ! ctx->stopped;
+}
+
+/*
+	Computes the records in [x,y] using the compute function (smalljac_Lpolys or smalljac_parallel_Lpolys), storing them if the range is long enough.
+	Returns 1 if we should continue, 0 if the callback stopped us, or an error code.
+*/
+static long _sjs_compute (smalljac_curve *sc, char *dir, unsigned long x, unsigned long y, int n, unsigned long flags, struct smalljac_store_ctx *ctx,
+					 long (*compute)(smalljac_curve_t, unsigned long, unsigned long, unsigned long, int (*)(smalljac_curve_t, unsigned long, int, long[], int, void *), void *))
+{
+	char tmp[SMALLJAC_STORE_MAX_PATH], name[SMALLJAC_STORE_MAX_PATH], host[64], curve[SMALLJAC_CURVE_STRING_LEN+2];
+	long r;
+
+	ctx->lf = 0;  ctx->count = 0;  ctx->replay = 0;
+	tmp[0] = '\0';
+	if ( y-x+1 >= SMALLJAC_STORE_MIN_SEGMENT ) {
+		if ( gethostname (host, sizeof(host)) < 0 ) strcpy (host, "localhost");
+		host[sizeof(host)-1] = '\0';
+		snprintf (tmp, sizeof(tmp), "%s/.tmp_%s_%d", dir, host, (int)getpid());
+		if ( sc->str[0] != '[' ) sprintf (curve, "[%s]", sc->str); else strcpy (curve, sc->str);
+		ctx->lf = smalljac_lpfile_create (tmp, curve, x, y, sc->genus, n);
+		flags &= ~SMALLJAC_GOOD_ONLY;										// stored segments include bad primes
+	}
+	_sjs.busy = 1;
+	r = (*compute) (sc, x, y, flags, _sjs_callback, ctx);
+	_sjs.busy = 0;
+	_sjs.computed += ctx->count;
+	if ( ctx->lf ) {
+		if ( r >= 0 && ctx->count && (! ctx->stopped || ctx->q-x+1 >= SMALLJAC_STORE_MIN_SEGMENT) ) {
+			// the segment covers [x,y] unless we were stopped, in which case it covers [x,q]
+			if ( ctx->stopped ) smalljac_lpfile_set_range (ctx->lf, x, ctx->q);
+			snprintf (name, sizeof(name), "%s/%lu_%lu_%d.lpd", dir, x, ctx->stopped ? ctx->q : y, n);
+			if ( smalljac_lpfile_close (ctx->lf) && rename (tmp, name) == 0 ) tmp[0] = '\0';
+		} else {
+			smalljac_lpfile_close (ctx->lf);
+		}
+		ctx->lf = 0;
+	}
+	if ( tmp[0] ) unlink (tmp);
+	if ( r < 0 ) return r;
+	return ! ctx->stopped;
+}
+
+/*
+	Handles a request for smalljac_Lpolys (or smalljac_parallel_Lpolys, as specified by compute) using the store, see above.
+	Returns the norm at which the callback returned 0, end if it never did, or an error code (as smalljac_Lpolys does).
+*/
+long smalljac_store_Lpolys (smalljac_curve *sc, unsigned long start, unsigned long end, unsigned long flags,
+					   int (*callback)(smalljac_curve_t curve, unsigned long q, int good, long a[], int n, void *arg), void *arg,
+					   long (*compute)(smalljac_curve_t, unsigned long, unsigned long, unsigned long, int (*)(smalljac_curve_t, unsigned long, int, long[], int, void *), void *))
+{
+	struct smalljac_store_segment *seg;
+	struct smalljac_store_ctx ctx;
+	char dir[SMALLJAC_STORE_MAX_DIR+32], name[SMALLJAC_STORE_MAX_PATH], verified[SMALLJAC_CURVE_STRING_LEN];
+	unsigned long x, y;
+	long r;
+	int i, j, k, n;
+
+	if ( end < start ) return (*compute) (sc, start, end, flags, callback, arg);						// let compute report the error
+	if ( ! start ) start = 1;
+	n = ( (flags&SMALLJAC_A1_ONLY) ? 1 : sc->genus );
+	snprintf (dir, sizeof(dir), "%s/%016lx", _sjs.dir, (unsigned long) smalljac_cache_curve_key (sc));
+	if ( mkdir (dir, 0755) < 0 && errno != EEXIST ) { err_printf ("smalljac_store: unable to create directory %s\n", dir);  return (*compute) (sc, start, end, flags, callback, arg); }
+	k = _sjs_list (dir, &seg);
+	memset (&ctx, 0, sizeof(ctx));
+	ctx.callback = callback;  ctx.arg = arg;  ctx.n = n;  ctx.flags = flags;  ctx.good_only = (flags&SMALLJAC_GOOD_ONLY);
+	verified[0] = '\0';
+	for ( x = start ; x <= end ; ) {
+		// use the usable segment containing x that extends furthest, if any
+		for ( i = -1, j = 0 ; j < k ; j++ ) if ( ! seg[j].bad && seg[j].n >= n && seg[j].start <= x && seg[j].end >= x && (i < 0 || seg[j].end > seg[i].end) ) i = j;
+		if ( i >= 0 ) {
+			y = ( seg[i].end < end ? seg[i].end : end );
+			snprintf (name, sizeof(name), "%s/%lu_%lu_%d.lpd", dir, seg[i].start, seg[i].end, seg[i].n);
+			ctx.q = x-1;  ctx.stopped = 0;
+			r = _sjs_replay (sc, name, x, y, n, flags, &ctx, verified);
+			if ( ! r ) break;
+			if ( r < 0 ) { seg[i].bad = 1;  x = ctx.q+1;  continue; }						// pick up where the bad file left off
+		} else {
+			// compute up to the next usable segment
+			for ( y = end, j = 0 ; j < k ; j++ ) if ( ! seg[j].bad && seg[j].n >= n && seg[j].start > x && seg[j].start <= y ) y = seg[j].start-1;
+			ctx.q = x-1;  ctx.stopped = 0;
+			r = _sjs_compute (sc, dir, x, y, n, flags, &ctx, compute);
+			if ( r < 0 ) { if ( seg ) mem_free (seg);  return r; }
+			if ( ! r ) break;
+		}
+		if ( y == end ) break;
+		x = y+1;
+	}
+	if ( seg ) mem_free (seg);
+	return ( ctx.stopped ? (long)ctx.q : (long)end );
+}
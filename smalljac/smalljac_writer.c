@@ -0,0 +1,301 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <zlib.h>
+#include <gmp.h>
+#include "smalljac.h"
+#include "smalljac_internal.h"
+#include "cstd.h"
+
+/*
+    Copyright (c) 2026 The smalljac contributors
+    See LICENSE file for license details.
+*/
+
+/*
+	Buffered output for data files (used by lpdata for its text files in place of fprintf).
+
+	Records are formatted directly into a large buffer, converting integers to decimal two digits at a time by table lookup,
+	and the buffer is written out one block of (at most) SMALLJAC_WRITER_BLOCK bytes at a time.  A block boundary never splits
+	a record (or any call to smalljac_writer_write that fits in a block), so for text files blocks always end with a newline.
+
+	With SMALLJAC_WRITER_COMPRESS each block is written as a separate gzip member, so the file can be read with gzip/zcat
+	(which decompress concatenated members), and the blocks are compressed by background processes (forked when the first block
+	is complete, so that they are not duplicated by the children of smalljac_parallel_Lpolys) while the caller carries on.
+	Blocks are handed out round robin and their results collected in the same order, so the output is the same for any number
+	of processes.  Each member carries an extra field with subfield id "SJ" holding its total length and uncompressed length
+	(little endian 32-bit integers, as in the rest of the gzip header), which allows a reader to locate the blocks without
+	decompressing anything and then decompress different blocks in parallel (see smalljac_lpfile_chunk).
+*/
+
+#define SMALLJAC_WRITER_BLOCK			(1<<20)						// uncompressed bytes per block
+#define SMALLJAC_WRITER_LEVEL			1							// zlib compression level (text data compresses almost as well at level 1 as at 6)
+#define SMALLJAC_WRITER_MAX_THREADS		32							// max background compression processes
+#define SMALLJAC_WRITER_MAX_RECORD		(21*(2*SMALLJAC_MAX_GENUS+1)+4)	// max length of a text record "q,a1,...,an\n"
+#define SMALLJAC_WRITER_HDRLEN		24							// length of the gzip member header we write
+#define SMALLJAC_WRITER_ZSIZE			(SMALLJAC_WRITER_HDRLEN+compressBound(SMALLJAC_WRITER_BLOCK)+8)
+
+struct smalljac_writer_worker {
+	pid_t pid;
+	int to, from;											// pipes to and from the worker
+	int busy;												// set if a block has been sent and its result not yet collected
+};
+
+typedef struct smalljac_writer_struct {
+	FILE *fp;
+	int flags, threads, next, started, err;
+	char *buf;												// current block
+	unsigned long len;
+	unsigned char *zbuf;										// compressed block
+	struct smalljac_writer_worker w[SMALLJAC_WRITER_MAX_THREADS];
+} smalljac_writer;
+
+static const char _sw_digits[201] =
+	"00010203040506070809101112131415161718192021222324252627282930313233343536373839404142434445464748495051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+
+// writes the decimal representation of x at s and returns a pointer to the end
+static inline char *_sw_utoa (char *s, unsigned long x)
+{
+	char buf[24];
+	register char *t;
+	register int len;
+
+	t = buf+sizeof(buf);
+	while ( x >= 100 ) { t -= 2;  memcpy (t, _sw_digits+2*(x%100), 2);  x /= 100; }
+	if ( x >= 10 ) { t -= 2;  memcpy (t, _sw_digits+2*x, 2); } else *--t = '0'+x;
+	len = buf+sizeof(buf)-t;
+	memcpy (s, t, len);
+	return s+len;
+}
+
+static inline char *_sw_ltoa (char *s, long x)
+	{ if ( x < 0 ) { *s++ = '-';  return _sw_utoa (s, -(unsigned long)x); }  return _sw_utoa (s, x); }
+
+static inline void _sw_put16 (unsigned char *s, unsigned x)  { s[0] = x;  s[1] = x>>8; }
+static inline void _sw_put32 (unsigned char *s, unsigned long x)  { s[0] = x;  s[1] = x>>8;  s[2] = x>>16;  s[3] = x>>24; }
+
+// read/write exactly len bytes on a pipe, returning 0 on failure
+static int _sw_read (int fd, void *buf, unsigned long len)
+{
+	register char *s;
+	register long k;
+
+	for ( s = buf ; len ; s += k, len -= k ) if ( (k = read (fd, s, len)) <= 0 ) { if ( k < 0 && errno == EINTR ) k = 0; else return 0; }
+	return 1;
+}
+
+static int _sw_write (int fd, void *buf, unsigned long len)
+{
+	register char *s;
+	register long k;
+
+	for ( s = buf ; len ; s += k, len -= k ) if ( (k = write (fd, s, len)) <= 0 ) { if ( k < 0 && errno == EINTR ) k = 0; else return 0; }
+	return 1;
+}
+
+// compresses buf[0..len-1] into a gzip member at out (which must hold SMALLJAC_WRITER_ZSIZE bytes), returns its length (0 on error)
+static unsigned long _sw_compress (unsigned char *out, char *buf, unsigned long len)
+{
+	z_stream z;
+	register unsigned long n;
+
+	memset (&z, 0, sizeof(z));
+	if ( deflateInit2 (&z, SMALLJAC_WRITER_LEVEL, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK ) return 0;
+	z.next_in = (unsigned char *)buf;  z.avail_in = len;
+	z.next_out = out + SMALLJAC_WRITER_HDRLEN;  z.avail_out = SMALLJAC_WRITER_ZSIZE - SMALLJAC_WRITER_HDRLEN - 8;
+	if ( deflate (&z, Z_FINISH) != Z_STREAM_END ) { deflateEnd (&z);  return 0; }
+	n = SMALLJAC_WRITER_HDRLEN + z.total_out + 8;
+	deflateEnd (&z);
+	memset (out, 0, SMALLJAC_WRITER_HDRLEN);
+	out[0] = 0x1f;  out[1] = 0x8b;  out[2] = 8;  out[3] = 4;  out[9] = 3;		// deflate, FEXTRA set, no mtime, unix
+	_sw_put16 (out+10, 12);
+	out[12] = 'S';  out[13] = 'J';
+	_sw_put16 (out+14, 8);
+	_sw_put32 (out+16, n);
+	_sw_put32 (out+20, len);
+	_sw_put32 (out+n-8, crc32 (crc32 (0, 0, 0), (unsigned char *)buf, len));
+	_sw_put32 (out+n-4, len);
+	return n;
+}
+
+// a background compression process: reads blocks (each preceded by its length) and returns gzip members (ditto) until it gets an empty block
+static void _sw_worker (int in, int out)
+{
+	unsigned char *zbuf;
+	char *buf;
+	uint32_t len;
+	unsigned long n;
+
+	buf = mem_alloc (SMALLJAC_WRITER_BLOCK);
+	zbuf = mem_alloc (SMALLJAC_WRITER_ZSIZE);
+	for (;;) {
+		if ( ! _sw_read (in, &len, sizeof(len)) || ! len || len > SMALLJAC_WRITER_BLOCK ) break;
+		if ( ! _sw_read (in, buf, len) ) break;
+		n = _sw_compress (zbuf, buf, len);
+		len = n;
+		if ( ! _sw_write (out, &len, sizeof(len)) || (n && ! _sw_write (out, zbuf, n)) ) break;
+	}
+	_exit (0);		// don't flush stdio buffers inherited from our parent
+}
+
+// forks the background compression processes, if this fails we compress blocks ourselves
+static void _sw_start (smalljac_writer *W)
+{
+	int to[2], from[2];
+	pid_t pid;
+	int i, j;
+
+	W->started = 1;
+	for ( i = 0 ; i < W->threads ; i++ ) {
+		if ( pipe (to) == -1 ) break;
+		if ( pipe (from) == -1 ) { close (to[0]);  close (to[1]);  break; }
+		pid = fork();
+		if ( pid < 0 ) { close (to[0]);  close (to[1]);  close (from[0]);  close (from[1]);  break; }
+		if ( ! pid ) {
+			close (to[1]);  close (from[0]);
+			for ( j = 0 ; j < i ; j++ ) { close (W->w[j].to);  close (W->w[j].from); }
+			_sw_worker (to[0], from[1]);
+		}
+		close (to[0]);  close (from[1]);
+		W->w[i].pid = pid;  W->w[i].to = to[1];  W->w[i].from = from[0];
+	}
+	W->threads = i;
+}
+
+// collects the result of the block most recently sent to the worker w and writes it
+static int _sw_collect (smalljac_writer *W, struct smalljac_writer_worker *w)
+{
+	uint32_t n;
+
+	w->busy = 0;
+	if ( ! _sw_read (w->from, &n, sizeof(n)) || ! n || n > SMALLJAC_WRITER_ZSIZE ) return 0;
+	if ( ! _sw_read (w->from, W->zbuf, n) ) return 0;
+	return ( fwrite (W->zbuf, 1, n, W->fp) == n );
+}
+
+// writes the current block, or hands it to the next background process for compression, returns 0 on error
+static int _sw_flush (smalljac_writer *W)
+{
+	struct smalljac_writer_worker *w;
+	unsigned long n;
+	uint32_t len;
+
+	if ( ! W->len ) return 1;
+	if ( ! (W->flags&SMALLJAC_WRITER_COMPRESS) ) {
+		if ( fwrite (W->buf, 1, W->len, W->fp) != W->len ) return 0;
+	} else {
+		if ( ! W->started ) _sw_start (W);
+		if ( ! W->threads ) {
+			if ( ! (n = _sw_compress (W->zbuf, W->buf, W->len)) || fwrite (W->zbuf, 1, n, W->fp) != n ) return 0;
+		} else {
+			w = W->w + W->next;
+			if ( w->busy && ! _sw_collect (W, w) ) return 0;
+			len = W->len;
+			if ( ! _sw_write (w->to, &len, sizeof(len)) || ! _sw_write (w->to, W->buf, len) ) return 0;
+			w->busy = 1;
+			W->next = (W->next+1) % W->threads;
+		}
+	}
+	W->len = 0;
+	return 1;
+}
+
+static int _sw_error (smalljac_writer *W)
+{
+	if ( ! W->err ) err_printf ("smalljac_writer: error writing data file\n");
+	W->err = 1;
+	return 0;
+}
+
+/*
+	Creates a file for buffered output.  If flags includes SMALLJAC_WRITER_COMPRESS the output is gzip compressed using the specified
+	number of background processes (0 to compress in the calling process, -1 to choose based on the number of cores available).
+	Returns null if the file cannot be created.
+*/
+smalljac_writer_t smalljac_writer_create (char *filename, int flags, int threads)
+{
+	smalljac_writer *W;
+
+	W = mem_alloc (sizeof(*W));
+	W->fp = fopen (filename, "w");
+	if ( ! W->fp ) { err_printf ("smalljac_writer_create: unable to create file %s\n", filename);  mem_free (W);  return 0; }
+	W->flags = flags;
+	W->buf = mem_alloc (SMALLJAC_WRITER_BLOCK);
+	if ( (flags&SMALLJAC_WRITER_COMPRESS) ) {
+		W->zbuf = mem_alloc (SMALLJAC_WRITER_ZSIZE);
+		if ( threads < 0 ) { threads = sysconf (_SC_NPROCESSORS_ONLN) / 4;  if ( ! threads && sysconf (_SC_NPROCESSORS_ONLN) > 1 ) threads = 1; }
+		W->threads = ( threads > SMALLJAC_WRITER_MAX_THREADS ? SMALLJAC_WRITER_MAX_THREADS : threads );
+	}
+	return (smalljac_writer_t) W;
+}
+
+// writes len bytes of data, returns 1 on success, 0 on error
+int smalljac_writer_write (smalljac_writer_t writer, void *data, unsigned long len)
+{
+	smalljac_writer *W = (smalljac_writer *) writer;
+	register char *s;
+	register unsigned long k;
+
+	if ( W->err ) return 0;
+	if ( W->len + len > SMALLJAC_WRITER_BLOCK && ! _sw_flush (W) ) return _sw_error (W);
+	for ( s = data ; len ; s += k, len -= k ) {
+		k = ( len < SMALLJAC_WRITER_BLOCK - W->len ? len : SMALLJAC_WRITER_BLOCK - W->len );
+		memcpy (W->buf + W->len, s, k);
+		W->len += k;
+		if ( W->len == SMALLJAC_WRITER_BLOCK && ! _sw_flush (W) ) return _sw_error (W);
+	}
+	return 1;
+}
+
+// writes the text record "q,a_1,...,a_n\n" (or "q,?\n" for bad reduction), as in the files written by lpdata, returns 1 on success, 0 on error
+int smalljac_writer_lpoly (smalljac_writer_t writer, unsigned long q, int good, long a[], int n)
+{
+	smalljac_writer *W = (smalljac_writer *) writer;
+	register char *s;
+	register int i;
+
+	if ( W->err ) return 0;
+	if ( n > 2*SMALLJAC_MAX_GENUS ) { err_printf ("smalljac_writer_lpoly: too many coefficients %d\n", n);  return 0; }
+	if ( W->len + SMALLJAC_WRITER_MAX_RECORD > SMALLJAC_WRITER_BLOCK && ! _sw_flush (W) ) return _sw_error (W);
+	s = _sw_utoa (W->buf + W->len, q);
+	if ( ! good || ! n ) {
+		*s++ = ',';  *s++ = '?';
+	} else {
+		for ( i = 0 ; i < n ; i++ ) { *s++ = ',';  s = _sw_ltoa (s, a[i]); }
+	}
+	*s++ = '\n';
+	W->len = s - W->buf;
+	return 1;
+}
+
+// flushes all output (waiting for any background compression to finish) and closes the file, returns 0 if an error occurred
+int smalljac_writer_close (smalljac_writer_t writer)
+{
+	smalljac_writer *W = (smalljac_writer *) writer;
+	struct smalljac_writer_worker *w;
+	uint32_t zero;
+	int i, status;
+
+	if ( ! W->err && ! _sw_flush (W) ) _sw_error (W);
+	// collect outstanding blocks oldest first, then tell the workers to exit
+	for ( i = 0 ; i < W->threads ; i++ ) {
+		w = W->w + (W->next+i) % W->threads;
+		if ( w->busy && ! _sw_collect (W, w) && ! W->err ) _sw_error (W);
+	}
+	zero = 0;
+	for ( i = 0 ; i < W->threads ; i++ ) {
+		_sw_write (W->w[i].to, &zero, sizeof(zero));
+		close (W->w[i].to);  close (W->w[i].from);
+		waitpid (W->w[i].pid, &status, 0);
+	}
+	if ( fclose (W->fp) && ! W->err ) _sw_error (W);
+	i = ! W->err;
+	mem_free (W->buf);
+	if ( W->zbuf ) mem_free (W->zbuf);
+	mem_free (W);
+	return i;
+}
@@ -14,90 +14,74 @@
 
 
 /*
-	We allocate three sections of memory, all of which will be small in practice (a few megabytes).
-	
-	(1) the hash table - 64 bits per entry
-	(2) the lookaside table - 128 bits per entry
-	(3) overflow lists - 128 bits per entry
-	
-	In most cases, only (1) gets used, and this is what we want to keep in cache.   We don't really
-	care about the size of the rest.
-	
-	Currently the number of overflow entries is equal the size of the hash table.  If we exceed this we
-	are getting a whole lot of collisions and should increase the table size anway.
+	The table is a single array of cache-line aligned buckets, 64 bits per entry.  When a bucket fills
+	up we move on to the next one (linear probing by buckets), which at a load factor of 0.5 almost
+	never happens.  The table can never fill, callers size it for the number of entries they will insert,
+	but if it somehow does we report this and drop the entry rather than exit - the search will then fail
+	(or fall back) in the usual way.
 */
 
-void smalljac_table_alloc (int bits)
+void smalljac_table_alloc (smalljac_tab_t *T, int bits)
 {
 	assert (bits>0);
 	if ( bits > 31 ) { err_printf ("smalljac_table_alloc: bits=%d too large!\n", bits);  exit (0); }
-	smalljac_htab = malloc(sizeof(*smalljac_htab)*(1<<bits));				// use malloc rather than mem_alloc - we don't need the memory initialized
-	// allocate space equal to table size for overflow - this could be made bigger
-	smalljac_htab_lists = malloc(sizeof(*smalljac_htab_lists)*2*(1<<bits));		// ditto
-	smalljac_htab_end = smalljac_htab_lists + 2*(1<<bits);
-	smalljac_table_bits = bits;
+	if ( bits < SMALLJAC_BUCKET_BITS ) bits = SMALLJAC_BUCKET_BITS;
+	// no need to use mem_alloc, we don't need the memory initialized
+	if ( posix_memalign ((void **)&T->buckets, sizeof(smalljac_bucket_t), sizeof(unsigned long)*(1UL<<bits)) ) {
+		err_printf ("smalljac_table_alloc: unable to allocate %lu bytes\n", sizeof(unsigned long)*(1UL<<bits));  abort ();
+	}
+	T->bits = bits;
+	T->mask = 0;  T->count = 0;  T->slots = 0;
 }
 
 
-void smalljac_table_init (int bits)
+void smalljac_table_free (smalljac_tab_t *T)
 {
-	static int warn;
-	
-	if ( bits > smalljac_table_bits )  {
-		if ( ! warn ) { printf ("%lu: smalljac_table_init: bits=%d exceeds allocated table size of %d bits\n", _ff_p, bits, smalljac_table_bits);  warn = 1; }
-		if ( bits-smalljac_table_bits > 4 ) { printf ("you must increase the allocated table size");  exit (0); }
-		bits = smalljac_table_bits;
-	}
-	smalljac_tabmask = (1UL<<bits)-1;
-	memset (smalljac_htab, 0, (1<<bits)*sizeof(unsigned long));
-	smalljac_htab_next = smalljac_htab_lists + (1<<bits);
+	free (T->buckets);
+	T->buckets = 0;
+	T->bits = 0;
 }
 
 
-void _smalljac_table_collision_insert (int index, unsigned long item)
+void smalljac_table_init (smalljac_tab_t *T, int bits)
 {
-//	printf ("collision at index %d\n", index);
-	if ( ! smalljac_htab_lists[index].item ) { smalljac_htab_lists[index].item = item;  smalljac_htab_lists[index].pNext = 0;  return; }
-	if ( smalljac_htab_next >= smalljac_htab_end ) {
-		err_printf ("%lu: Ran out of htab overflow entries smalljac_htab_next-smalljac_htab_lists = %ld - increase table size.\n", _ff_p, smalljac_htab_next-smalljac_htab_lists);  exit (0); }
-	smalljac_htab_next->item = item;
-	smalljac_htab_next->pNext = smalljac_htab_lists[index].pNext;
-	smalljac_htab_lists[index].pNext = smalljac_htab_next++;
+	if ( bits < SMALLJAC_BUCKET_BITS ) bits = SMALLJAC_BUCKET_BITS;
+	if ( bits > T->bits )  { smalljac_table_free (T);  smalljac_table_alloc (T, bits); }		// grow the table rather than exiting
+	T->mask = (1UL<<(bits-SMALLJAC_BUCKET_BITS))-1;
+	T->slots = 1UL<<bits;
+	T->count = 0;
+	memset (T->buckets, 0, T->slots*sizeof(unsigned long));
 }
 
 
-int _smalljac_table_get_matches (uint32_t matches[SMALLJAC_MAX_MATCHES], jac_t a[1], int index)
+void _smalljac_table_overflow_insert (smalljac_tab_t *T, smalljac_bucket_t *b, unsigned long item)
 {
-	register unsigned long item;
-	register struct smalljac_htab_list_item *pItem;
-	register int i;
+	register int k;
 	
-#if HECURVE_GENUS == 1
-	item = a[0].u[0];
-#else
-	item = (_ff_one(a[0].u[HECURVE_GENUS]) ? (1UL<<SMALLJAC_ITEM_BITS) : 0) + a[0].u[HECURVE_GENUS-1];
-	item <<= SMALLJAC_ITEM_BITS;
-	item += a[0].u[HECURVE_GENUS-2];
-#endif
-#if HECURVE_GENUS == 3
-	item <<= SMALLJAC_ITEM_BITS;
-	item += a[0].u[HECURVE_GENUS-3];
-#endif	
-	item <<= SMALLJAC_VBITS;
-	i = 0;
-	if ( (smalljac_htab[index] ^ item) <= SMALLJAC_VMASK ) matches[i++] = smalljac_htab[index]&SMALLJAC_VMASK;
-	if ( ! smalljac_htab_lists[index].item ) return i;
-	if ( (smalljac_htab_lists[index].item ^ item) <= SMALLJAC_VMASK ) matches[i++] = smalljac_htab_lists[index].item&SMALLJAC_VMASK;
-	if ( ! smalljac_htab_lists[index].pNext ) return i;
-	pItem = smalljac_htab_lists[index].pNext;
-	do {
-		if ( (pItem->item ^ item) <= SMALLJAC_VMASK ) {
-			if ( i >= SMALLJAC_MAX_MATCHES ) { err_printf ("Exceeded SMALLJAC_MAX_MATCHES=%d with p=%ld!\n", i, _ff_p);  exit (0); }
-			matches[i++] = pItem->item&SMALLJAC_VMASK;
-		}
-		pItem = pItem->pNext;
-	} while ( pItem );
-	return i;
+	if ( T->count >= T->slots ) { err_printf ("%lu: smalljac table full with %lu entries, entry dropped - increase table size.\n", _ff_p, T->count);  return; }
+	for (;;) {
+		b = ( b == T->buckets + T->mask ? T->buckets : b+1 );
+		for ( k = 0 ; k < SMALLJAC_BUCKET_SLOTS ; k++ ) if ( ! b->item[k] ) { b->item[k] = item;  T->count++;  return; }
+	}
 }
 
 
+// continues the probe sequence for item after the (full) bucket b, appending to the n matches already found
+int _smalljac_table_overflow_matches (smalljac_tab_t *T, uint32_t matches[SMALLJAC_MAX_MATCHES], int n, smalljac_bucket_t *b, unsigned long item)
+{
+	register smalljac_bucket_t *b0;
+	register unsigned hits;
+	int full;
+	
+	b0 = b;
+	do {
+		b = ( b == T->buckets + T->mask ? T->buckets : b+1 );
+		if ( b == b0 ) break;
+		hits = _smalljac_bucket_probe (b, item, &full);
+		for ( ; hits ; hits &= hits-1 ) {
+			if ( n >= SMALLJAC_MAX_MATCHES ) { err_printf ("Exceeded SMALLJAC_MAX_MATCHES=%d with p=%ld!\n", n, _ff_p);  return n; }
+			matches[n++] = b->item[__builtin_ctz(hits)]&SMALLJAC_VMASK;
+		}
+	} while ( full );
+	return n;
+}
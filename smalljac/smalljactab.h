@@ -16,19 +16,23 @@ extern "C" {
 #endif
 
 /*
-	Simple table lookup/insert code for smalljac.  This is designed for small tables
-        that fit in cache memory, using 64 bits per entry (128 bits per overflow entry).
-	This requires that the caller to either store the group entries in a seperate list
-	or reconstruct them as required.
-	
-        The table size is always a power of two and hashing is done by simply bit-masking
-	the group element for speed.  This can occasionally cause performance problems
-	but works well on average.
-	
-	Note that the table size used in smalljac_init may be any power of 2 smaller than
-	the allocated table size - this is desirable as it reduces the cose of initialization
-	and improves locality when this is as small as possible without creating too many
-	collisions.  A load factor of around 0.5 is works well.
+	Simple table lookup/insert code for smalljac, using 64 bits per entry.  Each entry packs
+	a fingerprint of the group element together with a value of up to SMALLJAC_VBITS bits,
+	so the caller must either store the group entries in a seperate list or reconstruct
+	them as required (matches are only candidates).
+
+	The table is open-addressed, with entries grouped into 64-byte buckets of SMALLJAC_BUCKET_SLOTS
+	entries that each occupy a single cache line.  The bucket is chosen by bit-masking the group element
+	for speed, and slots within a bucket are filled in order, so a lookup touches one cache line unless
+	the bucket is full (in which case we move on to the next bucket).  All the slots in a bucket are
+	compared at once without branching (the compiler can vectorize this).  Since the giant-step lookups
+	are essentially random accesses, smalljac_table_prefetch can be used to get the buckets for a batch
+	of giant steps on the way while they are computed/processed.
+
+	The table size is always a power of two.  The size used in smalljac_table_init may be any power of 2
+	smaller than the allocated table size - this is desirable as it reduces the cost of initialization
+	and improves locality when this is as small as possible.  A load factor of around 0.5 works well.
+	If a larger size is requested the table is reallocated.
 */
 
 #if HECURVE_GENUS == 1
@@ -45,33 +49,45 @@ extern "C" {
 #endif
 #define SMALLJAC_VMASK		((1UL<<SMALLJAC_VBITS)-1)
 #define SMALLJAC_MAX_MATCHES	128
+#define SMALLJAC_BUCKET_BITS	3
+#define SMALLJAC_BUCKET_SLOTS	(1<<SMALLJAC_BUCKET_BITS)			// 8 64-bit entries per 64-byte cache line
 
+typedef struct smalljac_bucket_struct {
+	unsigned long item[SMALLJAC_BUCKET_SLOTS];					// zero means empty, slots are filled in order
+} __attribute__ ((aligned (64))) smalljac_bucket_t;
 
-struct smalljac_htab_list_item {
-	unsigned long item;
-	struct smalljac_htab_list_item *pNext;
-};
-unsigned long *smalljac_htab;
-struct smalljac_htab_list_item *smalljac_htab_lists, *smalljac_htab_next, *smalljac_htab_end;
-ff_t smalljac_tabmask;
-int smalljac_table_bits;
+// all the state for a table lives here (rather than in globals) so that independent searches can each have their own table
+typedef struct smalljac_tab_struct {
+	smalljac_bucket_t *buckets;
+	unsigned long mask;						// bucket index mask for the size set by smalljac_table_init
+	unsigned long count, slots;				// entries inserted and number of slots in use
+	int bits;								// allocated size in entries, the size used by smalljac_table_init may be smaller
+} smalljac_tab_t;
 
-void smalljac_table_alloc (int bits);
-void smalljac_table_init (int bits);
+void smalljac_table_alloc (smalljac_tab_t *T, int bits);
+void smalljac_table_free (smalljac_tab_t *T);
+void smalljac_table_init (smalljac_tab_t *T, int bits);
 
-void _smalljac_table_collision_insert (int index, unsigned long item);
-int _smalljac_table_get_matches (uint32_t *matches, jac_t a[1], int index);
+void _smalljac_table_overflow_insert (smalljac_tab_t *T, smalljac_bucket_t *b, unsigned long item);
+int _smalljac_table_overflow_matches (smalljac_tab_t *T, uint32_t *matches, int n, smalljac_bucket_t *b, unsigned long item);
 
-static inline void smalljac_table_insert (jac_t a[1], uint32_t value)
+static inline unsigned long _smalljac_table_index (jac_t a[1])
+{
+#if HECURVE_GENUS == 1
+	return a[0].u[0];
+#else
+	return a[0].u[1];
+#endif
+}
+
+// returns the fingerprint of a shifted into position to be combined with a value
+static inline unsigned long _smalljac_table_item (jac_t a[1])
 {
-	register ff_t i;
 	register unsigned long item;
-	
+
 #if HECURVE_GENUS == 1
-	i = a[0].u[0] & smalljac_tabmask;
 	item = a[0].u[0];
 #else  // genus >= 2
-	i = a[0].u[1] & smalljac_tabmask;
 	item = (_ff_one(a[0].u[HECURVE_GENUS]) ? (1UL<<SMALLJAC_ITEM_BITS) : 0) + a[0].u[HECURVE_GENUS-1];
 	item <<= SMALLJAC_ITEM_BITS;
 	item += a[0].u[HECURVE_GENUS-2];
@@ -80,24 +96,54 @@ static inline void smalljac_table_insert (jac_t a[1], uint32_t value)
 	item += a[0].u[HECURVE_GENUS-3];
 #endif	
 #endif
-	item <<= SMALLJAC_VBITS;
-	item += value;
-	if ( ! smalljac_htab[i] ) { smalljac_htab[i] = item;  smalljac_htab_lists[i].item = 0;  return; }
-	_smalljac_table_collision_insert ((int)i, item);
+	return item << SMALLJAC_VBITS;
 }
 
+static inline void smalljac_table_prefetch (smalljac_tab_t *T, jac_t a[1])
+	{ __builtin_prefetch (T->buckets + (_smalljac_table_index(a) & T->mask)); }
 
-static inline int smalljac_table_lookup (uint32_t matches[SMALLJAC_MAX_MATCHES], jac_t a[1])
+static inline void smalljac_table_insert (smalljac_tab_t *T, jac_t a[1], uint32_t value)
 {
-	register ff_t i;
+	register smalljac_bucket_t *b;
+	register unsigned long item;
+	register int k;
 	
-#if HECURVE_GENUS == 1
-	i = a[0].u[0] & smalljac_tabmask;
-#else
-	i = a[0].u[1] & smalljac_tabmask;
-#endif
-	if ( ! smalljac_htab[i] ) return 0;		// usual case
-	return _smalljac_table_get_matches (matches, a, (int)i);
+	item = _smalljac_table_item (a) + value;
+	b = T->buckets + (_smalljac_table_index(a) & T->mask);
+	for ( k = 0 ; k < SMALLJAC_BUCKET_SLOTS ; k++ ) if ( ! b->item[k] ) { b->item[k] = item;  T->count++;  return; }
+	_smalljac_table_overflow_insert (T, b, item);
+}
+
+// returns a bitmap of the slots in b that match item, and sets *full if b has no empty slots
+static inline unsigned _smalljac_bucket_probe (smalljac_bucket_t *b, unsigned long item, int *full)
+{
+	register unsigned hits, empty;
+	register int k;
+
+	hits = empty = 0;
+	for ( k = 0 ; k < SMALLJAC_BUCKET_SLOTS ; k++ ) {
+		hits |= (unsigned)(((b->item[k]^item)>>SMALLJAC_VBITS) == 0) << k;
+		empty |= (unsigned)(b->item[k] == 0) << k;
+	}
+	*full = ! empty;
+	return hits & ~empty;
+}
+
+static inline int smalljac_table_lookup (smalljac_tab_t *T, uint32_t matches[SMALLJAC_MAX_MATCHES], jac_t a[1])
+{
+	register smalljac_bucket_t *b;
+	register unsigned long item;
+	register unsigned hits;
+	register int n;
+	int full;
+	
+	b = T->buckets + (_smalljac_table_index(a) & T->mask);
+	if ( ! b->item[0] ) return 0;
+	item = _smalljac_table_item (a);
+	hits = _smalljac_bucket_probe (b, item, &full);
+	for ( n = 0 ; hits ; hits &= hits-1 ) matches[n++] = b->item[__builtin_ctz(hits)]&SMALLJAC_VMASK;
+	if ( ! full ) return n;
+	return _smalljac_table_overflow_matches (T, matches, n, b, item);
 }
 
 #ifdef __cplusplus